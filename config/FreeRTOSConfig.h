@@ -102,7 +102,7 @@
 #define configTICK_RATE_HZ                                                        1024
 #define configMAX_PRIORITIES                                                      ( 5 )
 #define configMINIMAL_STACK_SIZE                                                  ( 256 )
-#define configTOTAL_HEAP_SIZE                                                     ( 13200 )
+#define configTOTAL_HEAP_SIZE                                                     ( 14864 )
 #define configMAX_TASK_NAME_LEN                                                   ( 10 )
 #define configUSE_16_BIT_TICKS                                                    0
 #define configIDLE_SHOULD_YIELD                                                   1
@@ -163,7 +163,7 @@
 #define INCLUDE_xTaskGetCurrentTaskHandle                                         1
 #define INCLUDE_uxTaskGetStackHighWaterMark                                       0
 #define INCLUDE_xTaskGetIdleTaskHandle                                            0
-#define INCLUDE_xTimerGetTimerDaemonTaskHandle                                    0
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle                                    1
 #define INCLUDE_pcTaskGetTaskName                                                 1
 #define INCLUDE_eTaskGetState                                                     1
 #define INCLUDE_xEventGroupSetBitFromISR                                          1
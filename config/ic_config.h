@@ -97,7 +97,42 @@
 #define IC_SPI_AFE_RESET_PIN   10
 #define IC_SPI_AFE_PDN_PIN   30
 
-#define IC_SPI_PENDIG_TRANSACTIONS  5
+#define IC_SPI_PENDIG_TRANSACTIONS  8   /**< Power of two, max length of a chain */
+#define IC_SPI_SYNC_TIMEOUT         64  /**< Default timeout of synchronous transfer (ticks) */
+
+/** @} */
+
+/*
+ *
+ * External flash
+ *
+ */
+/** @defgroup IC_FLASH
+ *  @{
+ */
+
+#define IC_FLASH_READ_CHUNKS        4     /**< Data transfers (max 255B each) in one fast-read chain */
+#define IC_FLASH_PROGRAM_POLL       1     /**< Status polling period while programming (ticks) */
+#define IC_FLASH_ERASE_POLL         16    /**< Status polling period while erasing (ticks) */
+#define IC_FLASH_SYNC_TIMEOUT       4096  /**< Max duration of single operation (ticks) */
+
+/** @} */
+
+/*
+ *
+ * BUS STATS
+ *
+ */
+/** @defgroup IC_BUS_STATS
+ *  @{
+ */
+
+#define IC_BUS_STATS_ENABLED          0   /**< TIMER1 (and HFCLK) runs while bus is not idle */
+#define IC_BUS_STATS_TIMER_FREQUENCY  NRF_TIMER_FREQ_125kHz
+#define IC_BUS_STATS_TICK_US          8
+#define IC_BUS_STATS_BUCKETS          12  /**< Last bucket - transactions longer than 16ms */
+#define IC_BUS_STATS_DEVICES          6
+#define IC_BUS_STATS_SEND_RETRIES     16
 
 /** @} */
 
@@ -120,7 +155,26 @@
 #define IC_TWI_IRQ_PRIORITY     IC_IRQ_PRIORITY_HIGH
 #define IC_TWI_FREQUENCY        IC_TWI_400KHZ_FREQUENCY
 
-#define IC_TWI_PENDIG_TRANSACTIONS  10
+#define IC_TWI_PENDIG_TRANSACTIONS  8   /**< Power of two */
+
+#define IC_TWI_MAX_RETRIES          3   /**< Retries of a single failed transaction */
+#define IC_TWI_RETRY_BASE_DELAY     2   /**< Backoff of the first retry (ticks), doubled per retry */
+#define IC_TWI_STUCK_BUS_ERRORS     4   /**< Consecutive errors treated as a stuck bus */
+#define IC_TWI_SYNC_TIMEOUT         64  /**< Default timeout of synchronous transaction (ticks) */
+
+/** @} */
+
+/*
+ *
+ * SYNC
+ *
+ */
+
+/** @defgroup IC_SYNC
+ *  @{
+ */
+
+#define IC_SYNC_WAITERS         4   /**< Tasks blocked on bus operations at once */
 
 /** @} */
 
@@ -151,6 +205,128 @@
 
 #define IC_STREAM1_TICK_PERIOD    32
 
+/** @} */
+/*
+ *
+ * RECORDER
+ *
+ */
+/** @defgroup IC_RECORDER
+ *  @{
+ */
+
+#define IC_RECORDER_PAGE_BUFFERS    4     /**< RAM pages waiting for flash (power of two) */
+#define IC_RECORDER_FLUSH_PERIOD    1024  /**< Max age of buffered data before partial page is written (ticks) */
+#define IC_RECORDER_MAX_CLIENTS     2
+#define IC_RECORDER_INDEX_SECTORS   16    /**< Index journal sectors, fit in first block */
+#define IC_RECORDER_MAX_BLOCKS      64    /**< Data blocks used by allocator */
+#define IC_RECORDER_TASK_PRIORITY   IC_FREERTOS_TASK_PRIORITY_MEDIUM
+
+/** @} */
+/*
+ *
+ * BULK
+ *
+ */
+/** @defgroup IC_BULK
+ *  @{
+ */
+
+#define IC_BULK_WINDOW              32    /**< Not acknowledged packets kept for retransmission */
+
+/** @} */
+/*
+ *
+ * MUX
+ *
+ */
+/** @defgroup IC_MUX
+ *  @{
+ */
+
+#define IC_MUX_PACKETS              8     /**< Notifications buffered (power of two) */
+#define IC_MUX_FLUSH_DEADLINE       32    /**< Max age of partially filled notification (ticks) */
+#define IC_MUX_SYNC_PERIOD          1024  /**< Absolute timestamp period (ticks) */
+#define IC_MUX_MAX_CLIENTS          2
+
+/** @} */
+/*
+ *
+ * CONNECTION PROFILES
+ *
+ */
+/** @defgroup IC_CONN_PROFILE
+ *  @{
+ */
+
+#define IC_CONN_IDLE_MIN_INTERVAL_MS        100
+#define IC_CONN_IDLE_MAX_INTERVAL_MS        200
+#define IC_CONN_IDLE_SLAVE_LATENCY          4
+#define IC_CONN_STREAMING_MIN_INTERVAL_MS   8
+#define IC_CONN_STREAMING_MAX_INTERVAL_MS   32
+#define IC_CONN_STREAMING_SLAVE_LATENCY     0
+#define IC_CONN_BULK_MIN_INTERVAL_MS        8
+#define IC_CONN_BULK_MAX_INTERVAL_MS        16
+#define IC_CONN_BULK_SLAVE_LATENCY          0
+#define IC_CONN_SUP_TIMEOUT_MS              4000
+
+#define IC_CONN_PROFILE_HOLDOFF   2048  /**< Ticks of lower demand before switching to slower profile */
+#define IC_CONN_PROFILE_RETRY     1024  /**< Ticks before repeating request refused by stack */
+
+/** @} */
+/*
+ *
+ * COMMANDS
+ *
+ */
+/** @defgroup IC_CMD
+ *  @{
+ */
+
+#define IC_CMD_QUEUE_LEN            8     /**< Frames waiting for command task (power of two) */
+#define IC_CMD_RESPONSE_QUEUE_LEN   8     /**< Responses queued by intake and timers (power of two) */
+#define IC_CMD_PENDED_MAX           2     /**< Different functions waiting for command task */
+#define IC_CMD_TASK_PRIORITY        IC_FREERTOS_TASK_PRIORITY_MEDIUM
+#define IC_CMD_BATCH_MAX            8     /**< Sub-commands in one batch */
+#define IC_CMD_BATCH_TIMEOUT        2048  /**< Ticks all sub-commands of batch have to arrive in */
+
+/** @} */
+/*
+ *
+ * SCHEDULER
+ *
+ */
+/** @defgroup IC_SCHEDULER
+ *  @{
+ */
+
+#define IC_SCHEDULER_ENTRIES    8             /**< Scheduled commands of all batches */
+#define IC_SCHEDULER_REPORTS    8             /**< Reports kept for central (power of two) */
+#define IC_SCHEDULER_GRACE      300           /**< Seconds entry can be late, then it expires */
+#define IC_SCHEDULER_MAX_SLEEP  3686400       /**< Ticks timer is armed for at most (1h) */
+#define IC_SCHEDULER_RETRY      16            /**< Ticks before resubmitting to full queue */
+#define IC_SCHEDULER_EPOCH      1514764800ul  /**< Clock before 01.01.2018 is not set */
+#define IC_SCHEDULER_FDS_FILE   0x5C4D        /**< FDS file of stored schedule */
+#define IC_SCHEDULER_FDS_KEY    0x0001
+
+/** @} */
+/*
+ *
+ * STREAM POLICY
+ *
+ */
+/** @defgroup IC_STREAM_POLICY
+ *  @{
+ */
+
+#define IC_STREAM_POLICY_PERIOD           256 /**< Link evaluation period (ticks) */
+#define IC_STREAM_POLICY_BUSY_THRESHOLD   4   /**< Refused stream frames per period - congestion */
+#define IC_STREAM_POLICY_RECOVERY_PERIODS 8   /**< Clean periods before stepping up */
+#define IC_STREAM_POLICY_SETTLE_PERIODS   2   /**< Periods not judged after step down */
+#define IC_STREAM_POLICY_MAX_RETRY        4   /**< Ticks producer waits for TX buffer */
+#define IC_STREAM_POLICY_ACC_DIVIDER      2   /**< ACC/PPG frames kept when ACC is decimated */
+#define IC_STREAM_POLICY_VITALS_DIVIDER   8   /**< ACC/PPG frames kept in vitals-only mode */
+
 /** @} */
 /*
  *
@@ -202,6 +378,12 @@
 
 #define IC_BQ27742_TWI_ADDRESS 0xAA
 
+#define IC_BQ_SAMPLE_FAST     pdMS_TO_TICKS(5000)     /**< Charging, low charge or high current */
+#define IC_BQ_SAMPLE_SLOW     pdMS_TO_TICKS(30000)
+#define IC_BQ_SAMPLE_SOC_LOW  15                      /**< State of charge (%) sampled fast */
+#define IC_BQ_SAMPLE_CURRENT  100                     /**< Average current (mA) sampled fast */
+#define IC_BQ_SNAPSHOT_STALE  pdMS_TO_TICKS(90000)    /**< Snapshot older than that is stale */
+
 /** @} */
 
 /*
@@ -218,6 +400,72 @@
 #define IC_LTC_MAX_VAL      0x3F
 #define IC_LTC_VIB_MIN_VAL  15
 #define IC_LTC_VIB_MAX_VAL  (0x3F-IC_LTC_VIB_MIN_VAL)
+#define IC_LTC_CURVES       2   /**< Slots of custom curves uploaded by central */
+#define IC_LTC_MAX_SLEEP    64  /**< Quanta (16 ticks) engine sleeps at most, bounds catching up */
+
+/** @} */
+
+/*
+ *
+ * PATTERN
+ *
+ */
+
+/** @defgroup IC_PATTERN
+ *  @{
+ */
+
+#define IC_PATTERN_SLOTS      2       /**< Patterns uploaded by central */
+#define IC_PATTERN_SLOT_SIZE  64      /**< Bytes of code in slot (multiple of 4) */
+#define IC_PATTERN_LOOPS      2       /**< Depth of nested loops */
+#define IC_PATTERN_MAX_STEPS  32      /**< Instructions run at once, loop without wait is stopped */
+#define IC_PATTERN_POLL       16      /**< Ticks between checks of WAIT_FOR */
+#define IC_PATTERN_FDS_FILE   0x5C50
+#define IC_PATTERN_FDS_KEY    1       /**< Key of the first slot, next slots follow */
+
+/** @} */
+
+/*
+ *
+ * LTC BUDGET
+ *
+ */
+
+/** @defgroup IC_LTC_BUDGET
+ *  @{
+ */
+
+#define IC_LTC_BUDGET_RED_UA      20000   /**< Current of channel at IC_LTC_MAX_VAL (uA) */
+#define IC_LTC_BUDGET_GREEN_UA    20000
+#define IC_LTC_BUDGET_BLUE_UA     20000
+#define IC_LTC_BUDGET_VIB_UA      80000
+#define IC_LTC_BUDGET_MAX_UA      120000  /**< Budget at IC_LTC_BUDGET_SOC_HIGH and above */
+#define IC_LTC_BUDGET_MIN_UA      40000   /**< Budget at IC_LTC_BUDGET_SOC_LOW and below */
+#define IC_LTC_BUDGET_SOC_HIGH    50      /**< State of charge (%) */
+#define IC_LTC_BUDGET_SOC_LOW     10
+#define IC_LTC_BUDGET_SOC_PERIOD  pdMS_TO_TICKS(60000)
+
+/** @} */
+
+/*
+ *
+ * SMART WAKE
+ *
+ */
+
+/** @defgroup IC_SMART_WAKE
+ *  @{
+ */
+
+#define IC_SMART_WAKE_EPOCH         30720     /**< Ticks of scored epoch (30s) */
+#define IC_SMART_WAKE_LIGHT_EPOCHS  2         /**< Light epochs in row starting sunrise */
+#define IC_SMART_WAKE_DELTA_RATIO   4         /**< Slow to fast EEG power of deep sleep */
+#define IC_SMART_WAKE_ACTIVITY      16        /**< Mean ACC change between samples of movement */
+#define IC_SMART_WAKE_RAMP          600       /**< Default sunrise length (s) */
+#define IC_SMART_WAKE_VIB_PERIOD    20480     /**< Ticks between vibration bursts (20s) */
+#define IC_SMART_WAKE_VIB_STEPS     8         /**< Bursts of rising intensity, then alarm ends */
+#define IC_SMART_WAKE_MAX_SLEEP     3686400   /**< Ticks timer waits for window at most (1h) */
+#define IC_SMART_WAKE_MAX_CLIENTS   2
 
 /** @} */
 
@@ -243,6 +491,8 @@ static inline int isr_context(){
 #define IC_FREERTOS_TASK_PRIORITY_LOW     1
 #define IC_FREERTOS_TASK_PRIORITY_LOWEST  0
 
+#define IC_HEAP_MIN_FREE  512   /**< Heap left at the end of init, less is reported (bytes) */
+
 #ifdef SEMAPHORE_H
 
 #define ALLOCK_SEMAPHORE(name)                                              \
@@ -85,6 +85,10 @@
 #include "ic_service_ads.h"
 
 #include "ic_service_stream1.h"
+#include "ic_service_recorder.h"
+#include "ic_service_bulk.h"
+#include "ic_service_mux.h"
+#include "ic_stream_policy.h"
 
 #include "ic_config.h"
 #include "ic_easy_ltc_driver.h"
@@ -92,15 +96,19 @@
 #include "ic_driver_ltc.h"
 #include "ic_driver_actuators.h"
 #include "ic_service_ltc.h"
+#include "ic_ltc_pattern.h"
 
 #include "ic_ble_service.h"
 
 #include "ic_service_time.h"
+#include "ic_scheduler.h"
+#include "ic_smart_wake.h"
 
 #include "ic_service_bas.h"
 
 #include "ic_driver_bq27742.h"
 #include "ic_driver_wdt.h"
+#include "ic_bus_stats.h"
 
 #define APP_TIMER_PRESCALER             0                                           /**< Value of the RTC1 PRESCALER register. */
 #define APP_TIMER_OP_QUEUE_SIZE         4                                           /**< Size of timer operation queues. */
@@ -226,55 +234,23 @@ static void power_up_all_systems(void){
 }
 
 #define WELCOME_PERIOD pdMS_TO_TICKS(500)
-#define PERIOD pdMS_TO_TICKS(2000)
+#define BYE_TIMEOUT    pdMS_TO_TICKS(3000)
 
 static void on_connect(void){
-  ic_actuator_set_ramp_func(IC_LEFT_BLUE_LED,   WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_BLUE_LED,  WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_LEFT_RED_LED,    WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_RED_LED,   WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_LEFT_GREEN_LED,  WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_GREEN_LED, WELCOME_PERIOD, 0, 0);
+  ic_pattern_play(IC_PATTERN_CONNECTED);
 }
 
 static void on_disconnect(void){
-  ic_actuator_set_ramp_func(IC_LEFT_RED_LED, WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_RED_LED, WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_LEFT_GREEN_LED, WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_GREEN_LED, WELCOME_PERIOD, 0, 0);
-  ic_actuator_set_off_func(IC_VIBRATOR, 0, 0, 0);
-  ic_actuator_set_off_func(IC_POWER_LEDS, 0, 0, 0);
-
-  ic_actuator_set_ramp_func(IC_LEFT_BLUE_LED, WELCOME_PERIOD>>1, 0, 3);
-  ic_actuator_set_ramp_func(IC_RIGHT_BLUE_LED, WELCOME_PERIOD>>1, 0, 3);
-  /*ic_actuator_set_triangle_func(IC_LEFT_BLUE_LED, PERIOD, 0, 5);*/
-  /*ic_actuator_set_triangle_func(IC_RIGHT_BLUE_LED, PERIOD, 0, 5);*/
+  ic_pattern_play(IC_PATTERN_DISCONNECTED);
 }
 
 #ifndef CHARGE_BYPASS
 static void on_charging(void){
-  ic_actuator_set_ramp_func(IC_RIGHT_RED_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_LEFT_GREEN_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_GREEN_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_LEFT_BLUE_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_BLUE_LED, PERIOD, 0, 0);
-  ic_actuator_set_off_func(IC_VIBRATOR, 0, 0, 0);
-  ic_actuator_set_off_func(IC_POWER_LEDS, 0, 0, 0);
-
-  ic_actuator_set_ramp_func(IC_LEFT_RED_LED, PERIOD, 0, 50);
-  /*ic_actuator_set_triangle_func(IC_RIGHT_RED_LED, PERIOD<<1, 0, 50);*/
+  ic_pattern_play(IC_PATTERN_CHARGING);
 }
 
 static void on_charged(void){
-  ic_actuator_set_ramp_func(IC_RIGHT_RED_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_LEFT_BLUE_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_GREEN_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_LEFT_RED_LED, PERIOD, 0, 0);
-  ic_actuator_set_ramp_func(IC_RIGHT_BLUE_LED, PERIOD, 0, 0);
-  ic_actuator_set_off_func(IC_VIBRATOR, 0, 0, 0);
-  ic_actuator_set_off_func(IC_POWER_LEDS, 0, 0, 0);
-
-  ic_actuator_set_ramp_func(IC_LEFT_GREEN_LED, PERIOD, 0, 30);
+  ic_pattern_play(IC_PATTERN_CHARGED);
 }
 
 static TimerHandle_t m_charging_timer_handle = NULL;
@@ -291,93 +267,15 @@ static void charging_timer_callback(TimerHandle_t xTimer){
 }
 #endif
 
-static void welcome(void){
-  ic_actuator_set_triangle_func(IC_LEFT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_LEFT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_LEFT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_RIGHT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_RIGHT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_RIGHT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-}
-
-static void welcome_wdt(void){
-  ic_actuator_set_triangle_func(IC_LEFT_RED_LED, PERIOD, PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_RIGHT_RED_LED, PERIOD, PERIOD+1, 63);
-  vTaskDelay(pdMS_TO_TICKS(PERIOD>>2));
-}
-
 void showoff(void){
-  ic_actuator_set_blink_func(IC_POWER_LEDS, WELCOME_PERIOD>>2, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_LEFT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_LEFT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_LEFT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_RIGHT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_RIGHT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_RIGHT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_VIBRATOR, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
+  ic_pattern_play(IC_PATTERN_SHOWOFF);
+  ic_pattern_wait(portMAX_DELAY);
 
   power_down_all_systems();
 
   NRF_POWER->SYSTEMOFF = 1;
 }
 
-static void showoff_light(void){
-  ic_actuator_set_blink_func(IC_POWER_LEDS, WELCOME_PERIOD>>2, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_LEFT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_LEFT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_LEFT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_RIGHT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_RIGHT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_RIGHT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-  ic_actuator_set_triangle_func(IC_VIBRATOR, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD));
-}
-
-void bye_bye(void){
-  ic_actuator_set_off_func(IC_LEFT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  ic_actuator_set_off_func(IC_LEFT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  ic_actuator_set_off_func(IC_LEFT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  ic_actuator_set_off_func(IC_RIGHT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  ic_actuator_set_off_func(IC_RIGHT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  ic_actuator_set_off_func(IC_RIGHT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-
-  ic_actuator_set_triangle_func(IC_LEFT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_LEFT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_LEFT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_RIGHT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_RIGHT_GREEN_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-  ic_actuator_set_triangle_func(IC_RIGHT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 63);
-  vTaskDelay(pdMS_TO_TICKS(WELCOME_PERIOD>>2));
-
-}
-
 static void m_deep_sleep(void){
   NRF_LOG_INFO("{%s}\n", (uint32_t)__func__);
   m_shutdown_source = IC_PWR_DOWN_SRC;
@@ -410,13 +308,15 @@ static void cleanup_task (void *arg){
     ic_bluetooth_disable();
     ic_service_stream1_deinit();
     ic_ads_service_deinit();
+    ic_service_recorder_deinit();
 
-    bye_bye();
+    ic_pattern_play(IC_PATTERN_BYE);
+    ic_pattern_wait(BYE_TIMEOUT);
   }else{
     ic_actuator_set_ramp_func(IC_LEFT_BLUE_LED, WELCOME_PERIOD, WELCOME_PERIOD, 0);
     ic_actuator_set_ramp_func(IC_LEFT_RED_LED, WELCOME_PERIOD, WELCOME_PERIOD, 0);
+    vTaskDelay(512);
   }
-  vTaskDelay(512);
   ic_ltc_service_deinit();
 
   power_down_all_systems();
@@ -427,9 +327,28 @@ static void cleanup_task (void *arg){
     NRF_POWER->SYSTEMOFF = 1;
 }
 
-static void shutdown_cmd(u_BLECmdPayload _) { ic_bq_shutdown(); }
-static void showoff_cmd(u_BLECmdPayload _) { showoff_light(); }
-static void program_BQ_cmd(u_BLECmdPayload _) { ic_bq_flash_image(); }
+static ic_return_val_e shutdown_cmd(u_BLECmdPayload _, void *ctx){
+  ic_bq_shutdown();
+  return IC_SUCCESS;
+}
+
+static ic_return_val_e showoff_cmd(u_BLECmdPayload _, void *ctx){
+  ic_pattern_play(IC_PATTERN_SHOWOFF);
+  return IC_SUCCESS;
+}
+
+static ic_return_val_e program_BQ_cmd(u_BLECmdPayload _, void *ctx){
+  ic_bq_flash_image();
+  return IC_SUCCESS;
+}
+
+static ic_return_val_e status_cmd(u_BLECmdPayload payload, void *ctx){
+  ic_bus_stats_dump();
+  cmd_stats_dump();
+  if(payload.data[0] != 0)
+    ic_bus_stats_reset();
+  return IC_SUCCESS;
+}
 
 static void init_task (void *arg){
   UNUSED_PARAMETER(arg);
@@ -437,6 +356,7 @@ static void init_task (void *arg){
   ic_wdt_init();
 
   ic_neuroon_exti_init();
+  ic_bq_sampler_init();
   ic_ltc_service_init();
 
 
@@ -471,12 +391,12 @@ static void init_task (void *arg){
 
   if (m_reset_reason != IC_RESET_REAS_WATCHDOG &&
       m_reset_reason != IC_RESET_REAS_BUTTON){
-    showoff_light();
+    ic_pattern_play(IC_PATTERN_SHOWOFF);
     vTaskDelay(IC_BUTTON_LONG_PRESS_OFFSET);
   }
 
   if(m_reset_reason == IC_RESET_REAS_WATCHDOG)
-    welcome_wdt();
+    ic_pattern_play(IC_PATTERN_WELCOME_WDT);
   else if(m_reset_reason == IC_RESET_REAS_BUTTON){
     vTaskDelay(IC_BUTTON_LONG_PRESS_OFFSET);
     if(!ic_button_pressed(IC_BUTTON_PWR_BUTTON_PIN) && m_reset_reason == IC_RESET_REAS_BUTTON){
@@ -484,24 +404,39 @@ static void init_task (void *arg){
       NRF_POWER->SYSTEMOFF = 1;
     }
     else
-      welcome();
+      ic_pattern_play(IC_PATTERN_WELCOME);
   }
 
 
 
   ic_btn_pwr_long_press_handle_init(m_deep_sleep);
 
+  ic_service_mux_init();
+  ic_stream_policy_init();
   ic_ads_service_init();
   ic_service_stream1_init();
+  ic_service_recorder_init();
+  ic_service_bulk_init();
   ic_ble_module_init();
   sd_power_reset_reason_clr(NRF_POWER->RESETREAS);
   ic_service_timestamp_init();
   cmd_module_init();
+  ic_scheduler_init();
+  ic_smart_wake_init();
   ic_init_battery_update();
-  on_disconnect();
-  cmd_task_connect_to_shutdown_cmd(shutdown_cmd);
-  cmd_task_connect_to_test_cmd(showoff_cmd);
-  cmd_task_connect_to_flashBQ_cmd(program_BQ_cmd);
+  /* Welcome is not cut */
+  ic_pattern_enqueue(IC_PATTERN_DISCONNECTED);
+  cmd_register(SHUTDOWN_CMD, shutdown_cmd, NULL);
+  cmd_register(TEST_CMD, showoff_cmd, NULL);
+  cmd_register(FLASH_BQ_CMD, program_BQ_cmd, NULL);
+  cmd_register(STATUS_CMD, status_cmd, NULL);
+
+  /* Init task is still alive, so this is the peak of heap usage */
+  __auto_type _heap_left = xPortGetMinimumEverFreeHeapSize();
+  if(_heap_left < IC_HEAP_MIN_FREE)
+    NRF_LOG_WARNING("heap almost used up: %d B left\n", _heap_left);
+  else
+    NRF_LOG_INFO("heap: %d B left\n", _heap_left);
   vTaskDelete(NULL);
   taskYIELD();
 }
@@ -0,0 +1,198 @@
+/**
+ * @file    ic_ble_conn_profile.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Connection parameters following streaming state
+ *
+ * Wanted profile is evaluated on every ICCS state change. One-shot timer either ends holdoff of
+ * slower profile or retries request refused while previous procedure was running. Parameters
+ * accepted by central come from CONNECTED and CONN_PARAM_UPDATE events and are kept in statistics.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_error.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "ble_conn_params.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "CONN"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_ble_conn_profile.h"
+#include "ic_ble_service.h"
+
+#define PROFILE(name)                                                                             \
+  {                                                                                               \
+    .min_conn_interval  = MSEC_TO_UNITS(IC_CONN_##name##_MIN_INTERVAL_MS, UNIT_1_25_MS),          \
+    .max_conn_interval  = MSEC_TO_UNITS(IC_CONN_##name##_MAX_INTERVAL_MS, UNIT_1_25_MS),          \
+    .slave_latency      = IC_CONN_##name##_SLAVE_LATENCY,                                         \
+    .conn_sup_timeout   = MSEC_TO_UNITS(IC_CONN_SUP_TIMEOUT_MS, UNIT_10_MS)                       \
+  }
+
+static const ble_gap_conn_params_t m_profiles[IC_CONN_PROFILE_NUM] = {
+  [IC_CONN_PROFILE_IDLE]      = PROFILE(IDLE),
+  [IC_CONN_PROFILE_STREAMING] = PROFILE(STREAMING),
+  [IC_CONN_PROFILE_BULK]      = PROFILE(BULK)
+};
+
+static const char *m_profile_names[IC_CONN_PROFILE_NUM] = {"idle", "streaming", "bulk"};
+
+static struct{
+  bool connected;
+  ic_conn_profile_e requested;
+  TimerHandle_t timer;
+  ic_conn_profile_stats_s stats;
+}m_profile;
+
+static ic_conn_profile_e m_wanted(void){
+  if(ble_iccs_bulk_ready())
+    return IC_CONN_PROFILE_BULK;
+
+  if(ble_iccs_stream0_ready() || ble_iccs_stream1_ready() || ble_iccs_stream2_ready()
+      || ble_iccs_mux_ready())
+    return IC_CONN_PROFILE_STREAMING;
+
+  return IC_CONN_PROFILE_IDLE;
+}
+
+static void m_schedule(TickType_t delay){
+  if(m_profile.timer != NULL)
+    xTimerChangePeriod(m_profile.timer, delay, OSTIMER_WAIT_FOR_QUEUE);
+}
+
+/**
+ * @brief Set profile as preferred and request it when current parameters do not fit.
+ */
+static void m_request(ic_conn_profile_e profile){
+  __auto_type _err_code =
+    ble_conn_params_change_conn_params((ble_gap_conn_params_t *)&m_profiles[profile]);
+
+  if(_err_code != NRF_SUCCESS){
+    /* Previous procedure still in progress */
+    NRF_LOG_WARNING("%s refused: 0x%X\n", (uint32_t)m_profile_names[profile], _err_code);
+    m_schedule(IC_CONN_PROFILE_RETRY);
+    return;
+  }
+
+  CRITICAL_REGION_ENTER();
+  m_profile.requested = profile;
+  m_profile.stats.profile = profile;
+  ++m_profile.stats.requests;
+  CRITICAL_REGION_EXIT();
+
+  NRF_LOG_INFO("profile %s\n", (uint32_t)m_profile_names[profile]);
+}
+
+/**
+ * @brief Faster profile is taken immediately, slower one after holdoff.
+ */
+static void m_update(bool holdoff_expired){
+  if(!m_profile.connected)
+    return;
+
+  __auto_type _wanted = m_wanted();
+
+  if(_wanted == m_profile.requested){
+    if(m_profile.timer != NULL)
+      xTimerStop(m_profile.timer, OSTIMER_WAIT_FOR_QUEUE);
+    return;
+  }
+
+  if(_wanted > m_profile.requested || holdoff_expired)
+    m_request(_wanted);
+  else
+    m_schedule(IC_CONN_PROFILE_HOLDOFF);
+}
+
+static void m_timer_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+  m_update(true);
+}
+
+static void on_state_change(void){
+  m_update(false);
+}
+
+static void m_accepted(const ble_gap_conn_params_t *params){
+  CRITICAL_REGION_ENTER();
+  m_profile.stats.interval = params->max_conn_interval;
+  m_profile.stats.latency = params->slave_latency;
+  m_profile.stats.timeout = params->conn_sup_timeout;
+  CRITICAL_REGION_EXIT();
+
+  NRF_LOG_INFO("interval %d, latency %d, timeout %d\n",
+      params->max_conn_interval,
+      params->slave_latency,
+      params->conn_sup_timeout);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+const ble_gap_conn_params_t *ic_conn_profile_params(ic_conn_profile_e profile){
+  return &m_profiles[profile < IC_CONN_PROFILE_NUM ? profile : IC_CONN_PROFILE_IDLE];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_conn_profile_init(void){
+  if(m_profile.timer == NULL){
+    m_profile.timer =
+      xTimerCreate("CONN", IC_CONN_PROFILE_HOLDOFF, pdFALSE, NULL, m_timer_callback);
+    if(m_profile.timer == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+  }
+
+  m_profile.requested = IC_CONN_PROFILE_IDLE;
+  ble_iccs_connect_to_state(on_state_change);
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_conn_profile_rejected(void){
+  CRITICAL_REGION_ENTER();
+  ++m_profile.stats.rejected;
+  CRITICAL_REGION_EXIT();
+
+  NRF_LOG_WARNING("%s not accepted by central\n", (uint32_t)m_profile_names[m_profile.requested]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_conn_profile_stats_s ic_conn_profile_get_stats(void){
+  ic_conn_profile_stats_s _stats;
+
+  CRITICAL_REGION_ENTER();
+  _stats = m_profile.stats;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_conn_profile_on_ble_evt(ble_evt_t *p_ble_evt){
+  switch(p_ble_evt->header.evt_id){
+    case BLE_GAP_EVT_CONNECTED:
+      m_profile.connected = true;
+      m_accepted(&p_ble_evt->evt.gap_evt.params.connected.conn_params);
+      break;
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      ++m_profile.stats.updates;
+      m_accepted(&p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params);
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      m_profile.connected = false;
+      if(m_profile.timer != NULL)
+        xTimerStop(m_profile.timer, OSTIMER_WAIT_FOR_QUEUE);
+      /* Next connection starts with idle profile, there is no link, so only preferred parameters
+       * are set */
+      (void)ble_conn_params_change_conn_params(
+          (ble_gap_conn_params_t *)&m_profiles[IC_CONN_PROFILE_IDLE]);
+      m_profile.requested = IC_CONN_PROFILE_IDLE;
+      break;
+    default:
+      break;
+  }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file    ic_ble_conn_profile.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Connection parameters following streaming state
+ *
+ * Profile is chosen from notifications enabled by central: bulk characteristic - BULK, any stream
+ * (or multiplexed stream) - STREAMING, otherwise IDLE. Faster profile is requested immediately,
+ * slower one after @ref IC_CONN_PROFILE_HOLDOFF of lower demand, so toggling notifications does
+ * not cause renegotiation storm. Requests go through Connection Parameters module, which also
+ * keeps retrying when central does not accept them.
+ */
+
+#ifndef IC_BLE_CONN_PROFILE_H
+#define IC_BLE_CONN_PROFILE_H
+
+#include <stdint.h>
+
+#include "ble.h"
+#include "ble_gap.h"
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_CONN_PROFILE
+ *  @{
+ */
+
+/**
+ * @brief Profiles ordered by radio duty cycle.
+ */
+typedef enum{
+  IC_CONN_PROFILE_IDLE = 0,
+  IC_CONN_PROFILE_STREAMING,
+  IC_CONN_PROFILE_BULK,
+
+  IC_CONN_PROFILE_NUM
+}ic_conn_profile_e;
+
+typedef struct{
+  uint8_t profile;                    /** Requested @ref ic_conn_profile_e */
+  uint16_t interval;                  /** Accepted connection interval (1.25ms units) */
+  uint16_t latency;                   /** Accepted slave latency */
+  uint16_t timeout;                   /** Accepted supervision timeout (10ms units) */
+  uint16_t requests;                  /** Profile switches requested */
+  uint16_t updates;                   /** Parameters changed by central */
+  uint16_t rejected;                  /** Negotiations which failed */
+}ic_conn_profile_stats_s;
+
+/**
+ * @brief Parameters of profile, used also as preferred parameters before connection.
+ */
+const ble_gap_conn_params_t *ic_conn_profile_params(ic_conn_profile_e profile);
+
+/**
+ * @brief Create hysteresis timer and follow notifications state. Call after Connection Parameters
+ * module was initialized.
+ */
+ic_return_val_e ic_conn_profile_init(void);
+
+/**
+ * @brief Report failed negotiation (Connection Parameters module gave up).
+ */
+void ic_conn_profile_rejected(void);
+
+ic_conn_profile_stats_s ic_conn_profile_get_stats(void);
+
+void ic_conn_profile_on_ble_evt(ble_evt_t *p_ble_evt);
+
+/** @} */
+
+#endif /* !IC_BLE_CONN_PROFILE_H */
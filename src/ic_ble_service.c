@@ -13,6 +13,7 @@
 #include "ble_gatts.h"
 #include "ble_srv_common.h"
 #include "app_error.h"
+#include "app_util_platform.h"
 
 #define NRF_LOG_MODULE_NAME "ICCS"
 #define NRF_LOG_LEVEL 5
@@ -30,13 +31,17 @@
 enum char_dir_e{
   CHAR_READ_ENABLE    = 0x01,
   CHAR_WRITE_ENABLE   = 0x02,
-  CHAR_NOTIFY_ENABLE  = 0x04
+  CHAR_NOTIFY_ENABLE  = 0x04,
+  CHAR_WRITE_CMD_ENABLE = 0x08    /** Write without response */
 }char_dir;
 
 #define STREAM0 0
 #define STREAM1 1
 #define STREAM2 2
 #define CMD_CHAR 3
+#define BULK_CHAR 4
+#define MUX_CHAR 5
+#define RESPONSE_CHAR 6
 
 static struct {
   uint8_t uuid_type;
@@ -51,12 +56,20 @@ typedef struct {
     void (*readiness_notify_handle)(bool);
     void (*write_handle)(uint8_t *, size_t);
   }char_callback;
+  void (*control_handle)(uint8_t *, size_t);  /** Writes to characteristic with notifications */
   bool notification_connected;
 }characteritic_desc_t;
 
 static uint16_t m_service_handle;
 static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
 
+/** Called when notifications of any characteristic were enabled or disabled */
+static void (*m_state_handle)(void);
+
+static ble_iccs_tx_stats_t m_tx_stats;
+static TickType_t m_connected_at;
+static bool m_first_notification;     /** No notification was sent in this connection yet */
+
 /*static characteritic_desc_t m_stream0_char_handle;*/
 /*static characteritic_desc_t m_stream1_char_handle;*/
 /*static characteritic_desc_t m_stream2_char_handle;*/
@@ -81,7 +94,22 @@ static characteritic_desc_t m_char_stream_list[] = {
   {
     .uuid = BLE_UUID_ICCS_CMD_CHARACTERISTIC,
     .char_callback = {NULL},
-    .read_write_notify = CHAR_WRITE_ENABLE
+    .read_write_notify = CHAR_WRITE_ENABLE|CHAR_WRITE_CMD_ENABLE
+  },
+  {
+    .uuid = BLE_UUID_ICCS_BULK_CHARACTERISTIC,
+    .char_callback = {NULL},
+    .read_write_notify = CHAR_WRITE_ENABLE|CHAR_NOTIFY_ENABLE
+  },
+  {
+    .uuid = BLE_UUID_ICCS_MUX_CHARACTERISTIC,
+    .char_callback = {NULL},
+    .read_write_notify = CHAR_READ_ENABLE|CHAR_NOTIFY_ENABLE
+  },
+  {
+    .uuid = UUID_RESPONSE_TX_CHARACTERISTIC,
+    .char_callback = {NULL},
+    .read_write_notify = CHAR_READ_ENABLE|CHAR_NOTIFY_ENABLE
   }
 };
 
@@ -115,6 +143,7 @@ static uint32_t char_add(
   _char_md.char_props.read   = (read_write&CHAR_READ_ENABLE)>0;
   _char_md.char_props.notify = (read_write&CHAR_NOTIFY_ENABLE)>0;
   _char_md.char_props.write  = (read_write&CHAR_WRITE_ENABLE)>0;
+  _char_md.char_props.write_wo_resp = (read_write&CHAR_WRITE_CMD_ENABLE)>0;
 
   _char_md.p_char_user_desc = NULL;
   _char_md.p_char_pf        = NULL;
@@ -127,7 +156,8 @@ static uint32_t char_add(
   _ble_uuid.uuid = uuid;
   memset(&_attr_md, 0, sizeof(_attr_md));
 
-  if(_char_md.char_props.write) BLE_GAP_CONN_SEC_MODE_SET_OPEN(&_attr_md.write_perm);
+  if(_char_md.char_props.write || _char_md.char_props.write_wo_resp)
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&_attr_md.write_perm);
   if(_char_md.char_props.read)  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&_attr_md.read_perm);
 
   _attr_md.vloc       = BLE_GATTS_VLOC_STACK;
@@ -169,6 +199,7 @@ uint32_t ble_iccs_init(const ble_iccs_init_t *iccs_init){
         IC_CHAR_MAX_LEN,
         &m_char_stream_list[i].char_handle,
         m_char_stream_list[i].read_write_notify);
+    if(_err_code != NRF_SUCCESS) return _err_code;
   }
 
   /*
@@ -204,6 +235,33 @@ static ic_return_val_e ble_iccs_send_to_char(
 
     __auto_type _sd_err = sd_ble_gatts_hvx(m_conn_handle, &hvx_params);
 
+    __auto_type _first = false;
+
+    CRITICAL_REGION_ENTER();
+    switch(_sd_err){
+      case NRF_SUCCESS:
+        ++m_tx_stats.sent;
+        ++m_tx_stats.in_flight;
+        if(m_first_notification){
+          m_first_notification = false;
+          m_tx_stats.first_notification = GET_TICK_COUNT() - m_connected_at;
+          _first = true;
+        }
+        break;
+      case NRF_ERROR_BUSY:
+      case BLE_ERROR_NO_TX_PACKETS:
+        ++m_tx_stats.busy;
+        break;
+      default:
+        ++m_tx_stats.errors;
+        break;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(_first)
+      NRF_LOG_INFO("First notification %d ticks after connection\n",
+          m_tx_stats.first_notification);
+
     if (_sd_err != NRF_SUCCESS){
       switch(_sd_err){
         case BLE_ERROR_INVALID_CONN_HANDLE:
@@ -255,6 +313,24 @@ ic_return_val_e ble_iccs_connect_to_cmd(void (*p_func)(uint8_t *, size_t)){
   return ble_iccs_connect_to_char(p_func, &m_char_stream_list[CMD_CHAR]);
 }
 
+ic_return_val_e ble_iccs_connect_to_bulk(void (*p_func)(bool), void (*p_control)(uint8_t *, size_t)){
+  m_char_stream_list[BULK_CHAR].control_handle = p_control;
+  return ble_iccs_connect_to_char(p_func, &m_char_stream_list[BULK_CHAR]);
+}
+
+ic_return_val_e ble_iccs_connect_to_mux(void (*p_func)(bool)){
+  return ble_iccs_connect_to_char(p_func, &m_char_stream_list[MUX_CHAR]);
+}
+
+ic_return_val_e ble_iccs_connect_to_response(void (*p_func)(bool)){
+  return ble_iccs_connect_to_char(p_func, &m_char_stream_list[RESPONSE_CHAR]);
+}
+
+ic_return_val_e ble_iccs_connect_to_state(void (*p_func)(void)){
+  m_state_handle = p_func;
+  return IC_SUCCESS;
+}
+
 ic_return_val_e ble_iccs_send_to_stream0(
     const uint8_t *data,
     size_t len,
@@ -276,6 +352,27 @@ ic_return_val_e ble_iccs_send_to_stream2(
   return ble_iccs_send_to_char(data, len, &m_char_stream_list[STREAM2], err);
 }
 
+ic_return_val_e ble_iccs_send_to_bulk(
+    const uint8_t *data,
+    size_t len,
+    uint32_t *err){
+  return ble_iccs_send_to_char(data, len, &m_char_stream_list[BULK_CHAR], err);
+}
+
+ic_return_val_e ble_iccs_send_to_mux(
+    const uint8_t *data,
+    size_t len,
+    uint32_t *err){
+  return ble_iccs_send_to_char(data, len, &m_char_stream_list[MUX_CHAR], err);
+}
+
+ic_return_val_e ble_iccs_send_to_response(
+    const uint8_t *data,
+    size_t len,
+    uint32_t *err){
+  return ble_iccs_send_to_char(data, len, &m_char_stream_list[RESPONSE_CHAR], err);
+}
+
 bool ble_iccs_stream0_ready(){
   return m_char_stream_list[STREAM0].notification_connected;
 }
@@ -288,35 +385,116 @@ bool ble_iccs_stream2_ready(){
   return m_char_stream_list[STREAM2].notification_connected;
 }
 
+bool ble_iccs_bulk_ready(){
+  return m_char_stream_list[BULK_CHAR].notification_connected;
+}
+
+bool ble_iccs_mux_ready(){
+  return m_char_stream_list[MUX_CHAR].notification_connected;
+}
+
+bool ble_iccs_response_ready(){
+  return m_char_stream_list[RESPONSE_CHAR].notification_connected;
+}
+
+ble_iccs_tx_stats_t ble_iccs_get_tx_stats(){
+  ble_iccs_tx_stats_t _stats;
+
+  CRITICAL_REGION_ENTER();
+  _stats = m_tx_stats;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
+}
+
 static void on_connect(ble_evt_t *p_ble_evt){
   m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+
+  uint8_t _count = 0;
+  if(sd_ble_tx_packet_count_get(m_conn_handle, &_count) != NRF_SUCCESS)
+    _count = 0;
+
+  CRITICAL_REGION_ENTER();
+  m_tx_stats.in_flight = 0;
+  m_tx_stats.capacity = _count;
+  m_connected_at = GET_TICK_COUNT();
+  m_first_notification = true;
+  CRITICAL_REGION_EXIT();
+}
+
+static void on_tx_complete(ble_evt_t *p_ble_evt){
+  __auto_type _count = p_ble_evt->evt.common_evt.params.tx_complete.count;
+
+  CRITICAL_REGION_ENTER();
+  m_tx_stats.in_flight = m_tx_stats.in_flight > _count ? m_tx_stats.in_flight - _count : 0;
+  CRITICAL_REGION_EXIT();
 }
 
 static void on_disconnect(ble_evt_t * p_ble_evt){
   m_conn_handle = BLE_CONN_HANDLE_INVALID;
+  m_tx_stats.in_flight = 0;
   for(int i = 0; i<sizeof(m_char_stream_list)/sizeof(m_char_stream_list[0]); ++i){
+    m_char_stream_list[i].notification_connected = false;
     if(m_char_stream_list[i].char_callback.readiness_notify_handle != NULL)
       m_char_stream_list[i].char_callback.readiness_notify_handle(false);
   }
 }
 
+static void set_notification(characteritic_desc_t *characteristic, bool enabled){
+  characteristic->notification_connected = enabled;
+  if(characteristic->char_callback.readiness_notify_handle != NULL)
+    characteristic->char_callback.readiness_notify_handle(enabled);
+}
+
 static void on_write(ble_gatts_evt_write_t * p_write_evt){
   for(int i = 0; i<sizeof(m_char_stream_list)/sizeof(m_char_stream_list[0]); ++i){
     if(m_char_stream_list[i].char_handle.cccd_handle == p_write_evt->handle){
-      __auto_type _notify_enabled = p_write_evt->data[0] == 0x01;
-      m_char_stream_list[i].notification_connected = _notify_enabled;
-      if(m_char_stream_list[i].char_callback.readiness_notify_handle != NULL)
-        m_char_stream_list[i].char_callback.readiness_notify_handle(_notify_enabled);
+      set_notification(&m_char_stream_list[i], p_write_evt->data[0] == 0x01);
+      if(m_state_handle != NULL)
+        m_state_handle();
       break;
     }
     if(m_char_stream_list[i].char_handle.value_handle == p_write_evt->handle){
-      if(m_char_stream_list[i].char_callback.write_handle != NULL){
+      /* Write commands let central send several frames (batch) in one connection event */
+      if(p_write_evt->op != BLE_GATTS_OP_WRITE_REQ && p_write_evt->op != BLE_GATTS_OP_WRITE_CMD)
+        break;
+      if(m_char_stream_list[i].control_handle != NULL){
+        m_char_stream_list[i].control_handle(p_write_evt->data, p_write_evt->len);
+      }
+      else if(m_char_stream_list[i].char_callback.write_handle != NULL){
         m_char_stream_list[i].char_callback.write_handle(p_write_evt->data, p_write_evt->len);
       }
     }
   }
 }
 
+void ble_iccs_on_sys_attr_applied(void){
+  __auto_type _changed = false;
+
+  for(int i = 0; i<sizeof(m_char_stream_list)/sizeof(m_char_stream_list[0]); ++i){
+    if(!(m_char_stream_list[i].read_write_notify & CHAR_NOTIFY_ENABLE))
+      continue;
+
+    uint8_t _cccd[BLE_CCCD_VALUE_LEN];
+    ble_gatts_value_t _value = {.len = sizeof(_cccd), .offset = 0, .p_value = _cccd};
+
+    if(sd_ble_gatts_value_get(
+          m_conn_handle,
+          m_char_stream_list[i].char_handle.cccd_handle,
+          &_value) != NRF_SUCCESS)
+      continue;
+
+    __auto_type _enabled = ble_srv_is_notification_enabled(_cccd);
+    if(_enabled != m_char_stream_list[i].notification_connected){
+      set_notification(&m_char_stream_list[i], _enabled);
+      _changed = true;
+    }
+  }
+
+  if(_changed && m_state_handle != NULL)
+    m_state_handle();
+}
+
 void ble_iccs_on_ble_evt(ble_evt_t * p_ble_evt)
 {
   switch (p_ble_evt->header.evt_id)
@@ -332,6 +510,9 @@ void ble_iccs_on_ble_evt(ble_evt_t * p_ble_evt)
     case BLE_GATTS_EVT_WRITE:
       on_write(&p_ble_evt->evt.gatts_evt.params.write);
       break;
+    case BLE_EVT_TX_COMPLETE:
+      on_tx_complete(p_ble_evt);
+      break;
 
     default:
       // No implementation needed.
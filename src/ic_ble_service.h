@@ -23,9 +23,11 @@
 
 #define BLE_UUID_ICCS_STREAM0_CHARACTERISTIC    0x0201
 #define BLE_UUID_ICCS_STREAM1_CHARACTERISTIC    0x0202
+#define BLE_UUID_ICCS_MUX_CHARACTERISTIC        0x0203
 
 #define BLE_UUID_ICCS_STREAM2_CHARACTERISTIC    0x0301
 #define BLE_UUID_ICCS_CMD_CHARACTERISTIC        0x0501
+#define BLE_UUID_ICCS_BULK_CHARACTERISTIC       0x0601
 
 #define UUID_RESPONSE_TX_CHARACTERISTIC       0x0302
 #define UUID_TEST_TOOL_TX_CHARACTERISTIC      0x0401
@@ -36,17 +38,44 @@ typedef struct{
   uint8_t dummy;
 }ble_iccs_init_t;
 
+/**
+ * @brief Notification accounting, basis of stream backpressure policy
+ */
+typedef struct{
+  uint8_t in_flight;                  /** Notifications queued in SoftDevice, not yet sent */
+  uint8_t capacity;                   /** SoftDevice TX buffers of current connection */
+  uint32_t sent;
+  uint32_t busy;                      /** Notifications refused because TX buffers were full */
+  uint32_t errors;
+  uint32_t first_notification;        /** Ticks from connection to first notification sent */
+}ble_iccs_tx_stats_t;
+
 uint32_t ble_iccs_init(const ble_iccs_init_t *iccs_init);
 ic_return_val_e ble_iccs_connect_to_stream0(void (*p_func)(bool));
 ic_return_val_e ble_iccs_connect_to_stream1(void (*p_func)(bool));
 ic_return_val_e ble_iccs_connect_to_stream2(void (*p_func)(bool));
 ic_return_val_e ble_iccs_connect_to_cmd(void (*p_func)(uint8_t *, size_t));
+ic_return_val_e ble_iccs_connect_to_bulk(void (*p_func)(bool), void (*p_control)(uint8_t *, size_t));
+ic_return_val_e ble_iccs_connect_to_mux(void (*p_func)(bool));
+ic_return_val_e ble_iccs_connect_to_response(void (*p_func)(bool));
+ic_return_val_e ble_iccs_connect_to_state(void (*p_func)(void));
 ic_return_val_e ble_iccs_send_to_stream0(const uint8_t *data, size_t len,uint32_t *err);
 ic_return_val_e ble_iccs_send_to_stream1(const uint8_t *data, size_t len,uint32_t *err);
 ic_return_val_e ble_iccs_send_to_stream2(const uint8_t *data, size_t len,uint32_t *err);
+ic_return_val_e ble_iccs_send_to_bulk(const uint8_t *data, size_t len,uint32_t *err);
+ic_return_val_e ble_iccs_send_to_mux(const uint8_t *data, size_t len,uint32_t *err);
+ic_return_val_e ble_iccs_send_to_response(const uint8_t *data, size_t len,uint32_t *err);
 bool ble_iccs_stream0_ready();
 bool ble_iccs_stream1_ready();
 bool ble_iccs_stream2_ready();
+bool ble_iccs_bulk_ready();
+bool ble_iccs_mux_ready();
+bool ble_iccs_response_ready();
+ble_iccs_tx_stats_t ble_iccs_get_tx_stats();
+/**
+ * @brief Bonded peer got its CCCDs restored by Peer Manager, follow them without CCCD writes.
+ */
+void ble_iccs_on_sys_attr_applied(void);
 void ble_iccs_on_ble_evt(ble_evt_t * p_ble_evt);
 
 #endif /* !IC_BLE_SERVICE_H */
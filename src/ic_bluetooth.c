@@ -34,6 +34,12 @@
 #include "ble_dis.h"
 #include "ic_ble_service.h"
 #include "ic_service_bas.h"
+#include "ic_service_recorder.h"
+#include "ic_service_bulk.h"
+#include "ic_service_mux.h"
+#include "ic_stream_policy.h"
+#include "ic_command_task.h"
+#include "ic_ble_conn_profile.h"
 #include "ic_serial.h"
 
 #include "ble_conn_state.h"
@@ -63,6 +69,8 @@ extern void main_on_ble_evt(ble_evt_t * p_ble_evt);
 
 #define PERIPHERAL_LINK_COUNT           1                                           /**< Number of peripheral links used by the application. When changing this number remember to adjust the RAM settings*/
 
+#define ATTR_TAB_SIZE                   0x680                                       /**< GATT attribute table: SoftDevice default 0x580 is full with 8 ICCS characteristics, DIS, BAS and DFU. When changing this number remember to adjust the RAM settings*/
+
 #define DEVICE_NAME                     "NeuroOn"                               /**< Name of device. Will be included in the advertising data. */
 #define MANUFACTURER_NAME               "Inteliclinic"                              /**< Manufacturer. Will be passed to Device Information Service. */
 
@@ -71,11 +79,8 @@ extern void main_on_ble_evt(ble_evt_t * p_ble_evt);
 
 #define APP_ADV_INTERVAL                300                                         /**< The advertising interval (in units of 0.625 ms. This value corresponds to 187.5 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS      0                                           /**< The advertising timeout in units of seconds. */
-
-#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(8, UNIT_1_25_MS)            /**< Minimum acceptable connection interval (0.1 seconds). */
-#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(32, UNIT_1_25_MS)            /**< Maximum acceptable connection interval (0.2 second). */
-#define SLAVE_LATENCY                   0                                           /**< Slave latency. */
-#define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Connection supervisory timeout (4 seconds). */
+#define APP_ADV_FAST_INTERVAL           40                                          /**< Advertising interval to bonded peers only (25 ms). */
+#define APP_ADV_FAST_TIMEOUT_IN_SECONDS 10                                          /**< Afterwards any central can connect, at APP_ADV_INTERVAL. */
 
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000, 31)  /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */ /*[TODO] PARAMETRYZACJA "0" !!!*/
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(30000, 31) /**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */ /*[TODO] PARAMETRYZACJA "0" !!!*/
@@ -96,6 +101,10 @@ static bool m_module_initialized = false;
 
 static bool m_ble_power_down = false;
 
+static pm_peer_id_t m_peer_id = PM_PEER_ID_INVALID;                                 /**< Peer of directed advertising. */
+static bool m_whitelist_changed = false;                                            /**< New bond, whitelist is refreshed when link is down. */
+static uint8_t m_whitelist_requests = 0;                                            /**< Whitelist is served only to fast advertising. */
+
 ALLOCK_SEMAPHORE(m_ble_event_ready);
 
 /*static SemaphoreHandle_t m_ble_event_ready = NULL;*/
@@ -129,6 +138,27 @@ static ble_uuid_t m_adv_uuids[] = {{BLE_UUID_ICCS_CHARACTERISTIC, BLE_UUID_TYPE_
 
 static void advertising_start(void);
 
+/**@brief Function for setting bonded peers as whitelist of advertising.
+ */
+static void whitelist_load(void)
+{
+    pm_peer_id_t peers[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+    uint32_t     peer_cnt = 0;
+
+    for (__auto_type peer_id = pm_next_peer_id_get(PM_PEER_ID_INVALID);
+        peer_id != PM_PEER_ID_INVALID && peer_cnt < BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+        peer_id = pm_next_peer_id_get(peer_id))
+    {
+        peers[peer_cnt++] = peer_id;
+    }
+
+    __auto_type err_code = pm_whitelist_set(peer_cnt != 0 ? peers : NULL, peer_cnt);
+    APP_ERROR_CHECK(err_code);
+
+    m_whitelist_changed = false;
+    NRF_LOG_INFO("%d bonded peers\r\n", peer_cnt);
+}
+
 /**@brief Function for handling Peer Manager events.
  *
  * @param[in] p_evt  Peer Manager event.
@@ -148,6 +178,7 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
             ble_conn_state_role(p_evt->conn_handle),
             p_evt->conn_handle,
             p_evt->params.conn_sec_succeeded.procedure);
+        m_peer_id = p_evt->peer_id;
       } break;
 
     case PM_EVT_CONN_SEC_FAILED:
@@ -162,8 +193,8 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
 
     case PM_EVT_CONN_SEC_CONFIG_REQ:
       {
-        // Reject pairing request from an already bonded peer.
-        pm_conn_sec_config_t conn_sec_config = {.allow_repairing = false};
+        // Bonds are kept across boots, so peer which lost its keys has to be able to pair again.
+        pm_conn_sec_config_t conn_sec_config = {.allow_repairing = true};
         pm_conn_sec_config_reply(p_evt->conn_handle, &conn_sec_config);
       } break;
 
@@ -183,9 +214,27 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
 
     case PM_EVT_PEERS_DELETE_SUCCEEDED:
       {
+        m_peer_id = PM_PEER_ID_INVALID;
+        whitelist_load();
         advertising_start();
       } break;
 
+    case PM_EVT_PEER_DATA_UPDATE_SUCCEEDED:
+      {
+        if (p_evt->params.peer_data_update_succeeded.flash_changed
+            && p_evt->params.peer_data_update_succeeded.data_id == PM_PEER_DATA_ID_BONDING)
+        {
+          // Whitelist can not be changed while it is used by advertising.
+          m_whitelist_changed = true;
+        }
+      } break;
+
+    case PM_EVT_LOCAL_DB_CACHE_APPLIED:
+      {
+        // CCCDs of bonded peer were restored, central will not write them again.
+        ble_iccs_on_sys_attr_applied();
+      } break;
+
     case PM_EVT_LOCAL_DB_CACHE_APPLY_FAILED:
       {
         // The local database has likely changed, send service changed indications.
@@ -217,9 +266,7 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
       } break;
 
     case PM_EVT_CONN_SEC_START:
-    case PM_EVT_PEER_DATA_UPDATE_SUCCEEDED:
     case PM_EVT_PEER_DELETE_SUCCEEDED:
-    case PM_EVT_LOCAL_DB_CACHE_APPLIED:
     case PM_EVT_SERVICE_CHANGED_IND_SENT:
     case PM_EVT_SERVICE_CHANGED_IND_CONFIRMED:
     default:
@@ -235,7 +282,6 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
 static void gap_params_init(void)
 {
     uint32_t                err_code;
-    ble_gap_conn_params_t   gap_conn_params;
     ble_gap_conn_sec_mode_t sec_mode;
 
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
@@ -250,14 +296,8 @@ static void gap_params_init(void)
        err_code = sd_ble_gap_appearance_set(BLE_APPEARANCE_);
        APP_ERROR_CHECK(err_code); */
 
-    memset(&gap_conn_params, 0, sizeof(gap_conn_params));
-
-    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
-    gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
-    gap_conn_params.slave_latency     = SLAVE_LATENCY;
-    gap_conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
-
-    err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
+    // Connection starts with idle profile, see ic_ble_conn_profile.h
+    err_code = sd_ble_gap_ppcp_set(ic_conn_profile_params(IC_CONN_PROFILE_IDLE));
     APP_ERROR_CHECK(err_code);
 }
 
@@ -330,7 +370,8 @@ static void services_init(void)
   ble_icbas_init();
 
   ble_iccs_init_t iccs_init;
-  ble_iccs_init(&iccs_init);
+  err_code = ble_iccs_init(&iccs_init);
+  APP_ERROR_CHECK(err_code);
 
   ble_dfu_init_t dfus_init;
 
@@ -372,20 +413,16 @@ static void services_init(void)
  *
  * @details This function will be called for all events in the Connection Parameters Module which
  *          are passed to the application.
- *          @note All this function does is to disconnect. This could have been done by simply
- *                setting the disconnect_on_fail config parameter, but instead we use the event
- *                handler mechanism to demonstrate its use.
+ *          @note Parameters depend on profile, link is kept when central does not accept them -
+ *                its parameters are still usable, only less efficient.
  *
  * @param[in] p_evt  Event received from the Connection Parameters Module.
  */
 static void on_conn_params_evt(ble_conn_params_evt_t * p_evt)
 {
-    uint32_t err_code;
-
     if (p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
     {
-        err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
-        APP_ERROR_CHECK(err_code);
+        ic_conn_profile_rejected();
     }
 }
 
@@ -450,12 +487,63 @@ static void sleep_mode_enter(void)
  */
 static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
 {
+    uint32_t err_code;
+
     switch (ble_adv_evt)
     {
+        case BLE_ADV_EVT_DIRECTED:
+            NRF_LOG_INFO("Directed advertising\r\n");
+            break;
+
         case BLE_ADV_EVT_FAST:
             NRF_LOG_INFO("Fast advertising\r\n");
             break;
 
+        case BLE_ADV_EVT_FAST_WHITELIST:
+            NRF_LOG_INFO("Fast advertising to bonded peers\r\n");
+            break;
+
+        case BLE_ADV_EVT_SLOW:
+            NRF_LOG_INFO("Slow advertising\r\n");
+            break;
+
+        case BLE_ADV_EVT_WHITELIST_REQUEST:
+        {
+            ble_gap_addr_t whitelist_addrs[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+            ble_gap_irk_t  whitelist_irks[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+            uint32_t       addr_cnt = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+            uint32_t       irk_cnt  = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+
+            // Only fast advertising is restricted, slow one (empty whitelist) is open to anyone.
+            if (m_whitelist_requests++ == 0)
+            {
+                err_code = pm_whitelist_get(whitelist_addrs, &addr_cnt, whitelist_irks, &irk_cnt);
+                APP_ERROR_CHECK(err_code);
+            }
+            else
+            {
+                addr_cnt = 0;
+                irk_cnt  = 0;
+            }
+
+            err_code = ble_advertising_whitelist_reply(whitelist_addrs, addr_cnt,
+                                                       whitelist_irks, irk_cnt);
+            APP_ERROR_CHECK(err_code);
+        } break; // BLE_ADV_EVT_WHITELIST_REQUEST
+
+        case BLE_ADV_EVT_PEER_ADDR_REQUEST:
+        {
+            pm_peer_data_bonding_t peer_bonding_data;
+
+            // Without reply directed advertising is skipped.
+            if (m_peer_id != PM_PEER_ID_INVALID
+                && pm_peer_data_bonding_load(m_peer_id, &peer_bonding_data) == NRF_SUCCESS)
+            {
+                err_code = ble_advertising_peer_addr_reply(&peer_bonding_data.peer_id.id_addr_info);
+                APP_ERROR_CHECK(err_code);
+            }
+        } break; // BLE_ADV_EVT_PEER_ADDR_REQUEST
+
         case BLE_ADV_EVT_IDLE:
             NRF_LOG_INFO("Advertising Idle\r\n");
             sleep_mode_enter();
@@ -478,6 +566,10 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
     {
         case BLE_GAP_EVT_DISCONNECTED:
             NRF_LOG_INFO("Disconnected.\r\n");
+            // Advertising module restarts advertising after this handler.
+            if (m_whitelist_changed)
+                whitelist_load();
+            m_whitelist_requests = 0;
             break; // BLE_GAP_EVT_DISCONNECTED
 
         case BLE_GAP_EVT_CONNECTED:
@@ -582,11 +674,17 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
   ble_conn_state_on_ble_evt(p_ble_evt);
   pm_on_ble_evt(p_ble_evt);
   ble_conn_params_on_ble_evt(p_ble_evt);
+  ic_conn_profile_on_ble_evt(p_ble_evt);
   on_ble_evt(p_ble_evt);
   if(!m_ble_power_down){
     ble_advertising_on_ble_evt(p_ble_evt);
   }
+  ic_recorder_on_ble_evt(p_ble_evt);
   ble_iccs_on_ble_evt(p_ble_evt);
+  ic_bulk_on_ble_evt(p_ble_evt);
+  ic_mux_on_ble_evt(p_ble_evt);
+  ic_stream_policy_on_ble_evt(p_ble_evt);
+  cmd_on_ble_evt(p_ble_evt);
   main_on_ble_evt(p_ble_evt);
   ble_dfu_on_ble_evt(&m_dfus, p_ble_evt);
   ble_icbas_on_ble_evt(p_ble_evt);
@@ -622,7 +720,8 @@ static void ble_stack_init(void)
                                                     &ble_enable_params);
     APP_ERROR_CHECK(err_code);
     ble_enable_params.common_enable_params.vs_uuid_count   = 2;
-    /*ble_enable_params.gatts_enable_params.attr_tab_size    = 0x580;*/
+    ble_enable_params.gatts_enable_params.service_changed  = IS_SRVC_CHANGED_CHARACT_PRESENT;
+    ble_enable_params.gatts_enable_params.attr_tab_size    = ATTR_TAB_SIZE;
 
     // Check the ram settings against the used number of links
     CHECK_RAM_START_ADDR(CENTRAL_LINK_COUNT, PERIPHERAL_LINK_COUNT);
@@ -700,10 +799,16 @@ static void advertising_init(void)
     advdata.uuids_complete.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
     advdata.uuids_complete.p_uuids  = m_adv_uuids;
 
+    // Reconnection of bonded peer: directed, then fast to whitelist, then slow to anyone.
     memset(&options, 0, sizeof(options));
-    options.ble_adv_fast_enabled  = true;
-    options.ble_adv_fast_interval = APP_ADV_INTERVAL;
-    options.ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS;
+    options.ble_adv_whitelist_enabled = true;
+    options.ble_adv_directed_enabled  = true;
+    options.ble_adv_fast_enabled      = true;
+    options.ble_adv_fast_interval     = APP_ADV_FAST_INTERVAL;
+    options.ble_adv_fast_timeout      = APP_ADV_FAST_TIMEOUT_IN_SECONDS;
+    options.ble_adv_slow_enabled      = true;
+    options.ble_adv_slow_interval     = APP_ADV_INTERVAL;
+    options.ble_adv_slow_timeout      = APP_ADV_TIMEOUT_IN_SECONDS;
 
     __auto_type err_code = ble_advertising_init(&advdata, NULL, &options, on_adv_evt, NULL);
     APP_ERROR_CHECK(err_code);
@@ -713,7 +818,8 @@ static void advertising_init(void)
  */
 static void advertising_start(void)
 {
-    __auto_type err_code = ble_advertising_start(BLE_ADV_MODE_FAST);
+    m_whitelist_requests = 0;
+    __auto_type err_code = ble_advertising_start(BLE_ADV_MODE_DIRECTED);
 
     APP_ERROR_CHECK(err_code);
 }
@@ -721,14 +827,16 @@ static void advertising_start(void)
 static void init_assets(void){
   // Initialize.
   ble_stack_init();
-  peer_manager_init(true);
+  peer_manager_init(false);
   gap_params_init();
   services_init();
   conn_params_init();
+  ic_conn_profile_init();
   advertising_init();
 
-  __auto_type err_code = ble_advertising_start(BLE_ADV_MODE_FAST);
-  APP_ERROR_CHECK(err_code);
+  whitelist_load();
+  m_peer_id = pm_next_peer_id_get(PM_PEER_ID_INVALID);
+  advertising_start();
 }
 
 static void ble_stack_thread(void * arg)
@@ -738,7 +846,7 @@ static void ble_stack_thread(void * arg)
   // Initialize.
 /*
  *  ble_stack_init();
- *  peer_manager_init(true);
+ *  peer_manager_init(false);
  *  gap_params_init();
  *  advertising_init();
  *  services_init();
@@ -805,8 +913,8 @@ ic_return_val_e ic_bluetooth_disable(void){
 ic_return_val_e ic_bluetooth_enable(void){
   if(m_module_initialized == false) return IC_NOT_INIALIZED;
   m_ble_power_down = false;
-  pm_peers_delete();
-  ble_advertising_start(BLE_ADV_MODE_FAST);
+  m_whitelist_requests = 0;
+  ble_advertising_start(BLE_ADV_MODE_DIRECTED);
 
   return NRF_SUCCESS;
 }
@@ -0,0 +1,294 @@
+/**
+ * @file    ic_bus_stats.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   TWI/SPI transaction statistics
+ *
+ * Devices get one of IC_BUS_STATS_DEVICES slots on first transaction, later ones are not counted.
+ * Counters are updated from bus IRQs with interrupts disabled and saturate instead of wrapping.
+ * Dump sends one counters frame and the histograms of every device on stream2.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ic_bus_stats.h"
+#include "ic_ble_service.h"
+
+#include "nrf_timer.h"
+#include "nrf_drv_common.h"
+
+#define NRF_LOG_MODULE_NAME "BUS"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#if IC_BUS_STATS_ENABLED
+
+#define IC_BUS_STATS_TIMER      NRF_TIMER1
+#define IC_BUS_STATS_IRQn       TIMER1_IRQn
+#define IC_BUS_STATS_CC         NRF_TIMER_CC_CHANNEL0
+#define IC_BUS_STATS_WRAP_CC    NRF_TIMER_CC_CHANNEL1   /* Compare at 0 - counter wrapped */
+
+#define IC_BUS_STATS_HIST_PER_FRAME 8
+
+typedef struct{
+  bool used;
+  uint8_t bus;
+  uint8_t id;
+  uint32_t transactions;
+  uint16_t busy;
+  uint16_t errors;
+  uint16_t wait_hist[IC_BUS_STATS_BUCKETS];
+  uint16_t transfer_hist[IC_BUS_STATS_BUCKETS];
+}device_stats_s;
+
+static struct{
+  ic_bus_timestamp_t last_done;       /** Completion of last transaction */
+  bool idle;                          /** Nothing was queued when last transaction finished */
+  uint8_t high_water;
+}m_bus[IC_BUS_NUM];
+
+static device_stats_s m_devices[IC_BUS_STATS_DEVICES];
+static bool m_module_initialized = false;
+
+static struct{
+  uint16_t volatile overflows;        /** Upper half of timestamp */
+  uint8_t active;                     /** Mask of active buses */
+}m_timer;
+
+static inline void m_saturated_inc(uint16_t *counter){
+  if(*counter != UINT16_MAX)
+    ++*counter;
+}
+
+static inline uint8_t m_bucket(ic_bus_timestamp_t delta){
+  uint8_t _bucket = 0;
+  while((delta >>= 1) != 0 && _bucket < IC_BUS_STATS_BUCKETS-1)
+    ++_bucket;
+  return _bucket;
+}
+
+/**
+ * @brief Find device entry. New one is allocated on first use. Called with interrupts disabled.
+ */
+static device_stats_s *m_get_device(ic_bus_e bus, uint8_t id){
+  for(int i = 0; i < IC_BUS_STATS_DEVICES; ++i){
+    if(!m_devices[i].used){
+      m_devices[i].used = true;
+      m_devices[i].bus = bus;
+      m_devices[i].id = id;
+      return &m_devices[i];
+    }
+    if(m_devices[i].bus == bus && m_devices[i].id == id)
+      return &m_devices[i];
+  }
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_bus_stats_init(void){
+  if(m_module_initialized)
+    return;
+
+  nrf_timer_mode_set(IC_BUS_STATS_TIMER, NRF_TIMER_MODE_TIMER);
+  nrf_timer_bit_width_set(IC_BUS_STATS_TIMER, NRF_TIMER_BIT_WIDTH_16);
+  nrf_timer_frequency_set(IC_BUS_STATS_TIMER, IC_BUS_STATS_TIMER_FREQUENCY);
+  nrf_timer_cc_write(IC_BUS_STATS_TIMER, IC_BUS_STATS_WRAP_CC, 0);
+  nrf_timer_int_enable(IC_BUS_STATS_TIMER, nrf_timer_compare_int_get(IC_BUS_STATS_WRAP_CC));
+  nrf_drv_common_irq_enable(IC_BUS_STATS_IRQn, APP_IRQ_PRIORITY_LOW);
+
+  ic_bus_stats_reset();
+  m_module_initialized = true;
+}
+
+void TIMER1_IRQHandler(void){
+  if(nrf_timer_event_check(IC_BUS_STATS_TIMER, nrf_timer_compare_event_get(IC_BUS_STATS_WRAP_CC))){
+    nrf_timer_event_clear(IC_BUS_STATS_TIMER, nrf_timer_compare_event_get(IC_BUS_STATS_WRAP_CC));
+    ++m_timer.overflows;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_bus_stats_active(ic_bus_e bus, bool active){
+  CRITICAL_REGION_ENTER();
+  __auto_type _was_active = m_timer.active != 0;
+
+  if(active)
+    m_timer.active |= 1 << bus;
+  else
+    m_timer.active &= ~(1 << bus);
+
+  if(!_was_active && m_timer.active != 0){
+    m_timer.overflows = 0;
+    nrf_timer_event_clear(IC_BUS_STATS_TIMER, nrf_timer_compare_event_get(IC_BUS_STATS_WRAP_CC));
+    nrf_timer_task_trigger(IC_BUS_STATS_TIMER, NRF_TIMER_TASK_CLEAR);
+    nrf_timer_task_trigger(IC_BUS_STATS_TIMER, NRF_TIMER_TASK_START);
+  }
+  else if(_was_active && m_timer.active == 0){
+    /* Releases HFCLK, STOP alone keeps it requested */
+    nrf_timer_task_trigger(IC_BUS_STATS_TIMER, NRF_TIMER_TASK_SHUTDOWN);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_bus_timestamp_t ic_bus_stats_timestamp(void){
+  uint16_t _low;
+  uint32_t _high;
+
+  CRITICAL_REGION_ENTER();
+  nrf_timer_task_trigger(IC_BUS_STATS_TIMER, nrf_timer_capture_task_get(IC_BUS_STATS_CC));
+  _low = (uint16_t)nrf_timer_cc_read(IC_BUS_STATS_TIMER, IC_BUS_STATS_CC);
+  _high = m_timer.overflows;
+  /* Wrapped after IRQs were disabled, IRQ did not count it yet */
+  if(nrf_timer_event_check(IC_BUS_STATS_TIMER, nrf_timer_compare_event_get(IC_BUS_STATS_WRAP_CC))
+      && _low < UINT16_MAX/2)
+    ++_high;
+  CRITICAL_REGION_EXIT();
+
+  return _high << 16 | _low;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_bus_stats_queued(ic_bus_e bus, uint8_t depth){
+  CRITICAL_REGION_ENTER();
+  if(depth > m_bus[bus].high_water)
+    m_bus[bus].high_water = depth;
+  CRITICAL_REGION_EXIT();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_bus_stats_busy(ic_bus_e bus, uint8_t id){
+  CRITICAL_REGION_ENTER();
+  __auto_type _device = m_get_device(bus, id);
+  if(_device != NULL)
+    m_saturated_inc(&_device->busy);
+  CRITICAL_REGION_EXIT();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_bus_stats_done(
+    ic_bus_e bus,
+    uint8_t id,
+    ic_bus_timestamp_t enqueued,
+    bool error,
+    uint8_t pending)
+{
+  __auto_type _now = ic_bus_stats_timestamp();
+
+  CRITICAL_REGION_ENTER();
+  __auto_type _start = enqueued;
+  if(!m_bus[bus].idle &&
+      (ic_bus_timestamp_t)(_now - enqueued) > (ic_bus_timestamp_t)(_now - m_bus[bus].last_done))
+    _start = m_bus[bus].last_done;
+
+  m_bus[bus].last_done = _now;
+  m_bus[bus].idle = pending == 0;
+
+  __auto_type _device = m_get_device(bus, id);
+  if(_device != NULL){
+    ++_device->transactions;
+    if(error)
+      m_saturated_inc(&_device->errors);
+    m_saturated_inc(&_device->wait_hist[m_bucket(_start - enqueued)]);
+    m_saturated_inc(&_device->transfer_hist[m_bucket(_now - _start)]);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_bus_stats_reset(void){
+  CRITICAL_REGION_ENTER();
+  memset(m_devices, 0, sizeof(m_devices));
+  for(int i = 0; i < IC_BUS_NUM; ++i){
+    m_bus[i].high_water = 0;
+    m_bus[i].idle = true;
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+static ic_return_val_e m_send_frame(ic_bus_stats_frame_s *frame){
+  uint32_t _err;
+  ic_return_val_e _ret_val;
+
+  for(int i = 0; i < IC_BUS_STATS_SEND_RETRIES; ++i){
+    _ret_val = ble_iccs_send_to_stream2((uint8_t *)frame, sizeof(*frame), &_err);
+    if(_ret_val != IC_BUSY)
+      break;
+    vTaskDelay(1);
+  }
+
+  return _ret_val;
+}
+
+static ic_return_val_e m_send_hist(
+    device_stats_s *device,
+    ic_bus_stats_frame_e type,
+    uint16_t *hist)
+{
+  ic_bus_stats_frame_s _frame = {.type = type, .bus = device->bus, .id = device->id};
+
+  for(uint8_t i = 0; i < IC_BUS_STATS_BUCKETS; i += IC_BUS_STATS_HIST_PER_FRAME){
+    memset(_frame.val, 0, sizeof(_frame.val));
+    _frame.first = i;
+    memcpy(
+        _frame.val,
+        &hist[i],
+        sizeof(uint16_t)*MIN(IC_BUS_STATS_HIST_PER_FRAME, IC_BUS_STATS_BUCKETS-i));
+
+    __auto_type _ret_val = m_send_frame(&_frame);
+    if(_ret_val != IC_SUCCESS)
+      return _ret_val;
+  }
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_bus_stats_dump(void){
+  if(!m_module_initialized)
+    return IC_NOT_INIALIZED;
+
+  for(int i = 0; i < IC_BUS_STATS_DEVICES && m_devices[i].used; ++i){
+    device_stats_s _device;
+    uint8_t _high_water;
+
+    CRITICAL_REGION_ENTER();
+    _device = m_devices[i];
+    _high_water = m_bus[_device.bus].high_water;
+    CRITICAL_REGION_EXIT();
+
+    NRF_LOG_INFO("%s 0x%02X: %d transactions, %d busy, %d errors\n",
+        (uint32_t)(_device.bus == IC_BUS_TWI ? "TWI" : "SPI"),
+        _device.id,
+        _device.transactions,
+        _device.busy,
+        _device.errors);
+
+    ic_bus_stats_frame_s _frame = {
+      .type   = IC_BUS_STATS_FRAME_SUMMARY,
+      .bus    = _device.bus,
+      .id     = _device.id,
+      .first  = _high_water,
+      .val    = {
+        (uint16_t)_device.transactions,
+        (uint16_t)(_device.transactions >> 16),
+        _device.busy,
+        _device.errors}
+    };
+
+    __auto_type _ret_val = m_send_frame(&_frame);
+    if(_ret_val == IC_SUCCESS)
+      _ret_val = m_send_hist(&_device, IC_BUS_STATS_FRAME_WAIT, _device.wait_hist);
+    if(_ret_val == IC_SUCCESS)
+      _ret_val = m_send_hist(&_device, IC_BUS_STATS_FRAME_TRANSFER, _device.transfer_hist);
+    if(_ret_val != IC_SUCCESS)
+      return _ret_val;
+  }
+
+  return IC_SUCCESS;
+}
+
+#endif /* IC_BUS_STATS_ENABLED */
@@ -0,0 +1,139 @@
+/**
+ * @file    ic_bus_stats.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   TWI/SPI transaction statistics
+ *
+ * Per device latency histograms (enqueue to start, start to complete), busy rejections, errors and
+ * queue high-water marks. Timestamps come from TIMER1 extended to 32 bits by its overflow IRQ.
+ * Timer (and HFCLK it needs) runs only while some bus is not idle, drivers report it with
+ * @ref ic_bus_stats_active. Disabled by default (@ref IC_BUS_STATS_ENABLED), frames are decoded on
+ * host by tools/bus_stats_dump.py.
+ */
+
+#ifndef IC_BUS_STATS_H
+#define IC_BUS_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_BUS_STATS
+ *  @{
+ */
+
+typedef enum{
+  IC_BUS_TWI = 0,
+  IC_BUS_SPI,
+
+  IC_BUS_NUM
+}ic_bus_e;
+
+/**
+ * @brief Type of diagnostic frame sent on stream2
+ */
+typedef enum{
+  IC_BUS_STATS_FRAME_SUMMARY = 0x01,  /** val[0..1] - transactions, val[2] - busy, val[3] - errors */
+  IC_BUS_STATS_FRAME_WAIT,            /** val - enqueue to start histogram from bucket 'first' */
+  IC_BUS_STATS_FRAME_TRANSFER         /** val - start to complete histogram from bucket 'first' */
+}ic_bus_stats_frame_e;
+
+/**
+ * @brief Diagnostic frame (20 bytes)
+ *
+ * Histogram bucket n counts transactions which took [2^n, 2^(n+1)) timer ticks
+ * (@ref IC_BUS_STATS_TICK_US us each). Last bucket holds everything longer. In summary frame
+ * 'first' field holds queue high-water mark of the bus.
+ */
+typedef struct __attribute__((packed)){
+  uint8_t type;                       /** @ref ic_bus_stats_frame_e */
+  uint8_t bus;                        /** @ref ic_bus_e */
+  uint8_t id;                         /** TWI address or SPI CS pin */
+  uint8_t first;
+  uint16_t val[8];
+}ic_bus_stats_frame_s;
+
+typedef uint32_t ic_bus_timestamp_t;
+
+#if IC_BUS_STATS_ENABLED
+
+/**
+ * @brief Configure timestamp timer. Can be called many times.
+ */
+void ic_bus_stats_init(void);
+
+/**
+ * @brief Report that queue of bus got first transaction (true) or got empty (false). Timer runs
+ * while any bus is active. Safe to call from IRQ.
+ */
+void ic_bus_stats_active(ic_bus_e bus, bool active);
+
+/**
+ * @brief Current timestamp. Safe to call from IRQ. Valid only while bus is active.
+ */
+ic_bus_timestamp_t ic_bus_stats_timestamp(void);
+
+/**
+ * @brief Report queue depth after transaction was queued.
+ */
+void ic_bus_stats_queued(ic_bus_e bus, uint8_t depth);
+
+/**
+ * @brief Report transaction rejected because queue or driver was busy.
+ */
+void ic_bus_stats_busy(ic_bus_e bus, uint8_t id);
+
+/**
+ * @brief Report finished transaction.
+ *
+ * Bus starts next transaction as soon as previous one is finished, so start time is the later of
+ * enqueue time and completion of previous transaction on the same bus.
+ *
+ * @param enqueued  Timestamp taken when transaction was queued.
+ * @param error     Transaction failed.
+ * @param pending   Transactions left in queue.
+ */
+void ic_bus_stats_done(
+    ic_bus_e bus,
+    uint8_t id,
+    ic_bus_timestamp_t enqueued,
+    bool error,
+    uint8_t pending);
+
+/**
+ * @brief Clear all statistics.
+ */
+void ic_bus_stats_reset(void);
+
+/**
+ * @brief Send all statistics as @ref ic_bus_stats_frame_s frames on stream2 (and to log).
+ *
+ * Blocks calling task when BLE buffers are full.
+ *
+ * @return IC_SUCCESS or IC_BLE_NOT_CONNECTED/IC_BUSY when frames could not be sent.
+ */
+ic_return_val_e ic_bus_stats_dump(void);
+
+#else
+
+static inline void ic_bus_stats_init(void){}
+static inline void ic_bus_stats_active(ic_bus_e bus, bool active){}
+static inline ic_bus_timestamp_t ic_bus_stats_timestamp(void){ return 0; }
+static inline void ic_bus_stats_queued(ic_bus_e bus, uint8_t depth){}
+static inline void ic_bus_stats_busy(ic_bus_e bus, uint8_t id){}
+static inline void ic_bus_stats_done(
+    ic_bus_e bus,
+    uint8_t id,
+    ic_bus_timestamp_t enqueued,
+    bool error,
+    uint8_t pending){}
+static inline void ic_bus_stats_reset(void){}
+static inline ic_return_val_e ic_bus_stats_dump(void){ return IC_NOT_INIALIZED; }
+
+#endif /* IC_BUS_STATS_ENABLED */
+
+/** @} */
+
+#endif /* !IC_BUS_STATS_H */
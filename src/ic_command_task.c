@@ -13,224 +13,866 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
+#include "timers.h"
+#include "app_util_platform.h"
 
 #include "ic_command_task.h"
+#include "ic_scheduler.h"
+#include "ic_ring_buffer.h"
 
 #define NRF_LOG_MODULE_NAME "CMD"
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 
-enum e_command_desc{
-  RGB_LED_DESC = 0,
-  POWER_LED_DESC,
-  VIBRATOR_DESC,
-  PULSEOXIMETER_DESC,
-  E_ALARM_DESC,
-  DEVICE_DESC,
-  STATUS_DESC,
-  DFU_DESC,
-  FEED_DESC,
-  UNLOCK_DESC,
-  SHUTDOWN_DESC,
-  TEST_DESC,
-  FLASH_BQ_DESC,
+#define CMD_RESPONSE_RETRIES  8
+
+#define CMD_SLOT(cmd_)  cmd_##_SLOT,
+#define CMD_INDEX(cmd_) [cmd_] = cmd_##_SLOT + 1,
+#define CMD_CASE(cmd_)  case cmd_:
+
+/**
+ * @brief Commands known by device, order does not matter.
+ */
+#define CMD_LIST(X)       \
+  X(RGB_LED_CMD)          \
+  X(POWER_LED_CMD)        \
+  X(VIBRATOR_CMD)         \
+  X(PULSEOXIMETER_CMD)    \
+  X(E_ALARM_CMD)          \
+  X(DEVICE_CMD)           \
+  X(STATUS_CMD)           \
+  X(DFU_CMD)              \
+  X(FEED_CMD)             \
+  X(UNLOCK_MASK)          \
+  X(SHUTDOWN_CMD)         \
+  X(TEST_CMD)             \
+  X(FLASH_BQ_CMD)         \
+  X(CMD_SCHEDULER)        \
+  X(CMD_LTC_CURVE)        \
+  X(CMD_LTC_PATTERN)      \
+  X(CMD_SMART_WAKE)
+
+enum e_command_slot{
+  CMD_LIST(CMD_SLOT)
 
   NUM_OF_COMMANDS
 };
 
+_Static_assert(NUM_OF_COMMANDS < UINT8_MAX, "Slot has to fit index table");
+
 typedef struct{
-  e_cmd cmd;
-  union{
-    void *p_func;
-    void (*cmd_handle)(u_BLECmdPayload);
-  }cmd_callback;
+  cmd_handler_t handler;
+  void *ctx;
+  cmd_stats_t stats;
 }command_desc_t;
 
+typedef struct __attribute__((packed)){
+  uint8_t id;
+  uint8_t cmd;
+  uint8_t status;                     /** @ref cmd_status_t */
+  uint8_t data[CMD_RESPONSE_DATA_LEN];
+}cmd_response_frame_t;
+
+_Static_assert(sizeof(cmd_response_frame_t) == 20, "Response has to fit notification");
+
+typedef struct{
+  cmd_request_t request;
+  uint8_t status;                     /** @ref cmd_status_t */
+  uint8_t len;
+  uint8_t data[CMD_RESPONSE_DATA_LEN];
+}cmd_queued_response_t;
+
+/** Validated frames waiting for command task */
+static IC_RING_BUFFER(u_cmdFrameContainer, IC_CMD_QUEUE_LEN) m_cmd_queue;
+/** Responses of contexts which can not block (MPSC), sent by command task */
+static IC_RING_BUFFER(cmd_queued_response_t, IC_CMD_RESPONSE_QUEUE_LEN) m_response_queue;
+/** Functions waiting for command task, NULL - free slot */
+static cmd_pended_t m_pended[IC_CMD_PENDED_MAX];
+static cmd_intake_stats_t m_intake;
+
+/**
+ * @brief Batch being collected by intake, then applied by command task. Frames are not touched by
+ * intake while batch is ready. Batch which is not completed in IC_CMD_BATCH_TIMEOUT is dropped by
+ * timer, its late sub-commands are rejected for another IC_CMD_BATCH_TIMEOUT.
+ */
+static struct{
+  cmd_request_t request;              /** Batch header */
+  uint32_t time;                      /** Unix time batch is scheduled at, 0 - apply now */
+  TickType_t started;                 /** Header arrived, or batch expired when 'late' is set */
+  uint8_t expected;
+  uint8_t count;
+  uint8_t late;                       /** Sub-commands of expired batch still to be rejected */
+  bool collecting;
+  bool volatile ready;
+  TimerHandle_t timer;
+  u_cmdFrameContainer frames[IC_CMD_BATCH_MAX];
+}m_batch;
+
+/** Request being handled by command task */
+static cmd_request_t m_current;
+static bool m_current_pending;        /** Response is sent by command task */
+static cmd_local_listener_t m_local_listener;
+
 static TaskHandle_t m_cmd_main_task_handle;
 static void m_cmd_handle(uint8_t *, size_t);
+static void m_batch_timer_callback(TimerHandle_t);
 
-static void default_cmd_handle(u_BLECmdPayload);
+static ic_return_val_e default_cmd_handle(u_BLECmdPayload, void *);
 static void wrong_cmd_handle(e_cmd);
 
-xQueueHandle cmd_queue;
-static command_desc_t m_cmd_list[NUM_OF_COMMANDS] = {
-  {
-    .cmd = RGB_LED_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = POWER_LED_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = VIBRATOR_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = PULSEOXIMETER_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = E_ALARM_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = DEVICE_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = STATUS_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = DFU_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = FEED_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = UNLOCK_MASK,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = SHUTDOWN_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = TEST_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  },
-  {
-    .cmd = FLASH_BQ_CMD,
-    .cmd_callback.cmd_handle = default_cmd_handle
-  }
+/** Slot of command + 1 indexed by command code, 0 - unknown command */
+static const uint8_t m_cmd_index[UINT8_MAX + 1] = {
+  CMD_LIST(CMD_INDEX)
+};
+
+static command_desc_t m_cmd_table[NUM_OF_COMMANDS] = {
+  [0 ... NUM_OF_COMMANDS - 1] = {.handler = default_cmd_handle}
 };
 
-static ic_return_val_e m_cmd_task_connect_to_cmd(void *p_func, command_desc_t *cmd_desc){
-  cmd_desc->cmd_callback.p_func = p_func;
-  return p_func != NULL ? IC_SUCCESS : IC_ERROR;
+/**
+ * @brief Never called. Does not compile when command is listed twice or collides with batch
+ * (duplicate case value).
+ */
+static inline void m_cmd_list_unique(e_cmd cmd){
+  switch((int)cmd){
+    CMD_LIST(CMD_CASE)
+    case CMD_BATCH:
+    default:
+      break;
+  }
 }
 
-ic_return_val_e cmd_task_connect_to_rgb_led_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[RGB_LED_DESC]);
+static command_desc_t *m_cmd_lookup(uint8_t cmd){
+  __auto_type _slot = m_cmd_index[cmd];
+  return _slot != 0 ? &m_cmd_table[_slot - 1] : NULL;
 }
 
-ic_return_val_e cmd_task_connect_to_power_led_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[POWER_LED_DESC]);
+static ic_return_val_e m_cmd_dispatch(command_desc_t *desc, u_BLECmdPayload payload){
+  cmd_handler_t _handler;
+  void *_ctx;
+
+  CRITICAL_REGION_ENTER();
+  _handler = desc->handler;
+  _ctx = desc->ctx;
+  CRITICAL_REGION_EXIT();
+
+  __auto_type _start = GET_TICK_COUNT();
+  __auto_type _ret_val = _handler(payload, _ctx);
+  __auto_type _ticks = GET_TICK_COUNT() - _start;
+
+  CRITICAL_REGION_ENTER();
+  ++desc->stats.count;
+  desc->stats.ticks += _ticks;
+  if(_ticks > desc->stats.max_ticks)
+    desc->stats.max_ticks = _ticks > UINT16_MAX ? UINT16_MAX : _ticks;
+  if(_ret_val != IC_SUCCESS)
+    ++desc->stats.errors;
+  CRITICAL_REGION_EXIT();
+
+  return _ret_val;
 }
 
-ic_return_val_e cmd_task_connect_to_vibrator_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[VIBRATOR_DESC]);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e cmd_register(e_cmd cmd, cmd_handler_t handler, void *ctx){
+  if(handler == NULL || (unsigned)cmd > UINT8_MAX)
+    return IC_ERROR;
+
+  __auto_type _desc = m_cmd_lookup(cmd);
+  if(_desc == NULL)
+    return IC_ERROR;
+
+  CRITICAL_REGION_ENTER();
+  _desc->handler = handler;
+  _desc->ctx = ctx;
+  CRITICAL_REGION_EXIT();
+
+  return IC_SUCCESS;
 }
 
-ic_return_val_e cmd_task_connect_to_pulseoximeter_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[PULSEOXIMETER_DESC]);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e cmd_get_stats(e_cmd cmd, cmd_stats_t *stats){
+  __auto_type _desc = (unsigned)cmd <= UINT8_MAX ? m_cmd_lookup(cmd) : NULL;
+  if(_desc == NULL || stats == NULL)
+    return IC_ERROR;
+
+  CRITICAL_REGION_ENTER();
+  *stats = _desc->stats;
+  CRITICAL_REGION_EXIT();
+
+  return IC_SUCCESS;
 }
 
-ic_return_val_e cmd_task_connect_to_e_alarm_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[E_ALARM_DESC]);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+cmd_intake_stats_t cmd_get_intake_stats(void){
+  cmd_intake_stats_t _stats;
+
+  CRITICAL_REGION_ENTER();
+  _stats = m_intake;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
 }
 
-ic_return_val_e cmd_task_connect_to_device_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[DEVICE_DESC]);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void cmd_stats_dump(void){
+  __auto_type _intake = cmd_get_intake_stats();
+  NRF_LOG_INFO("intake: %d received, %d invalid, %d overflows, %d coalesced, high water %d\n",
+      _intake.received,
+      _intake.invalid,
+      _intake.overflows,
+      _intake.coalesced,
+      _intake.high_water);
+  NRF_LOG_INFO("intake: %d responses lost\n", _intake.lost_responses);
+
+  for(int i = 0; i <= UINT8_MAX; ++i){
+    if(m_cmd_index[i] == 0)
+      continue;
+
+    cmd_stats_t _stats;
+    (void)cmd_get_stats(i, &_stats);
+    if(_stats.count == 0)
+      continue;
+
+    NRF_LOG_INFO("cmd 0x%02X: %d calls, %d errors, %d ticks (max %d)\n",
+        i, _stats.count, _stats.errors, _stats.ticks, _stats.max_ticks);
+  }
 }
 
-ic_return_val_e cmd_task_connect_to_status_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[STATUS_DESC]);
+static cmd_request_t m_request_of(const u_cmdFrameContainer *frame){
+  return (cmd_request_t){
+    .id     = frame->frame.sync,
+    .cmd    = frame->frame.cmd,
+    .tagged = frame->frame.sync <= CMD_MAX_REQUEST_ID,
+    .local  = frame->frame.sync >= CMD_LOCAL_ID_FIRST && frame->frame.sync <= CMD_LOCAL_ID_LAST
+  };
 }
 
-ic_return_val_e cmd_task_connect_to_dfu_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[DFU_DESC]);
+static void m_wake_task(void){
+  if(m_cmd_main_task_handle == NULL)
+    return;
+
+  if(isr_context()){
+    __auto_type _yield_required = pdFALSE;
+    vTaskNotifyGiveFromISR(m_cmd_main_task_handle, &_yield_required);
+    portYIELD_FROM_ISR(_yield_required);
+  }
+  else{
+    xTaskNotifyGive(m_cmd_main_task_handle);
+  }
 }
 
-ic_return_val_e cmd_task_connect_to_feed_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[FEED_DESC]);
+/**
+ * @brief Pending actuator command superseded by frame. Only the newest pending command of
+ * overlapping devices can be replaced, otherwise order of commands would change final state.
+ * Called with interrupts disabled.
+ */
+static u_cmdFrameContainer *m_coalesce_slot(const u_cmdFrameContainer *frame){
+  if(frame->frame.cmd != DEVICE_CMD)
+    return NULL;
+
+  __auto_type _devices = frame->frame.payload.device_cmd.device;
+
+  for(int i = IC_RING_COUNT(m_cmd_queue) - 1; i >= 0; --i){
+    __auto_type _pending = &IC_RING_AT(m_cmd_queue, i);
+    if(_pending->frame.cmd != DEVICE_CMD)
+      continue;
+
+    if(_pending->frame.payload.device_cmd.device == _devices)
+      return _pending;
+    if(_pending->frame.payload.device_cmd.device & _devices)
+      return NULL;
+  }
+  return NULL;
 }
 
-ic_return_val_e cmd_task_connect_to_unlock_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[UNLOCK_DESC]);
+/**
+ * @return CMD_STATUS_OK - frame queued, CMD_STATUS_COALESCED - frame replaced superseded one,
+ * CMD_STATUS_BUSY - queue full.
+ */
+static cmd_status_t m_cmd_push(const u_cmdFrameContainer *frame, cmd_request_t *superseded){
+  __auto_type _status = CMD_STATUS_OK;
+
+  CRITICAL_REGION_ENTER();
+  ++m_intake.received;
+
+  __auto_type _slot = m_coalesce_slot(frame);
+  if(_slot != NULL){
+    *superseded = m_request_of(_slot);
+    *_slot = *frame;
+    ++m_intake.coalesced;
+    _status = CMD_STATUS_COALESCED;
+  }
+  else if(IC_RING_FULL(m_cmd_queue)){
+    ++m_intake.overflows;
+    _status = CMD_STATUS_BUSY;
+  }
+  else{
+    IC_RING_NEXT(m_cmd_queue) = *frame;
+    ic_ring_commit(&m_cmd_queue.ring);
+    if(IC_RING_COUNT(m_cmd_queue) > m_intake.high_water)
+      m_intake.high_water = IC_RING_COUNT(m_cmd_queue);
+  }
+  CRITICAL_REGION_EXIT();
+
+  return _status;
 }
 
-ic_return_val_e cmd_task_connect_to_shutdown_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[SHUTDOWN_DESC]);
+static cmd_status_t m_status_of(ic_return_val_e ret_val){
+  switch(ret_val){
+    case IC_SUCCESS:
+      return CMD_STATUS_OK;
+    case IC_BUSY:
+      return CMD_STATUS_BUSY;
+    default:
+      return CMD_STATUS_ERROR;
+  }
 }
 
-ic_return_val_e cmd_task_connect_to_test_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[TEST_DESC]);
+static void m_batch_schedule(void){
+  ic_scheduler_handle_s _handle;
+  __auto_type _ret_val = ic_scheduler_add(m_batch.time, m_batch.frames, m_batch.count, &_handle);
+
+  m_batch.ready = false;
+  if(_ret_val == IC_SUCCESS)
+    cmd_respond(m_batch.request, CMD_STATUS_OK, &_handle, sizeof(_handle));
+  else
+    cmd_respond(m_batch.request, m_status_of(_ret_val), NULL, 0);
+}
+
+/**
+ * @brief Apply collected batch in one pass. Nothing is applied (or scheduled) when any command is
+ * unknown, sub-commands get no responses of their own.
+ */
+static void m_batch_apply(void){
+  command_desc_t *_desc[IC_CMD_BATCH_MAX];
+  cmd_batch_result_t _result = {.count = m_batch.count, .first_failed = CMD_BATCH_NONE_FAILED};
+
+  for(int i = 0; i < m_batch.count; ++i){
+    _desc[i] = m_cmd_lookup(m_batch.frames[i].frame.cmd);
+    if(_desc[i] == NULL){
+      wrong_cmd_handle(m_batch.frames[i].frame.cmd);
+      _result.failed = 1;
+      _result.first_failed = i;
+      cmd_respond(m_batch.request, CMD_STATUS_UNKNOWN_CMD, &_result, sizeof(_result));
+      m_batch.ready = false;
+      return;
+    }
+  }
+
+  if(m_batch.time != 0){
+    m_batch_schedule();
+    return;
+  }
+
+  for(int i = 0; i < m_batch.count; ++i){
+    m_current = m_request_of(&m_batch.frames[i]);
+    m_current.tagged = false;
+    m_current_pending = false;
+
+    if(m_cmd_dispatch(_desc[i], m_batch.frames[i].frame.payload) != IC_SUCCESS){
+      if(_result.failed++ == 0)
+        _result.first_failed = i;
+    }
+  }
+
+  m_batch.ready = false;
+  cmd_respond(
+      m_batch.request,
+      _result.failed == 0 ? CMD_STATUS_OK : CMD_STATUS_ERROR,
+      &_result,
+      sizeof(_result));
 }
 
-ic_return_val_e cmd_task_connect_to_flashBQ_cmd(void (*p_func)(u_BLECmdPayload)){
-  return m_cmd_task_connect_to_cmd(p_func, &m_cmd_list[FLASH_BQ_DESC]);
+/**
+ * @brief Send responses queued by @ref cmd_respond_async.
+ */
+static void m_flush_responses(void){
+  for(;;){
+    cmd_queued_response_t _response;
+    bool _ok;
+
+    CRITICAL_REGION_ENTER();
+    IC_RING_POP(m_response_queue, _response, _ok);
+    CRITICAL_REGION_EXIT();
+
+    if(!_ok)
+      return;
+
+    (void)cmd_respond(_response.request, _response.status, _response.data, _response.len);
+  }
+}
+
+/**
+ * @brief Run functions passed to @ref cmd_pend.
+ */
+static void m_run_pended(void){
+  for(int i = 0; i < IC_CMD_PENDED_MAX; ++i){
+    cmd_pended_t _function;
+
+    CRITICAL_REGION_ENTER();
+    _function = m_pended[i];
+    m_pended[i] = NULL;
+    CRITICAL_REGION_EXIT();
+
+    if(_function != NULL)
+      _function();
+  }
 }
 
 void cmd_main_task(void *args){
   UNUSED_PARAMETER(args);
-  cmd_queue = xQueueCreate(5, sizeof(u_cmdFrameContainer));
-  if(NULL == cmd_queue){
-    NRF_LOG_ERROR("CMD queue init error\n");
-    APP_ERROR_HANDLER(NRF_ERROR_INTERNAL);
-  }
 
   ble_iccs_connect_to_cmd(m_cmd_handle);
 
-  uint8_t i = 0;
   u_cmdFrameContainer tmp_frame;
   memset(&tmp_frame, 0, sizeof(u_cmdFrameContainer));
 
   for(;;){
-    xQueueReceive(cmd_queue, &(tmp_frame), portMAX_DELAY);
-    if(tmp_frame.frame.sync != 0xEE || !neuroon_cmd_frame_validate(tmp_frame.data, 20)){
-      NRF_LOG_ERROR("Wrong SYNC/CRC\n");
-      continue;
-    }
-    for(i = 0; i < NUM_OF_COMMANDS; i++){
-      if(tmp_frame.frame.cmd == m_cmd_list[i].cmd){
-        m_cmd_list[i].cmd_callback.cmd_handle(tmp_frame.frame.payload);
+    (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    for(;;){
+      bool _ok;
+
+      m_flush_responses();
+      m_run_pended();
+
+      /* Popped with interrupts disabled, intake may coalesce pending frames */
+      CRITICAL_REGION_ENTER();
+      IC_RING_POP(m_cmd_queue, tmp_frame, _ok);
+      CRITICAL_REGION_EXIT();
+
+      if(!_ok)
         break;
+
+      if(tmp_frame.frame.cmd == CMD_BATCH){
+        m_batch_apply();
+        continue;
       }
-    }
-    if(i == NUM_OF_COMMANDS){
-      wrong_cmd_handle(tmp_frame.frame.cmd);
+
+      m_current = m_request_of(&tmp_frame);
+
+      __auto_type _desc = m_cmd_lookup(tmp_frame.frame.cmd);
+      if(_desc == NULL){
+        wrong_cmd_handle(tmp_frame.frame.cmd);
+        cmd_respond(m_current, CMD_STATUS_UNKNOWN_CMD, NULL, 0);
+        continue;
+      }
+
+      m_current_pending = true;
+      __auto_type _ret_val = m_cmd_dispatch(_desc, tmp_frame.frame.payload);
+      if(m_current_pending)
+        cmd_respond(
+            cmd_defer(),
+            _ret_val == IC_SUCCESS ? CMD_STATUS_OK : CMD_STATUS_ERROR,
+            NULL,
+            0);
     }
   }
   cmd_module_destroy();
 }
 
 void cmd_module_init(void){
-  if(pdPASS != xTaskCreate(cmd_main_task, "CMD", 256, NULL, IC_FREERTOS_TASK_PRIORITY_LOW, &m_cmd_main_task_handle)){
+  ic_ring_clean(&m_cmd_queue.ring);
+  ic_ring_clean(&m_response_queue.ring);
+
+  if(m_batch.timer == NULL)
+    m_batch.timer = xTimerCreate(
+        "BATCH",
+        IC_CMD_BATCH_TIMEOUT,
+        pdFALSE,
+        NULL,
+        m_batch_timer_callback);
+  if(m_batch.timer == NULL)
+    APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+
+  if(pdPASS != xTaskCreate(
+        cmd_main_task,
+        "CMD",
+        256,
+        NULL,
+        IC_CMD_TASK_PRIORITY,
+        &m_cmd_main_task_handle)){
     APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
   }
 }
 
 bool cmd_queue_reset(void){
-  if(NULL == cmd_queue)
+  if(NULL == m_cmd_main_task_handle)
     return false;
-  xQueueReset(cmd_queue);
+
+  CRITICAL_REGION_ENTER();
+  ic_ring_clean(&m_cmd_queue.ring);
+  CRITICAL_REGION_EXIT();
   return true;
 }
 
 void cmd_module_destroy(void){
-  vQueueDelete(cmd_queue);
-  vTaskDelete(m_cmd_main_task_handle);
+  __auto_type _handle = m_cmd_main_task_handle;
+
+  m_cmd_main_task_handle = NULL;
+  vTaskDelete(_handle);
   taskYIELD();
 }
 
+/**
+ * @brief Drop batch which was not completed in time. Called by timer and by intake, whichever
+ * comes first answers it.
+ */
+static void m_batch_expire(void){
+  __auto_type _expired = false;
+  cmd_request_t _request;
+
+  CRITICAL_REGION_ENTER();
+  __auto_type _now = GET_TICK_COUNT();
+  if(m_batch.collecting && _now - m_batch.started >= IC_CMD_BATCH_TIMEOUT){
+    m_batch.collecting = false;
+    m_batch.late = m_batch.expected - m_batch.count;
+    m_batch.started = _now;
+    _request = m_batch.request;
+    _expired = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(_expired){
+    NRF_LOG_WARNING("Batch %d expired\n", _request.id);
+    cmd_respond_async(_request, CMD_STATUS_INVALID_FRAME, NULL, 0);
+  }
+}
+
+static void m_batch_timer_callback(TimerHandle_t timer){
+  UNUSED_PARAMETER(timer);
+  m_batch_expire();
+}
+
+static void m_batch_start(const u_cmdFrameContainer *frame){
+  __auto_type _request = m_request_of(frame);
+  __auto_type _expected = frame->frame.payload.data[0];
+
+  if(!_request.tagged || _expected == 0 || _expected > IC_CMD_BATCH_MAX){
+    NRF_LOG_ERROR("Wrong batch\n");
+    cmd_respond_async(_request, CMD_STATUS_INVALID_FRAME, NULL, 0);
+    return;
+  }
+
+  if(m_batch.ready){
+    cmd_respond_async(_request, CMD_STATUS_BUSY, NULL, 0);
+    return;
+  }
+
+  __auto_type _previous = m_batch.request;
+  bool _superseded;
+
+  CRITICAL_REGION_ENTER();
+  _superseded = m_batch.collecting;
+  m_batch.request = _request;
+  m_batch.time = frame->frame.payload.data[1]
+    | frame->frame.payload.data[2] << 8
+    | frame->frame.payload.data[3] << 16
+    | (uint32_t)frame->frame.payload.data[4] << 24;
+  m_batch.started = GET_TICK_COUNT();
+  m_batch.expected = _expected;
+  m_batch.count = 0;
+  m_batch.late = 0;
+  m_batch.collecting = true;
+  CRITICAL_REGION_EXIT();
+
+  if(_superseded){
+    NRF_LOG_WARNING("Batch %d not completed\n", _previous.id);
+    cmd_respond_async(_previous, CMD_STATUS_INVALID_FRAME, NULL, 0);
+  }
+
+  /* Intake can not block, when timer queue is full batch expires on next frame */
+  (void)xTimerReset(m_batch.timer, 0);
+}
+
+/**
+ * @brief Take sub-command of batch being collected, or reject late sub-command of expired one.
+ *
+ * @return false when frame is not part of any batch.
+ */
+static bool m_batch_collect(const u_cmdFrameContainer *frame, cmd_request_t request){
+  __auto_type _taken = false;
+  __auto_type _complete = false;
+  __auto_type _late = false;
+
+  m_batch_expire();
+
+  CRITICAL_REGION_ENTER();
+  if(request.id == m_batch.request.id && m_batch.collecting){
+    m_batch.frames[m_batch.count++] = *frame;
+    if(m_batch.count == m_batch.expected){
+      m_batch.collecting = false;
+      m_batch.ready = true;
+      _complete = true;
+    }
+    _taken = true;
+  }
+  else if(request.id == m_batch.request.id && m_batch.late != 0
+      && GET_TICK_COUNT() - m_batch.started < IC_CMD_BATCH_TIMEOUT){
+    --m_batch.late;
+    _taken = true;
+    _late = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(!_taken)
+    return false;
+
+  if(_late){
+    NRF_LOG_WARNING("Late sub-command of batch %d\n", request.id);
+    cmd_respond_async(request, CMD_STATUS_INVALID_FRAME, NULL, 0);
+  }
+
+  if(!_complete)
+    return true;
+
+  (void)xTimerStop(m_batch.timer, 0);
+
+  /* Header frame is a marker, command task applies frames collected here */
+  u_cmdFrameContainer _marker = {.frame = {.sync = m_batch.request.id, .cmd = CMD_BATCH}};
+  cmd_request_t _superseded;
+
+  if(m_cmd_push(&_marker, &_superseded) == CMD_STATUS_BUSY){
+    m_batch.ready = false;
+    cmd_respond_async(m_batch.request, CMD_STATUS_BUSY, NULL, 0);
+    return true;
+  }
+  m_wake_task();
+  return true;
+}
+
+/**
+ * @brief Intake of command characteristic writes. Frames are validated here, every rejected one is
+ * counted and answered (tagged requests).
+ */
 static void m_cmd_handle(uint8_t *data, size_t len){
   if(data == NULL || data == (void *)0x01) return; //TODO error is lower(bluetooth driver - here is only a dirty fix
   if(len < sizeof(s_frame)){
     NRF_LOG_ERROR("Uncomplete frame. Number of bytes: %d\n", len);
+    CRITICAL_REGION_ENTER();
+    ++m_intake.invalid;
+    CRITICAL_REGION_EXIT();
+    return;
+  }
+
+  u_cmdFrameContainer _frame;
+  memcpy(&_frame, data, sizeof(_frame));
+  __auto_type _request = m_request_of(&_frame);
+
+  if(!_request.tagged && _frame.frame.sync != CMD_SYNC_LEGACY){
+    NRF_LOG_ERROR("Wrong SYNC\n");
+    CRITICAL_REGION_ENTER();
+    ++m_intake.invalid;
+    CRITICAL_REGION_EXIT();
+    return;
+  }
+
+  if(!neuroon_cmd_frame_validate(_frame.data, 20)){
+    NRF_LOG_ERROR("Wrong CRC\n");
+    CRITICAL_REGION_ENTER();
+    ++m_intake.invalid;
+    CRITICAL_REGION_EXIT();
+    cmd_respond_async(_request, CMD_STATUS_INVALID_FRAME, NULL, 0);
     return;
   }
-  xQueueSendFromISR(cmd_queue, (u_cmdFrameContainer*)data, NULL);
+
+  if(_frame.frame.cmd == CMD_BATCH){
+    m_batch_start(&_frame);
+    return;
+  }
+
+  if(_request.tagged && m_batch_collect(&_frame, _request))
+    return;
+
+  cmd_request_t _superseded;
+
+  switch(m_cmd_push(&_frame, &_superseded)){
+    case CMD_STATUS_COALESCED:
+      cmd_respond_async(_superseded, CMD_STATUS_COALESCED, NULL, 0);
+      m_wake_task();
+      break;
+    case CMD_STATUS_BUSY:
+      NRF_LOG_WARNING("Command queue full, 0x%02X dropped\n", _request.cmd);
+      cmd_respond_async(_request, CMD_STATUS_BUSY, NULL, 0);
+      break;
+    default:
+      m_wake_task();
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e cmd_submit(uint8_t id, uint8_t cmd, const u_BLECmdPayload *payload){
+  if(id < CMD_LOCAL_ID_FIRST || id > CMD_LOCAL_ID_LAST || payload == NULL)
+    return IC_ERROR;
+
+  u_cmdFrameContainer _frame = {.frame = {.sync = id, .cmd = cmd, .payload = *payload}};
+  cmd_request_t _superseded;
+
+  switch(m_cmd_push(&_frame, &_superseded)){
+    case CMD_STATUS_BUSY:
+      return IC_BUSY;
+    case CMD_STATUS_COALESCED:
+      cmd_respond_async(_superseded, CMD_STATUS_COALESCED, NULL, 0);
+      break;
+    default:
+      break;
+  }
+  m_wake_task();
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e cmd_pend(cmd_pended_t function){
+  if(function == NULL)
+    return IC_ERROR;
+
+  __auto_type _ret_val = IC_BUSY;
+
+  CRITICAL_REGION_ENTER();
+  for(int i = 0; i < IC_CMD_PENDED_MAX && _ret_val != IC_SUCCESS; ++i){
+    if(m_pended[i] == function)
+      _ret_val = IC_SUCCESS;
+  }
+  for(int i = 0; i < IC_CMD_PENDED_MAX && _ret_val != IC_SUCCESS; ++i){
+    if(m_pended[i] == NULL){
+      m_pended[i] = function;
+      _ret_val = IC_SUCCESS;
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(_ret_val == IC_SUCCESS)
+    m_wake_task();
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void cmd_on_ble_evt(ble_evt_t *p_ble_evt){
+  if(p_ble_evt->header.evt_id != BLE_GAP_EVT_DISCONNECTED)
+    return;
+
+  /* Request IDs of next connection start over, nothing can be answered anyway */
+  CRITICAL_REGION_ENTER();
+  m_batch.collecting = false;
+  m_batch.late = 0;
+  CRITICAL_REGION_EXIT();
+
+  if(m_batch.timer != NULL)
+    (void)xTimerStop(m_batch.timer, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void cmd_connect_local(cmd_local_listener_t listener){
+  m_local_listener = listener;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+cmd_request_t cmd_defer(void){
+  m_current_pending = false;
+  return m_current;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e cmd_respond(
+    cmd_request_t request,
+    cmd_status_t status,
+    const void *data,
+    size_t len)
+{
+  if(request.local){
+    __auto_type _listener = m_local_listener;
+    if(_listener != NULL)
+      _listener(request, status);
+    return IC_SUCCESS;
+  }
+
+  if(!request.tagged)
+    return IC_SUCCESS;
+
+  if(len > CMD_RESPONSE_DATA_LEN || (data == NULL && len != 0))
+    return IC_ERROR;
+
+  cmd_response_frame_t _frame = {.id = request.id, .cmd = request.cmd, .status = status};
+  if(len != 0)
+    memcpy(_frame.data, data, len);
+
+  __auto_type _ret_val = IC_BUSY;
+  for(int i = 0; i < CMD_RESPONSE_RETRIES && _ret_val == IC_BUSY; ++i){
+    _ret_val = ble_iccs_send_to_response(
+        (uint8_t *)&_frame,
+        CMD_RESPONSE_HEADER + len,
+        NULL);
+    if(_ret_val == IC_BUSY)
+      vTaskDelay(1);
+  }
+
+  if(_ret_val != IC_SUCCESS)
+    NRF_LOG_WARNING("Response %d lost\n", request.id);
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e cmd_respond_async(
+    cmd_request_t request,
+    cmd_status_t status,
+    const void *data,
+    size_t len)
+{
+  if(!request.tagged && !request.local)
+    return IC_SUCCESS;
+
+  if(len > CMD_RESPONSE_DATA_LEN || (data == NULL && len != 0))
+    return IC_ERROR;
+
+  __auto_type _queued = false;
+
+  CRITICAL_REGION_ENTER();
+  if(!IC_RING_FULL(m_response_queue)){
+    __auto_type _response = &IC_RING_NEXT(m_response_queue);
+    _response->request = request;
+    _response->status = status;
+    _response->len = len;
+    if(len != 0)
+      memcpy(_response->data, data, len);
+    ic_ring_commit(&m_response_queue.ring);
+    _queued = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(_queued){
+    m_wake_task();
+    return IC_SUCCESS;
+  }
+
+  /* Queue full, one attempt without waiting for TX buffer */
+  __auto_type _ret_val = IC_BUSY;
+  if(!request.local && !isr_context()){
+    cmd_response_frame_t _frame = {.id = request.id, .cmd = request.cmd, .status = status};
+    if(len != 0)
+      memcpy(_frame.data, data, len);
+    _ret_val = ble_iccs_send_to_response((uint8_t *)&_frame, CMD_RESPONSE_HEADER + len, NULL);
+  }
+
+  if(_ret_val != IC_SUCCESS){
+    NRF_LOG_WARNING("Response %d lost\n", request.id);
+    CRITICAL_REGION_ENTER();
+    ++m_intake.lost_responses;
+    CRITICAL_REGION_EXIT();
+  }
+
+  return _ret_val;
 }
 
-static void default_cmd_handle(u_BLECmdPayload cmd_payload){
+static ic_return_val_e default_cmd_handle(u_BLECmdPayload cmd_payload, void *ctx){
+  UNUSED_PARAMETER(ctx);
   NRF_LOG_INFO("Payload:\n");
   for(uint8_t i = 0; i < sizeof(u_BLECmdPayload); i++)
     NRF_LOG_INFO(" %d\n", cmd_payload.data[i]);
+  return IC_SUCCESS;
 }
 
 static void wrong_cmd_handle(e_cmd cmd){
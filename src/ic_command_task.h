@@ -4,30 +4,165 @@
  * @date    November, 2017
  * @brief   Brief description
  *
- * Description
+ * Command frame sync byte selects framing:
+ *  - 0xEE          - legacy frame, no response is sent,
+ *  - 0x00 - 0x7F   - request ID, response is sent on response characteristic. Requests can be
+ *                    pipelined, responses come out of order (deferred ones later),
+ *  - 0x80 - 0xBF   - local request ID, frame was submitted by device itself (@ref cmd_submit),
+ *                    response is passed to local listener. Such frames are rejected by intake.
+ *
+ * Response:  [id:8][cmd:8][status:8][data:up to CMD_RESPONSE_DATA_LEN]
+ *
+ * Batch: tagged frame with cmd CMD_BATCH and number of sub-commands in payload[0] (up to
+ * IC_CMD_BATCH_MAX), followed by sub-command frames with the same request ID. When all of them
+ * arrived they are applied one after another in one pass of command task, nothing is applied when
+ * any of them is unknown. Batch gets one response with @ref cmd_batch_result_t, sub-commands get
+ * none. Non-zero unix time in payload[1..4] (little endian) hands batch over to scheduler instead,
+ * response carries @ref ic_scheduler_handle_s. Batch which is not completed in IC_CMD_BATCH_TIMEOUT
+ * is answered with CMD_STATUS_INVALID_FRAME, so are its late sub-commands. Disconnection drops it.
  */
 
 #ifndef IC_COMMAND_TASK_H
 #define IC_COMMAND_TASK_H
 
+#include "ble.h"
+
 #include "ic_frame_handle.h"
 #include "ic_config.h"
 
+#define CMD_SYNC_LEGACY         0xEE
+#define CMD_MAX_REQUEST_ID      0x7F
+#define CMD_LOCAL_ID_FIRST      0x80
+#define CMD_LOCAL_ID_LAST       0xBF
+#define CMD_RESPONSE_HEADER     3
+#define CMD_RESPONSE_DATA_LEN   (20 - CMD_RESPONSE_HEADER)
+#define CMD_BATCH               0xBA
+#define CMD_BATCH_NONE_FAILED   0xFF
+#define CMD_SCHEDULER           0x5C  /** Handled by @ref ic_scheduler.h */
+#define CMD_LTC_CURVE           0x5D  /** Handled by @ref ic_service_ltc.h */
+#define CMD_LTC_PATTERN         0x5E  /** Handled by @ref ic_ltc_pattern.h */
+#define CMD_SMART_WAKE          0x5F  /** Handled by @ref ic_smart_wake.h */
+
+typedef enum{
+  CMD_STATUS_OK = 0x00,
+  CMD_STATUS_ERROR,
+  CMD_STATUS_UNKNOWN_CMD,
+  CMD_STATUS_INVALID_FRAME,           /** Wrong CRC */
+  CMD_STATUS_BUSY,                    /** Command queue was full, request dropped */
+  CMD_STATUS_COALESCED,               /** Superseded by newer command for the same devices */
+  CMD_STATUS_EXPIRED                  /** Scheduled command was not executed in time */
+}cmd_status_t;
+
+typedef struct{
+  uint8_t id;
+  uint8_t cmd;
+  bool tagged;                        /** Legacy requests get no response */
+  bool local;                         /** Submitted by device, response goes to local listener */
+}cmd_request_t;
+
+typedef void (*cmd_local_listener_t)(cmd_request_t request, cmd_status_t status);
+
+typedef void (*cmd_pended_t)(void);
+
+typedef struct __attribute__((packed)){
+  uint8_t count;                      /** Sub-commands in batch */
+  uint8_t failed;                     /** Handlers which did not return IC_SUCCESS */
+  uint8_t first_failed;               /** Index of first failed one, CMD_BATCH_NONE_FAILED */
+}cmd_batch_result_t;
+
+typedef ic_return_val_e (*cmd_handler_t)(u_BLECmdPayload payload, void *ctx);
+
+typedef struct{
+  uint32_t count;
+  uint32_t ticks;                     /** Total handler execution time */
+  uint16_t max_ticks;
+  uint16_t errors;                    /** Handler did not return IC_SUCCESS */
+}cmd_stats_t;
+
+typedef struct{
+  uint32_t received;                  /** Valid frames */
+  uint16_t invalid;                   /** Frames with wrong length, SYNC or CRC */
+  uint16_t overflows;                 /** Frames rejected because queue was full */
+  uint16_t coalesced;                 /** Pending actuator commands replaced by newer ones */
+  uint8_t high_water;                 /** Max frames waiting in queue */
+  uint16_t lost_responses;            /** Responses which could be neither queued nor sent */
+}cmd_intake_stats_t;
+
 void cmd_module_init(void);
 bool cmd_queue_reset(void);
 void cmd_module_destroy(void);
-ic_return_val_e cmd_task_connect_to_rgb_led_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_power_led_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_vibrator_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_pulseoximeter_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_e_alarm_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_device_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_status_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_dfu_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_feed_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_unlock_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_shutdown_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_test_cmd(void (*p_func)(u_BLECmdPayload));
-ic_return_val_e cmd_task_connect_to_flashBQ_cmd(void (*p_func)(u_BLECmdPayload));
+
+/**
+ * @brief Register handler of command, replaces previous one. Handler is called from command task
+ * with context given here, its return value is reported as response status.
+ *
+ * @return IC_ERROR when command is not known by command task.
+ */
+ic_return_val_e cmd_register(e_cmd cmd, cmd_handler_t handler, void *ctx);
+
+ic_return_val_e cmd_get_stats(e_cmd cmd, cmd_stats_t *stats);
+
+cmd_intake_stats_t cmd_get_intake_stats(void);
+
+/**
+ * @brief Log intake statistics and statistics of commands which were called.
+ */
+void cmd_stats_dump(void);
+
+/**
+ * @brief Queue command on behalf of device module. Does not block, call from task.
+ *
+ * @param id  Local request ID, CMD_LOCAL_ID_FIRST - CMD_LOCAL_ID_LAST.
+ *
+ * @return IC_SUCCESS, IC_BUSY when queue is full, IC_ERROR on wrong ID.
+ */
+ic_return_val_e cmd_submit(uint8_t id, uint8_t cmd, const u_BLECmdPayload *payload);
+
+/**
+ * @brief Drops batch being collected on disconnection.
+ */
+void cmd_on_ble_evt(ble_evt_t *p_ble_evt);
+
+/**
+ * @brief Set receiver of responses of local requests, replaces previous one.
+ */
+void cmd_connect_local(cmd_local_listener_t listener);
+
+/**
+ * @brief Take over response of request being handled. Call from command handler, otherwise
+ * CMD_STATUS_OK is sent when handler returns.
+ */
+cmd_request_t cmd_defer(void);
+
+/**
+ * @brief Send response of request. Call from task, each request should get exactly one response.
+ *
+ * Waits a few ticks for TX buffer, use @ref cmd_respond_async where blocking is not allowed.
+ */
+ic_return_val_e cmd_respond(
+    cmd_request_t request,
+    cmd_status_t status,
+    const void *data,
+    size_t len);
+
+/**
+ * @brief Queue response, command task sends it. Does not block, call from BLE stack task, timer
+ * callbacks or IRQ. When queue is full response is sent right away if TX buffer is free.
+ *
+ * @return IC_SUCCESS, IC_BUSY when response was lost, IC_ERROR on wrong data length.
+ */
+ic_return_val_e cmd_respond_async(
+    cmd_request_t request,
+    cmd_status_t status,
+    const void *data,
+    size_t len);
+
+/**
+ * @brief Run function on command task, where it may block on BLE. Does not block, call from timer
+ * callbacks or IRQ. Function already waiting is not added again.
+ *
+ * @return IC_SUCCESS, IC_BUSY when IC_CMD_PENDED_MAX functions are waiting, IC_ERROR on NULL.
+ */
+ic_return_val_e cmd_pend(cmd_pended_t function);
 
 #endif /* !IC_COMMAND_TASK_H */
@@ -18,5 +18,6 @@ const char *g_return_val_string[] = {
   "IC_NOT_INIALIZED",
   "IC_WARNING",
   "IC_ERROR",
-  "IC_UNKNOWN_ERROR"
+  "IC_UNKNOWN_ERROR",
+  "IC_TIMEOUT"
 };
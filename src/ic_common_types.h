@@ -19,7 +19,8 @@ typedef enum{
   IC_NOT_INIALIZED,
   IC_WARNING,
   IC_ERROR,
-  IC_UNKNOWN_ERROR
+  IC_UNKNOWN_ERROR,
+  IC_TIMEOUT
 }ic_return_val_e;
 
 extern const char *g_return_val_string[];
@@ -166,10 +166,6 @@ ic_return_val_e ads_get_value(void (*p_read_callback)(int16_t), bool force){
         );
   }
 
-  if(_ret_val != IC_SUCCESS){
-    ic_twi_refresh_bus();
-  }
-
   return _ret_val;
 }
 
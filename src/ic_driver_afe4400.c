@@ -9,7 +9,9 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include "nordic_common.h"
+#include "app_util_platform.h"
 #include "nrf.h"
 #include "app_error.h"
 #include "ic_config.h"
@@ -319,16 +321,18 @@ typedef struct __attribute__((packed))
 /**********************************************************************************************************/
 /**********************************************************************************************************/
 
-  /*  semaphore for blocking and releasing spi transfer  */
-static volatile bool m_semaphore = true;
-
-/**********************************************************************************************************/
 	/*	configure SPI REGISTER to handle the SPI interrupt	*/
 SPI_REGISTER(afe_spi_write);
 
+  /*  buffers for synchronous register access (used by one task at a time)  */
 static uint8_t m_output_buffer[128];
 static uint8_t m_input_buffer[128] = {0};
 
+  /*  separate buffers for LED values read, so it can be queued next to register access  */
+static uint8_t m_values_output[AFE4400_LED_LEN * sizeof(afe_send_pack_s)];
+static uint8_t m_values_input[AFE4400_LED_LEN * sizeof(afe_send_pack_s)];
+static volatile bool m_values_pending = false;
+
   /** Array with timing values you want to write to specific timing registers
    *  It is needed to write timing values in correct sequence (given in datasheet (page 31 table 2))
    */
@@ -405,56 +409,27 @@ static uint16_t m_timing_data_64Hz[29] =
 };
 */
 /**********************************************************************************************************/
-/**
- * @brief SPI transaction callback
- *
- * @param context
- *
- * You have to declare spi transaction callback.
- * The callback is returned after spi transaction is finished.
- * In callback function is highly recommended to handle some semaphore
- * which will be taken or given while triggering callback function.
- *
- * In this example, semaphore (bool variable) is set to true which means that spi transaction is completed.
- * Before using SPI_SEND_DATA in later code, semaphore is checked and properly handled.
- */
-static void callback_spi(void *context)
-{
-  /*NRF_LOG_INFO("{ %s }\r\n", (uint32_t)__func__);*/
-  m_semaphore = true;  // transaction ended, set semaphore value to true
-
-  if(context != NULL)
-  {
-    *(uint32_t*)context  = m_output_buffer[7];
-    *(uint32_t*)context |= m_output_buffer[6]  << 8;
-    *(uint32_t*)context |= m_output_buffer[5]  << 16;
-  }
-  else
-    UNUSED_VARIABLE(context);
-}
-/**********************************************************************************************************/
-
 static void spi_led_callback(void *p_context)
 {
   /*NRF_LOG_INFO("{ %s }\r\n", (uint32_t)__func__);*/
-  m_semaphore = true;  // transaction ended, set semaphore value to true
   static uint32_t _led_val[AFE4400_LED_LEN] = {0};
 
   if (p_context != NULL)
   {
     for (int i = 0; i < AFE4400_LED_LEN; i++)
     {
-      _led_val[i]  = m_output_buffer[i * 4 + 3];
-      _led_val[i] |= m_output_buffer[i * 4 + 2] << 8;
-      _led_val[i] |= m_output_buffer[i * 4 + 1] << 16;
+      _led_val[i]  = m_values_output[i * 4 + 3];
+      _led_val[i] |= m_values_output[i * 4 + 2] << 8;
+      _led_val[i] |= m_values_output[i * 4 + 1] << 16;
         /*  two MSB can be ignored, but we're using 24-bit word format  */
       if (_led_val[i] & 0x200000)
         _led_val[i] |= 0xFFC00000;
     }
-    ((ic_afe_event_cb_done)p_context)(*(ic_afe_val_s*)_led_val);
   }
-  else
-    UNUSED_VARIABLE(p_context);
+  m_values_pending = false;  // transaction ended, buffers can be reused
+
+  if (p_context != NULL)
+    ((ic_afe_event_cb_done)p_context)(*(ic_afe_val_s*)_led_val);
 }
 
 /**
@@ -469,65 +444,51 @@ static void convert(uint32_t regVal, uint8_t *data)
   data[1] = regVal >> 8;
   data[2] = regVal;
 }
+/**********************************************************************************************************/
+/**
+ * @brief Send chain of transfers and block until it is finished
+ *
+ * @param transfers - transfers descriptors
+ * @param count     - number of transfers
+ */
+static ic_return_val_e afe_send_sync(ic_spi_transfer_s *transfers, size_t count)
+{
+  __auto_type _ret_val = SPI_SEND_CHAIN_SYNC(afe_spi_write, transfers, count, IC_SPI_SYNC_TIMEOUT);
+  if (_ret_val != IC_SUCCESS)
+    NRF_LOG_ERROR("SPI ERROR: %s\r\n", (uint32_t)g_return_val_string[_ret_val]);
 
+  return _ret_val;
+}
+/**********************************************************************************************************/
 /**
- * @brief Enable read option in AFE4400
+ * @brief Fill transfer of single pack
+ *
+ * @param transfer  - transfer descriptor
+ * @param pack      - pack to send (placed in m_input_buffer)
  */
-static ic_return_val_e afe_enable_read(void)
+static void afe_pack_transfer(ic_spi_transfer_s *transfer, afe_send_pack_s *pack)
 {
-  if (m_semaphore)
-  {
-    m_semaphore = false;
-    afe_send_pack_s *_data_to_send = (afe_send_pack_s *)&m_input_buffer[0];
-
-    _data_to_send->reg = AFE4400_CONTROL0;
-    convert(1, _data_to_send->data);  // convert data for sending via spi
-    __auto_type _ret_val =
-        SPI_SEND_DATA(
-            afe_spi_write,
-            _data_to_send,
-            m_output_buffer,
-            sizeof(afe_send_pack_s),
-            callback_spi,
-            NULL);
-    if (_ret_val != IC_SUCCESS)
-      NRF_LOG_ERROR("ERROR SPI\r\n");
-    while(m_semaphore == false);
-
-    return IC_SUCCESS;
-  }
-  else
-    return IC_BUSY;
+  *transfer = (ic_spi_transfer_s){
+    .in_buffer  = (uint8_t *)pack,
+    .in_len     = sizeof(afe_send_pack_s),
+    .out_buffer = m_output_buffer + ((uint8_t *)pack - m_input_buffer),
+    .out_len    = sizeof(afe_send_pack_s),
+    .callback   = NULL,
+    .context    = NULL,
+    .open       = false
+  };
 }
 /**********************************************************************************************************/
 /**
- * @brief Disable read option (enable write option) in AFE4400
+ * @brief Fill CONTROL0 pack switching AFE4400 between write (read disabled) and read mode
+ *
+ * @param pack  - pack to fill
+ * @param read  - enable read option
  */
-static ic_return_val_e afe_enable_write(void)
+static void afe_control_pack(afe_send_pack_s *pack, bool read)
 {
-  if (m_semaphore)
-  {
-    m_semaphore = false;
-    afe_send_pack_s *_data_to_send = (afe_send_pack_s *)&m_input_buffer[0];
-
-    _data_to_send->reg = AFE4400_CONTROL0;
-    memset(_data_to_send->data, 0, 3);	// convert data for sending via spi
-    __auto_type _ret_val =
-        SPI_SEND_DATA(
-            afe_spi_write,
-            m_input_buffer,
-            m_output_buffer,
-            sizeof(afe_send_pack_s),
-            callback_spi,
-            NULL);
-    if (_ret_val != IC_SUCCESS)
-      NRF_LOG_ERROR("ERROR SPI\r\n");
-    while(m_semaphore == false);
-
-    return IC_SUCCESS;
-  }
-  else
-    return IC_BUSY;
+  pack->reg = AFE4400_CONTROL0;
+  convert(read ? 1 : 0, pack->data);
 }
 /**********************************************************************************************************/
 /**
@@ -542,8 +503,7 @@ static ic_return_val_e afe_enable_write(void)
  * uint8_t regAddr = AFE4400_LED2STC;
  * uint32_t regVal = 0x1F;
  *
- *  // be sure that afe4400 is in writing mode
- *  // if not sure, firstly call afe_disable_read() function
+ *  // write is wrapped with write enable and read enable in a single SPI chain
  *
  * afe_write_reg(regAddr, regVal);
  *
@@ -551,36 +511,19 @@ static ic_return_val_e afe_enable_write(void)
  */
 static ic_return_val_e afe_write_reg(uint8_t regAddr, uint32_t regVal)
 {
-  if (m_semaphore)
-  {
-    afe_enable_write();
-      /*  enable write flag  */
-    m_semaphore = false;
-      /*  put correct register address and register value to send  */
-    afe_send_pack_s *_data_to_send = (afe_send_pack_s*)m_input_buffer;
-    _data_to_send->reg = regAddr;
-    convert(regVal, _data_to_send->data);	// convert data for sending via spi
-    __auto_type _ret_val =
-        SPI_SEND_DATA(
-            afe_spi_write,
-            m_input_buffer,
-            m_output_buffer,
-            sizeof(afe_send_pack_s),
-            callback_spi,
-            NULL);
-    if (_ret_val != IC_SUCCESS)
-      NRF_LOG_ERROR("ERROR SPI\r\n");
-    while(m_semaphore == false);
-
-    afe_enable_read();	// enable reading (disable writing)
-
-    return IC_SUCCESS;
-  }
-  else
-  {
-    NRF_LOG_INFO("Can't send via SPI\r\n");
-    return IC_BUSY;
-  }
+  afe_send_pack_s *_packs = (afe_send_pack_s*)m_input_buffer;
+  ic_spi_transfer_s _transfers[3];
+
+    /*  enable write, write register and enable read again in one chain  */
+  afe_control_pack(&_packs[0], false);
+  _packs[1].reg = regAddr;
+  convert(regVal, _packs[1].data);	// convert data for sending via spi
+  afe_control_pack(&_packs[2], true);
+
+  for (int i = 0; i < 3; i++)
+    afe_pack_transfer(&_transfers[i], &_packs[i]);
+
+  return afe_send_sync(_transfers, 3);
 }
 /**********************************************************************************************************/
 /**
@@ -605,40 +548,29 @@ static ic_return_val_e afe_write_reg(uint8_t regAddr, uint32_t regVal)
  */
 static ic_return_val_e afe_read_reg(uint8_t regAddr, uint32_t *reg_value)
 {
-  if (m_semaphore)
-  {
-    m_semaphore = false;
-
-    afe_send_s *_data_to_send = (afe_send_s*)m_input_buffer;
-    _data_to_send->operation = READ_OPERATION;  // store register address
-    _data_to_send->data.reg = regAddr;
-
-    __auto_type _ret_val =
-      SPI_SEND_DATA(
-          afe_spi_write,
-          m_input_buffer,
-          m_output_buffer,
-          sizeof(afe_send_s),
-          callback_spi,
-          NULL);
-
-    if (_ret_val != IC_SUCCESS)
-      NRF_LOG_ERROR("SPI ERROR\r\n");
+  afe_send_s *_data_to_send = (afe_send_s*)m_input_buffer;
+  _data_to_send->operation = READ_OPERATION;  // store register address
+  _data_to_send->data.reg = regAddr;
+
+  ic_spi_transfer_s _transfer = {
+    .in_buffer  = m_input_buffer,
+    .in_len     = sizeof(afe_send_s),
+    .out_buffer = m_output_buffer,
+    .out_len    = sizeof(afe_send_s),
+    .callback   = NULL,
+    .context    = NULL,
+    .open       = false
+  };
 
-      /*  make this function blocking  */
-    while(m_semaphore == false){}
+  __auto_type _ret_val = afe_send_sync(&_transfer, 1);
+  if (_ret_val != IC_SUCCESS)
+    return _ret_val;
 
-    *reg_value  = m_output_buffer[7];
-    *reg_value |= m_output_buffer[6] << 8;
-    *reg_value |= m_output_buffer[5] << 16;
+  *reg_value  = m_output_buffer[7];
+  *reg_value |= m_output_buffer[6] << 8;
+  *reg_value |= m_output_buffer[5] << 16;
 
-    return IC_SUCCESS;
-  }
-  else
-  {
-    NRF_LOG_INFO("Can't send via SPI\r\n");
-    return IC_BUSY;
-  }
+  return IC_SUCCESS;
 }
 /**********************************************************************************************************/
 /**
@@ -745,27 +677,39 @@ static uint16_t afe_check_diagnostic(void)
 /**********************************************************************************************************/
 ic_return_val_e ic_afe_get_values(ic_afe_event_cb_done cb, bool force){
   UNUSED_PARAMETER(force);
-  if (m_semaphore)
+
+  __auto_type _busy = true;
+  CRITICAL_REGION_ENTER();
+  if (!m_values_pending)
   {
-    m_semaphore = false;
-    afe_send_pack_s *_data_to_send = (afe_send_pack_s *)&m_input_buffer[0];
+    m_values_pending = true;
+    _busy = false;
+  }
+  CRITICAL_REGION_EXIT();
 
-    for (int i = 0; i < AFE4400_LED_LEN; i++)
-    {
-      _data_to_send->reg = AFE4400_LED2VAL + i;
-      memset(_data_to_send->data, 0, sizeof(_data_to_send->data));
-      ++(_data_to_send);
-    }
-    __auto_type _ret_val =
-        SPI_SEND_DATA(
-            afe_spi_write,
-            m_input_buffer,
-            m_output_buffer,
-            (SPI_SEND_4BYTES * AFE4400_LED_LEN) + (AFE4400_LED_LEN * 3),
-            spi_led_callback,
-            cb);
-    if (_ret_val != IC_SUCCESS)
-      return IC_ERROR;
+  if (_busy)
+    return IC_BUSY;
+
+  afe_send_pack_s *_data_to_send = (afe_send_pack_s *)m_values_input;
+
+  for (int i = 0; i < AFE4400_LED_LEN; i++)
+  {
+    _data_to_send->reg = AFE4400_LED2VAL + i;
+    memset(_data_to_send->data, 0, sizeof(_data_to_send->data));
+    ++(_data_to_send);
+  }
+  __auto_type _ret_val =
+      SPI_SEND_DATA(
+          afe_spi_write,
+          m_values_input,
+          m_values_output,
+          sizeof(m_values_input),
+          spi_led_callback,
+          cb);
+  if (_ret_val != IC_SUCCESS)
+  {
+    m_values_pending = false;
+    return _ret_val == IC_BUSY ? IC_BUSY : IC_ERROR;
   }
 
   return IC_SUCCESS;
@@ -883,32 +827,29 @@ void afe_set_default_timing(void)
  */
 static void afe_set_timing_fast(uint16_t *timing_data, size_t data_len)
 {
-  if (m_semaphore)
-  {
-      /*  set write flag  */
-    afe_enable_write();
-    m_semaphore = false;
-    afe_send_pack_s *_data_to_send = (afe_send_pack_s*)&m_input_buffer[0];
+  afe_send_pack_s *_packs = (afe_send_pack_s*)m_input_buffer;
+  ic_spi_transfer_s _transfers[3];
 
-    for (int i = 0; i < data_len; i++)
-    {
-      _data_to_send->reg = AFE4400_LED2STC + i;
-      convert(timing_data[i], _data_to_send->data);
-      ++(_data_to_send);
-    }
-    __auto_type _ret_val =
-        SPI_SEND_DATA(
-            afe_spi_write,
-            m_input_buffer,
-            m_output_buffer,
-            data_len * sizeof(afe_send_pack_s),
-            callback_spi,
-            NULL);
-    if (_ret_val != IC_SUCCESS)
-      NRF_LOG_ERROR("SPI ERROR\r\n");
+  ASSERT((data_len + 2) * sizeof(afe_send_pack_s) <= sizeof(m_input_buffer));
+
+    /*  set write flag  */
+  afe_control_pack(&_packs[0], false);
+  afe_pack_transfer(&_transfers[0], &_packs[0]);
+
+  for (int i = 0; i < data_len; i++)
+  {
+    _packs[i + 1].reg = AFE4400_LED2STC + i;
+    convert(timing_data[i], _packs[i + 1].data);
   }
+  afe_pack_transfer(&_transfers[1], &_packs[1]);
+  _transfers[1].in_len  = data_len * sizeof(afe_send_pack_s);
+  _transfers[1].out_len = data_len * sizeof(afe_send_pack_s);
+
     /*  set read flag  */
-  afe_enable_read();
+  afe_control_pack(&_packs[data_len + 1], true);
+  afe_pack_transfer(&_transfers[2], &_packs[data_len + 1]);
+
+  afe_send_sync(_transfers, 3);
 }
 /**********************************************************************************************************/
 /**
@@ -14,6 +14,7 @@
 #include <cstring>
 #include <climits>
 #include <cmath>
+#include <cstdlib>
 
 #include "ic_driver_twi.h"
 #include "ic_service_ltc.h"
@@ -23,6 +24,8 @@
 #include "task.h"
 #include "timers.h"
 #include "semphr.h"
+#include "app_error.h"
+#include "app_util_platform.h"
 
 
 extern "C" {
@@ -80,7 +83,8 @@ constexpr T ensureEndianness (T a) {
   vTaskDelay(BQ27742_US_WAIT_TIME);                                                                   \
   set_bq_register(block_data_access, data, size);                                                     \
   nrf_delay_us(BQ27742_US_WAIT_TIME);                                                                 \
-  TWI_READ_DATA(BQ, BQ27742_BLOCK_DATA, _reg_value, BQ27742_DATA_FLASH_BLOCK_SIZE, NULL, NULL);       \
+  TWI_READ_DATA_SYNC(BQ, BQ27742_BLOCK_DATA, _reg_value, BQ27742_DATA_FLASH_BLOCK_SIZE,               \
+      IC_TWI_SYNC_TIMEOUT);                                                                           \
   uint32_t _flash_data_sum = 0;                                                                       \
   for (int i = 0; i < BQ27742_DATA_FLASH_BLOCK_SIZE; i++){                                            \
     _flash_data_sum += _reg_value[i];                                                                 \
@@ -105,7 +109,7 @@ static ic_return_val_e set_bq_register(const uint8_t reg_addr, const T &&data){
     NRF_LOG_RAW_INFO("0x%02X ", byte);
   NRF_LOG_RAW_INFO("\n");
   #else
-  return TWI_SEND_DATA(BQ, _buffer, sizeof(_buffer), NULL, NULL);
+  return TWI_SEND_DATA_SYNC(BQ, _buffer, sizeof(_buffer), IC_TWI_SYNC_TIMEOUT);
   #endif
 }
 
@@ -122,7 +126,7 @@ static ic_return_val_e set_bq_register(const uint8_t reg_addr, const T &data){
     NRF_LOG_RAW_INFO("0x%02X ", byte);
   NRF_LOG_RAW_INFO("\n");
   #else
-  return TWI_SEND_DATA(BQ, _buffer, sizeof(_buffer), NULL, NULL);
+  return TWI_SEND_DATA_SYNC(BQ, _buffer, sizeof(_buffer), IC_TWI_SYNC_TIMEOUT);
   #endif
 }
 
@@ -143,7 +147,7 @@ static ic_return_val_e set_bq_register(const uint8_t reg_addr, const T *data, si
 //    NRF_LOG_RAW_INFO("0x%02X ", byte);
 //  NRF_LOG_RAW_INFO("\n");
   #endif
-  return TWI_SEND_DATA(BQ, _buffer, sizeof(_buffer), NULL, NULL);
+  return TWI_SEND_DATA_SYNC(BQ, _buffer, sizeof(_buffer), IC_TWI_SYNC_TIMEOUT);
 }
 
 template <class T>
@@ -151,7 +155,9 @@ static ic_return_val_e get_bq_register(const uint8_t reg_addr, T &data){
 
   uint8_t _buffer[sizeof(T)];
 
-  TWI_READ_DATA(BQ, reg_addr , _buffer, sizeof(_buffer), NULL, NULL);
+  auto _ret_val = TWI_READ_DATA_SYNC(BQ, reg_addr , _buffer, sizeof(_buffer), IC_TWI_SYNC_TIMEOUT);
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
 
   std::memcpy(&data, _buffer , sizeof(T));
 
@@ -903,7 +909,7 @@ static uint16_t bq27742_read_control_data (uint16_t subcommand)
   vTaskDelay(pdMS_TO_TICKS(1));
 
   #ifndef DEBUG_BQ
-  TWI_READ_DATA(BQ, BQ27742_CONTROL, (uint8_t *)&return_value, sizeof(return_value), NULL, NULL);
+  TWI_READ_DATA_SYNC(BQ, BQ27742_CONTROL, (uint8_t *)&return_value, sizeof(return_value), IC_TWI_SYNC_TIMEOUT);
   #endif
 
   return return_value;
@@ -1012,9 +1018,259 @@ static uint16_t bq27742_device_type_read(){
   return 0x00;
 }
 
+/** Standard commands from TEMPERATURE up to STATE_OF_CHARGE are read in one burst */
+#define BQ27742_SNAPSHOT_FIRST  BQ27742_TEMPERATURE
+#define BQ27742_SNAPSHOT_LEN    (BQ27742_STATE_OF_CHARGE + 2 - BQ27742_SNAPSHOT_FIRST)
+
+/** Timer may fire up to one tick early, gauge needs 1 ms after subcommand is written */
+#define BQ27742_SAMPLER_CONTROL_DELAY   (pdMS_TO_TICKS(1) + 1)
+/** Transfer which did not finish by then is abandoned */
+#define BQ27742_SAMPLER_TIMEOUT         (2*IC_TWI_SYNC_TIMEOUT)
+
+/** Steps of asynchronous reading, each one is started by sampler timer */
+typedef enum{
+  BQ27742_SAMPLER_IDLE = 0,
+  BQ27742_SAMPLER_BURST,              /** Burst of standard commands is read */
+  BQ27742_SAMPLER_CONTROL,            /** SAFETY_STATUS subcommand is written */
+  BQ27742_SAMPLER_SAFETY              /** SAFETY_STATUS is read */
+}bq27742_sampler_step_e;
+
+static struct{
+  ic_bq_snapshot_s snapshot;          /** age and stale are filled by ic_bq_get_snapshot */
+  ic_bq_snapshot_s reading;           /** Snapshot being read */
+  TimerHandle_t timer;                /** Next reading or, while reading, its next step */
+  SemaphoreHandle_t lock;             /** Binary semaphore held while gauge is read or programmed */
+  bq27742_sampler_step_e step;
+  uint8_t transfer;                   /** Number of current transfer, late callbacks are ignored */
+  ic_return_val_e volatile result;
+  bool volatile done;                 /** Transfer of current step finished */
+  uint8_t burst[BQ27742_SNAPSHOT_LEN];
+  uint8_t control[3];                 /** CONTROL register and subcommand */
+  uint16_t safety;
+}m_sampler;
+
+static uint16_t m_burst_value(const uint8_t *burst, uint8_t command){
+  return burst[command - BQ27742_SNAPSHOT_FIRST]
+    | burst[command - BQ27742_SNAPSHOT_FIRST + 1] << CHAR_BIT;
+}
+
+/** Programming sequences must not be interleaved with readings */
+static void m_sampler_hold(void){
+  if(m_sampler.lock != NULL)
+    xSemaphoreTake(m_sampler.lock, portMAX_DELAY);
+}
+
+static void m_sampler_release(void){
+  if(m_sampler.lock != NULL)
+    xSemaphoreGive(m_sampler.lock);
+}
+
+static void m_burst_parse(const uint8_t *burst, ic_bq_snapshot_s *snapshot){
+  *snapshot = {};
+  snapshot->soc           = m_burst_value(burst, BQ27742_STATE_OF_CHARGE);
+  snapshot->voltage       = m_burst_value(burst, BQ27742_VOLTAGE);
+  snapshot->current       = (int16_t)m_burst_value(burst, BQ27742_AVERAGE_CURRENT);
+  snapshot->temperature   = m_burst_value(burst, BQ27742_TEMPERATURE);
+  snapshot->flags         = m_burst_value(burst, BQ27742_FLAGS);
+  snapshot->time_to_empty = m_burst_value(burst, BQ27742_TIME_TO_EMPTY);
+}
+
+/** SAFETY_STATUS is needed by charger state only */
+static bool m_safety_needed(const ic_bq_snapshot_s *snapshot){
+  return !(snapshot->flags & (1<<FC)) && snapshot->current >= 0;
+}
+
+static void m_store(bool read, const ic_bq_snapshot_s *snapshot){
+  if(!read){
+    NRF_LOG_ERROR("Gauge not read\n");
+    CRITICAL_REGION_ENTER();
+    ++m_sampler.snapshot.failures;
+    CRITICAL_REGION_EXIT();
+    return;
+  }
+
+  auto _snapshot = *snapshot;
+  _snapshot.time_stamp = xTaskGetTickCount();
+  _snapshot.valid = true;
+
+  CRITICAL_REGION_ENTER();
+  m_sampler.snapshot = _snapshot;
+  CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Gauge is read often while charging, with low charge or high current, and after failed
+ * reading.
+ */
+static TickType_t m_sample_period(bool sampled){
+  if(!sampled)
+    return IC_BQ_SAMPLE_FAST;
+
+  auto _snapshot = &m_sampler.snapshot;
+  if(!(_snapshot->flags & (1<<DSG))
+      || _snapshot->soc <= IC_BQ_SAMPLE_SOC_LOW
+      || std::abs(_snapshot->current) >= IC_BQ_SAMPLE_CURRENT)
+    return IC_BQ_SAMPLE_FAST;
+
+  return IC_BQ_SAMPLE_SLOW;
+}
+
+/**
+ * @brief Blocking reading, used once by @ref ic_bq_sampler_init. Waits for programming to end.
+ */
+static bool m_sample(void){
+  ic_bq_snapshot_s _snapshot;
+
+  m_sampler_hold();
+  TWI_INIT(BQ);
+  auto _ret_val = TWI_READ_DATA_SYNC(
+      BQ,
+      BQ27742_SNAPSHOT_FIRST,
+      m_sampler.burst,
+      sizeof(m_sampler.burst),
+      IC_TWI_SYNC_TIMEOUT);
+
+  if(_ret_val == IC_SUCCESS){
+    m_burst_parse(m_sampler.burst, &_snapshot);
+    if(m_safety_needed(&_snapshot))
+      _snapshot.safety = bq27742_read_control_data(BQ27742_SAFETY_STATUS);
+  }
+  TWI_DEINIT(BQ);
+  m_sampler_release();
+
+  m_store(_ret_val == IC_SUCCESS, &_snapshot);
+  return _ret_val == IC_SUCCESS;
+}
+
+/**
+ * @brief Fire sampler timer after ticks. Sampler timer callback must not block on timer queue.
+ */
+static void m_sampler_schedule(TickType_t ticks){
+  if(isr_context()){
+    BaseType_t _yield_required = pdFALSE;
+    xTimerChangePeriodFromISR(m_sampler.timer, ticks, &_yield_required);
+    portYIELD_FROM_ISR(_yield_required);
+  }
+  else{
+    xTimerChangePeriod(m_sampler.timer, ticks, 0);
+  }
+}
+
+static void m_sampler_transfer_done(ic_return_val_e result, void *context){
+  if((uintptr_t)context != m_sampler.transfer)
+    return;
+
+  m_sampler.result = result;
+  m_sampler.done = true;
+  m_sampler_schedule(
+      m_sampler.step == BQ27742_SAMPLER_CONTROL ? BQ27742_SAMPLER_CONTROL_DELAY : 1);
+}
+
+/**
+ * @brief Start transfer of step. Timer is armed with timeout first, callback rearms it.
+ */
+static bool m_sampler_start(bq27742_sampler_step_e step){
+  auto _context = (void *)(uintptr_t)++m_sampler.transfer;
+  ic_return_val_e _ret_val;
+
+  m_sampler.step = step;
+  m_sampler.done = false;
+  m_sampler_schedule(BQ27742_SAMPLER_TIMEOUT);
+
+  switch(step){
+    case BQ27742_SAMPLER_BURST:
+      _ret_val = TWI_READ_DATA(
+          BQ,
+          BQ27742_SNAPSHOT_FIRST,
+          m_sampler.burst,
+          sizeof(m_sampler.burst),
+          m_sampler_transfer_done,
+          _context);
+      break;
+    case BQ27742_SAMPLER_CONTROL:
+      m_sampler.control[0] = BQ27742_CONTROL;
+      m_sampler.control[1] = (uint8_t)BQ27742_SAFETY_STATUS;
+      m_sampler.control[2] = (uint8_t)(BQ27742_SAFETY_STATUS >> CHAR_BIT);
+      _ret_val = TWI_SEND_DATA(
+          BQ,
+          m_sampler.control,
+          sizeof(m_sampler.control),
+          m_sampler_transfer_done,
+          _context);
+      break;
+    default:
+      _ret_val = TWI_READ_DATA(
+          BQ,
+          BQ27742_CONTROL,
+          reinterpret_cast<uint8_t *>(&m_sampler.safety),
+          sizeof(m_sampler.safety),
+          m_sampler_transfer_done,
+          _context);
+      break;
+  }
+
+  return _ret_val == IC_SUCCESS;
+}
+
+static void m_sampler_finish(bool read){
+  /* Transfer abandoned after timeout must not touch next reading */
+  ++m_sampler.transfer;
+  m_sampler.step = BQ27742_SAMPLER_IDLE;
+
+  TWI_DEINIT(BQ);
+  xSemaphoreGive(m_sampler.lock);
+
+  m_store(read, &m_sampler.reading);
+  m_sampler_schedule(m_sample_period(read));
+}
+
+/**
+ * @brief Reading is a chain of asynchronous transfers run from timer task, no step waits for TWI.
+ * One burst of standard commands, SAFETY_STATUS is written and read only when needed. Reading is
+ * postponed while gauge is programmed.
+ */
+static void m_sampler_timer_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+
+  if(m_sampler.step == BQ27742_SAMPLER_IDLE){
+    if(xSemaphoreTake(m_sampler.lock, 0) != pdTRUE){
+      m_sampler_schedule(IC_BQ_SAMPLE_FAST);
+      return;
+    }
+
+    TWI_INIT(BQ);
+    if(!m_sampler_start(BQ27742_SAMPLER_BURST))
+      m_sampler_finish(false);
+    return;
+  }
+
+  if(!m_sampler.done || m_sampler.result != IC_SUCCESS){
+    m_sampler_finish(false);
+    return;
+  }
+
+  switch(m_sampler.step){
+    case BQ27742_SAMPLER_BURST:
+      m_burst_parse(m_sampler.burst, &m_sampler.reading);
+      if(!m_safety_needed(&m_sampler.reading))
+        m_sampler_finish(true);
+      else if(!m_sampler_start(BQ27742_SAMPLER_CONTROL))
+        m_sampler_finish(false);
+      break;
+    case BQ27742_SAMPLER_CONTROL:
+      if(!m_sampler_start(BQ27742_SAMPLER_SAFETY))
+        m_sampler_finish(false);
+      break;
+    default:
+      m_sampler.reading.safety = m_sampler.safety;
+      m_sampler_finish(true);
+      break;
+  }
+}
+
 #define BQ_ADVANCED
 
-void ic_bq_flash_image(){
+static void bq27742_flash_image(){
   TWI_INIT(BQ);
   NRF_LOG_INFO("Control Status: 0x%X\n", bq27742_control_status_read());
   auto _unsealed = bq27742_unsealed_set();
@@ -1124,48 +1380,25 @@ void ic_bq_flash_image(){
   vTaskDelay(5);
 }
 
+void ic_bq_flash_image(){
+  m_sampler_hold();
+  bq27742_flash_image();
+  m_sampler_release();
+}
+
 void ic_bq_shutdown() {
+  m_sampler_hold();
   TWI_INIT(BQ);
 
   uint16_t _set_shutdown = BQ27742_SET_SHUTDOWN;
   set_bq_register(BQ27742_CONTROL, _set_shutdown);
 
   TWI_DEINIT(BQ);
+  m_sampler_release();
 }
 
-/**
- * @fn bq27742_read_reg_data  (uint8_t command)
- * @brief read data from  general register
- *  param[in] command: data command code
- *  param[out] read register data
- */
-static uint16_t bq27742_read_reg_data (uint8_t command)
-{
-  uint16_t return_value =0;
-
-  get_bq_register (command, return_value);
-
-  return return_value;
-}
-
-
-/**
- * @fn bq27742_flags_read ()
- * @brief read data from flags register
- *  param[out] register value
- */
-static uint16_t bq27742_flags_read ()
-{
-  uint16_t flag_value =0;
-
-  flag_value = bq27742_read_reg_data(BQ27742_FLAGS);
-
-  return flag_value;
-}
-
-
-
 void ic_bq_reset(){
+  m_sampler_hold();
   TWI_INIT(BQ);
   for (uint16_t i = 0; i<0x09; ++i){
     auto _rc = bq27742_read_control_data(i);
@@ -1180,34 +1413,22 @@ void ic_bq_reset(){
   NRF_LOG_INFO("Sealed: %s\n",
       (uint32_t)(_sealed?"true":"false"));
   TWI_DEINIT(BQ);
+  m_sampler_release();
 }
 
 uint16_t ic_bq_getSafetyStatus(void) {
+  m_sampler_hold();
   TWI_INIT(BQ);
 
   uint16_t safety = bq27742_read_control_data(BQ27742_SAFETY_STATUS);
 //  NRF_LOG_INFO("** Safety status: 0x%02X invalid protector: %d\n", safety , safety&0x80);
 
   TWI_DEINIT(BQ);
+  m_sampler_release();
   return safety;
 }
 
 
-static bool ic_bq_battery_full_charged (void)
-{
-  TWI_INIT(BQ);
-  uint16_t flag_value = 0;
-
-  flag_value = bq27742_flags_read ();
-
-  TWI_DEINIT(BQ);
-  if(flag_value & (1<<FC))
-    return true;
-  else
-    return false;
-}
-
-
 ///**
 // * Check is State of charge is below 1%
 // * @return true/false
@@ -1263,13 +1484,9 @@ static bool ic_bq_battery_full_charged (void)
  * One of charging errors detected
  * @return true/false
  */
-static bool bq27742_charging_error_detected (void)
+static bool bq27742_charging_error_detected (uint16_t safety_status)
 {
-  TWI_INIT(BQ);
-  uint16_t safety_status = 0;
   uint8_t charging_error_mask = 1 << OVP_S | 1 << OTC_S | 1 << TDD_S | 1 << ISD_S;
-  safety_status = ic_bq_getSafetyStatus();
-  TWI_DEINIT(BQ);
   if(safety_status & charging_error_mask)
     return true;
   else
@@ -1280,25 +1497,23 @@ static bool bq27742_charging_error_detected (void)
 
 void ic_bq_read_measurement_data (void)
 {
+  m_sampler_hold();
   TWI_INIT(BQ);
-  uint16_t temp;
+  uint16_t temp = 0;
   get_bq_register(BQ27742_TEMPERATURE, temp);
-  vTaskDelay(100);
-  uint16_t voltage;
+  uint16_t voltage = 0;
   get_bq_register(BQ27742_VOLTAGE, voltage);
-  vTaskDelay(100);
-  int16_t avgCurr;
+  int16_t avgCurr = 0;
   get_bq_register(BQ27742_AVERAGE_CURRENT, avgCurr);
-  vTaskDelay(100);
-  uint16_t soc;
+  uint16_t soc = 0;
   get_bq_register(BQ27742_STATE_OF_CHARGE, soc);
-  vTaskDelay(100);
 
   NRF_LOG_RAW_INFO("temperature: %d\n", temp );
   NRF_LOG_RAW_INFO("voltage: %dmV\n", voltage);
   NRF_LOG_RAW_INFO("avg current: %dmA\n", avgCurr);
   NRF_LOG_RAW_INFO("state of charge: %d%%\n", soc);
   TWI_DEINIT(BQ);
+  m_sampler_release();
 }
 
 
@@ -1308,11 +1523,12 @@ void ic_bq_read_measurement_data (void)
  */
 uint16_t ic_bq_getChargeLevel(void)
 {
-  TWI_INIT(BQ);
   uint16_t soc;
-  get_bq_register(BQ27742_STATE_OF_CHARGE, soc);
-//  NRF_LOG_RAW_INFO("state of charge: %d\n", soc);
-  TWI_DEINIT(BQ);
+
+  CRITICAL_REGION_ENTER();
+  soc = m_sampler.snapshot.soc;
+  CRITICAL_REGION_EXIT();
+
   return soc;
 }
 
@@ -1322,11 +1538,12 @@ uint16_t ic_bq_getChargeLevel(void)
  * @return percent value
  */
 bool ic_bq_getDischarging(void) {
-  TWI_INIT(BQ);
-  uint16_t flag_value = 0;
+  uint16_t flag_value;
+
+  CRITICAL_REGION_ENTER();
+  flag_value = m_sampler.snapshot.flags;
+  CRITICAL_REGION_EXIT();
 
-  flag_value = bq27742_flags_read();
-  TWI_DEINIT(BQ);
   if (flag_value & (1 << DSG))
     return true;
   else
@@ -1339,20 +1556,23 @@ bool ic_bq_getDischarging(void) {
  * @return state
  */
 en_chargerState ic_bq_getChargerState(void) {
+  ic_bq_snapshot_s _snapshot;
+
+  CRITICAL_REGION_ENTER();
+  _snapshot = m_sampler.snapshot;
+  CRITICAL_REGION_EXIT();
 
-  if(ic_bq_battery_full_charged())
+  if(_snapshot.flags & (1<<FC))
     return BATT_CHARGED;
 
   auto state = BATT_NOTCHARGING;
-  int16_t avgCurr;
-
-  get_bq_register(BQ27742_AVERAGE_CURRENT, avgCurr);
+  int16_t avgCurr = _snapshot.current;
 
   if (  avgCurr<0 ) { //nie ładuje
     state = BATT_NOTCHARGING;
   }
   else{
-    if (bq27742_charging_error_detected())
+    if (bq27742_charging_error_detected(_snapshot.safety))
       state = BATT_CHARGING;
     else
       state = BATT_CHARGER_FAULT;
@@ -1360,6 +1580,48 @@ en_chargerState ic_bq_getChargerState(void) {
   return state;
 }
 
+ic_return_val_e ic_bq_sampler_init(void){
+  /* Mutexes are not enabled in FreeRTOSConfig.h */
+  if(m_sampler.lock == NULL){
+    m_sampler.lock = xSemaphoreCreateBinary();
+    if(m_sampler.lock == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+    xSemaphoreGive(m_sampler.lock);
+  }
+
+  if(m_sampler.timer != NULL)
+    return IC_SUCCESS;
+
+  /* Getters are valid right after init */
+  auto _period = m_sample_period(m_sample());
+
+  m_sampler.timer = xTimerCreate("BQS", _period, pdFALSE, NULL, m_sampler_timer_callback);
+  if(m_sampler.timer == NULL)
+    APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+
+  xTimerStart(m_sampler.timer, OSTIMER_WAIT_FOR_QUEUE);
+
+  return IC_SUCCESS;
+}
+
+ic_bq_snapshot_s ic_bq_get_snapshot(void){
+  ic_bq_snapshot_s _snapshot;
+
+  CRITICAL_REGION_ENTER();
+  _snapshot = m_sampler.snapshot;
+  CRITICAL_REGION_EXIT();
+
+  if(_snapshot.valid){
+    _snapshot.age = xTaskGetTickCount() - _snapshot.time_stamp;
+    _snapshot.stale = _snapshot.age > IC_BQ_SNAPSHOT_STALE;
+  }else{
+    _snapshot.age = UINT32_MAX;
+    _snapshot.stale = true;
+  }
+
+  return _snapshot;
+}
+
 
 /**
  * Read data from data flash
@@ -1386,7 +1648,7 @@ void bq27742_data_flash_read(
   set_bq_register(BQ27742_DATA_FLASH_BLOCK, (uint8_t)block);
   vTaskDelay(100);
 
-  TWI_READ_DATA(BQ, BQ27742_BLOCK_DATA, (uint8_t*)value, len, NULL, NULL);
+  TWI_READ_DATA_SYNC(BQ, BQ27742_BLOCK_DATA, (uint8_t*)value, len, IC_TWI_SYNC_TIMEOUT);
   vTaskDelay(pdMS_TO_TICKS(1));
 
   uint8_t memChck[1] = {0};
@@ -1407,7 +1669,7 @@ void bq27742_data_flash_read(
 /**
  * Read and print on console all data from data flash
  */
-void ic_bq_readFlashTest(void){
+static void bq27742_read_flash_test(void){
   TWI_INIT(BQ);
 //  NRF_LOG_INFO("Control Status: 0x%X\n", bq27742_control_status_read());
   auto _unsealed = bq27742_unsealed_set();
@@ -1483,3 +1745,9 @@ void ic_bq_readFlashTest(void){
   TWI_DEINIT(BQ);
 }
 
+void ic_bq_readFlashTest(void){
+  m_sampler_hold();
+  bq27742_read_flash_test();
+  m_sampler_release();
+}
+
@@ -4,12 +4,21 @@
  * @date    January, 2018
  * @brief   Brief description
  *
- * Description
+ * Gauge is read by sampler timer (@ref ic_bq_sampler_init) into snapshot, one burst of
+ * standard commands every @ref IC_BQ_SAMPLE_SLOW, or @ref IC_BQ_SAMPLE_FAST while charging, with
+ * low charge or high current. Reading is a chain of asynchronous TWI transfers started from timer
+ * task, so sampler has no task. Getters return snapshot values and do not touch TWI.
  */
 
 #ifndef IC_DRIVER_BQ27742_H
 #define IC_DRIVER_BQ27742_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -22,10 +31,34 @@ typedef enum {
   BATT_CHARGER_FAULT =3 //!< Charger connected and battery is on fault state
 }en_chargerState;
 
+typedef struct{
+  uint16_t soc;                       /** State of charge (%) */
+  uint16_t voltage;                   /** mV */
+  int16_t current;                    /** Average current (mA), negative when discharging */
+  uint16_t temperature;               /** 0.1 K */
+  uint16_t flags;                     /** FLAGS register */
+  uint16_t time_to_empty;             /** min, 65535 when not discharging */
+  uint16_t safety;                    /** SAFETY_STATUS, read only while charging */
+  uint16_t failures;                  /** Failed readings since snapshot was taken */
+  uint32_t time_stamp;                /** Tick of reading */
+  uint32_t age;                       /** Ticks since reading, UINT32_MAX when never read */
+  bool valid;                         /** Gauge was read at least once */
+  bool stale;                         /** Older than IC_BQ_SNAPSHOT_STALE or not valid */
+}ic_bq_snapshot_s;
+
 void ic_bq_flash_image();
 void ic_bq_reset();
 
+/**
+ * @brief Create mutex and sampler timer, read gauge once so getters are valid when it returns.
+ * Call from task.
+ */
+ic_return_val_e ic_bq_sampler_init(void);
+
+ic_bq_snapshot_s ic_bq_get_snapshot(void);
+
 uint16_t ic_bq_getChargeLevel(void);
+bool ic_bq_getDischarging(void);
 en_chargerState ic_bq_getChargerState(void);
 void ic_bq_read_measurement_data (void);
 void ic_bq_shutdown(void);
@@ -2,12 +2,597 @@
  * @file    ic_driver_flash.c
  * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
  * @date    June, 2017
- * @brief   Brief description
+ * @brief   External JEDEC SPI NOR flash driver
  *
- * Description
+ * Every operation is a sequence of steps. Step queues one chain of SPI transfers, last transfer
+ * callback (SPI IRQ) starts next step. Waiting for the chip (program/erase, wake up) and retries
+ * when SPI queue is full are done with one-shot timer, so nothing spins.
  */
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
 #include "ic_driver_flash.h"
+#include "ic_driver_spi.h"
+#include "ic_sync.h"
+#include "ic_config.h"
+
+#include "app_util_platform.h"
+#include "nrf_assert.h"
+
+#define NRF_LOG_MODULE_NAME "FLASH"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#define FLASH_CMD_WRITE_ENABLE    0x06
+#define FLASH_CMD_READ_STATUS     0x05
+#define FLASH_CMD_PAGE_PROGRAM    0x02
+#define FLASH_CMD_FAST_READ       0x0B
+#define FLASH_CMD_SECTOR_ERASE    0x20
+#define FLASH_CMD_BLOCK_ERASE     0xD8
+#define FLASH_CMD_READ_ID         0x9F
+#define FLASH_CMD_POWER_DOWN      0xB9
+#define FLASH_CMD_RESUME          0xAB
+
+#define FLASH_STATUS_WIP          0x01
+
+#define FLASH_MAX_TRANSFER        255 /* nrf_drv_spi transfer length is 8 bit */
+
+_Static_assert(
+    IC_FLASH_READ_CHUNKS + 1 <= IC_SPI_PENDIG_TRANSACTIONS,
+    "Fast-read chain does not fit SPI queue");
+
+typedef enum{
+  FLASH_OP_NONE = 0,
+  FLASH_OP_READ,
+  FLASH_OP_PROGRAM,
+  FLASH_OP_ERASE,
+  FLASH_OP_POWER_DOWN,
+  FLASH_OP_RESUME
+}flash_op_e;
+
+SPI_REGISTER(flash);
+
+static struct{
+  flash_op_e volatile op;
+  ic_flash_event_cb callback;
+  void *context;
+  ic_sync_s * volatile sync;          /** Waiter of synchronous operation */
+  bool volatile aborted;              /** Waiter gave up, nothing may continue the operation */
+  TickType_t started;
+
+  uint32_t address;
+  uint8_t *buffer;
+  size_t left;
+  size_t chain_len;                   /** Bytes read by chain in flight */
+  ic_flash_erase_e erase;
+
+  void (*next)(void);                 /** Step started by timer */
+  TimerHandle_t timer;
+
+  ic_flash_id_s id;
+  bool powered_down;
+  bool initialized;
+
+  uint8_t write_enable[1];
+  uint8_t command[5];
+  uint8_t status_tx[2];
+  uint8_t status_rx[4];
+}m_flash = {
+  .write_enable = {FLASH_CMD_WRITE_ENABLE},
+  .status_tx    = {FLASH_CMD_READ_STATUS, 0},
+};
+
+static void m_chain_done(void *context);
+
+static void m_finish(ic_return_val_e result){
+  __auto_type _callback = m_flash.callback;
+  __auto_type _context = m_flash.context;
+  __auto_type _sync = m_flash.sync;
+
+  m_flash.sync = NULL;
+  m_flash.op = FLASH_OP_NONE;
+
+  if(result != IC_SUCCESS)
+    NRF_LOG_ERROR("operation failed: %s\n", (uint32_t)g_return_val_string[result]);
+
+  if(_callback != NULL)
+    _callback(result, _context);
+
+  if(_sync != NULL)
+    ic_sync_signal(_sync, result);
+}
+
+static void m_schedule(void (*step)(void), TickType_t delay){
+  BaseType_t _ret_val;
+
+  if(m_flash.aborted)
+    return;
+
+  m_flash.next = step;
+  if(isr_context()){
+    __auto_type _yield_required = pdFALSE;
+    _ret_val = xTimerChangePeriodFromISR(m_flash.timer, delay, &_yield_required);
+    portYIELD_FROM_ISR(_yield_required);
+  }
+  else{
+    _ret_val = xTimerChangePeriod(m_flash.timer, delay, OSTIMER_WAIT_FOR_QUEUE);
+  }
+
+  if(_ret_val != pdPASS)
+    m_finish(IC_ERROR);
+}
+
+static void m_timer_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+
+  if(m_flash.next != NULL && !m_flash.aborted)
+    m_flash.next();
+}
+
+/**
+ * @brief Queue chain of step. When SPI queue is full, step is repeated later.
+ *
+ * Chain is not queued after operation was aborted, so its buffers are not used anymore.
+ */
+static void m_send(void (*step)(void), ic_spi_transfer_s *transfers, size_t count){
+  transfers[count-1].open = false;
+  transfers[count-1].callback = m_chain_done;
+
+  __auto_type _ret_val = IC_SUCCESS;
+  __auto_type _aborted = false;
+
+  CRITICAL_REGION_ENTER();
+  _aborted = m_flash.aborted;
+  if(!_aborted)
+    _ret_val = SPI_SEND_CHAIN(flash, transfers, count);
+  CRITICAL_REGION_EXIT();
+
+  if(_aborted)
+    return;
+
+  if(_ret_val == IC_BUSY && GET_TICK_COUNT() - m_flash.started > IC_FLASH_SYNC_TIMEOUT)
+    m_finish(IC_TIMEOUT);
+  else if(_ret_val == IC_BUSY)
+    m_schedule(step, 1);
+  else if(_ret_val != IC_SUCCESS)
+    m_finish(IC_ERROR);
+}
+
+static inline ic_spi_transfer_s m_tx(uint8_t *buffer, size_t len, bool open){
+  return (ic_spi_transfer_s){.in_buffer = buffer, .in_len = len, .open = open};
+}
+
+static inline ic_spi_transfer_s m_rx(uint8_t *buffer, size_t len, bool open){
+  return (ic_spi_transfer_s){.out_buffer = buffer, .out_len = len, .open = open};
+}
+
+static void m_set_command(uint8_t command, uint32_t address){
+  m_flash.command[0] = command;
+  m_flash.command[1] = (uint8_t)(address >> 16);
+  m_flash.command[2] = (uint8_t)(address >> 8);
+  m_flash.command[3] = (uint8_t)address;
+  m_flash.command[4] = 0;             /* fast-read dummy byte */
+}
+
+static void m_read_step(void){
+  ic_spi_transfer_s _transfers[IC_FLASH_READ_CHUNKS + 1];
+  size_t _count = 0;
+
+  m_set_command(FLASH_CMD_FAST_READ, m_flash.address);
+  _transfers[_count++] = m_tx(m_flash.command, 5, true);
+
+  m_flash.chain_len = 0;
+  while(_count <= IC_FLASH_READ_CHUNKS && m_flash.chain_len < m_flash.left){
+    __auto_type _len = MIN(m_flash.left - m_flash.chain_len, FLASH_MAX_TRANSFER);
+    _transfers[_count++] = m_rx(m_flash.buffer + m_flash.chain_len, _len, true);
+    m_flash.chain_len += _len;
+  }
+
+  m_send(m_read_step, _transfers, _count);
+}
+
+static void m_program_step(void){
+  ic_spi_transfer_s _transfers[4];
+  size_t _count = 0;
+
+  m_set_command(FLASH_CMD_PAGE_PROGRAM, m_flash.address);
+  _transfers[_count++] = m_tx(m_flash.write_enable, 1, false);
+  _transfers[_count++] = m_tx(m_flash.command, 4, true);
+
+  for(size_t _sent = 0; _sent < m_flash.left; _sent += FLASH_MAX_TRANSFER){
+    __auto_type _len = MIN(m_flash.left - _sent, FLASH_MAX_TRANSFER);
+    _transfers[_count++] = m_tx(m_flash.buffer + _sent, _len, true);
+  }
+
+  m_send(m_program_step, _transfers, _count);
+}
+
+static void m_erase_step(void){
+  ic_spi_transfer_s _transfers[2];
+
+  m_set_command(
+      m_flash.erase == IC_FLASH_ERASE_BLOCK ? FLASH_CMD_BLOCK_ERASE : FLASH_CMD_SECTOR_ERASE,
+      m_flash.address);
+  _transfers[0] = m_tx(m_flash.write_enable, 1, false);
+  _transfers[1] = m_tx(m_flash.command, 4, false);
+
+  m_send(m_erase_step, _transfers, 2);
+}
+
+static void m_status_step(void){
+  ic_spi_transfer_s _transfer = {
+    .in_buffer  = m_flash.status_tx,
+    .in_len     = sizeof(m_flash.status_tx),
+    .out_buffer = m_flash.status_rx,
+    .out_len    = sizeof(m_flash.status_tx)
+  };
+
+  m_send(m_status_step, &_transfer, 1);
+}
+
+static void m_power_down_step(void){
+  m_flash.command[0] = FLASH_CMD_POWER_DOWN;
+  __auto_type _transfer = m_tx(m_flash.command, 1, false);
+
+  m_send(m_power_down_step, &_transfer, 1);
+}
+
+static void m_resume_step(void){
+  m_flash.command[0] = FLASH_CMD_RESUME;
+  __auto_type _transfer = m_tx(m_flash.command, 1, false);
+
+  m_send(m_resume_step, &_transfer, 1);
+}
+
+static void m_resume_done(void){
+  m_flash.powered_down = false;
+  m_finish(IC_SUCCESS);
+}
+
+static void m_status_done(void){
+  if((m_flash.status_rx[1] & FLASH_STATUS_WIP) == 0){
+    m_finish(IC_SUCCESS);
+    return;
+  }
+
+  if(GET_TICK_COUNT() - m_flash.started > IC_FLASH_SYNC_TIMEOUT){
+    m_finish(IC_TIMEOUT);
+    return;
+  }
+
+  m_schedule(
+      m_status_step,
+      m_flash.op == FLASH_OP_ERASE ? IC_FLASH_ERASE_POLL : IC_FLASH_PROGRAM_POLL);
+}
+
+/**
+ * @brief Last transfer of a chain finished (SPI IRQ).
+ */
+static void m_chain_done(void *context){
+  UNUSED_PARAMETER(context);
+
+  if(m_flash.aborted)
+    return;
+
+  /* Status polling is scheduled only by program/erase, after their command chain */
+  if(m_flash.next == m_status_step){
+    m_status_done();
+    return;
+  }
+
+  switch(m_flash.op){
+    case FLASH_OP_READ:
+      m_flash.address += m_flash.chain_len;
+      m_flash.buffer += m_flash.chain_len;
+      m_flash.left -= m_flash.chain_len;
+      if(m_flash.left != 0)
+        m_read_step();
+      else
+        m_finish(IC_SUCCESS);
+      break;
+    case FLASH_OP_PROGRAM:
+      m_schedule(m_status_step, IC_FLASH_PROGRAM_POLL);
+      break;
+    case FLASH_OP_ERASE:
+      m_schedule(m_status_step, IC_FLASH_ERASE_POLL);
+      break;
+    case FLASH_OP_POWER_DOWN:
+      m_flash.powered_down = true;
+      m_finish(IC_SUCCESS);
+      break;
+    case FLASH_OP_RESUME:
+      m_schedule(m_resume_done, 1);   /* tRES, chip does not accept commands yet */
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Reserve driver for new operation.
+ *
+ * @param sync  Set to waiter when operation is started without callback, it is passed to @ref
+ *              m_wait.
+ */
+static ic_return_val_e m_begin(
+    flash_op_e op,
+    ic_flash_event_cb cb,
+    void *context,
+    ic_sync_s **sync)
+{
+  *sync = NULL;
+
+  if(!m_flash.initialized)
+    return IC_NOT_INIALIZED;
+
+  if(cb == NULL && (isr_context() || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING))
+    return IC_ERROR;
+
+  if(cb == NULL && (*sync = ic_sync_claim(IC_SPI_SYNC_TIMEOUT)) == NULL)
+    return IC_BUSY;
+
+  __auto_type _ret_val = IC_SUCCESS;
+  CRITICAL_REGION_ENTER();
+  if(m_flash.op != FLASH_OP_NONE)
+    _ret_val = IC_BUSY;
+  else
+    m_flash.op = op;
+  CRITICAL_REGION_EXIT();
+
+  if(_ret_val == IC_SUCCESS && m_flash.powered_down && op != FLASH_OP_RESUME){
+    NRF_LOG_ERROR("chip in deep power-down\n");
+    m_flash.op = FLASH_OP_NONE;
+    _ret_val = IC_ERROR;
+  }
+
+  if(_ret_val != IC_SUCCESS){
+    ic_sync_release(*sync);
+    *sync = NULL;
+    return _ret_val;
+  }
+
+  m_flash.callback = cb;
+  m_flash.context = context;
+  m_flash.next = NULL;
+  m_flash.started = GET_TICK_COUNT();
+  m_flash.aborted = false;
+  m_flash.sync = *sync;
+
+  return IC_SUCCESS;
+}
+
+/**
+ * @brief Stop operation of waiter which timed out.
+ *
+ * Steps started by IRQ or timer check the flag, so after SPI queue of the chip is dropped nothing
+ * touches caller buffer anymore.
+ */
+static void m_abort(ic_sync_s *sync){
+  __auto_type _owner = false;
+
+  CRITICAL_REGION_ENTER();
+  _owner = m_flash.sync == sync;
+  if(_owner)
+    m_flash.aborted = true;
+  CRITICAL_REGION_EXIT();
+
+  if(!_owner)
+    return;                           /* Finished in the meantime */
+
+  NRF_LOG_ERROR("operation aborted\n");
+  (void)xTimerStop(m_flash.timer, OSTIMER_WAIT_FOR_QUEUE);
+  SPI_CANCEL(flash);
+  m_flash.next = NULL;
+  m_finish(IC_TIMEOUT);
+}
+
+/**
+ * @brief Block calling task until operation is finished, if it was started without callback.
+ *
+ * Driver gives up with IC_TIMEOUT after IC_FLASH_SYNC_TIMEOUT on its own, waiter has some slack on
+ * top of that and aborts the operation only when driver got stuck.
+ */
+static ic_return_val_e m_wait(ic_sync_s *sync){
+  if(sync == NULL)
+    return IC_SUCCESS;
+
+  if(!ic_sync_wait(sync, m_flash.started, IC_FLASH_SYNC_TIMEOUT + IC_SPI_SYNC_TIMEOUT))
+    m_abort(sync);
+
+  __auto_type _ret_val = sync->result;
+  ic_sync_release(sync);
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_flash_init(void){
+  if(m_flash.initialized)
+    return IC_SUCCESS;
+
+  SPI_INIT(flash, IC_SPI_FLASH_SS_PIN);
+  SPI_CS_HIGH(flash);
+
+  if(m_flash.timer == NULL)
+    m_flash.timer = xTimerCreate("FLASH", 1, pdFALSE, NULL, m_timer_callback);
+
+  if(m_flash.timer == NULL){
+    SPI_UNINIT(flash);
+    return IC_ERROR;
+  }
+
+  m_flash.op = FLASH_OP_NONE;
+  m_flash.initialized = true;
+
+  /* Chip could be left in deep power-down by previous run */
+  __auto_type _ret_val = ic_flash_resume(NULL, NULL);
+
+  if(_ret_val == IC_SUCCESS){
+    m_flash.command[0] = FLASH_CMD_READ_ID;
+    ic_spi_transfer_s _transfer = {
+      .in_buffer  = m_flash.command,
+      .in_len     = 1,
+      .out_buffer = m_flash.status_rx,
+      .out_len    = 4
+    };
+    _ret_val = SPI_SEND_CHAIN_SYNC(flash, &_transfer, 1, IC_SPI_SYNC_TIMEOUT);
+  }
+
+  if(_ret_val == IC_SUCCESS){
+    m_flash.id.manufacturer = m_flash.status_rx[1];
+    m_flash.id.type         = m_flash.status_rx[2];
+    m_flash.id.capacity     = m_flash.status_rx[3];
+
+    NRF_LOG_INFO("JEDEC ID: %02X %02X %02X\n",
+        m_flash.id.manufacturer,
+        m_flash.id.type,
+        m_flash.id.capacity);
+
+    if(m_flash.id.manufacturer == 0x00 || m_flash.id.manufacturer == 0xFF ||
+        m_flash.id.capacity < 16 || m_flash.id.capacity > 24)
+      _ret_val = IC_ERROR;
+  }
+
+  if(_ret_val != IC_SUCCESS){
+    NRF_LOG_ERROR("no flash chip\n");
+    m_flash.initialized = false;
+    SPI_UNINIT(flash);
+  }
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_flash_deinit(void){
+  if(!m_flash.initialized)
+    return IC_SUCCESS;
+
+  if(ic_flash_busy())
+    return IC_BUSY;
+
+  if(!m_flash.powered_down)
+    ic_flash_power_down(NULL, NULL);
+
+  m_flash.initialized = false;
+  SPI_UNINIT(flash);
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_flash_id_s ic_flash_get_id(void){
+  return m_flash.id;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t ic_flash_size(void){
+  return m_flash.initialized ? 1UL << m_flash.id.capacity : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_flash_read(
+    uint32_t address,
+    uint8_t *buffer,
+    size_t len,
+    ic_flash_event_cb cb,
+    void *context)
+{
+  ASSERT(buffer != NULL);
+
+  if(len == 0 || address + len > ic_flash_size())
+    return IC_ERROR;
+
+  ic_sync_s *_sync;
+  __auto_type _ret_val = m_begin(FLASH_OP_READ, cb, context, &_sync);
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
+
+  m_flash.address = address;
+  m_flash.buffer = buffer;
+  m_flash.left = len;
+  m_read_step();
+
+  return m_wait(_sync);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_flash_program(
+    uint32_t address,
+    const uint8_t *data,
+    size_t len,
+    ic_flash_event_cb cb,
+    void *context)
+{
+  ASSERT(data != NULL);
+
+  if(len == 0 || (address % IC_FLASH_PAGE_SIZE) + len > IC_FLASH_PAGE_SIZE ||
+      address + len > ic_flash_size())
+    return IC_ERROR;
+
+  ic_sync_s *_sync;
+  __auto_type _ret_val = m_begin(FLASH_OP_PROGRAM, cb, context, &_sync);
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
+
+  m_flash.address = address;
+  m_flash.buffer = (uint8_t *)data;
+  m_flash.left = len;
+  m_program_step();
+
+  return m_wait(_sync);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_flash_erase(
+    uint32_t address,
+    ic_flash_erase_e size,
+    ic_flash_event_cb cb,
+    void *context)
+{
+  __auto_type _size = size == IC_FLASH_ERASE_BLOCK ? IC_FLASH_BLOCK_SIZE : IC_FLASH_SECTOR_SIZE;
+
+  if(address % _size != 0 || address >= ic_flash_size())
+    return IC_ERROR;
+
+  ic_sync_s *_sync;
+  __auto_type _ret_val = m_begin(FLASH_OP_ERASE, cb, context, &_sync);
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
+
+  m_flash.address = address;
+  m_flash.erase = size;
+  m_erase_step();
+
+  return m_wait(_sync);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_flash_power_down(ic_flash_event_cb cb, void *context){
+  ic_sync_s *_sync;
+  __auto_type _ret_val = m_begin(FLASH_OP_POWER_DOWN, cb, context, &_sync);
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
+
+  m_power_down_step();
+
+  return m_wait(_sync);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_flash_resume(ic_flash_event_cb cb, void *context){
+  ic_sync_s *_sync;
+  __auto_type _ret_val = m_begin(FLASH_OP_RESUME, cb, context, &_sync);
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
 
+  m_resume_step();
 
+  return m_wait(_sync);
+}
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ic_flash_busy(void){
+  return m_flash.op != FLASH_OP_NONE;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file    ic_driver_flash.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   External JEDEC SPI NOR flash driver
+ *
+ * Driver works with any JEDEC compatible SPI NOR flash with 3 byte addressing (up to 16MB), 256B
+ * pages, 4kB sectors and 64kB blocks. Only one operation is performed at a time. Operation started
+ * with callback returns immediately and callback is called from SPI IRQ or timer task when it is
+ * finished. With NULL callback operation blocks calling task, when chip does not finish it in
+ * IC_FLASH_SYNC_TIMEOUT it is aborted and IC_TIMEOUT is returned, buffer is not used afterwards.
+ */
+
+#ifndef IC_DRIVER_FLASH_H
+#define IC_DRIVER_FLASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ic_common_types.h"
+
+/** @defgroup IC_FLASH
+ *  @{
+ */
+
+#define IC_FLASH_PAGE_SIZE    256
+#define IC_FLASH_SECTOR_SIZE  4096
+#define IC_FLASH_BLOCK_SIZE   65536
+
+typedef void (*ic_flash_event_cb)(ic_return_val_e result, void *context);
+
+/**
+ * @brief JEDEC ID of the chip
+ */
+typedef struct{
+  uint8_t manufacturer;
+  uint8_t type;
+  uint8_t capacity;                   /** log2 of size in bytes */
+}ic_flash_id_s;
+
+typedef enum{
+  IC_FLASH_ERASE_SECTOR = 0,          /** 4kB */
+  IC_FLASH_ERASE_BLOCK                /** 64kB */
+}ic_flash_erase_e;
+
+/**
+ * @brief Initialize driver, wake up chip and probe its JEDEC ID. Call from task.
+ *
+ * @return IC_SUCCESS or IC_ERROR when no known chip answered.
+ */
+ic_return_val_e ic_flash_init(void);
+
+ic_return_val_e ic_flash_deinit(void);
+
+/**
+ * @brief JEDEC ID read during init.
+ */
+ic_flash_id_s ic_flash_get_id(void);
+
+/**
+ * @brief Size of the chip in bytes (0 when driver is not initialized).
+ */
+uint32_t ic_flash_size(void);
+
+/**
+ * @brief Read data with fast-read command.
+ *
+ * Read is not limited to a page, data is streamed in chains of SPI transfers.
+ *
+ * @param address   Start address.
+ * @param buffer    Buffer for data. Has to be valid until operation is finished.
+ * @param len       Number of bytes.
+ * @param cb        Called when data is ready. NULL - block calling task.
+ * @param context   Callback context.
+ *
+ * @return IC_SUCCESS, IC_BUSY when other operation is in progress, IC_ERROR on wrong arguments,
+ *         IC_TIMEOUT when blocking operation was aborted.
+ */
+ic_return_val_e ic_flash_read(
+    uint32_t address,
+    uint8_t *buffer,
+    size_t len,
+    ic_flash_event_cb cb,
+    void *context);
+
+/**
+ * @brief Program data. Area has to be erased and can not cross page boundary.
+ *
+ * Callback is called when chip finished programming.
+ *
+ * @param data  Data to write. Has to be valid until operation is finished.
+ */
+ic_return_val_e ic_flash_program(
+    uint32_t address,
+    const uint8_t *data,
+    size_t len,
+    ic_flash_event_cb cb,
+    void *context);
+
+/**
+ * @brief Erase sector or block. Address has to be aligned to erased size.
+ */
+ic_return_val_e ic_flash_erase(
+    uint32_t address,
+    ic_flash_erase_e size,
+    ic_flash_event_cb cb,
+    void *context);
+
+/**
+ * @brief Put chip into deep power-down. Only @ref ic_flash_resume is accepted afterwards.
+ */
+ic_return_val_e ic_flash_power_down(ic_flash_event_cb cb, void *context);
+
+/**
+ * @brief Release chip from deep power-down.
+ */
+ic_return_val_e ic_flash_resume(ic_flash_event_cb cb, void *context);
+
+/**
+ * @brief Operation in progress.
+ */
+bool ic_flash_busy(void);
+
+/** @} */
+
+#endif /* !IC_DRIVER_FLASH_H */
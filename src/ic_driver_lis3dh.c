@@ -199,7 +199,6 @@ ic_return_val_e ic_lis3dh_read_data(void(*fp)(acc_data_s data), bool force){
           NULL);
   if (_ret_val != IC_SUCCESS)
   {
-    ic_twi_refresh_bus();
     m_fp_force = NULL;
     return _ret_val;
   }
@@ -65,13 +65,7 @@ ic_return_val_e ic_set_channel(
   m_ltc_channels[channel].bufer[0] = channel;
   m_ltc_channels[channel].bufer[1] = val&0x3F;
 
-  __auto_type _ret_val = TWI_SEND_DATA(ltc_twi, m_ltc_channels[channel].bufer, 2, fp, context);
-
-  if(_ret_val != IC_SUCCESS){
-    ic_twi_refresh_bus();
-  }
-
-  return _ret_val;
+  return TWI_SEND_DATA(ltc_twi, m_ltc_channels[channel].bufer, 2, fp, context);
 }
 
 ic_return_val_e ic_enable_channel(uint8_t channel){
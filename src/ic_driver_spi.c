@@ -7,7 +7,13 @@
  * Description
  */
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include "ic_driver_spi.h"
+#include "ic_bus_stats.h"
+#include "ic_ring_buffer.h"
+#include "ic_sync.h"
 #include "ic_config.h"
 
 #include "app_error.h"
@@ -22,100 +28,111 @@
 static struct{
   const nrf_drv_spi_t nrf_drv_instance;
   uint8_t spi_instance_cnt;
-  bool line_busy;
-  ic_spi_instance_s *instance;
-  ic_spi_event_cb callback;
+  bool volatile line_busy;
+  nrf_drv_spi_config_t config;
 }m_current_state = {
                     .nrf_drv_instance = NRF_DRV_SPI_INSTANCE(IC_SPI_INSTANCE),
                     .spi_instance_cnt = 0,
                     .line_busy        = false,
-                    .instance          = NULL,
-                    .callback         = NULL
                   };
 
-static struct transaction_queue_s{
-  volatile uint8_t tail;
-  volatile uint8_t head;
-  struct{
-    volatile bool occupied;
-    ic_spi_instance_s instance;
-  }data[IC_SPI_PENDIG_TRANSACTIONS];
-}m_instance_queue;
-
-static inline void pop_element(struct transaction_queue_s *queue){
-  if(queue->head != queue->tail){
-    if(++queue->tail==IC_SPI_PENDIG_TRANSACTIONS)
-      queue->tail = 0;
-  }
+/**
+ * @brief Transaction queue. Filled by tasks and IRQs (MPSC), released by SPI IRQ.
+ */
+struct transaction_queue_field_s{
+  ic_bus_timestamp_t enqueued;
+  ic_spi_instance_s *instance;
+  ic_spi_transfer_s transfer;
+  ic_sync_s *sync;                     /** Waiter of synchronous chain, NULL for asynchronous */
+  bool last;                          /** Last transfer of chain */
+  bool cancelled;                     /** Not started, callback not called */
+};
+
+static IC_RING_BUFFER(struct transaction_queue_field_s, IC_SPI_PENDIG_TRANSACTIONS)
+  m_instance_queue;
+
+static inline ret_code_t m_start_transfer(struct transaction_queue_field_s *field){
+  ic_spi_cs_low(field->instance);
+  return nrf_drv_spi_transfer(
+      &m_current_state.nrf_drv_instance,
+      field->transfer.in_buffer,
+      field->transfer.in_len,
+      field->transfer.out_buffer,
+      field->transfer.out_len);
 }
 
-static inline bool put_queue_top(
-    struct transaction_queue_s *queue,
-    ic_spi_instance_s *instance)
-{
-  uint8_t _head = queue->head;
-  uint8_t _tail = queue->tail;
+/**
+ * @brief Finish first transfer in queue. Called from IRQ or with interrupts disabled.
+ */
+static void m_finish_transfer(bool error){
+  __auto_type _field = &IC_RING_FIRST(m_instance_queue);
+  __auto_type _instance = _field->instance;
+
+  if(!_field->transfer.open || error)
+    ic_spi_cs_high(_instance);
 
-  if(++_head == IC_SPI_PENDIG_TRANSACTIONS)
-    _head = 0;
+  ic_bus_stats_done(
+      IC_BUS_SPI,
+      _instance->pin,
+      _field->enqueued,
+      error,
+      IC_RING_COUNT(m_instance_queue) - 1);
 
-  if(_head == _tail)
-    return false;
+  --_instance->pending;
 
-  memcpy(
-      &queue->data[queue->head].instance,
-      instance,
-      sizeof(ic_spi_instance_s)
-      );
+  if (_field->transfer.callback != NULL && !_field->cancelled){
+    _field->transfer.callback(_field->transfer.context);
+  }
 
-  if(++queue->head == IC_SPI_PENDIG_TRANSACTIONS)
-    queue->head = 0;
+  if(_field->sync != NULL){
+    if(error)
+      _field->sync->result = IC_ERROR;
+    if(_field->last)
+      ic_sync_signal(_field->sync, _field->sync->result);
+  }
 
-  return true;
+  ic_ring_release(&m_instance_queue.ring);
 }
 
-#define get_queue_last(v) &(v).data[(v).head==0?IC_SPI_PENDIG_TRANSACTIONS-1:(v).head-1].instance
-
-#define get_queue_first(v) &(v).data[(v).tail].instance
+/**
+ * @brief Start next queued transfer. Transfers which can not be started or were cancelled are
+ * dropped.
+ *
+ * Line stays busy until queue is empty, so transfers queued from callbacks do not start on their
+ * own.
+ */
+static void m_start_next(){
+  for(;;){
+    __auto_type _empty = true;
+
+    CRITICAL_REGION_ENTER();
+    _empty = IC_RING_EMPTY(m_instance_queue);
+    if(_empty && m_current_state.line_busy){
+      m_current_state.line_busy = false;
+      ic_bus_stats_active(IC_BUS_SPI, false);
+    }
+    CRITICAL_REGION_EXIT();
 
-#define is_queue_empty(v) ((v).head == (v).tail)
+    if(_empty)
+      return;
 
-static void clean_queue(struct transaction_queue_s *queue){
-  while(!is_queue_empty(*queue)){
-    pop_element(queue);
+    __auto_type _field = &IC_RING_FIRST(m_instance_queue);
+    if(!_field->cancelled){
+      if(m_start_transfer(_field) == NRF_SUCCESS)
+        return;
+      NRF_LOG_ERROR("transfer dropped\n");
+    }
+    m_finish_transfer(true);
   }
 }
 
 static void spi_event_handler(nrf_drv_spi_evt_t const *p_event){
   UNUSED_VARIABLE(p_event);
 
-  m_current_state.line_busy = false;
-
-  if(!is_queue_empty(m_instance_queue)){
-    __auto_type _instance = get_queue_first(m_instance_queue);
-    if(!_instance->transaction_desc.open)
-      ic_spi_cs_high(_instance);
+  if(!IC_RING_EMPTY(m_instance_queue))
+    m_finish_transfer(false);
 
-    _instance->active = false;
-
-    if (_instance->callback != NULL){
-      _instance->callback(_instance->context);
-    }
-
-    pop_element(&m_instance_queue);
-
-    if (!is_queue_empty(m_instance_queue)){
-      m_current_state.line_busy = true;
-      _instance = get_queue_first(m_instance_queue);
-      ic_spi_cs_low(_instance);
-      nrf_drv_spi_transfer(
-          &m_current_state.nrf_drv_instance,
-          _instance->transaction_desc.in_buffer,
-          _instance->transaction_desc.in_len,
-          _instance->transaction_desc.out_buffer,
-          _instance->transaction_desc.out_len);
-    }
-  }
+  m_start_next();
 }
 
 ic_return_val_e ic_spi_init(ic_spi_instance_s *instance, uint8_t pin){
@@ -124,20 +141,24 @@ ic_return_val_e ic_spi_init(ic_spi_instance_s *instance, uint8_t pin){
   /*instance->nrf_spi_instance = (void *)&m_current_state.nrf_drv_instance;*/
 
   instance->pin = pin;
-  instance->active = false;
-  instance->callback = NULL;
-  memset(&instance->transaction_desc, 0, sizeof(instance->transaction_desc));
+  instance->pending = 0;
 
   nrf_gpio_cfg_output(instance->pin);
 
+  ic_bus_stats_init();
+  ic_sync_init();
+
   if(m_current_state.spi_instance_cnt++ == 0){
-    clean_queue(&m_instance_queue);
-    nrf_drv_spi_config_t _spi_config = NRF_DRV_SPI_DEFAULT_CONFIG;
-    _spi_config.ss_pin    = NRF_DRV_SPI_PIN_NOT_USED;
-    _spi_config.miso_pin  = IC_SPI_MISO_PIN;
-    _spi_config.mosi_pin  = IC_SPI_MOSI_PIN;
-    _spi_config.sck_pin   = IC_SPI_SCK_PIN;
-    APP_ERROR_CHECK(nrf_drv_spi_init(&m_current_state.nrf_drv_instance, &_spi_config, spi_event_handler));
+    ic_ring_clean(&m_instance_queue.ring);
+    m_current_state.config = (nrf_drv_spi_config_t)NRF_DRV_SPI_DEFAULT_CONFIG;
+    m_current_state.config.ss_pin    = NRF_DRV_SPI_PIN_NOT_USED;
+    m_current_state.config.miso_pin  = IC_SPI_MISO_PIN;
+    m_current_state.config.mosi_pin  = IC_SPI_MOSI_PIN;
+    m_current_state.config.sck_pin   = IC_SPI_SCK_PIN;
+    APP_ERROR_CHECK(nrf_drv_spi_init(
+          &m_current_state.nrf_drv_instance,
+          &m_current_state.config,
+          spi_event_handler));
   }
 
   return IC_SUCCESS;
@@ -159,6 +180,148 @@ ic_return_val_e ic_spi_deinit(ic_spi_instance_s *instance){
   return IC_SUCCESS;
 }
 
+static ic_return_val_e m_send_chain(
+    ic_spi_instance_s *instance,
+    const ic_spi_transfer_s *transfers,
+    size_t count,
+    ic_sync_s *sync)
+{
+  ASSERT(instance!=NULL);
+  ASSERT(transfers!=NULL);
+
+  if(count == 0 || count > IC_SPI_PENDIG_TRANSACTIONS)
+    return IC_ERROR;
+
+  __auto_type _ret_val = IC_SUCCESS;
+  __auto_type _start = false;
+
+  CRITICAL_REGION_ENTER();
+  if(IC_RING_SIZE(m_instance_queue) - IC_RING_COUNT(m_instance_queue) < count){
+    _ret_val = IC_BUSY;
+  }
+  else{
+    // Line is idle only when queue was empty, so our chain is first in queue
+    if(!m_current_state.line_busy){
+      m_current_state.line_busy = true;
+      ic_bus_stats_active(IC_BUS_SPI, true);
+      _start = true;
+    }
+
+    __auto_type _timestamp = ic_bus_stats_timestamp();
+    for(size_t i = 0; i < count; ++i){
+      __auto_type _field = &IC_RING_NEXT(m_instance_queue);
+      _field->enqueued = _timestamp;
+      _field->instance = instance;
+      _field->transfer = transfers[i];
+      _field->sync = sync;
+      _field->last = i == count-1;
+      _field->cancelled = false;
+      ic_ring_commit(&m_instance_queue.ring);
+    }
+    instance->pending += count;
+    ic_bus_stats_queued(IC_BUS_SPI, IC_RING_COUNT(m_instance_queue));
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(_ret_val == IC_BUSY){
+    ic_bus_stats_busy(IC_BUS_SPI, instance->pin);
+    return IC_BUSY;
+  }
+
+  if(_start && m_start_transfer(&IC_RING_FIRST(m_instance_queue)) != NRF_SUCCESS){
+    CRITICAL_REGION_ENTER();
+    m_finish_transfer(true);
+    m_start_next();
+    CRITICAL_REGION_EXIT();
+    return IC_ERROR;
+  }
+
+  return IC_SUCCESS;
+}
+
+ic_return_val_e ic_spi_send_chain(
+    ic_spi_instance_s *instance,
+    const ic_spi_transfer_s *transfers,
+    size_t count)
+{
+  return m_send_chain(instance, transfers, count, NULL);
+}
+
+/**
+ * @brief Cancel queued transfers of device (only those of given chain when sync is not NULL).
+ *
+ * Transfer in flight is stopped by restarting the driver, so DMA does not touch its buffers after
+ * return. Cancelled transfers signal nothing and their callbacks are not called.
+ */
+static void m_cancel(ic_spi_instance_s *instance, ic_sync_s *sync){
+  CRITICAL_REGION_ENTER();
+  uint8_t _tail = m_instance_queue.ring.tail;
+  uint8_t _head = m_instance_queue.ring.head;
+  for(uint8_t i = _tail; i != _head; ++i){
+    __auto_type _field = &IC_RING_SLOT(m_instance_queue, i);
+    if(_field->instance == instance && (sync == NULL || _field->sync == sync)){
+      _field->cancelled = true;
+      _field->sync = NULL;
+    }
+  }
+
+  if(m_current_state.line_busy
+      && !IC_RING_EMPTY(m_instance_queue)
+      && IC_RING_FIRST(m_instance_queue).cancelled)
+  {
+    // First transfer is in flight (or its IRQ is pending and cleared by init)
+    nrf_drv_spi_uninit(&m_current_state.nrf_drv_instance);
+    APP_ERROR_CHECK(nrf_drv_spi_init(
+          &m_current_state.nrf_drv_instance,
+          &m_current_state.config,
+          spi_event_handler));
+    m_finish_transfer(true);
+    m_start_next();
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+ic_return_val_e ic_spi_send_chain_sync(
+    ic_spi_instance_s *instance,
+    const ic_spi_transfer_s *transfers,
+    size_t count,
+    uint32_t timeout)
+{
+  if(isr_context())
+    return IC_ERROR;
+
+  if(xTaskGetSchedulerState() != taskSCHEDULER_RUNNING){
+    __auto_type _ret_val = m_send_chain(instance, transfers, count, NULL);
+    // No scheduler to block on (early init) - busy wait, IRQ finishes the chain
+    while(_ret_val == IC_SUCCESS && instance->pending != 0);
+    return _ret_val;
+  }
+
+  __auto_type _start = xTaskGetTickCount();
+  __auto_type _sync = ic_sync_claim(timeout);
+  if(_sync == NULL)
+    return IC_TIMEOUT;
+  _sync->result = IC_SUCCESS;
+
+  __auto_type _ret_val = m_send_chain(instance, transfers, count, _sync);
+  while(_ret_val == IC_BUSY && xTaskGetTickCount() - _start < timeout){
+    vTaskDelay(1);  // Queue full, wait for a free slot
+    _ret_val = m_send_chain(instance, transfers, count, _sync);
+  }
+
+  if(_ret_val == IC_SUCCESS && ic_sync_wait(_sync, _start, timeout))
+    _ret_val = _sync->result;
+  else if(_ret_val == IC_SUCCESS || _ret_val == IC_BUSY)
+    _ret_val = IC_TIMEOUT;
+
+  // Rest of chain must not touch caller buffers nor signal released waiter
+  if(!_sync->done)
+    m_cancel(instance, _sync);
+
+  ic_sync_release(_sync);
+  return _ret_val;
+}
+
 ic_return_val_e ic_spi_send(
     ic_spi_instance_s *instance,
     uint8_t *in_buffer,
@@ -169,54 +332,20 @@ ic_return_val_e ic_spi_send(
     void *context,
     bool open)
 {
-  ASSERT(instance!=NULL);
   ASSERT(in_buffer!=NULL);
   ASSERT(out_buffer!=NULL);
 
-
-  instance->callback = callback;
-  instance->context = context;
-
-  instance->transaction_desc.in_len = in_len;
-  instance->transaction_desc.in_buffer = in_buffer;
-  instance->transaction_desc.out_len = out_len;
-  instance->transaction_desc.out_buffer = out_buffer;
-  instance->transaction_desc.open = open;
-
-  __auto_type _ret_val = false;
-
-  CRITICAL_REGION_ENTER();
-  _ret_val = put_queue_top(&m_instance_queue, instance);
-  CRITICAL_REGION_EXIT();
-
-  if(!_ret_val)
-    return IC_BUSY;
-  else{
-    instance->active = true;
-    if(m_current_state.line_busy){
-      return IC_SUCCESS;
-    }
-    else{
-      m_current_state.line_busy = true;
-      ic_spi_cs_low(instance);
-      __auto_type _ret_val =
-        nrf_drv_spi_transfer(
-            &m_current_state.nrf_drv_instance,
-            in_buffer,
-            in_len,
-            out_buffer,
-            out_len);
-
-      switch(_ret_val){
-        case NRF_SUCCESS:
-          return IC_SUCCESS;
-        case NRF_ERROR_BUSY:
-          return IC_BUSY;
-        default:
-          return IC_ERROR;
-      }
-    }
-  }
+  ic_spi_transfer_s _transfer = {
+    .in_buffer  = in_buffer,
+    .in_len     = in_len,
+    .out_buffer = out_buffer,
+    .out_len    = out_len,
+    .callback   = callback,
+    .context    = context,
+    .open       = open
+  };
+
+  return m_send_chain(instance, &_transfer, 1, NULL);
 }
 
 void ic_spi_cs_high(ic_spi_instance_s *instance){
@@ -228,5 +357,9 @@ void ic_spi_cs_low(ic_spi_instance_s *instance){
 }
 
 bool ic_spi_instance_busy(ic_spi_instance_s *instance){
-  return instance->active;
+  return instance->pending != 0;
+}
+
+void ic_spi_cancel(ic_spi_instance_s *instance){
+  m_cancel(instance, NULL);
 }
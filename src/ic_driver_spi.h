@@ -17,25 +17,69 @@
 
 typedef void (*ic_spi_event_cb)(void *context);
 
+/**
+ * @brief Single SPI transfer descriptor.
+ *
+ * Descriptor is copied into driver queue, only buffers have to live until transfer is finished.
+ */
 typedef struct{
-  void *nrf_spi_instance;
-  ic_spi_event_cb callback;
+  uint8_t *in_buffer;                 /** Data to send */
+  size_t in_len;
+  uint8_t *out_buffer;                /** Received data */
+  size_t out_len;
+  ic_spi_event_cb callback;           /** Called from IRQ when transfer is finished. Can be NULL */
   void *context;
+  bool open;                          /** Keep CS low after transfer (next one continues frame) */
+}ic_spi_transfer_s;
+
+/**
+ * @brief SPI device instance. DO NOT FILL IT MANUALLY!!
+ */
+typedef struct{
+  void *nrf_spi_instance;
   uint8_t pin;
-  bool active;                        /** Is line ocupated by device */
-  struct{
-    size_t in_len;
-    uint8_t *in_buffer;
-    size_t out_len;
-    uint8_t *out_buffer;
-    bool open;
-  }transaction_desc;
+  uint8_t volatile pending;           /** Number of queued transfers of this device */
 }ic_spi_instance_s;
 
 ic_return_val_e ic_spi_init(ic_spi_instance_s *instance, uint8_t pin);
 
 ic_return_val_e ic_spi_deinit(ic_spi_instance_s *instance);
 
+/**
+ * @brief Queue chain of transfers.
+ *
+ * Transfers of a chain are queued atomically and go back to back, no other device can use the bus
+ * in between. CS is raised after every transfer which is not 'open'. Many chains of the same device
+ * can be queued at once.
+ *
+ * @param instance  Device instance.
+ * @param transfers Transfers descriptors.
+ * @param count     Number of transfers.
+ *
+ * @return IC_SUCCESS, IC_BUSY when there is no room for whole chain, IC_ERROR on driver error.
+ */
+ic_return_val_e ic_spi_send_chain(
+    ic_spi_instance_s *instance,
+    const ic_spi_transfer_s *transfers,
+    size_t count);
+
+/**
+ * @brief Queue chain of transfers and block calling task until it is finished.
+ *
+ * Calling task sleeps on a waiter from @ref ic_sync_claim, before scheduler is started it busy
+ * waits. On timeout the rest of chain is cancelled, buffers are not used after return. Can not be
+ * called from IRQ.
+ *
+ * @param timeout Max blocking time (ticks).
+ *
+ * @return IC_SUCCESS, IC_TIMEOUT, IC_ERROR on driver error or when called from IRQ.
+ */
+ic_return_val_e ic_spi_send_chain_sync(
+    ic_spi_instance_s *instance,
+    const ic_spi_transfer_s *transfers,
+    size_t count,
+    uint32_t timeout);
+
 ic_return_val_e ic_spi_send(
     ic_spi_instance_s *instance,
     uint8_t *in_buffer,
@@ -53,6 +97,14 @@ void ic_spi_cs_low(ic_spi_instance_s *instance);
 
 bool ic_spi_instance_busy(ic_spi_instance_s *instance);
 
+/**
+ * @brief Drop all queued transfers of device and stop the one in flight.
+ *
+ * Callbacks of dropped transfers are not called. Call from task, when device state machine gave up
+ * waiting for them.
+ */
+void ic_spi_cancel(ic_spi_instance_s *instance);
+
 #define SPI_REGISTER(name)\
   static ic_spi_instance_s name##_spi_instance;
 
@@ -67,12 +119,20 @@ bool ic_spi_instance_busy(ic_spi_instance_s *instance);
   ic_spi_send(&name##_spi_instance, (uint8_t *)in_buffer, (uint8_t)len, (uint8_t *)out_buffer,\
       (uint8_t)len, callback, context, true)
 
+#define SPI_SEND_CHAIN(name, transfers, count)\
+  ic_spi_send_chain(&name##_spi_instance, transfers, count)
+
+#define SPI_SEND_CHAIN_SYNC(name, transfers, count, timeout)\
+  ic_spi_send_chain_sync(&name##_spi_instance, transfers, count, timeout)
+
 #define SPI_CS_HIGH(name) ic_spi_cs_high(&name##_spi_instance)
 
 #define SPI_CS_LOW(name) ic_spi_cs_low(&name##_spi_instance)
 
 #define SPI_TRANSACTION_ACTIVE(name) ic_spi_instance_busy(&name##_spi_instance)
 
+#define SPI_CANCEL(name) ic_spi_cancel(&name##_spi_instance)
+
 #define SPI_UNINIT(name) ic_spi_deinit(&name##_spi_instance)
 
 #endif /* !IC_DRIVER_SPI_H */
@@ -9,7 +9,14 @@
 #include "nrf_drv_twi.h"
 #include "app_twi.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
 #include "ic_driver_twi.h"
+#include "ic_bus_stats.h"
+#include "ic_ring_buffer.h"
+#include "ic_sync.h"
 #include "ic_config.h"
 
 #include "app_error.h"
@@ -41,23 +48,34 @@
     IC_TWI_TRANSFER(name, TWI_READ_OP(address), p_data, length, flags)
 
 /**
- * @brief 
+ * @brief State of single queued transaction
+ */
+enum transaction_state_e{
+  TWI_TRANSACTION_SCHEDULED = 0,      /** Handed to app_twi, waiting for completion */
+  TWI_TRANSACTION_RETRY,              /** Failed, waiting for backoff timer to be rescheduled */
+  TWI_TRANSACTION_DONE                /** Finished, slot can be freed */
+};
+
+/**
+ * @brief
  */
 struct transaction_queue_field_s{
   ic_twi_event_cb callback;           /** TWI IRQ callback */
   void *context;                      /** TWI IRQ callbacks context */
   app_twi_transaction_t transaction;  /** RESERVED */
   app_twi_transfer_t transfers[2];    /** RESERVED */
+  uint8_t reg_addr;                   /** Register address, must outlive callers stack */
+  uint8_t retries;                    /** Number of already performed retries */
+  uint8_t address;                    /** Devices TWI address, for statistics */
+  ic_bus_timestamp_t enqueued;        /** Time of handing transaction to app_twi */
+  enum transaction_state_e volatile state;
 };
 
 /**
- * @brief
+ * @brief Transaction queue. Filled by tasks and IRQs (MPSC), released by TWI IRQ.
  */
-struct transaction_queue_s{
-  struct transaction_queue_field_s callback_array[IC_TWI_PENDIG_TRANSACTIONS];
-  uint8_t volatile head;
-  uint8_t volatile tail;
-}m_transaction_queue;
+static IC_RING_BUFFER(struct transaction_queue_field_s, IC_TWI_PENDIG_TRANSACTIONS)
+  m_transaction_queue;
 
 /**
  * @brief
@@ -71,81 +89,414 @@ static struct{
   .twi_instance_cnt = 0,
 };
 
-static inline void pop_element(struct transaction_queue_s *queue){
-  if(queue->head != queue->tail){
-    if(++queue->tail==IC_TWI_PENDIG_TRANSACTIONS)
-      queue->tail = 0;
-  }
-}
+/**
+ * @brief Error recovery state
+ *
+ * Failed transaction is retried alone after backoff. Only when bus looks stuck (SDA held low or
+ * many consecutive errors) bus is cleared and all unfinished transactions are rescheduled. Bus
+ * clear and full reschedule are done by timer task only, other contexts request them.
+ */
+static struct{
+  TimerHandle_t timer;                /** Backoff timer, runs recovery in timer task context */
+  uint8_t consecutive_errors;         /** Errors since last successful transaction */
+  bool volatile bus_clear_pending;    /** Bus clear requested by IRQ handler or task */
+  uint32_t volatile bus_clears;       /** Finished bus clears, cancelled waits watch it */
+}m_recovery;
 
-static inline bool put_queue_top(
-    struct transaction_queue_s *queue,
+static app_twi_transaction_t const * m_nordic_twi_queue[IC_TWI_PENDIG_TRANSACTIONS+1];
+static nrf_drv_twi_config_t m_twi_config = {
+    .frequency          = (nrf_twi_frequency_t)IC_TWI_FREQUENCY,
+    .scl                = IC_TWI_SCL_PIN,
+    .sda                = IC_TWI_SDA_PIN,
+    .interrupt_priority = IC_TWI_IRQ_PRIORITY,
+    .clear_bus_init     = true,
+    .hold_bus_uninit    = true};
+
+/**
+ * @brief Put transaction on the top of the queue. Must be called with interrupts disabled.
+ *
+ * @return Queue entry or NULL when queue is full.
+ */
+static inline struct transaction_queue_field_s *put_queue_top(
     ic_twi_event_cb callback,
     void *context,
     app_twi_transaction_t transaction,
     app_twi_transfer_t *transfers) // Assumed there are 2 * sizeof(app_twi_transfer_t) bytes
 {
-  uint8_t _head = queue->head;
-  uint8_t _tail = queue->tail;
-
-  if(++_head == IC_TWI_PENDIG_TRANSACTIONS)
-    _head = 0;
-
-  if(_head == _tail)
-    return false;
-
-  queue->callback_array[queue->head].callback = callback;
-  queue->callback_array[queue->head].context = context;
-  queue->callback_array[queue->head].transaction = transaction;
-  queue->callback_array[queue->head].transaction.p_user_data =
-    &(queue->callback_array[queue->head]);
-  queue->callback_array[queue->head].transaction.p_transfers =
-    queue->callback_array[queue->head].transfers;
-  memcpy(
-      queue->callback_array[queue->head].transfers,
-      transfers,
-      sizeof(queue->callback_array[queue->head].transfers)
-      );
-
-  if(++queue->head == IC_TWI_PENDIG_TRANSACTIONS)
-    queue->head = 0;
-
-  return true;
+  if(IC_RING_FULL(m_transaction_queue))
+    return NULL;
+
+  if(IC_RING_EMPTY(m_transaction_queue))
+    ic_bus_stats_active(IC_BUS_TWI, true);
+
+  __auto_type _field = &IC_RING_NEXT(m_transaction_queue);
+
+  _field->callback = callback;
+  _field->context = context;
+  _field->retries = 0;
+  _field->state = TWI_TRANSACTION_SCHEDULED;
+  _field->transaction = transaction;
+  _field->transaction.p_user_data = _field;
+  _field->transaction.p_transfers = _field->transfers;
+  memcpy(_field->transfers, transfers, sizeof(_field->transfers));
+  if(transaction.number_of_transfers == 2){
+    _field->reg_addr = *transfers[0].p_data;
+    _field->transfers[0].p_data = &_field->reg_addr;
+  }
+
+  ic_ring_commit(&m_transaction_queue.ring);
+
+  return _field;
 }
 
-#define get_queue_last(v) (v).callback_array[(v).head==0?IC_TWI_PENDIG_TRANSACTIONS-1:(v).head-1]
+/**
+ * @brief Free all finished slots from the tail of the queue.
+ *
+ * Retried transactions finish out of order, so slot is released only when all older ones are done.
+ * Must be called with interrupts disabled or from TWI IRQ.
+ */
+static inline void drain_queue(){
+  while(!IC_RING_EMPTY(m_transaction_queue) &&
+      IC_RING_FIRST(m_transaction_queue).state == TWI_TRANSACTION_DONE){
+    ic_ring_release(&m_transaction_queue.ring);
+    if(IC_RING_EMPTY(m_transaction_queue))
+      ic_bus_stats_active(IC_BUS_TWI, false);
+  }
+}
 
-#define get_queue_first(v) (v).callback_array[(v).tail]
+static inline bool m_bus_stuck(){
+  return
+    m_recovery.consecutive_errors >= IC_TWI_STUCK_BUS_ERRORS ||
+    nrf_gpio_pin_read(IC_TWI_SDA_PIN) == 0;
+}
+
+/**
+ * @brief Bus clear and full reschedule are done in timer task only, or before scheduler is started
+ * when nothing can preempt them.
+ */
+static bool m_recovery_owner(){
+  return
+    m_recovery.timer == NULL ||
+    xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ||
+    xTaskGetCurrentTaskHandle() == xTimerGetTimerDaemonTaskHandle();
+}
 
-#define is_queue_empty(v) ((v).head == (v).tail)
+static void m_arm_recovery(uint8_t retries){
+  if(m_recovery.timer == NULL)
+    return;
 
-void clean_queue(struct transaction_queue_s *queue){
-  while(!is_queue_empty(*queue)){
-    pop_element(queue);
+  __auto_type _period = (TickType_t)(IC_TWI_RETRY_BASE_DELAY << retries);
+  if(isr_context()){
+    __auto_type _yield_required = pdFALSE;
+    xTimerChangePeriodFromISR(m_recovery.timer, _period, &_yield_required);
+    portYIELD_FROM_ISR(_yield_required);
+  }
+  else{
+    xTimerChangePeriod(m_recovery.timer, _period, OSTIMER_WAIT_FOR_QUEUE);
   }
 }
 
+/**
+ * @brief Clear stuck bus.
+ *
+ * Reinitialization of app_twi drops its internal queue and toggles SCL (clear_bus_init) so slave
+ * releases SDA. Every unfinished transaction has to be scheduled again.
+ */
+static void m_bus_clear(){
+  NRF_LOG_INFO("{%s}\n", (uint32_t)__func__);
+  app_twi_uninit(&m_curren_state.nrf_drv_instance);
+  app_twi_init(
+      &m_curren_state.nrf_drv_instance,
+      &m_twi_config,
+      IC_TWI_PENDIG_TRANSACTIONS,
+      m_nordic_twi_queue);
+  m_recovery.consecutive_errors = 0;
+}
+
+/**
+ * @brief Reschedule transactions waiting for retry.
+ *
+ * TWI IRQ releases entries meanwhile, so queue is walked by free running indexes of snapshot and
+ * every entry is checked to be still in queue when it is claimed.
+ *
+ * @param all if true - every unfinished transaction is rescheduled (after bus clear), except ones
+ * abandoned by synchronous callers (no callback), which are dropped.
+ */
+static void m_reschedule(bool all){
+  uint8_t _tail, _head;
+
+  CRITICAL_REGION_ENTER();
+  _tail = m_transaction_queue.ring.tail;
+  _head = m_transaction_queue.ring.head;
+  CRITICAL_REGION_EXIT();
+
+  for(uint8_t i = _tail; i != _head; ++i){
+    __auto_type _field = &IC_RING_SLOT(m_transaction_queue, i);
+    __auto_type _reschedule = false;
+
+    CRITICAL_REGION_ENTER();
+    if(IC_RING_LIVE(m_transaction_queue, i)){
+      if(all && _field->callback == NULL){
+        _field->state = TWI_TRANSACTION_DONE;
+      }
+      else if(_field->state == TWI_TRANSACTION_RETRY ||
+          (all && _field->state == TWI_TRANSACTION_SCHEDULED)){
+        _field->state = TWI_TRANSACTION_SCHEDULED;
+        _field->enqueued = ic_bus_stats_timestamp();
+        _reschedule = true;
+      }
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(_reschedule &&
+        app_twi_schedule(&m_curren_state.nrf_drv_instance, &_field->transaction) != NRF_SUCCESS){
+      CRITICAL_REGION_ENTER();
+      _field->state = TWI_TRANSACTION_DONE;
+      CRITICAL_REGION_EXIT();
+      if(_field->callback != NULL)
+        _field->callback(IC_ERROR, _field->context);
+    }
+  }
+
+  CRITICAL_REGION_ENTER();
+  drain_queue();
+  CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Backoff timer handler. Runs in timer task context.
+ */
+static void m_recovery_timer_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+
+  __auto_type _bus_clear = m_recovery.bus_clear_pending;
+  m_recovery.bus_clear_pending = false;
+
+  if(_bus_clear)
+    m_bus_clear();
+
+  m_reschedule(_bus_clear);
+
+  if(_bus_clear)
+    ++m_recovery.bus_clears;
+}
+
+/**
+ * @brief Clear bus and reschedule everything, in place when called by recovery owner, by timer
+ * task otherwise.
+ */
+static void m_request_bus_clear(){
+  if(m_recovery_owner()){
+    m_recovery.bus_clear_pending = false;
+    m_bus_clear();
+    m_reschedule(true);
+    ++m_recovery.bus_clears;
+    return;
+  }
+
+  m_recovery.bus_clear_pending = true;
+  m_arm_recovery(0);
+}
+
 /**
  * @brief TWI IRQ handler
  *
+ * Successful transaction is reported to user. Failed one is retried with exponential backoff, and
+ * reported as IC_ERROR when it runs out of retries. Other queued transactions are not affected.
+ *
  * @param result    message from driver @ref NRF_ERRORS_BASE
  * @param p_context user data passed by driver
  */
 static void m_twi_event_handler(uint32_t result, void *p_context){
   struct transaction_queue_field_s * _transaction = p_context;
 
-  if(_transaction != NULL){
-    if(!is_queue_empty(m_transaction_queue)){
-      __auto_type _callback = get_queue_first(m_transaction_queue).callback;
-      __auto_type _context = get_queue_first(m_transaction_queue).context;
+  if(_transaction == NULL){
+    NRF_LOG_INFO("no instance data!\n");
+    return;
+  }
 
-      if(_callback != NULL)
-        _callback(result == NRF_SUCCESS ? IC_SUCCESS : IC_ERROR, _context);
+  ic_bus_stats_done(
+      IC_BUS_TWI,
+      _transaction->address,
+      _transaction->enqueued,
+      result != NRF_SUCCESS,
+      IC_RING_COUNT(m_transaction_queue) - 1);
 
-      pop_element(&m_transaction_queue);
+  if(result == NRF_SUCCESS){
+    m_recovery.consecutive_errors = 0;
+  }
+  else{
+    if(m_recovery.consecutive_errors < UINT8_MAX)
+      ++m_recovery.consecutive_errors;
+
+    if(m_bus_stuck())
+      m_recovery.bus_clear_pending = true;
+
+    if(_transaction->retries < IC_TWI_MAX_RETRIES && m_recovery.timer != NULL){
+      _transaction->state = TWI_TRANSACTION_RETRY;
+      m_arm_recovery(_transaction->retries++);
+      return;
+    }
+
+    NRF_LOG_INFO("transaction dropped\n");
+    if(m_recovery.bus_clear_pending)
+      m_arm_recovery(0);
+  }
+
+  _transaction->state = TWI_TRANSACTION_DONE;
+  if(_transaction->callback != NULL)
+    _transaction->callback(result == NRF_SUCCESS ? IC_SUCCESS : IC_ERROR, _transaction->context);
+
+  drain_queue();
+}
+
+static inline ic_return_val_e m_nrf_to_ic(ret_code_t ret_val){
+  switch (ret_val){
+    case NRF_SUCCESS:
+      return IC_SUCCESS;
+    case NRF_ERROR_BUSY:
+    default:
+      return ret_val == NRF_ERROR_BUSY? IC_DRIVER_BUSY : IC_ERROR;
+  }
+}
+
+/**
+ * @brief Put transaction into queue and hand it to app_twi.
+ *
+ * @param retries Initial retry counter. IC_TWI_MAX_RETRIES disables retries done by IRQ handler.
+ * @param field   If not NULL - filled with queue entry of scheduled transaction.
+ */
+static ic_return_val_e m_ic_twi_schedule(
+    app_twi_transaction_t transaction,
+    app_twi_transfer_t *transfers,
+    ic_twi_event_cb callback,
+    void *context,
+    uint8_t retries,
+    struct transaction_queue_field_s **field)
+{
+  struct transaction_queue_field_s *_field = NULL;
+  CRITICAL_REGION_ENTER();
+  _field = put_queue_top(callback, context, transaction, transfers);
+  if(_field != NULL){
+    _field->retries = retries;
+    _field->address = TWI_WRITE_OP(transfers[0].operation);
+    _field->enqueued = ic_bus_stats_timestamp();
+    ic_bus_stats_queued(IC_BUS_TWI, IC_RING_COUNT(m_transaction_queue));
+  }
+  CRITICAL_REGION_EXIT();
+  if(_field == NULL) {
+    ic_bus_stats_busy(IC_BUS_TWI, TWI_WRITE_OP(transfers[0].operation));
+    return IC_SOFTWARE_BUSY;
+  }
+
+  __auto_type _ret_val = app_twi_schedule(&m_curren_state.nrf_drv_instance, &_field->transaction);
+
+  if(_ret_val != NRF_SUCCESS){
+    ic_bus_stats_busy(IC_BUS_TWI, _field->address);
+    CRITICAL_REGION_ENTER();
+    _field->state = TWI_TRANSACTION_DONE;
+    drain_queue();
+    CRITICAL_REGION_EXIT();
+  }
+  else if(field != NULL){
+    *field = _field;
+  }
+
+  return m_nrf_to_ic(_ret_val);
+}
+
+static void m_sync_callback(ic_return_val_e twi_return, void *context){
+  ic_sync_signal(context, twi_return);
+}
+
+/**
+ * @brief Abandon synchronous transaction which did not finish on time.
+ *
+ * Transaction may still be in flight and point to callers stack. Its callback is removed, so
+ * waiter is not signalled anymore, and caller waits for bus clear, which stops app_twi and drops
+ * the entry. Other unfinished transactions are rescheduled by it.
+ */
+static void m_sync_cancel(struct transaction_queue_field_s *field, ic_sync_s *sync){
+  __auto_type _abandoned = false;
+
+  CRITICAL_REGION_ENTER();
+  if(field->context == sync && field->state != TWI_TRANSACTION_DONE){
+    field->callback = NULL;
+    _abandoned = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(!_abandoned)
+    return;
+
+  __auto_type _bus_clears = m_recovery.bus_clears;
+  m_request_bus_clear();
+  while(m_recovery.bus_clears == _bus_clears){
+    vTaskDelay(1);
+    /* Timer queue was full */
+    if(m_recovery.bus_clear_pending && !xTimerIsTimerActive(m_recovery.timer))
+      m_arm_recovery(0);
+  }
+}
+
+/**
+ * @brief Synchronous transaction blocking calling task.
+ *
+ * Transaction goes through the same queue as asynchronous ones, calling task sleeps on waiter
+ * (@ref ic_sync_s) until it is finished, task notifications are left to the task. Retries are done
+ * here, not in timer task, so it is safe to call it from timer callbacks.
+ *
+ * @param timeout Max time (ticks) caller can be blocked.
+ *
+ * @return IC_SUCCESS, IC_ERROR when all retries failed, IC_TIMEOUT when transaction did not finish
+ * on time.
+ */
+static ic_return_val_e m_ic_twi_blocking(
+    ic_sync_s *sync,
+    app_twi_transaction_t transaction,
+    app_twi_transfer_t *transfers,
+    TickType_t start,
+    TickType_t timeout)
+{
+  uint8_t _retries = 0;
+
+  for(;;){
+    struct transaction_queue_field_s *_field = NULL;
+    ic_sync_reset(sync);
+
+    __auto_type _ret_val = m_ic_twi_schedule(
+        transaction,
+        transfers,
+        m_sync_callback,
+        sync,
+        IC_TWI_MAX_RETRIES,
+        &_field);
+
+    if(_ret_val == IC_SUCCESS){
+      if(!ic_sync_wait(sync, start, timeout)){
+        m_sync_cancel(_field, sync);
+        if(!sync->done)
+          return IC_TIMEOUT;
+      }
+      _ret_val = sync->result;
+    }
+
+    if(_ret_val == IC_SUCCESS)
+      return IC_SUCCESS;
+
+    if(xTaskGetTickCount() - start >= timeout)
+      return _ret_val == IC_ERROR ? IC_ERROR : IC_TIMEOUT;
+
+    if(_ret_val == IC_ERROR){
+      if(_retries == IC_TWI_MAX_RETRIES)
+        return IC_ERROR;
+      if(m_bus_stuck())
+        m_request_bus_clear();
+      vTaskDelay(IC_TWI_RETRY_BASE_DELAY << _retries++);
+    }
+    else{
+      vTaskDelay(1);  // Queue full, wait for a free slot
     }
-  }else{
-    NRF_LOG_INFO("no instance data!\n");
   }
 }
 
@@ -157,8 +508,9 @@ static void m_twi_event_handler(uint32_t result, void *p_context){
  * @param reg_addr  Target register for read purpose.
  * @param buffer    Preallocated transfer buffer.
  * @param len       Length buffer.
- * @param callback  IRQ handler code.
+ * @param callback  IRQ handler code. If NULL - transaction is synchronous.
  * @param read      if true - read transaction. Otherwise - write.
+ * @param timeout   Synchronous transaction timeout (ticks).
  *
  * @return  IC_SUCCESS, when everything went ok. IC_BUSY when previously started device transaction
  * wasnt handled yet
@@ -172,7 +524,8 @@ static ic_return_val_e m_ic_twi_transaction(
     ic_twi_event_cb callback,
     void *context,
     bool read,
-    bool force)
+    bool force,
+    TickType_t timeout)
 {
   UNUSED_PARAMETER(force);
   ASSERT(buffer!=NULL);
@@ -192,49 +545,44 @@ static ic_return_val_e m_ic_twi_transaction(
     transaction.number_of_transfers = 1;
   }
 
-  if(callback != NULL){
-    __auto_type _ret_val = false;
-    CRITICAL_REGION_ENTER();
-    _ret_val = put_queue_top(
-        &m_transaction_queue,
-        callback,
-        context,
-        transaction,
-        transfers);
-    CRITICAL_REGION_EXIT();
-    if((!_ret_val) == true) {
-      return IC_SOFTWARE_BUSY;
-    }
+  if(callback != NULL)
+    return m_ic_twi_schedule(transaction, transfers, callback, context, 0, NULL);
+
+  if(!isr_context() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING){
+    __auto_type _start = xTaskGetTickCount();
+    __auto_type _sync = ic_sync_claim(timeout);
+    if(_sync == NULL)
+      return IC_TIMEOUT;
+
+    __auto_type _ret_val = m_ic_twi_blocking(_sync, transaction, transfers, _start, timeout);
+    ic_sync_release(_sync);
+    return _ret_val;
   }
 
-  __auto_type _ret_val = callback == NULL ?
-    app_twi_perform(
+  // No scheduler to block on (early init) - busy wait
+  ret_code_t _ret_val;
+  uint8_t _retries = 0;
+  do{
+    _ret_val = app_twi_perform(
         &m_curren_state.nrf_drv_instance,
         transfers,
         transaction.number_of_transfers,
-        NULL) :
-    app_twi_schedule(
-        &m_curren_state.nrf_drv_instance,
-        &get_queue_last(m_transaction_queue).transaction);
+        NULL);
 
-  switch (_ret_val){
-    case NRF_SUCCESS:
-      return IC_SUCCESS;
-    case NRF_ERROR_BUSY:
-    default:
-      return _ret_val == NRF_ERROR_BUSY? IC_DRIVER_BUSY : IC_ERROR;
-  }
-}
+    if(_ret_val == NRF_SUCCESS || _ret_val == NRF_ERROR_BUSY)
+      break;
 
-static app_twi_transaction_t const * m_nordic_twi_queue[IC_TWI_PENDIG_TRANSACTIONS+1];
-static nrf_drv_twi_config_t m_twi_config = {
-    .frequency          = (nrf_twi_frequency_t)IC_TWI_FREQUENCY,
-    .scl                = IC_TWI_SCL_PIN,
-    .sda                = IC_TWI_SDA_PIN,
-    .interrupt_priority = IC_TWI_IRQ_PRIORITY,
-    .clear_bus_init     = true,
-    .hold_bus_uninit    = true};
+    if(m_recovery.consecutive_errors < UINT8_MAX)
+      ++m_recovery.consecutive_errors;
+    if(!isr_context() && m_bus_stuck())
+      m_request_bus_clear();
+  }while(_retries++ < IC_TWI_MAX_RETRIES);
 
+  if(_ret_val == NRF_SUCCESS)
+    m_recovery.consecutive_errors = 0;
+
+  return m_nrf_to_ic(_ret_val);
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ic_return_val_e ic_twi_init(ic_twi_instance_s * instance){
@@ -243,6 +591,9 @@ ic_return_val_e ic_twi_init(ic_twi_instance_s * instance){
 
   NRF_LOG_INFO("{%s}\n", (uint32_t)__func__);
 
+  ic_bus_stats_init();
+  ic_sync_init();
+
   if(m_curren_state.twi_instance_cnt++ == 0){
     __auto_type err_code = app_twi_init(
         &m_curren_state.nrf_drv_instance,
@@ -253,6 +604,15 @@ ic_return_val_e ic_twi_init(ic_twi_instance_s * instance){
     APP_ERROR_CHECK(err_code);
   }
 
+  if(m_recovery.timer == NULL){
+    m_recovery.timer = xTimerCreate(
+        "TWI",
+        IC_TWI_RETRY_BASE_DELAY,
+        pdFALSE,
+        NULL,
+        m_recovery_timer_callback);
+  }
+
   return IC_SUCCESS;
 }
 
@@ -292,7 +652,8 @@ ic_return_val_e ic_twi_send(
       callback,                 // ic_twi_event_cb callback,
       context,
       false,
-      force);                   // bool read
+      force,                    // bool read
+      IC_TWI_SYNC_TIMEOUT);
 
 }
 
@@ -316,18 +677,53 @@ ic_return_val_e ic_twi_read(
       callback,                 // ic_twi_event_cb callback,
       context,
       true,
-      force);                    // bool read
+      force,                    // bool read
+      IC_TWI_SYNC_TIMEOUT);
 
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_twi_send_sync(
+    ic_twi_instance_s * const instance,
+    uint8_t *buffer,
+    size_t len,
+    uint32_t timeout)
+{
+  return m_ic_twi_transaction(
+      instance,
+      instance->device_address,
+      0x00,
+      buffer,
+      len,
+      NULL,
+      NULL,
+      false,
+      false,
+      timeout);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_twi_read_sync(
+    ic_twi_instance_s *const instance,
+    uint8_t reg_addr,
+    uint8_t *buffer,
+    size_t len,
+    uint32_t timeout)
+{
+  return m_ic_twi_transaction(
+      instance,
+      instance->device_address,
+      reg_addr,
+      buffer,
+      len,
+      NULL,
+      NULL,
+      true,
+      false,
+      timeout);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
 void ic_twi_refresh_bus(){
-  NRF_LOG_INFO("{%s}\n", (uint32_t)__func__);
-  /*NRF_LOG_FLUSH();*/
-  app_twi_uninit(&m_curren_state.nrf_drv_instance);
-  clean_queue(&m_transaction_queue);
-  app_twi_init(
-      &m_curren_state.nrf_drv_instance,
-      &m_twi_config,
-      IC_TWI_PENDIG_TRANSACTIONS,
-      m_nordic_twi_queue);
+  m_request_bus_clear();
 }
@@ -178,6 +178,42 @@ typedef struct{
     context)                                                                                      \
   ic_twi_read(&name##_twi_instance, reg_addr, in_buffer, len, callback, context, true)
 
+/**
+ * @brief   Macro simplifying @ref ic_twi_send_sync
+ *
+ * @param name      Name of instace.
+ * @param in_buffer Prealocated buffer provided by user.
+ * @param len       Length of buffer.
+ * @param timeout   Max blocking time (ticks).
+ *
+ * @return  @ref ic_twi_send_sync.
+ */
+#define TWI_SEND_DATA_SYNC(                                                                       \
+    name,                                                                                         \
+    in_buffer,                                                                                    \
+    len,                                                                                          \
+    timeout)                                                                                      \
+  ic_twi_send_sync(&name##_twi_instance, in_buffer, len, timeout)
+
+/**
+ * @brief   Macro simplifying @ref ic_twi_read_sync
+ *
+ * @param name      Name of instance.
+ * @param reg_addr  Target register address.
+ * @param in_buffer Prealocated buffer provided by user.
+ * @param len       Length of buffer.
+ * @param timeout   Max blocking time (ticks).
+ *
+ * @return  @ref ic_twi_read_sync
+ */
+#define TWI_READ_DATA_SYNC(                                                                       \
+    name,                                                                                         \
+    reg_addr,                                                                                     \
+    in_buffer,                                                                                    \
+    len,                                                                                          \
+    timeout)                                                                                      \
+  ic_twi_read_sync(&name##_twi_instance, reg_addr, in_buffer, len, timeout)
+
 /**
  * @brief TWI instance initialization function.
  *
@@ -245,6 +281,57 @@ ic_return_val_e ic_twi_read(
     void *context,
     bool force);
 
+/**
+ * @brief Send data and block calling task until transaction is finished.
+ *
+ * Transaction is queued together with asynchronous ones and calling task sleeps on waiter
+ * (@ref ic_sync_s), so CPU is free while it is in flight and task notifications of the caller are
+ * not touched. Must not be called from IRQ. Before scheduler is started it falls back to busy
+ * waiting. @ref ic_twi_send with NULL callback works the same way with @ref IC_TWI_SYNC_TIMEOUT.
+ *
+ * @param instance  Pointer to allocated instance memory.
+ * @param in_buffer Prealocated buffer provided by user.
+ * @param len       Lenght of buffer.
+ * @param timeout   Max blocking time (ticks).
+ *
+ * @return  IC_SUCCESS, IC_ERROR when transaction failed after retries, IC_TIMEOUT when it did not
+ * finish on time.
+ */
+ic_return_val_e ic_twi_send_sync(
+    ic_twi_instance_s * const instance,
+    uint8_t *in_buffer,
+    size_t len,
+    uint32_t timeout);
+
+/**
+ * @brief Read data and block calling task until transaction is finished.
+ *
+ * See @ref ic_twi_send_sync.
+ *
+ * @param instance  Pointer to allocated instance memory.
+ * @param reg_addr  target register address.
+ * @param in_buffer Prealocated buffer provided by user.
+ * @param len       Lenght of buffer.
+ * @param timeout   Max blocking time (ticks).
+ *
+ * @return  IC_SUCCESS, IC_ERROR when transaction failed after retries, IC_TIMEOUT when it did not
+ * finish on time.
+ */
+ic_return_val_e ic_twi_read_sync(
+    ic_twi_instance_s *const instance,
+    uint8_t reg_addr,
+    uint8_t *in_buffer,
+    size_t len,
+    uint32_t timeout);
+
+/**
+ * @brief Clear TWI bus and reschedule all unfinished transactions.
+ *
+ * Driver does it on its own when bus looks stuck, so there is no need to call it after single
+ * failed transaction. Queued transactions are NOT dropped. Clear is done by timer task, which
+ * also runs retries, so call returns before it is done (unless called from timer callback). Must
+ * not be called from IRQ.
+ */
 void ic_twi_refresh_bus();
 
 #ifdef __cplusplus
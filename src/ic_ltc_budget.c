@@ -0,0 +1,214 @@
+/**
+ * @file    ic_ltc_budget.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Power budget of actuators
+ *
+ * Budget is refreshed by own timer from gauge snapshot, LTC service only reads it when it applies
+ * the limit on every output write. Currents are kept multiplied by IC_LTC_MAX_VAL, so the limit
+ * costs one division and only when LEDs are scaled. Announcement refused because TX buffers are
+ * full is sent again at the next write of outputs.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "BUDGET"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_ltc_budget.h"
+#include "ic_service_ltc.h"
+#include "ic_ble_service.h"
+#include "ic_service_mux.h"
+#include "ic_driver_bq27742.h"
+
+_Static_assert(sizeof(ic_ltc_budget_frame_s) <= 20, "Announcement has to fit notification");
+_Static_assert(IC_LTC_BUDGET_SOC_HIGH > IC_LTC_BUDGET_SOC_LOW, "Budget falls with charge");
+_Static_assert(IC_LTC_BUDGET_MAX_UA >= IC_LTC_BUDGET_MIN_UA, "Budget falls with charge");
+_Static_assert(
+    (uint64_t)IC_LTC_BUDGET_MAX_UA * IC_LTC_MAX_VAL * IC_LTC_BUDGET_SCALE_ONE <= UINT32_MAX,
+    "Scale is computed in 32 bits");
+
+/** Current of devices at IC_LTC_MAX_VAL (uA), in order of @ref ic_devices_e */
+static const uint32_t m_full_current[IC_VIBRATOR + 1] = {
+  [IC_LEFT_GREEN_LED]   = IC_LTC_BUDGET_GREEN_UA,
+  [IC_LEFT_RED_LED]     = IC_LTC_BUDGET_RED_UA,
+  [IC_LEFT_BLUE_LED]    = IC_LTC_BUDGET_BLUE_UA,
+  [IC_RIGHT_GREEN_LED]  = IC_LTC_BUDGET_GREEN_UA,
+  [IC_RIGHT_RED_LED]    = IC_LTC_BUDGET_RED_UA,
+  [IC_RIGHT_BLUE_LED]   = IC_LTC_BUDGET_BLUE_UA,
+  [IC_VIBRATOR]         = IC_LTC_BUDGET_VIB_UA
+};
+
+static struct{
+  uint8_t volatile soc;
+  uint32_t volatile budget;           /** uA */
+  ic_ltc_budget_state_e state;
+  uint32_t announced_budget;
+  bool announce;                      /** Event not announced yet */
+  TimerHandle_t timer;
+  ic_ltc_budget_frame_s frame;
+  ic_ltc_budget_stats_s stats;
+}m_budget = {
+  .soc    = 100,
+  .budget = IC_LTC_BUDGET_MAX_UA
+};
+
+static inline uint16_t m_saturate(uint32_t val){
+  return val > UINT16_MAX ? UINT16_MAX : val;
+}
+
+static uint32_t m_budget_of(uint8_t soc){
+  if(soc >= IC_LTC_BUDGET_SOC_HIGH)
+    return IC_LTC_BUDGET_MAX_UA;
+  if(soc <= IC_LTC_BUDGET_SOC_LOW)
+    return IC_LTC_BUDGET_MIN_UA;
+
+  return IC_LTC_BUDGET_MIN_UA
+    + (IC_LTC_BUDGET_MAX_UA - IC_LTC_BUDGET_MIN_UA) * (soc - IC_LTC_BUDGET_SOC_LOW)
+    / (IC_LTC_BUDGET_SOC_HIGH - IC_LTC_BUDGET_SOC_LOW);
+}
+
+static void m_announce(void){
+  if(!m_budget.announce)
+    return;
+
+  m_budget.frame.time_stamp = GET_TICK_COUNT();
+
+  __auto_type _ret_val = ic_mux_active() ?
+    ic_mux_append(
+        IC_MUX_BUDGET,
+        m_budget.frame.time_stamp,
+        &m_budget.frame,
+        sizeof(m_budget.frame)) :
+    ble_iccs_send_to_stream2((uint8_t *)&m_budget.frame, sizeof(m_budget.frame), NULL);
+
+  switch(_ret_val){
+    case IC_BUSY:
+      /* Repeated at the next refresh */
+      return;
+    case IC_SUCCESS:
+      break;
+    default:
+      ++m_budget.stats.lost_events;
+      break;
+  }
+  m_budget.announce = false;
+}
+
+static void m_timer_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+
+  __auto_type _snapshot = ic_bq_get_snapshot();
+  if(_snapshot.stale)
+    return;
+
+  __auto_type _soc = _snapshot.soc;
+  if(_soc > 100){
+    NRF_LOG_ERROR("Invalid state of charge %d\n", _soc);
+    return;
+  }
+
+  m_budget.soc = _soc;
+  m_budget.budget = m_budget_of(_soc);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_ltc_budget_init(void){
+  if(m_budget.timer == NULL){
+    m_budget.timer = xTimerCreate(
+        "BUDGET",
+        IC_LTC_BUDGET_SOC_PERIOD,
+        pdTRUE,
+        NULL,
+        m_timer_callback);
+    if(m_budget.timer == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+  }
+
+  if(xTimerStart(m_budget.timer, OSTIMER_WAIT_FOR_QUEUE) != pdPASS)
+    NRF_LOG_ERROR("Timer not started\n");
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_ltc_budget_deinit(void){
+  if(m_budget.timer == NULL)
+    return IC_NOT_INIALIZED;
+
+  xTimerStop(m_budget.timer, OSTIMER_WAIT_FOR_QUEUE);
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_ltc_budget_limit_s ic_ltc_budget_apply(const uint8_t *levels){
+  /* Currents are kept multiplied by IC_LTC_MAX_VAL, no division per channel */
+  uint32_t _leds = 0;
+  for(int i = 0; i < IC_VIBRATOR; ++i)
+    _leds += m_full_current[i] * levels[i];
+
+  uint32_t _vibrator = m_full_current[IC_VIBRATOR] * levels[IC_VIBRATOR];
+  uint32_t _budget_ua = m_budget.budget;
+  uint32_t _budget = _budget_ua * IC_LTC_MAX_VAL;
+
+  ic_ltc_budget_limit_s _limit = {
+    .scale = IC_LTC_BUDGET_SCALE_ONE,
+    .vibrator_deferred = _vibrator > _budget
+  };
+
+  if(!_limit.vibrator_deferred)
+    _budget -= _vibrator;
+  if(_leds > _budget)
+    _limit.scale = _budget * IC_LTC_BUDGET_SCALE_ONE / _leds;
+
+  ic_ltc_budget_state_e _state = _limit.vibrator_deferred ? IC_LTC_BUDGET_DEFERRED :
+    _limit.scale < IC_LTC_BUDGET_SCALE_ONE ? IC_LTC_BUDGET_SCALED :
+    IC_LTC_BUDGET_OK;
+
+  if(_state != IC_LTC_BUDGET_OK)
+    ++m_budget.stats.limited;
+
+  if(_state != m_budget.state
+      || (_state != IC_LTC_BUDGET_OK && _budget_ua != m_budget.announced_budget))
+  {
+    NRF_LOG_INFO("State %d -> %d, budget %d uA\n", m_budget.state, _state, _budget_ua);
+
+    m_budget.frame = (ic_ltc_budget_frame_s){
+      .type     = IC_LTC_BUDGET_FRAME,
+      .state    = _state,
+      .previous = m_budget.state,
+      .soc      = m_budget.soc,
+      .scale    = _limit.scale,
+      .demand   = m_saturate((_leds + _vibrator) / (IC_LTC_MAX_VAL * 1000)),
+      .budget   = m_saturate(_budget_ua / 1000)
+    };
+    m_budget.state = _state;
+    m_budget.announced_budget = _budget_ua;
+    m_budget.announce = true;
+    ++m_budget.stats.events;
+  }
+  m_announce();
+
+  return _limit;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_ltc_budget_stats_s ic_ltc_budget_get_stats(void){
+  ic_ltc_budget_stats_s _stats;
+
+  CRITICAL_REGION_ENTER();
+  _stats = m_budget.stats;
+  _stats.state = m_budget.state;
+  _stats.soc = m_budget.soc;
+  _stats.budget = m_budget.budget;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
+}
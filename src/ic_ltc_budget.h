@@ -0,0 +1,93 @@
+/**
+ * @file    ic_ltc_budget.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Power budget of actuators
+ *
+ * Current drawn by actuators is estimated from output levels of channels, current of channel at
+ * IC_LTC_MAX_VAL is set per color (and for vibrator) in config and scales linearly with level.
+ * Budget falls linearly from @ref IC_LTC_BUDGET_MAX_UA at @ref IC_LTC_BUDGET_SOC_HIGH state of
+ * charge to @ref IC_LTC_BUDGET_MIN_UA at @ref IC_LTC_BUDGET_SOC_LOW, state of charge is taken from
+ * gauge snapshot every @ref IC_LTC_BUDGET_SOC_PERIOD (stale snapshot is ignored). LTC service
+ * applies limit whenever it writes outputs:
+ *  - vibrator has priority, it is deferred (held off while its function runs) only when it does
+ *    not fit budget alone - lower level would stall the motor,
+ *  - LEDs share the rest, all of them are scaled by the same factor, so colors are kept.
+ * Power LEDs are not limited.
+ *
+ * Each state transition, and budget change while outputs are limited, is announced in-band with
+ * @ref ic_ltc_budget_frame_s - as a record of multiplexed stream when central is subscribed to it,
+ * otherwise on stream2.
+ */
+
+#ifndef IC_LTC_BUDGET_H
+#define IC_LTC_BUDGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_LTC_BUDGET
+ *  @{
+ */
+
+/** Type of stream2 frame, continues @ref IC_STREAM_POLICY_FRAME */
+#define IC_LTC_BUDGET_FRAME     0x11
+#define IC_LTC_BUDGET_SCALE_ONE 256
+
+typedef enum{
+  IC_LTC_BUDGET_OK = 0,
+  IC_LTC_BUDGET_SCALED,               /** LEDs are dimmed */
+  IC_LTC_BUDGET_DEFERRED              /** Vibrator is held off (LEDs may be dimmed too) */
+}ic_ltc_budget_state_e;
+
+typedef struct{
+  uint16_t scale;                     /** LED levels are scaled by scale/IC_LTC_BUDGET_SCALE_ONE */
+  bool vibrator_deferred;
+}ic_ltc_budget_limit_s;
+
+/**
+ * @brief Announcement of budget event.
+ */
+typedef struct __attribute__((packed)){
+  uint8_t type;                       /** @ref IC_LTC_BUDGET_FRAME */
+  uint8_t state;                      /** @ref ic_ltc_budget_state_e */
+  uint8_t previous;
+  uint8_t soc;                        /** State of charge (%) */
+  uint16_t scale;
+  uint16_t demand;                    /** Estimated current of requested outputs (mA) */
+  uint16_t budget;                    /** mA */
+  uint32_t time_stamp;
+}ic_ltc_budget_frame_s;
+
+typedef struct{
+  uint8_t state;                      /** @ref ic_ltc_budget_state_e */
+  uint8_t soc;
+  uint32_t budget;                    /** uA */
+  uint32_t limited;                   /** Refreshes with limited outputs */
+  uint16_t events;
+  uint16_t lost_events;               /** Events not announced, no stream was subscribed */
+}ic_ltc_budget_stats_s;
+
+/**
+ * @brief Start reading state of charge. Called by LTC service, budget is the highest until the
+ * first reading.
+ */
+ic_return_val_e ic_ltc_budget_init(void);
+
+ic_return_val_e ic_ltc_budget_deinit(void);
+
+/**
+ * @brief Limit of outputs. Called by LTC service before outputs are written.
+ *
+ * @param levels  Output levels of devices up to IC_VIBRATOR (@ref ic_devices_e).
+ */
+ic_ltc_budget_limit_s ic_ltc_budget_apply(const uint8_t *levels);
+
+ic_ltc_budget_stats_s ic_ltc_budget_get_stats(void);
+
+/** @} */
+
+#endif /* !IC_LTC_BUDGET_H */
@@ -0,0 +1,553 @@
+/**
+ * @file    ic_ltc_pattern.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Keyframe sequences of light and vibration
+ *
+ * Interpreter runs in callback of one software timer, which is rearmed to the next WAIT, so no task
+ * is needed. Play, enqueue and stop only leave request and fire the timer on the next tick.
+ * Interpreter stops after @ref IC_PATTERN_MAX_STEPS instructions without wait or at malformed
+ * code, so broken user slot cannot starve timer task.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "fds.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "PATTERN"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_ltc_pattern.h"
+#include "ic_service_ltc.h"
+#include "ic_command_task.h"
+#include "ic_low_level_control.h"
+
+#define PATTERN_STOP    0xFE          /** Request stopping pattern */
+#define SLOT_WORDS      (IC_PATTERN_SLOT_SIZE / 4)
+
+#define WELCOME_PERIOD  pdMS_TO_TICKS(500)
+#define WDT_PERIOD      pdMS_TO_TICKS(2000)
+#define DEV(device)     IC_PATTERN_DEVICE(device)
+#define LEDS            IC_PATTERN_LEDS
+
+_Static_assert(IC_PATTERN_SLOT_SIZE % 4 == 0, "Slot is written to flash in words");
+_Static_assert(IC_PATTERN_SLOT_SIZE <= UINT8_MAX + 1, "Offset of write is 8 bit");
+_Static_assert(IC_PATTERN_SLOTS <= PATTERN_STOP - IC_PATTERN_USER, "Slots collide with requests");
+
+static const uint8_t m_welcome[] = {
+  IC_PATTERN_SET(DEV(IC_LEFT_RED_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD+1),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_LEFT_GREEN_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD+1),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_LEFT_BLUE_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD+1),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_RIGHT_RED_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD+1),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_RIGHT_GREEN_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD+1),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_RIGHT_BLUE_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD+1),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_END
+};
+
+static const uint8_t m_welcome_wdt[] = {
+  IC_PATTERN_SET(DEV(IC_LEFT_RED_LED), FUN_TYPE_TRIANGLE, 63, WDT_PERIOD, WDT_PERIOD+1),
+  IC_PATTERN_WAIT(WDT_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_RIGHT_RED_LED), FUN_TYPE_TRIANGLE, 63, WDT_PERIOD, WDT_PERIOD+1),
+  IC_PATTERN_WAIT(WDT_PERIOD>>2),
+  IC_PATTERN_END
+};
+
+static const uint8_t m_showoff[] = {
+  IC_PATTERN_SET(DEV(IC_POWER_LEDS), FUN_TYPE_BLINK, 63, WELCOME_PERIOD>>2, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_LEFT_RED_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_LEFT_GREEN_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_LEFT_BLUE_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_RIGHT_RED_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_RIGHT_GREEN_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_RIGHT_BLUE_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_VIBRATOR), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD),
+  IC_PATTERN_END
+};
+
+static const uint8_t m_bye[] = {
+  IC_PATTERN_SET(LEDS, FUN_TYPE_OFF, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_SET(DEV(IC_LEFT_RED_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_LEFT_GREEN_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_LEFT_BLUE_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_RIGHT_RED_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_RIGHT_GREEN_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT(WELCOME_PERIOD>>2),
+  IC_PATTERN_SET(DEV(IC_RIGHT_BLUE_LED), FUN_TYPE_TRIANGLE, 63, WELCOME_PERIOD, WELCOME_PERIOD),
+  IC_PATTERN_WAIT_FOR(LEDS),
+  IC_PATTERN_END
+};
+
+static const uint8_t m_connected[] = {
+  IC_PATTERN_SET(LEDS, FUN_TYPE_RAMP, 0, WELCOME_PERIOD, 0),
+  IC_PATTERN_END
+};
+
+static const uint8_t m_disconnected[] = {
+  IC_PATTERN_SET(
+      DEV(IC_LEFT_RED_LED) | DEV(IC_RIGHT_RED_LED) | DEV(IC_LEFT_GREEN_LED) |
+      DEV(IC_RIGHT_GREEN_LED),
+      FUN_TYPE_RAMP, 0, WELCOME_PERIOD, 0),
+  IC_PATTERN_SET(DEV(IC_VIBRATOR) | DEV(IC_POWER_LEDS), FUN_TYPE_OFF, 0, 0, 0),
+  IC_PATTERN_SET(
+      DEV(IC_LEFT_BLUE_LED) | DEV(IC_RIGHT_BLUE_LED),
+      FUN_TYPE_RAMP, 3, WELCOME_PERIOD>>1, 0),
+  IC_PATTERN_END
+};
+
+static const uint8_t m_charging[] = {
+  IC_PATTERN_SET(LEDS & ~DEV(IC_LEFT_RED_LED), FUN_TYPE_RAMP, 0, WDT_PERIOD, 0),
+  IC_PATTERN_SET(DEV(IC_VIBRATOR) | DEV(IC_POWER_LEDS), FUN_TYPE_OFF, 0, 0, 0),
+  IC_PATTERN_SET(DEV(IC_LEFT_RED_LED), FUN_TYPE_RAMP, 50, WDT_PERIOD, 0),
+  IC_PATTERN_END
+};
+
+static const uint8_t m_charged[] = {
+  IC_PATTERN_SET(LEDS & ~DEV(IC_LEFT_GREEN_LED), FUN_TYPE_RAMP, 0, WDT_PERIOD, 0),
+  IC_PATTERN_SET(DEV(IC_VIBRATOR) | DEV(IC_POWER_LEDS), FUN_TYPE_OFF, 0, 0, 0),
+  IC_PATTERN_SET(DEV(IC_LEFT_GREEN_LED), FUN_TYPE_RAMP, 30, WDT_PERIOD, 0),
+  IC_PATTERN_END
+};
+
+static const struct{
+  const uint8_t *code;
+  size_t len;
+}m_builtin[IC_PATTERN_BUILTIN_NUM] = {
+  [IC_PATTERN_WELCOME]      = {m_welcome,       sizeof(m_welcome)},
+  [IC_PATTERN_WELCOME_WDT]  = {m_welcome_wdt,   sizeof(m_welcome_wdt)},
+  [IC_PATTERN_SHOWOFF]      = {m_showoff,       sizeof(m_showoff)},
+  [IC_PATTERN_BYE]          = {m_bye,           sizeof(m_bye)},
+  [IC_PATTERN_CONNECTED]    = {m_connected,     sizeof(m_connected)},
+  [IC_PATTERN_DISCONNECTED] = {m_disconnected,  sizeof(m_disconnected)},
+  [IC_PATTERN_CHARGING]     = {m_charging,      sizeof(m_charging)},
+  [IC_PATTERN_CHARGED]      = {m_charged,       sizeof(m_charged)}
+};
+
+/** Length of instructions */
+static const uint8_t m_code_len[] = {
+  [IC_PATTERN_CODE_END]       = 1,
+  [IC_PATTERN_CODE_SET]       = 8,
+  [IC_PATTERN_CODE_WAIT]      = 3,
+  [IC_PATTERN_CODE_WAIT_FOR]  = 2,
+  [IC_PATTERN_CODE_LOOP]      = 2,
+  [IC_PATTERN_CODE_NEXT]      = 1
+};
+
+static uint8_t m_slots[IC_PATTERN_SLOTS][IC_PATTERN_SLOT_SIZE] __attribute__((aligned(4)));
+
+/** Copy of slot being written, FDS reads it until write is finished */
+static uint8_t m_store[IC_PATTERN_SLOT_SIZE] __attribute__((aligned(4)));
+
+/**
+ * Pattern is stepped only by timer callback, other contexts leave request and restart timer.
+ */
+static struct{
+  const uint8_t *code;                /** NULL - nothing is played */
+  size_t len;
+  size_t pc;
+  struct{
+    size_t start;
+    uint8_t left;                     /** 0 - forever */
+  }loops[IC_PATTERN_LOOPS];
+  uint8_t depth;
+  uint8_t volatile pattern;           /** Played one */
+  uint8_t volatile request;
+  uint8_t volatile queued;
+  bool loaded;
+  bool storing;
+  TaskHandle_t volatile waiting;
+  TimerHandle_t timer;
+}m_pattern = {
+  .pattern  = IC_PATTERN_NONE,
+  .request  = IC_PATTERN_NONE,
+  .queued   = IC_PATTERN_NONE
+};
+
+static inline uint16_t m_u16(const uint8_t *data){
+  return data[0] | data[1] << 8;
+}
+
+static bool m_valid(uint8_t pattern){
+  return pattern < IC_PATTERN_BUILTIN_NUM ||
+    (pattern >= IC_PATTERN_USER && pattern < IC_PATTERN_USER + IC_PATTERN_SLOTS);
+}
+
+static bool m_playing(void){
+  return m_pattern.pattern != IC_PATTERN_NONE ||
+    (m_pattern.request != IC_PATTERN_NONE && m_pattern.request != PATTERN_STOP) ||
+    m_pattern.queued != IC_PATTERN_NONE;
+}
+
+/**
+ * @brief Run the pattern timer on the next tick.
+ *
+ * Timer callbacks (smart wake stopping pattern) must not block on the queue the timer task itself
+ * reads, there the command is posted without waiting.
+ */
+static void m_kick(void){
+  __auto_type _wait = xTaskGetCurrentTaskHandle() == xTimerGetTimerDaemonTaskHandle() ?
+    0 : OSTIMER_WAIT_FOR_QUEUE;
+
+  if(xTimerChangePeriod(m_pattern.timer, 1, _wait) != pdPASS)
+    NRF_LOG_ERROR("Timer not armed\n");
+}
+
+static void m_start(uint8_t pattern){
+  if(pattern < IC_PATTERN_BUILTIN_NUM){
+    m_pattern.code = m_builtin[pattern].code;
+    m_pattern.len = m_builtin[pattern].len;
+  }
+  else{
+    m_pattern.code = m_slots[pattern - IC_PATTERN_USER];
+    m_pattern.len = IC_PATTERN_SLOT_SIZE;
+  }
+  m_pattern.pc = 0;
+  m_pattern.depth = 0;
+  m_pattern.pattern = pattern;
+}
+
+/**
+ * @brief Pattern ended, the enqueued one starts.
+ */
+static void m_finish(void){
+  uint8_t _queued;
+
+  CRITICAL_REGION_ENTER();
+  _queued = m_pattern.queued;
+  m_pattern.queued = IC_PATTERN_NONE;
+  CRITICAL_REGION_EXIT();
+
+  m_pattern.code = NULL;
+  m_pattern.pattern = IC_PATTERN_NONE;
+
+  if(_queued != IC_PATTERN_NONE){
+    m_start(_queued);
+    return;
+  }
+
+  __auto_type _waiting = m_pattern.waiting;
+  if(_waiting != NULL)
+    xTaskNotifyGive(_waiting);
+}
+
+static void m_set(
+    uint8_t devices,
+    uint8_t func,
+    uint8_t intensity,
+    uint32_t period,
+    uint32_t duration)
+{
+  for(int i = IC_LEFT_GREEN_LED; i <= IC_POWER_LEDS; ++i)
+    if(devices & IC_PATTERN_DEVICE(i))
+      if(ic_actuator_set_func(i, func, period, duration, intensity) != IC_SUCCESS)
+        NRF_LOG_ERROR("Function %d not set\n", func);
+}
+
+/**
+ * @brief Run instructions until pattern waits or ends.
+ *
+ * @return Ticks to wait.
+ */
+static TickType_t m_run(void){
+  for(int i = 0; m_pattern.code != NULL; ++i){
+    __auto_type _code = &m_pattern.code[m_pattern.pc];
+
+    if(m_pattern.pc >= m_pattern.len || _code[0] == IC_PATTERN_CODE_END){
+      m_finish();
+      continue;
+    }
+
+    if(i == IC_PATTERN_MAX_STEPS
+        || _code[0] >= sizeof(m_code_len)
+        || m_pattern.pc + m_code_len[_code[0]] > m_pattern.len
+        || (_code[0] == IC_PATTERN_CODE_LOOP && m_pattern.depth == IC_PATTERN_LOOPS)){
+      NRF_LOG_ERROR("Pattern 0x%X broken at %d\n", m_pattern.pattern, m_pattern.pc);
+      m_finish();
+      continue;
+    }
+
+    switch(_code[0]){
+      case IC_PATTERN_CODE_SET:
+        m_set(
+            _code[1],
+            _code[2],
+            _code[3],
+            m_u16(&_code[4]) * IC_PATTERN_UNIT,
+            m_u16(&_code[6]) * IC_PATTERN_UNIT);
+        break;
+      case IC_PATTERN_CODE_WAIT:
+        m_pattern.pc += m_code_len[IC_PATTERN_CODE_WAIT];
+        if(m_u16(&_code[1]) != 0)
+          return m_u16(&_code[1]) * IC_PATTERN_UNIT;
+        continue;
+      case IC_PATTERN_CODE_WAIT_FOR:
+        if(ic_actuator_active() & _code[1])
+          return IC_PATTERN_POLL;
+        break;
+      case IC_PATTERN_CODE_LOOP:
+        m_pattern.loops[m_pattern.depth].start = m_pattern.pc + m_code_len[IC_PATTERN_CODE_LOOP];
+        m_pattern.loops[m_pattern.depth].left = _code[1];
+        ++m_pattern.depth;
+        break;
+      case IC_PATTERN_CODE_NEXT:
+        if(m_pattern.depth == 0)
+          break;
+        {
+          __auto_type _loop = &m_pattern.loops[m_pattern.depth - 1];
+          if(_loop->left == 0 || --_loop->left != 0){
+            m_pattern.pc = _loop->start;
+            continue;
+          }
+          --m_pattern.depth;
+        }
+        break;
+    }
+    m_pattern.pc += m_code_len[_code[0]];
+  }
+  return 0;
+}
+
+static void m_timer_callback(TimerHandle_t xTimer){
+  uint8_t _request;
+
+  CRITICAL_REGION_ENTER();
+  _request = m_pattern.request;
+  m_pattern.request = IC_PATTERN_NONE;
+  CRITICAL_REGION_EXIT();
+
+  if(_request == PATTERN_STOP)
+    m_finish();
+  else if(_request != IC_PATTERN_NONE)
+    m_start(_request);
+
+  __auto_type _ticks = m_run();
+  if(_ticks != 0 && xTimerChangePeriod(xTimer, _ticks, 0) != pdPASS)
+    NRF_LOG_ERROR("Pattern stalled\n");
+}
+
+static void m_load(void){
+  if(m_pattern.loaded)
+    return;
+
+  for(int i = 0; i < IC_PATTERN_SLOTS; ++i){
+    fds_record_desc_t _desc;
+    fds_find_token_t _token = {0};
+    fds_flash_record_t _record;
+
+    __auto_type _err =
+      fds_record_find(IC_PATTERN_FDS_FILE, IC_PATTERN_FDS_KEY + i, &_desc, &_token);
+
+    /* Called again with FDS_EVT_INIT */
+    if(_err == FDS_ERR_NOT_INITIALIZED)
+      return;
+
+    if(_err == FDS_SUCCESS && fds_record_open(&_desc, &_record) == FDS_SUCCESS){
+      if(_record.p_header->tl.length_words == SLOT_WORDS)
+        memcpy(m_slots[i], _record.p_data, IC_PATTERN_SLOT_SIZE);
+      (void)fds_record_close(&_desc);
+    }
+  }
+  m_pattern.loaded = true;
+}
+
+static void m_fds_evt_handler(fds_evt_t const * const p_evt){
+  switch(p_evt->id){
+    case FDS_EVT_INIT:
+      if(p_evt->result == FDS_SUCCESS)
+        m_load();
+      break;
+    case FDS_EVT_WRITE:
+    case FDS_EVT_UPDATE:
+      if(p_evt->write.file_id != IC_PATTERN_FDS_FILE)
+        break;
+      if(p_evt->result != FDS_SUCCESS)
+        NRF_LOG_ERROR("Slot %d not stored\n", p_evt->write.record_key - IC_PATTERN_FDS_KEY);
+      m_pattern.storing = false;
+      break;
+    default:
+      break;
+  }
+}
+
+static ic_return_val_e m_pattern_cmd(u_BLECmdPayload payload, void *ctx){
+  UNUSED_PARAMETER(ctx);
+
+  switch(payload.data[0]){
+    case IC_PATTERN_OP_WRITE:
+      if(payload.data[3] > sizeof(payload.data) - 4)
+        return IC_ERROR;
+      return ic_pattern_write(payload.data[1], payload.data[2], &payload.data[4], payload.data[3]);
+    case IC_PATTERN_OP_STORE:
+      return ic_pattern_store(payload.data[1]);
+    case IC_PATTERN_OP_PLAY:
+      return ic_pattern_play(payload.data[1]);
+    case IC_PATTERN_OP_STOP:
+      ic_pattern_stop();
+      return IC_SUCCESS;
+    default:
+      return IC_ERROR;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_pattern_init(void){
+  if(m_pattern.timer == NULL){
+    m_pattern.timer = xTimerCreate("PATTERN", 1, pdFALSE, NULL, m_timer_callback);
+    if(m_pattern.timer == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+
+    __auto_type _err = fds_register(m_fds_evt_handler);
+    if(_err != FDS_SUCCESS)
+      APP_ERROR_HANDLER(_err);
+  }
+
+  cmd_register(CMD_LTC_PATTERN, m_pattern_cmd, NULL);
+
+  m_load();
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_pattern_play(uint8_t pattern){
+  if(!m_valid(pattern))
+    return IC_ERROR;
+
+  CRITICAL_REGION_ENTER();
+  m_pattern.request = pattern;
+  m_pattern.queued = IC_PATTERN_NONE;
+  CRITICAL_REGION_EXIT();
+
+  m_kick();
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_pattern_enqueue(uint8_t pattern){
+  if(!m_valid(pattern))
+    return IC_ERROR;
+
+  bool _idle;
+
+  CRITICAL_REGION_ENTER();
+  _idle = m_pattern.pattern == IC_PATTERN_NONE && m_pattern.request == IC_PATTERN_NONE;
+  if(_idle)
+    m_pattern.request = pattern;
+  else
+    m_pattern.queued = pattern;
+  CRITICAL_REGION_EXIT();
+
+  if(_idle)
+    m_kick();
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_pattern_stop(void){
+  CRITICAL_REGION_ENTER();
+  m_pattern.request = PATTERN_STOP;
+  m_pattern.queued = IC_PATTERN_NONE;
+  CRITICAL_REGION_EXIT();
+
+  m_kick();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ic_pattern_wait(TickType_t timeout){
+  m_pattern.waiting = xTaskGetCurrentTaskHandle();
+
+  while(m_playing())
+    if(ulTaskNotifyTake(pdTRUE, timeout) == 0)
+      break;
+
+  m_pattern.waiting = NULL;
+  return !m_playing();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_pattern_write(
+    uint8_t slot,
+    uint8_t offset,
+    const uint8_t *code,
+    size_t len)
+{
+  if(slot >= IC_PATTERN_SLOTS || code == NULL || offset + len > IC_PATTERN_SLOT_SIZE)
+    return IC_ERROR;
+
+  if(m_pattern.pattern == IC_PATTERN_USER + slot)
+    ic_pattern_stop();
+
+  memcpy(&m_slots[slot][offset], code, len);
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_pattern_store(uint8_t slot){
+  if(slot >= IC_PATTERN_SLOTS)
+    return IC_ERROR;
+
+  bool _start;
+
+  CRITICAL_REGION_ENTER();
+  _start = m_pattern.loaded && !m_pattern.storing;
+  if(_start){
+    memcpy(m_store, m_slots[slot], IC_PATTERN_SLOT_SIZE);
+    m_pattern.storing = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(!_start)
+    return IC_BUSY;
+
+  fds_record_chunk_t _chunk = {.p_data = m_store, .length_words = SLOT_WORDS};
+  fds_record_t _record = {
+    .file_id  = IC_PATTERN_FDS_FILE,
+    .key      = IC_PATTERN_FDS_KEY + slot,
+    .data     = {.p_chunks = &_chunk, .num_chunks = 1}
+  };
+  fds_record_desc_t _desc;
+  fds_find_token_t _token = {0};
+
+  __auto_type _err = fds_record_find(IC_PATTERN_FDS_FILE, _record.key, &_desc, &_token)
+    == FDS_SUCCESS ?
+    fds_record_update(&_desc, &_record) :
+    fds_record_write(NULL, &_record);
+
+  if(_err == FDS_SUCCESS)
+    return IC_SUCCESS;
+
+  m_pattern.storing = false;
+
+  if(_err == FDS_ERR_NO_SPACE_IN_FLASH){
+    (void)fds_gc();
+    return IC_BUSY;
+  }
+
+  NRF_LOG_ERROR("Slot %d not stored: %d\n", slot, _err);
+  return IC_ERROR;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file    ic_ltc_pattern.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Keyframe sequences of light and vibration
+ *
+ * Pattern is a byte code stepped by LTC service in background, caller is not blocked:
+ *  - SET      [code][devices:8][func:8][intensity:8][period:16][duration:16] - start function on
+ *             devices (mask of @ref IC_PATTERN_DEVICE), func as in DEVICE_CMD (gamma flag too),
+ *  - WAIT     [code][time:16] - continue after time,
+ *  - WAIT_FOR [code][devices:8] - continue when devices finished (function ended, output is 0),
+ *  - LOOP     [code][count:8] - play instructions up to NEXT count times, 0 - forever,
+ *  - NEXT     [code],
+ *  - END      [code] - also end of code.
+ * Times are in @ref IC_PATTERN_UNIT ticks, loops nest @ref IC_PATTERN_LOOPS deep.
+ *
+ * Built-in patterns are encoded at compile time with IC_PATTERN_* macros. Central uploads patterns
+ * to @ref IC_PATTERN_SLOTS slots (played as IC_PATTERN_USER + slot) with CMD_LTC_PATTERN, stored
+ * slots are restored after reboot. payload[0] selects operation:
+ *  - WRITE - [slot:8][offset:8][count:8][code:up to 12],
+ *  - STORE - [slot:8] write slot to flash,
+ *  - PLAY  - [pattern:8],
+ *  - STOP.
+ *
+ * Multi-byte values are little endian.
+ */
+
+#ifndef IC_LTC_PATTERN_H
+#define IC_LTC_PATTERN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_PATTERN
+ *  @{
+ */
+
+#define IC_PATTERN_UNIT       16      /** Ticks, quantum of LTC service */
+#define IC_PATTERN_USER       0x80
+#define IC_PATTERN_NONE       0xFF
+
+#define IC_PATTERN_DEVICE(device) (1 << (device))
+#define IC_PATTERN_LEDS           0x3F
+
+typedef enum{
+  IC_PATTERN_CODE_END = 0x00,
+  IC_PATTERN_CODE_SET,
+  IC_PATTERN_CODE_WAIT,
+  IC_PATTERN_CODE_WAIT_FOR,
+  IC_PATTERN_CODE_LOOP,
+  IC_PATTERN_CODE_NEXT
+}ic_pattern_code_e;
+
+typedef enum{
+  IC_PATTERN_OP_WRITE = 0x00,
+  IC_PATTERN_OP_STORE,
+  IC_PATTERN_OP_PLAY,
+  IC_PATTERN_OP_STOP
+}ic_pattern_op_e;
+
+typedef enum{
+  IC_PATTERN_WELCOME = 0x00,
+  IC_PATTERN_WELCOME_WDT,
+  IC_PATTERN_SHOWOFF,
+  IC_PATTERN_BYE,
+  IC_PATTERN_CONNECTED,
+  IC_PATTERN_DISCONNECTED,
+  IC_PATTERN_CHARGING,
+  IC_PATTERN_CHARGED,
+
+  IC_PATTERN_BUILTIN_NUM
+}ic_pattern_e;
+
+#define IC_PATTERN_U16(val)   (uint8_t)(val), (uint8_t)((val) >> 8)
+#define IC_PATTERN_TIME(ticks) IC_PATTERN_U16(((ticks) + IC_PATTERN_UNIT/2) / IC_PATTERN_UNIT)
+
+#define IC_PATTERN_SET(devices, func, intensity, period, duration)                                \
+  IC_PATTERN_CODE_SET, (devices), (func), (intensity),                                            \
+  IC_PATTERN_TIME(period), IC_PATTERN_TIME(duration)
+#define IC_PATTERN_WAIT(time)         IC_PATTERN_CODE_WAIT, IC_PATTERN_TIME(time)
+#define IC_PATTERN_WAIT_FOR(devices)  IC_PATTERN_CODE_WAIT_FOR, (devices)
+#define IC_PATTERN_LOOP(count)        IC_PATTERN_CODE_LOOP, (count)
+#define IC_PATTERN_NEXT               IC_PATTERN_CODE_NEXT
+#define IC_PATTERN_END                IC_PATTERN_CODE_END
+
+/**
+ * @brief Create timer, register CMD_LTC_PATTERN and restore stored slots. Called by LTC service.
+ */
+ic_return_val_e ic_pattern_init(void);
+
+/**
+ * @brief Stop current pattern and play pattern (@ref ic_pattern_e or IC_PATTERN_USER + slot).
+ * Devices keep functions set by stopped pattern. Call from task or timer callback.
+ */
+ic_return_val_e ic_pattern_play(uint8_t pattern);
+
+/**
+ * @brief Play pattern when current one ends, at once when nothing is played. Only the last
+ * enqueued pattern is kept.
+ */
+ic_return_val_e ic_pattern_enqueue(uint8_t pattern);
+
+void ic_pattern_stop(void);
+
+/**
+ * @brief Block calling task until pattern (and enqueued one) ended.
+ *
+ * @return false on timeout.
+ */
+bool ic_pattern_wait(TickType_t timeout);
+
+/**
+ * @brief Overwrite code of slot, slot being played is stopped.
+ */
+ic_return_val_e ic_pattern_write(
+    uint8_t slot,
+    uint8_t offset,
+    const uint8_t *code,
+    size_t len);
+
+/**
+ * @return IC_SUCCESS when write started, IC_BUSY when other slot is being written or flash has to
+ * be garbage collected first (repeat later).
+ */
+ic_return_val_e ic_pattern_store(uint8_t slot);
+
+/** @} */
+
+#endif /* !IC_LTC_PATTERN_H */
@@ -0,0 +1,179 @@
+/**
+ * @file    ic_ring_buffer.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Generic ring buffer
+ *
+ * Header only ring buffer usable from C and C++. Size is a compile time power of two (max 128), so
+ * wrapping is done with a mask. Head and tail are free running 8 bit counters: head - tail is
+ * number of elements and whole buffer can be used.
+ *
+ * Variants:
+ *  - SPSC - one producer and one consumer (e.g. task and IRQ). Lock free, head is written only by
+ *    producer, tail only by consumer.
+ *  - MPSC - many producers (tasks and IRQs). Producers are serialized with critical region, consumer
+ *    is lock free.
+ *
+ * Elements are filled in place: get slot with @ref IC_RING_NEXT, fill it and publish it with
+ * @ref ic_ring_commit.
+ */
+
+#ifndef IC_RING_BUFFER_H
+#define IC_RING_BUFFER_H
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_util_platform.h"
+
+/** @defgroup IC_RING_BUFFER
+ *  @{
+ */
+
+#ifdef __cplusplus
+#define IC_RING_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define IC_RING_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+#define IC_RING_COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+/**
+ * @brief Ring buffer indexes.
+ */
+typedef struct{
+  uint8_t volatile head;              /** Written by producer */
+  uint8_t volatile tail;              /** Written by consumer */
+}ic_ring_s;
+
+/**
+ * @brief Ring buffer type of given element type and size.
+ *
+ * @param type  Type of element.
+ * @param size  Number of elements. Power of two, not bigger than 128.
+ */
+#define IC_RING_BUFFER(type, size)                                                                \
+  struct{                                                                                         \
+    IC_RING_STATIC_ASSERT(                                                                        \
+        (size) > 0 && (size) <= 128 && ((size) & ((size)-1)) == 0,                                \
+        "Ring buffer size has to be power of two not bigger than 128");                           \
+    ic_ring_s ring;                                                                               \
+    type data[size];                                                                              \
+  }
+
+#define IC_RING_SIZE(rb) (sizeof((rb).data)/sizeof((rb).data[0]))
+
+#define IC_RING_MASK(rb) (IC_RING_SIZE(rb)-1)
+
+/** Number of elements in buffer */
+#define IC_RING_COUNT(rb) ((uint8_t)((rb).ring.head - (rb).ring.tail))
+
+#define IC_RING_EMPTY(rb) ((rb).ring.head == (rb).ring.tail)
+
+#define IC_RING_FULL(rb) (IC_RING_COUNT(rb) >= IC_RING_SIZE(rb))
+
+/** i-th element counting from the oldest one */
+#define IC_RING_AT(rb, i) (rb).data[((rb).ring.tail + (i)) & IC_RING_MASK(rb)]
+
+/**
+ * Element at free running index, e.g. i-th after snapshot of tail. Unlike @ref IC_RING_AT it does
+ * not move when consumer releases elements.
+ */
+#define IC_RING_SLOT(rb, index) (rb).data[(uint8_t)(index) & IC_RING_MASK(rb)]
+
+/**
+ * Element at free running index is still in buffer (not released by consumer). Index has to be taken
+ * less than 256 - size releases ago, older indexes alias newer ones.
+ */
+#define IC_RING_LIVE(rb, index) ((uint8_t)((uint8_t)(index) - (rb).ring.tail) < IC_RING_COUNT(rb))
+
+/** Oldest element (consumer side) */
+#define IC_RING_FIRST(rb) IC_RING_AT(rb, 0)
+
+/** Newest element */
+#define IC_RING_LAST(rb) (rb).data[((rb).ring.head - 1) & IC_RING_MASK(rb)]
+
+/** Free slot to be filled before @ref ic_ring_commit (producer side) */
+#define IC_RING_NEXT(rb) (rb).data[(rb).ring.head & IC_RING_MASK(rb)]
+
+/**
+ * @brief Publish element written to @ref IC_RING_NEXT slot.
+ */
+static inline void ic_ring_commit(ic_ring_s *ring){
+  IC_RING_COMPILER_BARRIER();
+  ring->head = ring->head + 1;
+}
+
+/**
+ * @brief Release oldest element.
+ */
+static inline void ic_ring_release(ic_ring_s *ring){
+  IC_RING_COMPILER_BARRIER();
+  if(ring->head != ring->tail)
+    ring->tail = ring->tail + 1;
+}
+
+/**
+ * @brief Drop all elements. Consumer side.
+ */
+static inline void ic_ring_clean(ic_ring_s *ring){
+  ring->tail = ring->head;
+}
+
+/**
+ * @brief Push copy of element, single producer version.
+ *
+ * @param rb    Ring buffer.
+ * @param value Element.
+ * @param ok    bool variable, set to false when buffer was full.
+ */
+#define IC_RING_PUSH_SPSC(rb, value, ok)                                                          \
+  do{                                                                                             \
+    (ok) = !IC_RING_FULL(rb);                                                                     \
+    if(ok){                                                                                       \
+      IC_RING_NEXT(rb) = (value);                                                                 \
+      ic_ring_commit(&(rb).ring);                                                                 \
+    }                                                                                             \
+  }while(0)
+
+/**
+ * @brief Push copy of element, multiple producers version. Safe to call from IRQ.
+ *
+ * @param rb    Ring buffer.
+ * @param value Element.
+ * @param ok    bool variable, set to false when buffer was full.
+ */
+#define IC_RING_PUSH_MPSC(rb, value, ok)                                                          \
+  do{                                                                                             \
+    CRITICAL_REGION_ENTER();                                                                      \
+    IC_RING_PUSH_SPSC(rb, value, ok);                                                             \
+    CRITICAL_REGION_EXIT();                                                                       \
+  }while(0)
+
+/**
+ * @brief Pop oldest element.
+ *
+ * @param rb    Ring buffer.
+ * @param value Variable receiving element.
+ * @param ok    bool variable, set to false when buffer was empty.
+ */
+#define IC_RING_POP(rb, value, ok)                                                                \
+  do{                                                                                             \
+    (ok) = !IC_RING_EMPTY(rb);                                                                    \
+    if(ok){                                                                                       \
+      (value) = IC_RING_FIRST(rb);                                                                \
+      ic_ring_release(&(rb).ring);                                                                \
+    }                                                                                             \
+  }while(0)
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !IC_RING_BUFFER_H */
@@ -0,0 +1,508 @@
+/**
+ * @file    ic_scheduler.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Commands triggered at unix time
+ *
+ * Table of entries is shared by command task (scheduling, cancel) and timer task (due entries),
+ * it is changed in critical regions only. Entry refused by full command queue is put back at the
+ * front and retried after @ref IC_SCHEDULER_RETRY. FDS writes the table asynchronously from a copy,
+ * changes made during the write mark it dirty and are stored when the write completes.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "fds.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "SCHED"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_scheduler.h"
+#include "ic_command_task.h"
+#include "ic_ble_service.h"
+#include "ic_service_time.h"
+#include "ic_ring_buffer.h"
+
+#define SCHEDULER_VERSION 1
+#define SCHEDULER_HANDLES (CMD_LOCAL_ID_LAST - CMD_LOCAL_ID_FIRST + 1)
+#define SCHEDULER_WORDS   ((sizeof(scheduler_table_s) + 3) / 4)
+
+typedef struct __attribute__((packed)){
+  uint32_t time;                      /** Unix time */
+  uint8_t handle;                     /** Batch entry comes from */
+  uint8_t cmd;
+  u_BLECmdPayload payload;
+}scheduler_entry_s;
+
+/**
+ * @brief Schedule, also its image in flash. Sorted by time, entries of equal time in order they
+ * were added.
+ */
+typedef struct{
+  uint16_t version;
+  uint8_t count;
+  uint8_t next_handle;
+  scheduler_entry_s entries[IC_SCHEDULER_ENTRIES];
+}scheduler_table_s;
+
+typedef struct{
+  uint32_t time;                      /** Unix time of execution */
+  uint8_t handle;
+  uint8_t cmd;
+  uint8_t status;                     /** @ref cmd_status_t */
+}scheduler_report_s;
+
+_Static_assert(IC_SCHEDULER_ENTRIES < SCHEDULER_HANDLES, "Each batch needs free handle");
+_Static_assert(sizeof(ic_scheduler_status_s) <= CMD_RESPONSE_DATA_LEN, "Status has to fit frame");
+
+/** Filled by all contexts, sent by command task */
+static IC_RING_BUFFER(scheduler_report_s, IC_SCHEDULER_REPORTS) m_reports;
+
+/** Copy of schedule being written, FDS reads it until write is finished */
+static scheduler_table_s m_store __attribute__((aligned(4)));
+
+static struct{
+  bool loaded;                        /** Stored schedule was restored (or there was none) */
+  bool storing;                       /** m_store is being written */
+  bool dirty;                         /** Schedule changed since m_store was taken */
+  bool stored;                        /** Last write succeeded */
+  uint8_t lost_reports;
+  TimerHandle_t timer;
+  scheduler_table_s table;
+}m_sched;
+
+static inline uint32_t m_now(void){
+  return (uint32_t)ic_unix_timestamp_get().unix_timestamp;
+}
+
+static inline bool m_clock_set(uint32_t now){
+  return now >= IC_SCHEDULER_EPOCH;
+}
+
+/**
+ * @brief Called with interrupts disabled, caller checks there is room.
+ *
+ * @param first Put entry before entries of the same time (it was taken from the front).
+ */
+static void m_insert(const scheduler_entry_s *entry, bool first){
+  __auto_type _table = &m_sched.table;
+  int i = _table->count;
+
+  for(; i > 0; --i){
+    __auto_type _time = _table->entries[i - 1].time;
+    if(_time < entry->time || (!first && _time == entry->time))
+      break;
+    _table->entries[i] = _table->entries[i - 1];
+  }
+  _table->entries[i] = *entry;
+  ++_table->count;
+}
+
+static bool m_pop_due(uint32_t now, scheduler_entry_s *entry){
+  bool _due;
+
+  CRITICAL_REGION_ENTER();
+  __auto_type _table = &m_sched.table;
+  _due = _table->count != 0 && _table->entries[0].time <= now;
+  if(_due){
+    *entry = _table->entries[0];
+    --_table->count;
+    memmove(&_table->entries[0], &_table->entries[1], _table->count * sizeof(*entry));
+  }
+  CRITICAL_REGION_EXIT();
+
+  return _due;
+}
+
+/**
+ * @brief Called with interrupts disabled, there are more handles than entries.
+ */
+static uint8_t m_alloc_handle(void){
+  __auto_type _table = &m_sched.table;
+
+  for(;;){
+    __auto_type _handle = _table->next_handle;
+    _table->next_handle = (_handle + 1) % SCHEDULER_HANDLES;
+
+    __auto_type _used = false;
+    for(int i = 0; i < _table->count && !_used; ++i)
+      _used = _table->entries[i].handle == _handle;
+    if(!_used)
+      return _handle;
+  }
+}
+
+/**
+ * @brief Arm timer to the nearest entry. Timer task calls it with block_time 0.
+ */
+static void m_arm(TickType_t block_time){
+  bool _pending;
+  uint32_t _next = 0;
+
+  CRITICAL_REGION_ENTER();
+  _pending = m_sched.table.count != 0;
+  if(_pending)
+    _next = m_sched.table.entries[0].time;
+  CRITICAL_REGION_EXIT();
+
+  __auto_type _now = m_now();
+  if(!_pending || !m_clock_set(_now)){
+    xTimerStop(m_sched.timer, block_time);
+    return;
+  }
+
+  TickType_t _ticks = 1;
+  if(_next > _now){
+    __auto_type _seconds = _next - _now;
+    _ticks = _seconds > IC_SCHEDULER_MAX_SLEEP / configTICK_RATE_HZ ?
+      IC_SCHEDULER_MAX_SLEEP :
+      _seconds * configTICK_RATE_HZ;
+  }
+
+  if(xTimerChangePeriod(m_sched.timer, _ticks, block_time) != pdPASS)
+    NRF_LOG_ERROR("Timer not armed\n");
+}
+
+static void m_persist(void){
+  bool _start;
+
+  CRITICAL_REGION_ENTER();
+  _start = m_sched.loaded && !m_sched.storing;
+  if(_start){
+    m_store = m_sched.table;
+    m_sched.storing = true;
+    m_sched.dirty = false;
+  }
+  else{
+    m_sched.dirty = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(!_start)
+    return;
+
+  fds_record_chunk_t _chunk = {.p_data = &m_store, .length_words = SCHEDULER_WORDS};
+  fds_record_t _record = {
+    .file_id  = IC_SCHEDULER_FDS_FILE,
+    .key      = IC_SCHEDULER_FDS_KEY,
+    .data     = {.p_chunks = &_chunk, .num_chunks = 1}
+  };
+  fds_record_desc_t _desc;
+  fds_find_token_t _token = {0};
+
+  __auto_type _err = fds_record_find(IC_SCHEDULER_FDS_FILE, IC_SCHEDULER_FDS_KEY, &_desc, &_token)
+    == FDS_SUCCESS ?
+    fds_record_update(&_desc, &_record) :
+    fds_record_write(NULL, &_record);
+
+  if(_err == FDS_SUCCESS)
+    return;
+
+  /* Repeated after garbage collection or next change */
+  if(_err == FDS_ERR_NO_SPACE_IN_FLASH)
+    (void)fds_gc();
+  else
+    NRF_LOG_ERROR("Schedule not stored: %d\n", _err);
+
+  CRITICAL_REGION_ENTER();
+  m_sched.storing = false;
+  m_sched.dirty = true;
+  CRITICAL_REGION_EXIT();
+}
+
+static void m_load(void){
+  if(m_sched.loaded)
+    return;
+
+  fds_record_desc_t _desc;
+  fds_find_token_t _token = {0};
+  fds_flash_record_t _record;
+
+  __auto_type _err = fds_record_find(IC_SCHEDULER_FDS_FILE, IC_SCHEDULER_FDS_KEY, &_desc, &_token);
+
+  /* Called again with FDS_EVT_INIT */
+  if(_err == FDS_ERR_NOT_INITIALIZED)
+    return;
+
+  if(_err == FDS_SUCCESS && fds_record_open(&_desc, &_record) == FDS_SUCCESS){
+    const scheduler_table_s *_stored = _record.p_data;
+
+    if(_record.p_header->tl.length_words == SCHEDULER_WORDS
+        && _stored->version == SCHEDULER_VERSION
+        && _stored->count <= IC_SCHEDULER_ENTRIES){
+      CRITICAL_REGION_ENTER();
+      m_sched.table = *_stored;
+      CRITICAL_REGION_EXIT();
+      m_sched.stored = true;
+    }
+    (void)fds_record_close(&_desc);
+  }
+
+  m_sched.loaded = true;
+  NRF_LOG_INFO("%d entries restored\n", m_sched.table.count);
+
+  m_arm(OSTIMER_WAIT_FOR_QUEUE);
+}
+
+/**
+ * @brief Send kept reports while central is subscribed. Runs on command task only, sending waits
+ * for TX buffer.
+ */
+static void m_flush_reports(void){
+  while(ble_iccs_response_ready()){
+    scheduler_report_s _report;
+    bool _ok;
+
+    CRITICAL_REGION_ENTER();
+    _ok = !IC_RING_EMPTY(m_reports);
+    if(_ok)
+      _report = IC_RING_FIRST(m_reports);
+    CRITICAL_REGION_EXIT();
+
+    if(!_ok)
+      break;
+
+    cmd_request_t _request = {
+      .id     = CMD_LOCAL_ID_FIRST + _report.handle,
+      .cmd    = _report.cmd,
+      .tagged = true
+    };
+    if(cmd_respond(_request, _report.status, &_report.time, sizeof(_report.time)) != IC_SUCCESS)
+      break;
+
+    CRITICAL_REGION_ENTER();
+    ic_ring_release(&m_reports.ring);
+    CRITICAL_REGION_EXIT();
+  }
+}
+
+static void m_report(uint8_t handle, uint8_t cmd, cmd_status_t status, uint32_t time){
+  scheduler_report_s _report = {.time = time, .handle = handle, .cmd = cmd, .status = status};
+  bool _ok;
+
+  IC_RING_PUSH_MPSC(m_reports, _report, _ok);
+  if(!_ok){
+    CRITICAL_REGION_ENTER();
+    if(m_sched.lost_reports < UINT8_MAX)
+      ++m_sched.lost_reports;
+    CRITICAL_REGION_EXIT();
+  }
+
+  /* Timer callback reports too, it must not wait for TX buffer */
+  (void)cmd_pend(m_flush_reports);
+}
+
+/**
+ * @brief Responses of submitted entries.
+ */
+static void m_on_response(cmd_request_t request, cmd_status_t status){
+  m_report(request.id - CMD_LOCAL_ID_FIRST, request.cmd, status, m_now());
+}
+
+static void m_timer_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+
+  __auto_type _now = m_now();
+  __auto_type _changed = false;
+  __auto_type _busy = false;
+  scheduler_entry_s _entry;
+
+  while(m_clock_set(_now) && m_pop_due(_now, &_entry)){
+    if(_now - _entry.time > IC_SCHEDULER_GRACE){
+      NRF_LOG_WARNING("Entry %d expired\n", _entry.handle);
+      m_report(_entry.handle, _entry.cmd, CMD_STATUS_EXPIRED, _now);
+    }
+    else if(cmd_submit(CMD_LOCAL_ID_FIRST + _entry.handle, _entry.cmd, &_entry.payload) == IC_BUSY){
+      CRITICAL_REGION_ENTER();
+      m_insert(&_entry, true);
+      CRITICAL_REGION_EXIT();
+      _busy = true;
+      break;
+    }
+    _changed = true;
+  }
+
+  if(_changed)
+    m_persist();
+
+  if(_busy)
+    xTimerChangePeriod(m_sched.timer, IC_SCHEDULER_RETRY, 0);
+  else
+    m_arm(0);
+}
+
+static void m_fds_evt_handler(fds_evt_t const * const p_evt){
+  switch(p_evt->id){
+    case FDS_EVT_INIT:
+      if(p_evt->result == FDS_SUCCESS)
+        m_load();
+      break;
+    case FDS_EVT_WRITE:
+    case FDS_EVT_UPDATE:
+      if(p_evt->write.file_id != IC_SCHEDULER_FDS_FILE)
+        break;
+      m_sched.stored = p_evt->result == FDS_SUCCESS;
+      m_sched.storing = false;
+      if(m_sched.dirty)
+        m_persist();
+      break;
+    case FDS_EVT_GC:
+      if(m_sched.dirty && !m_sched.storing)
+        m_persist();
+      break;
+    default:
+      break;
+  }
+}
+
+static ic_return_val_e m_scheduler_cmd(u_BLECmdPayload payload, void *ctx){
+  UNUSED_PARAMETER(ctx);
+
+  switch(payload.data[0]){
+    case IC_SCHEDULER_OP_TIME:
+      ic_unix_timestamp_set(
+          payload.data[1]
+          | payload.data[2] << 8
+          | payload.data[3] << 16
+          | (uint32_t)payload.data[4] << 24);
+      m_arm(OSTIMER_WAIT_FOR_QUEUE);
+      return IC_SUCCESS;
+    case IC_SCHEDULER_OP_CANCEL:
+      return ic_scheduler_cancel(payload.data[1]);
+    case IC_SCHEDULER_OP_STATUS:
+      {
+        __auto_type _status = ic_scheduler_get_status();
+        cmd_respond(cmd_defer(), CMD_STATUS_OK, &_status, sizeof(_status));
+      }
+      return IC_SUCCESS;
+    case IC_SCHEDULER_OP_REPORT:
+      m_flush_reports();
+      return IC_SUCCESS;
+    default:
+      return IC_ERROR;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_scheduler_init(void){
+  if(m_sched.timer == NULL){
+    m_sched.timer = xTimerCreate("SCHED", 1, pdFALSE, NULL, m_timer_callback);
+    if(m_sched.timer == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+
+    m_sched.table.version = SCHEDULER_VERSION;
+    ic_ring_clean(&m_reports.ring);
+
+    __auto_type _err = fds_register(m_fds_evt_handler);
+    if(_err != FDS_SUCCESS)
+      APP_ERROR_HANDLER(_err);
+  }
+
+  cmd_connect_local(m_on_response);
+  cmd_register(CMD_SCHEDULER, m_scheduler_cmd, NULL);
+
+  m_load();
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_scheduler_add(
+    uint32_t time,
+    const u_cmdFrameContainer *frames,
+    uint8_t count,
+    ic_scheduler_handle_s *handle)
+{
+  if(frames == NULL || handle == NULL || count == 0)
+    return IC_ERROR;
+
+  if(!m_sched.loaded)
+    return IC_BUSY;
+
+  __auto_type _now = m_now();
+  if(m_clock_set(_now) && time < _now && _now - time > IC_SCHEDULER_GRACE)
+    return IC_ERROR;
+
+  __auto_type _ret_val = IC_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  if(m_sched.table.count + count > IC_SCHEDULER_ENTRIES){
+    _ret_val = IC_BUSY;
+  }
+  else{
+    handle->handle = m_alloc_handle();
+    for(int i = 0; i < count; ++i){
+      scheduler_entry_s _entry = {
+        .time     = time,
+        .handle   = handle->handle,
+        .cmd      = frames[i].frame.cmd,
+        .payload  = frames[i].frame.payload
+      };
+      m_insert(&_entry, false);
+    }
+    handle->free = IC_SCHEDULER_ENTRIES - m_sched.table.count;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
+
+  NRF_LOG_INFO("Batch %d: %d commands at %d\n", handle->handle, count, time);
+
+  m_persist();
+  m_arm(OSTIMER_WAIT_FOR_QUEUE);
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_scheduler_cancel(uint8_t handle){
+  int _removed = 0;
+
+  CRITICAL_REGION_ENTER();
+  __auto_type _table = &m_sched.table;
+  int j = 0;
+  for(int i = 0; i < _table->count; ++i){
+    if(handle == IC_SCHEDULER_ALL || _table->entries[i].handle == handle)
+      ++_removed;
+    else
+      _table->entries[j++] = _table->entries[i];
+  }
+  _table->count = j;
+  CRITICAL_REGION_EXIT();
+
+  if(_removed == 0)
+    return handle == IC_SCHEDULER_ALL ? IC_SUCCESS : IC_ERROR;
+
+  m_persist();
+  m_arm(OSTIMER_WAIT_FOR_QUEUE);
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_scheduler_status_s ic_scheduler_get_status(void){
+  __auto_type _now = m_now();
+  ic_scheduler_status_s _status;
+
+  CRITICAL_REGION_ENTER();
+  _status = (ic_scheduler_status_s){
+    .now          = m_clock_set(_now) ? _now : 0,
+    .next         = m_sched.table.count != 0 ? m_sched.table.entries[0].time : 0,
+    .entries      = m_sched.table.count,
+    .reports      = IC_RING_COUNT(m_reports),
+    .lost_reports = m_sched.lost_reports,
+    .stored       = m_sched.stored && !m_sched.dirty && !m_sched.storing
+  };
+  CRITICAL_REGION_EXIT();
+
+  return _status;
+}
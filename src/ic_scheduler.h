@@ -0,0 +1,97 @@
+/**
+ * @file    ic_scheduler.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Commands triggered at unix time
+ *
+ * Commands are scheduled as batch with unix time (@ref ic_command_task.h), so alarm or light
+ * therapy runs without central being connected. Entries are kept sorted by time and one timer is
+ * armed to the nearest one (at most @ref IC_SCHEDULER_MAX_SLEEP ahead, so clock changes are
+ * followed). Due entries are submitted to command task with local request ID CMD_LOCAL_ID_FIRST +
+ * handle, entry later than @ref IC_SCHEDULER_GRACE (device was off, clock was not set) expires.
+ *
+ * Schedule is stored in internal flash (FDS) and restored after reboot. Entries wait until clock is
+ * set.
+ *
+ * Outcome of each command is reported on response characteristic:
+ *                [CMD_LOCAL_ID_FIRST + handle][cmd][status][unix time:32]
+ * When central is not subscribed reports are kept (first @ref IC_SCHEDULER_REPORTS) until it asks
+ * for them.
+ *
+ * CMD_SCHEDULER payload[0] selects operation:
+ *  - TIME    - [unix time:32] set clock,
+ *  - CANCEL  - [handle:8] remove entries of batch, IC_SCHEDULER_ALL removes all of them,
+ *  - STATUS  - response carries @ref ic_scheduler_status_s,
+ *  - REPORT  - send kept reports.
+ *
+ * Multi-byte values are little endian.
+ */
+
+#ifndef IC_SCHEDULER_H
+#define IC_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ic_frame_handle.h"
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_SCHEDULER
+ *  @{
+ */
+
+#define IC_SCHEDULER_ALL  0xFF
+
+typedef enum{
+  IC_SCHEDULER_OP_TIME = 0x00,
+  IC_SCHEDULER_OP_CANCEL,
+  IC_SCHEDULER_OP_STATUS,
+  IC_SCHEDULER_OP_REPORT
+}ic_scheduler_op_e;
+
+/**
+ * @brief Response of scheduled batch.
+ */
+typedef struct __attribute__((packed)){
+  uint8_t handle;                     /** Reports come with CMD_LOCAL_ID_FIRST + handle */
+  uint8_t free;                       /** Entries left */
+}ic_scheduler_handle_s;
+
+typedef struct __attribute__((packed)){
+  uint32_t now;                       /** Unix time, 0 - clock not set */
+  uint32_t next;                      /** Time of the nearest entry, 0 - nothing scheduled */
+  uint8_t entries;
+  uint8_t reports;                    /** Reports waiting for central */
+  uint8_t lost_reports;               /** Reports dropped because there was no room */
+  uint8_t stored;                     /** Schedule in flash is up to date */
+}ic_scheduler_status_s;
+
+/**
+ * @brief Create timer, register CMD_SCHEDULER and restore stored schedule. Call after command
+ * task and Peer Manager (which initializes FDS) were initialized.
+ */
+ic_return_val_e ic_scheduler_init(void);
+
+/**
+ * @brief Schedule commands of batch, they are executed one after another at given time.
+ *
+ * @return IC_SUCCESS, IC_BUSY when there is no room or stored schedule was not restored yet,
+ * IC_ERROR when time already expired.
+ */
+ic_return_val_e ic_scheduler_add(
+    uint32_t time,
+    const u_cmdFrameContainer *frames,
+    uint8_t count,
+    ic_scheduler_handle_s *handle);
+
+/**
+ * @return IC_SUCCESS or IC_ERROR when there is no such batch.
+ */
+ic_return_val_e ic_scheduler_cancel(uint8_t handle);
+
+ic_scheduler_status_s ic_scheduler_get_status(void);
+
+/** @} */
+
+#endif /* !IC_SCHEDULER_H */
@@ -23,6 +23,10 @@
 #include "ic_frame_handle.h"
 
 #include "ic_service_ads.h"
+#include "ic_service_recorder.h"
+#include "ic_service_mux.h"
+#include "ic_stream_policy.h"
+#include "ic_smart_wake.h"
 #include "ic_driver_ads.h"
 
 #include "ic_nrf_error.h"
@@ -35,6 +39,10 @@ u_eegDataFrameContainter m_eeg_packet;
 
 static TaskHandle_t send_data_task_handle = NULL;
 
+/** Two frames averaged into one when stream policy compresses EEG */
+static u_eegDataFrameContainter m_compressed_packet;
+static bool m_compressed_half = false;
+
 ALLOCK_SEMAPHORE(m_twi_ready);
 
 static inline bool add_eeg(int16_t eeg){
@@ -60,7 +68,7 @@ void read_callback(int16_t eeg){
 static void on_stream_state_change(bool active){
   __auto_type _timer_ret_val = pdFAIL;
   if(active)  START_TIMER (m_ads_service_timer_handle, 0, _timer_ret_val);
-  else{
+  else if(!ic_recorder_active() && !ic_mux_active() && !ic_smart_wake_sampling()){
     vTaskSuspend(send_data_task_handle);
     STOP_TIMER  (m_ads_service_timer_handle, 0, _timer_ret_val);
     m_measurement_cnt = 0;
@@ -68,6 +76,18 @@ static void on_stream_state_change(bool active){
   UNUSED_PARAMETER(_timer_ret_val);
 }
 
+static void on_record_state_change(bool active){
+  on_stream_state_change(active || ble_iccs_stream0_ready());
+}
+
+static void on_mux_state_change(bool active){
+  on_stream_state_change(active || ble_iccs_stream0_ready());
+}
+
+static void on_smart_wake_state_change(bool active){
+  on_stream_state_change(active || ble_iccs_stream0_ready());
+}
+
 static void ads_timer_callback(TimerHandle_t xTimer){
   UNUSED_PARAMETER(xTimer);
 
@@ -95,26 +115,71 @@ static void ads_timer_callback(TimerHandle_t xTimer){
   }
 }
 
+#define EEG_SAMPLES (sizeof(m_eeg_packet.frame.eeg_data)/sizeof(m_eeg_packet.frame.eeg_data[0]))
+
+_Static_assert(EEG_SAMPLES % 2 == 0, "Compression averages pairs of samples");
+
+/**
+ * @brief Frame to send, NULL when compressed frame is not complete yet.
+ */
+static u_eegDataFrameContainter *m_next_frame(void){
+  if(ic_stream_policy_level() < IC_STREAM_POLICY_EEG_COMPRESSED){
+    m_compressed_half = false;
+    return &m_eeg_packet;
+  }
+
+  const size_t _offset = m_compressed_half ? EEG_SAMPLES/2 : 0;
+  if(!m_compressed_half)
+    m_compressed_packet.frame.time_stamp = m_eeg_packet.frame.time_stamp;
+
+  for(size_t i = 0; i < EEG_SAMPLES/2; ++i)
+    m_compressed_packet.frame.eeg_data[_offset + i] =
+      (m_eeg_packet.frame.eeg_data[2*i] + m_eeg_packet.frame.eeg_data[2*i + 1]) / 2;
+
+  m_compressed_half = !m_compressed_half;
+  return m_compressed_half ? NULL : &m_compressed_packet;
+}
+
 static void send_data_task(void *arg){
   uint32_t _nrf_error;
   for(;;){
-    __auto_type _err = ble_iccs_send_to_stream0(
-        m_eeg_packet.raw_data,
-        sizeof(u_eegDataFrameContainter),
-        &_nrf_error);
-
-
-    switch(_err){
-      case IC_SUCCESS:
-        break;
-      case IC_BLE_NOT_CONNECTED:
-        break;
-      case IC_BUSY:
-        vTaskDelay(1);
-        continue;
-      default:
-        /*NRF_LOG_INFO("err: %s\n", (uint32_t)ic_get_nrferr2str(_nrf_error));*/
-        break;
+    ic_smart_wake_eeg(&m_eeg_packet);
+    __auto_type _frame = m_next_frame();
+
+    for(int _retry = 0; _frame != NULL; ++_retry){
+      __auto_type _err = ic_mux_active() ?
+        ic_mux_append(
+            IC_MUX_EEG,
+            _frame->frame.time_stamp,
+            _frame->frame.eeg_data,
+            sizeof(_frame->frame.eeg_data)) :
+        ble_iccs_send_to_stream0(
+            _frame->raw_data,
+            sizeof(u_eegDataFrameContainter),
+            &_nrf_error);
+
+      switch(_err){
+        case IC_SUCCESS:
+          break;
+        case IC_BLE_NOT_CONNECTED:
+          ic_recorder_append(
+              IC_RECORDER_EEG,
+              _frame->raw_data,
+              sizeof(u_eegDataFrameContainter));
+          break;
+        case IC_BUSY:
+          ic_stream_policy_refused();
+          if(_retry < IC_STREAM_POLICY_MAX_RETRY){
+            vTaskDelay(1);
+            continue;
+          }
+          ic_stream_policy_drop();
+          break;
+        default:
+          /*NRF_LOG_INFO("err: %s\n", (uint32_t)ic_get_nrferr2str(_nrf_error));*/
+          break;
+      }
+      break;
     }
     vTaskSuspend(NULL);
     taskYIELD();
@@ -145,6 +210,9 @@ ic_return_val_e ic_ads_service_init(void){
     }
 
   ble_iccs_connect_to_stream0(on_stream_state_change);
+  ic_recorder_connect(on_record_state_change);
+  ic_mux_connect(on_mux_state_change);
+  ic_smart_wake_connect(on_smart_wake_state_change);
 
   vTaskSuspend(send_data_task_handle);
 
@@ -0,0 +1,353 @@
+/**
+ * @file    ic_service_bulk.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Bulk download of external flash over BLE
+ *
+ * Window buffer holds IC_BULK_WINDOW packets. Packets from the last acknowledged one are read ahead
+ * from flash asynchronously, sent as long as SoftDevice accepts notifications and kept until they
+ * are acknowledged, so they can be retransmitted. Module has no task, @ref m_work runs on recorder
+ * task (@ref ic_recorder_attach) and owns all state, requests from BLE are passed through a ring
+ * buffer.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "app_error.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "BULK"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_service_bulk.h"
+#include "ic_service_recorder.h"
+#include "ic_driver_flash.h"
+#include "ic_ble_service.h"
+#include "ic_ring_buffer.h"
+
+_Static_assert(IC_BULK_WINDOW <= IC_BULK_SEQ_MASK/2, "Bulk window too big for sequence numbers");
+
+typedef struct{
+  uint8_t data[IC_BULK_PACKET_SIZE];
+  uint8_t len;
+}bulk_request_s;
+
+/** Filled by BLE task (SPSC) */
+static IC_RING_BUFFER(bulk_request_s, 4) m_requests;
+
+static uint8_t m_window[IC_BULK_WINDOW][IC_BULK_PAYLOAD];
+
+static struct{
+  bool initialized;
+  bool active;
+  uint32_t offset;                    /** Flash address of packet 0 */
+  uint32_t length;
+  uint32_t packets;
+  uint32_t acked;                     /** Packets below are acknowledged */
+  uint32_t sent;                      /** Next new packet */
+  uint32_t loaded;                    /** Packets below are in window buffer */
+  uint32_t resend;                    /** Retransmission range [resend, resend_end) */
+  uint32_t resend_end;
+  uint32_t reading;                   /** Packets being read from flash */
+  ic_return_val_e volatile read_result;
+  bool volatile read_done;
+  uint8_t control[IC_BULK_PACKET_SIZE];
+  uint8_t control_len;                /** Control notification waiting for buffer */
+}m_bulk;
+
+static inline uint16_t m_get16(const uint8_t *data){
+  return data[0] | data[1] << 8;
+}
+
+static inline uint32_t m_get32(const uint8_t *data){
+  return m_get16(data) | (uint32_t)m_get16(data + 2) << 16;
+}
+
+static inline void m_put16(uint8_t *data, uint16_t value){
+  data[0] = (uint8_t)value;
+  data[1] = (uint8_t)(value >> 8);
+}
+
+static inline void m_put32(uint8_t *data, uint32_t value){
+  m_put16(data, (uint16_t)value);
+  m_put16(data + 2, (uint16_t)(value >> 16));
+}
+
+/**
+ * @brief Packet number of sequence number from window.
+ */
+static inline uint32_t m_index(uint16_t seq){
+  return m_bulk.acked + ((seq - m_bulk.acked) & IC_BULK_SEQ_MASK);
+}
+
+static void m_control(ic_bulk_op_e op, const uint8_t *args, size_t len){
+  m_put16(m_bulk.control, IC_BULK_CONTROL_FLAG | op);
+  memcpy(&m_bulk.control[2], args, len);
+  m_bulk.control_len = 2 + len;
+}
+
+static void m_abort(ic_return_val_e reason){
+  uint8_t _reason = reason;
+
+  NRF_LOG_ERROR("aborted: %s\n", (uint32_t)g_return_val_string[reason]);
+  m_bulk.active = false;
+  m_control(IC_BULK_ERROR, &_reason, 1);
+}
+
+static void m_read_callback(ic_return_val_e result, void *context){
+  UNUSED_PARAMETER(context);
+
+  m_bulk.read_result = result;
+  m_bulk.read_done = true;
+  ic_recorder_wake();
+}
+
+static void m_read_ahead(void){
+  if(m_bulk.reading != 0)
+    return;
+
+  __auto_type _limit = MIN(m_bulk.acked + IC_BULK_WINDOW, m_bulk.packets);
+  if(m_bulk.loaded >= _limit)
+    return;
+
+  /* Do not cross end of window buffer */
+  __auto_type _slot = m_bulk.loaded % IC_BULK_WINDOW;
+  __auto_type _count = MIN(_limit - m_bulk.loaded, IC_BULK_WINDOW - _slot);
+  __auto_type _start = m_bulk.loaded * IC_BULK_PAYLOAD;
+  __auto_type _len = MIN(_count * IC_BULK_PAYLOAD, m_bulk.length - _start);
+
+  __auto_type _ret_val = ic_flash_read(
+      m_bulk.offset + _start,
+      m_window[_slot],
+      _len,
+      m_read_callback,
+      NULL);
+
+  if(_ret_val == IC_SUCCESS)
+    m_bulk.reading = _count;
+  else if(_ret_val != IC_BUSY)      // Busy flash is retried on next call
+    m_abort(_ret_val);
+}
+
+static ic_return_val_e m_send_packet(uint32_t index){
+  uint8_t _packet[IC_BULK_PACKET_SIZE];
+  __auto_type _len = MIN(IC_BULK_PAYLOAD, m_bulk.length - index * IC_BULK_PAYLOAD);
+
+  m_put16(_packet, index & IC_BULK_SEQ_MASK);
+  memcpy(&_packet[2], m_window[index % IC_BULK_WINDOW], _len);
+
+  return ble_iccs_send_to_bulk(_packet, 2 + _len, NULL);
+}
+
+/**
+ * @brief Send notifications until SoftDevice buffers are full.
+ */
+static void m_pump(void){
+  if(m_bulk.control_len != 0){
+    if(ble_iccs_send_to_bulk(m_bulk.control, m_bulk.control_len, NULL) == IC_BUSY)
+      return;
+    m_bulk.control_len = 0;
+  }
+
+  while(m_bulk.active){
+    uint32_t *_next;
+
+    if(m_bulk.resend < m_bulk.resend_end)
+      _next = &m_bulk.resend;
+    else if(m_bulk.sent < m_bulk.loaded)
+      _next = &m_bulk.sent;
+    else
+      break;
+
+    switch(m_send_packet(*_next)){
+      case IC_SUCCESS:
+        ++*_next;
+        break;
+      case IC_BUSY:
+        return;
+      default:
+        m_abort(IC_BLE_NOT_CONNECTED);
+        return;
+    }
+  }
+}
+
+static void m_start(const uint8_t *args){
+  __auto_type _offset = m_get32(args);
+  __auto_type _length = m_get32(args + 4);
+
+  if(_length == 0 || _offset >= ic_flash_size() || _length > ic_flash_size() - _offset){
+    m_abort(IC_ERROR);
+    return;
+  }
+
+  m_bulk.offset = _offset;
+  m_bulk.length = _length;
+  m_bulk.packets = (_length + IC_BULK_PAYLOAD - 1) / IC_BULK_PAYLOAD;
+  m_bulk.acked = m_bulk.sent = m_bulk.loaded = 0;
+  m_bulk.resend = m_bulk.resend_end = 0;
+  m_bulk.active = true;
+
+  NRF_LOG_INFO("download 0x%06X +%d\n", _offset, _length);
+}
+
+static void m_ack(uint16_t seq){
+  __auto_type _index = m_index(seq);
+  if(_index >= m_bulk.sent)
+    return;
+
+  m_bulk.acked = _index + 1;
+  if(m_bulk.resend < m_bulk.acked)
+    m_bulk.resend = MIN(m_bulk.acked, m_bulk.resend_end);
+
+  if(m_bulk.acked == m_bulk.packets){
+    m_bulk.active = false;
+    m_control(IC_BULK_DONE, NULL, 0);
+  }
+}
+
+static void m_nack(uint16_t seq, uint8_t count){
+  __auto_type _index = m_index(seq);
+  if(_index >= m_bulk.sent)
+    return;
+
+  m_bulk.resend = _index;
+  m_bulk.resend_end = MIN(_index + count, m_bulk.sent);
+}
+
+static void m_info(void){
+  uint8_t _args[10];
+  __auto_type _stats = ic_recorder_get_stats();
+
+  m_put32(&_args[0], ic_flash_size());
+  m_put32(&_args[4], _stats.head);
+  m_put16(&_args[8], _stats.session);
+  m_control(IC_BULK_INFO, _args, sizeof(_args));
+}
+
+static void m_seek(const uint8_t *args){
+  uint8_t _response[5];
+  uint32_t _address = 0;
+
+  _response[0] = ic_recorder_seek(m_get16(args), m_get32(args + 2), &_address);
+  m_put32(&_response[1], _address);
+  m_control(IC_BULK_SEEK, _response, sizeof(_response));
+}
+
+/**
+ * @brief Apply requests. Returns false when request has to wait (flash read in progress).
+ */
+static bool m_handle_request(const bulk_request_s *request){
+  if(request->len < 1)
+    return true;
+
+  switch(request->data[0]){
+    case IC_BULK_INFO:
+      m_info();
+      break;
+    case IC_BULK_START:
+      if(m_bulk.reading != 0)
+        return false;
+      if(request->len >= 9)
+        m_start(&request->data[1]);
+      break;
+    case IC_BULK_ACK:
+      if(m_bulk.active && request->len >= 3)
+        m_ack(m_get16(&request->data[1]));
+      break;
+    case IC_BULK_NACK:
+      if(m_bulk.active && request->len >= 4)
+        m_nack(m_get16(&request->data[1]), request->data[3]);
+      break;
+    case IC_BULK_STOP:
+      m_bulk.active = false;
+      break;
+    case IC_BULK_SEEK:
+      if(request->len >= 7)
+        m_seek(&request->data[1]);
+      break;
+    default:
+      break;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Runs on recorder task. Returns ticks to the next call.
+ */
+static TickType_t m_work(void){
+  if(m_bulk.read_done){
+    m_bulk.read_done = false;
+    if(m_bulk.read_result != IC_SUCCESS)
+      m_abort(m_bulk.read_result);
+    else if(m_bulk.active)
+      m_bulk.loaded += m_bulk.reading;
+    m_bulk.reading = 0;
+  }
+
+  while(!IC_RING_EMPTY(m_requests) && m_handle_request(&IC_RING_FIRST(m_requests)))
+    ic_ring_release(&m_requests.ring);
+
+  if(m_bulk.active)
+    m_read_ahead();
+
+  m_pump();
+
+  /* Poll while flash is busy with recorder */
+  return m_bulk.active ? 1 : portMAX_DELAY;
+}
+
+static void on_bulk_write(uint8_t *data, size_t len){
+  __auto_type _ok = true;
+  bulk_request_s _request = {.len = MIN(len, IC_BULK_PACKET_SIZE)};
+
+  memcpy(_request.data, data, _request.len);
+  IC_RING_PUSH_SPSC(m_requests, _request, _ok);
+  if(!_ok)
+    NRF_LOG_ERROR("request dropped\n");
+
+  ic_recorder_wake();
+}
+
+static void on_bulk_state_change(bool active){
+  if(!active){
+    uint8_t _stop = IC_BULK_STOP;
+    on_bulk_write(&_stop, 1);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_service_bulk_init(void){
+  if(m_bulk.initialized)
+    return IC_SUCCESS;
+
+  if(ic_flash_size() == 0)
+    return IC_NOT_INIALIZED;
+
+  ic_ring_clean(&m_requests.ring);
+
+  __auto_type _ret_val = ic_recorder_attach(m_work);
+  if(_ret_val != IC_SUCCESS)
+    return _ret_val;
+
+  ble_iccs_connect_to_bulk(on_bulk_state_change, on_bulk_write);
+
+  m_bulk.initialized = true;
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_bulk_on_ble_evt(ble_evt_t *p_ble_evt){
+  switch(p_ble_evt->header.evt_id){
+    case BLE_EVT_TX_COMPLETE:
+      ic_recorder_wake();
+      break;
+    default:
+      break;
+  }
+}
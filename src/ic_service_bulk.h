@@ -0,0 +1,73 @@
+/**
+ * @file    ic_service_bulk.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Bulk download of external flash over BLE
+ *
+ * Protocol on bulk characteristic. Host writes requests, device answers with notifications.
+ *
+ * Data notification:     [seq:16][data:up to IC_BULK_PAYLOAD]
+ *  seq is 15 bit packet number, packet n carries bytes [offset + n*IC_BULK_PAYLOAD, ...) of the
+ *  requested range. Device keeps at most IC_BULK_WINDOW packets not acknowledged.
+ *
+ * Control notification:  [0x8000 | ic_bulk_op_e:16][arguments]
+ *
+ * Requests (little endian):
+ *  - IC_BULK_INFO                                  -> INFO [flash size:32][log head:32][session:16]
+ *  - IC_BULK_START [offset:32][length:32]          start (or resume from offset) download
+ *  - IC_BULK_ACK   [seq:16]                        all packets up to seq were received
+ *  - IC_BULK_NACK  [seq:16][count:8]               retransmit count packets starting from seq
+ *  - IC_BULK_STOP                                  abort download
+ *  - IC_BULK_SEEK  [session:16][time:32]           -> SEEK [ic_return_val_e:8][address:32]
+ *                                                  flash address of session data at unix time,
+ *                                                  start of 64kB block holding it (see
+ *                                                  @ref ic_recorder_seek)
+ *
+ * Device sends DONE when whole range was acknowledged and ERROR [ic_return_val_e:8] when download
+ * was aborted. Recorder index (see @ref ic_service_recorder.h) can be downloaded from address 0.
+ */
+
+#ifndef IC_SERVICE_BULK_H
+#define IC_SERVICE_BULK_H
+
+#include <stdint.h>
+
+#include "ble.h"
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_BULK
+ *  @{
+ */
+
+#define IC_BULK_PACKET_SIZE     20
+#define IC_BULK_PAYLOAD         (IC_BULK_PACKET_SIZE - sizeof(uint16_t))
+#define IC_BULK_SEQ_MASK        0x7FFF
+#define IC_BULK_CONTROL_FLAG    0x8000
+
+typedef enum{
+  IC_BULK_INFO = 0x01,
+  IC_BULK_START,
+  IC_BULK_ACK,
+  IC_BULK_NACK,
+  IC_BULK_STOP,
+  IC_BULK_DONE,
+  IC_BULK_ERROR,
+  IC_BULK_SEEK
+}ic_bulk_op_e;
+
+/**
+ * @brief Attach to recorder task and connect to bulk characteristic. Requires initialized
+ * recorder, download runs on its task.
+ */
+ic_return_val_e ic_service_bulk_init(void);
+
+/**
+ * @brief Resumes download when SoftDevice released notification buffers.
+ */
+void ic_bulk_on_ble_evt(ble_evt_t *p_ble_evt);
+
+/** @} */
+
+#endif /* !IC_SERVICE_BULK_H */
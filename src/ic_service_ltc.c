@@ -16,6 +16,8 @@
 #include "ic_config.h"
 #include "ic_service_ltc.h"
 #include "ic_driver_actuators.h"
+#include "ic_ltc_pattern.h"
+#include "ic_ltc_budget.h"
 
 #include "ic_command_task.h"
 #include "ic_frame_handle.h"
@@ -27,14 +29,22 @@
 #include "nrf_gpio.h"
 
 #define QUANTUM_OF_TIME 16
+#define PERIOD_STEPS    128   /** Waveforms are functions of step in period */
+#define Q16_ONE         65536
 
 static volatile uint32_t m_active_function_counter = 0;
 
-const float m_beta_factor = 1.0/IC_LTC_MAX_VAL;
-const float m_beta_factor_vib0 = 1.0/IC_LTC_VIB_MAX_VAL;
-const float m_beta_factor_vib1 = IC_LTC_VIB_MAX_VAL/63.0;
+/**
+ * Time advances in quanta. Task sleeps until the nearest quantum at which output of any device may
+ * change, devices are then advanced by all quanta they skipped (outputs of skipped quanta are the
+ * same, nothing has to be written).
+ */
+static uint32_t m_quantum = 0;        /** Last processed quantum */
+static TickType_t m_quantum_tick = 0; /** Tick m_quantum was due at */
+
+/** Limit of power budget outputs are written with */
+static ic_ltc_budget_limit_s m_limit = {.scale = IC_LTC_BUDGET_SCALE_ONE};
 
-static TimerHandle_t m_ltc_refresh_timer_handle = NULL;
 static TimerHandle_t m_ltc_blink_timer_handle = NULL;
 static TaskHandle_t m_ltc_refresh_task_handle = NULL;
 static bool m_module_initialized = false;
@@ -51,11 +61,16 @@ static struct device_state_s{
   uint32_t cur_period;
   uint32_t cur_duration;
   uint8_t intensity;
-  float alpha;
-  float beta;
-  float a_ramp_coef;
+  uint32_t step;                      /** Phase, step*period/PERIOD_STEPS <= cur_period */
+  uint32_t step_rem;                  /** Rest of phase in 1/period of step */
+  uint32_t step_inc;                  /** Phase increment per quantum */
+  uint32_t step_inc_rem;
+  int32_t beta;                       /** Q16 amplitude, intensity/IC_LTC_MAX_VAL */
+  int32_t a_ramp_coef;                /** Q16 ramp slope per step */
   uint8_t b_ramp_coef;
   uint8_t ramp_step;
+  bool gamma;                         /** Output is gamma corrected (LEDs only) */
+  uint32_t quantum;                   /** State is advanced up to this quantum */
 }m_device_state[] =
 {
   {.desired_val = 0x00, .device = ACTUATOR_LEFT_GREEN_LED,   .associated_callback = NULL,  .turned_on = false,  .refresh_ltc = false, .func = FUN_TYPE_OFF, .intensity = 0x00},
@@ -75,10 +90,65 @@ static ic_return_val_e actuator_set_func(
     uint32_t duration,
     uint8_t intensity);
 
-static void m_device_parse(u_BLECmdPayload payload){
+/**
+ * @brief Q16 of num/den rounded up. Truncated product with step (< PERIOD_STEPS) is then exactly
+ * floor(step*num/den), error of ratio is smaller than distance to the next integer.
+ */
+static inline int32_t m_q16_ratio(int32_t num, int32_t den){
+  __auto_type _scaled = num * Q16_ONE;
+  /* Division truncates toward zero, so negative ratio is already rounded up */
+  return _scaled > 0 ? (_scaled + den - 1) / den : _scaled / den;
+}
+
+/* sin(x) for 0 <= x <= pi/2 (Taylor series, error below 1e-7), evaluated by compiler */
+#define SIN_TAYLOR(x) \
+  ((x)*(1 - (x)*(x)/6*(1 - (x)*(x)/20*(1 - (x)*(x)/42*(1 - (x)*(x)/72*(1 - (x)*(x)/110))))))
+#define SINE_POINT(k)   (uint8_t)(IC_LTC_MAX_VAL*SIN_TAYLOR((k)*3.14159265358979/64) + 0.5)
+#define SINE_POINTS(k)  SINE_POINT(k), SINE_POINT(k+1), SINE_POINT(k+2), SINE_POINT(k+3)
+
+/* CIE 1931 relative luminance of lightness l (0 - 100), evaluated by compiler */
+#define CIE_Y(l)        ((l) <= 8 ? (l)/903.3 : ((l)+16)/116.0*((l)+16)/116.0*((l)+16)/116.0)
+#define GAMMA_POINT(k)  (uint8_t)(IC_LTC_MAX_VAL*CIE_Y((k)*100.0/IC_LTC_MAX_VAL) + 0.5)
+#define GAMMA_POINTS(k) GAMMA_POINT(k), GAMMA_POINT(k+1), GAMMA_POINT(k+2), GAMMA_POINT(k+3)
+
+#define LTC_FUNC_NUM    (IC_LTC_FUNC_CURVE + IC_LTC_CURVES)
+
+_Static_assert(IC_LTC_MAX_VAL == 63, "Tables are generated for 6 bit levels");
+_Static_assert(LTC_FUNC_NUM <= IC_LTC_FUNC_GAMMA, "Function types collide with gamma flag");
+
+/** sin of the first quarter of period (PERIOD_STEPS/4 steps) in levels */
+static const uint8_t m_sine_quarter[PERIOD_STEPS/4 + 1] = {
+  SINE_POINTS(0),   SINE_POINTS(4),   SINE_POINTS(8),   SINE_POINTS(12),
+  SINE_POINTS(16),  SINE_POINTS(20),  SINE_POINTS(24),  SINE_POINTS(28),
+  SINE_POINT(32)
+};
+
+/** LTC level giving perceived brightness level */
+static const uint8_t m_gamma[IC_LTC_MAX_VAL + 1] = {
+  GAMMA_POINTS(0),  GAMMA_POINTS(4),  GAMMA_POINTS(8),  GAMMA_POINTS(12),
+  GAMMA_POINTS(16), GAMMA_POINTS(20), GAMMA_POINTS(24), GAMMA_POINTS(28),
+  GAMMA_POINTS(32), GAMMA_POINTS(36), GAMMA_POINTS(40), GAMMA_POINTS(44),
+  GAMMA_POINTS(48), GAMMA_POINTS(52), GAMMA_POINTS(56), GAMMA_POINTS(60)
+};
+
+static uint8_t m_curves[IC_LTC_CURVES][IC_LTC_CURVE_POINTS];
+
+static ic_return_val_e m_curve_parse(u_BLECmdPayload payload, void *ctx){
+  UNUSED_PARAMETER(ctx);
+
+  __auto_type _count = payload.data[2];
+  if(_count > sizeof(payload.data) - 3)
+    return IC_ERROR;
+
+  return ic_actuator_set_curve(payload.data[0], payload.data[1], &payload.data[3], _count);
+}
+
+static ic_return_val_e m_device_parse(u_BLECmdPayload payload, void *ctx){
 
   __auto_type _period = pdMS_TO_TICKS((payload.device_cmd.func_parameter.periodic_func.period*100));
   __auto_type _duration = pdMS_TO_TICKS((payload.device_cmd.func_parameter.periodic_func.duration*100));
+  __auto_type _func = payload.device_cmd.func_type & ~IC_LTC_FUNC_GAMMA;
+  __auto_type _gamma = (payload.device_cmd.func_type & IC_LTC_FUNC_GAMMA) != 0;
 
   NRF_LOG_INFO("dev: 0x%X\tfunc: %d\tperiod: %d\tduration: %d\n",
       payload.device_cmd.device,
@@ -86,50 +156,59 @@ static void m_device_parse(u_BLECmdPayload payload){
       payload.device_cmd.func_parameter.periodic_func.period,
       payload.device_cmd.func_parameter.periodic_func.duration);
 
+  if(_func >= LTC_FUNC_NUM)
+    return IC_ERROR;
+
   if(payload.device_cmd.device&DEV_RIGHT_RED_LED){
+    m_device_state[ACTUATOR_RIGHT_RED_LED].gamma = _gamma;
     actuator_set_func(
         &m_device_state[ACTUATOR_RIGHT_RED_LED],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         payload.device_cmd.intensity.right_red_led);
   }
   if(payload.device_cmd.device&DEV_RIGHT_GREEN_LED){
+    m_device_state[ACTUATOR_RIGHT_GREEN_LED].gamma = _gamma;
     actuator_set_func(
         &m_device_state[ACTUATOR_RIGHT_GREEN_LED],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         payload.device_cmd.intensity.right_green_led);
   }
   if(payload.device_cmd.device&DEV_RIGHT_BLUE_LED){
+    m_device_state[ACTUATOR_RIGHT_BLUE_LED].gamma = _gamma;
     actuator_set_func(
         &m_device_state[ACTUATOR_RIGHT_BLUE_LED],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         payload.device_cmd.intensity.right_blue_led);
   }
   if(payload.device_cmd.device&DEV_LEFT_RED_LED){
+    m_device_state[ACTUATOR_LEFT_RED_LED].gamma = _gamma;
     actuator_set_func(
         &m_device_state[ACTUATOR_LEFT_RED_LED],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         payload.device_cmd.intensity.left_red_led);
   }
   if(payload.device_cmd.device&DEV_LEFT_GREEN_LED){
+    m_device_state[ACTUATOR_LEFT_GREEN_LED].gamma = _gamma;
     actuator_set_func(
         &m_device_state[ACTUATOR_LEFT_GREEN_LED],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         payload.device_cmd.intensity.left_green_led);
   }
   if(payload.device_cmd.device&DEV_LEFT_BLUE_LED){
+    m_device_state[ACTUATOR_LEFT_BLUE_LED].gamma = _gamma;
     actuator_set_func(
         &m_device_state[ACTUATOR_LEFT_BLUE_LED],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         payload.device_cmd.intensity.left_blue_led);
@@ -137,7 +216,7 @@ static void m_device_parse(u_BLECmdPayload payload){
   if(payload.device_cmd.device&DEV_VIBRATOR){
     actuator_set_func(
         &m_device_state[ACTUATOR_VIBRATOR],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         payload.device_cmd.intensity.vibrator);
@@ -145,36 +224,44 @@ static void m_device_parse(u_BLECmdPayload payload){
   if(payload.device_cmd.device&DEV_POWER_LED){
     actuator_set_func(
         &m_device_state[ACTUATOR_POWER_LEDS],
-        payload.device_cmd.func_type,
+        _func,
         _period,
         _duration,
         0);
   }
+  return IC_SUCCESS;
 }
 
 static uint8_t function_ramp_down(struct device_state_s *device){
-  uint8_t _step = QUANTUM_OF_TIME * device->beta;
+  uint8_t _step = (QUANTUM_OF_TIME * device->beta) >> 16;
   if (_step == 0) _step = 1;
   return ({int16_t _ret_val =
       device->desired_val - _step; _ret_val<0 ? 0 : _ret_val;});
 }
 
 static uint8_t function_ramp_up(struct device_state_s *device){
-  uint8_t _step = QUANTUM_OF_TIME * device->beta;
+  uint8_t _step = (QUANTUM_OF_TIME * device->beta) >> 16;
   if (_step == 0) _step = 1;
   return ({__auto_type _ret_val =
       device->desired_val + _step; _ret_val>device->intensity ? device->intensity : _ret_val;});
 }
 
+/**
+ * @brief Value between b_ramp_coef and target intensity, never negative.
+ */
+static inline uint8_t m_ramp_val(struct device_state_s *device, int32_t step){
+  return (device->b_ramp_coef * Q16_ONE + step * device->a_ramp_coef) >> 16;
+}
+
 uint8_t function_ramp(struct device_state_s *device){
-  int16_t _step = device->cur_period*device->alpha;
+  int16_t _step = device->step;
   uint8_t _ret_val;
   if(_step<device->ramp_step || _step==127){
-    _ret_val = 127*device->a_ramp_coef + device->b_ramp_coef;
+    _ret_val = m_ramp_val(device, 127);
     actuator_set_func(device,FUN_TYPE_ON, 0, 0, _ret_val);
     return device->desired_val;
   }
-  _ret_val = _step*device->a_ramp_coef + device->b_ramp_coef;
+  _ret_val = m_ramp_val(device, _step);
   device->ramp_step = _step;
   return _ret_val;
 }
@@ -188,17 +275,17 @@ static uint8_t function_on(struct device_state_s *device){
 }
 
 static uint8_t function_saw(struct device_state_s *device){
-  uint8_t _step = device->cur_period*device->alpha;
-  return (_step>>1)*device->beta;
+  uint8_t _step = device->step;
+  return ((_step>>1)*device->beta) >> 16;
 }
 
 static uint8_t function_triangle(struct device_state_s *device){
-  uint8_t _step = device->cur_period*device->alpha;
-  return (_step<64?_step:127-_step)*device->beta;
+  uint8_t _step = device->step;
+  return ((_step<64?_step:127-_step)*device->beta) >> 16;
 }
 
 static uint8_t function_square(struct device_state_s *device){
-  uint8_t _step = device->cur_period*device->alpha;
+  uint8_t _step = device->step;
   uint8_t _ret_val;
   if(_step<64){
     if(device->device == ACTUATOR_VIBRATOR)
@@ -215,6 +302,37 @@ static uint8_t function_square(struct device_state_s *device){
   return _ret_val;
 }
 
+/**
+ * @brief Raised cosine, rises from 0 to intensity in half of period like triangle does.
+ */
+static uint8_t function_sin(struct device_state_s *device){
+  uint8_t _step = device->step & (PERIOD_STEPS - 1);
+  uint8_t _i = _step & (PERIOD_STEPS/4 - 1);
+  int16_t _cos;
+
+  switch(_step / (PERIOD_STEPS/4)){
+    case 0:
+      _cos = m_sine_quarter[PERIOD_STEPS/4 - _i];
+      break;
+    case 1:
+      _cos = -m_sine_quarter[_i];
+      break;
+    case 2:
+      _cos = -m_sine_quarter[PERIOD_STEPS/4 - _i];
+      break;
+    default:
+      _cos = m_sine_quarter[_i];
+      break;
+  }
+  return (((IC_LTC_MAX_VAL - _cos) >> 1) * device->beta) >> 16;
+}
+
+static uint8_t function_curve(struct device_state_s *device){
+  __auto_type _curve = m_curves[device->func - IC_LTC_FUNC_CURVE];
+  uint8_t _step = device->step & (PERIOD_STEPS - 1);
+  return (_curve[_step * IC_LTC_CURVE_POINTS / PERIOD_STEPS] * device->beta) >> 16;
+}
+
 static uint8_t function_blink(struct device_state_s *device){
   uint8_t _ret_val;
   if(device->cur_period<QUANTUM_OF_TIME){
@@ -225,22 +343,23 @@ static uint8_t function_blink(struct device_state_s *device){
   return _ret_val;
 }
 
-uint8_t(*m_function_map[])(struct device_state_s *) = {
+uint8_t(*m_function_map[LTC_FUNC_NUM])(struct device_state_s *) = {
   function_off,
   function_off,
   function_on,
-  function_triangle, // it is dummy func(should be sinus)
+  function_sin,
   function_blink,
   function_square,
   function_saw,
   function_triangle,
-  function_ramp
+  function_ramp,
+  [IC_LTC_FUNC_CURVE ... LTC_FUNC_NUM - 1] = function_curve
 };
 
 static uint8_t calculate_val(struct device_state_s *device){
   uint8_t _offset = 0;
 
-  __auto_type _ret_val = m_function_map[device->func] != NULL ?
+  __auto_type _ret_val = device->func < LTC_FUNC_NUM && m_function_map[device->func] != NULL ?
     m_function_map[device->func](device)+_offset : ({/*NRF_LOG_INFO("Function not implemented\n");*/ 0;});
 
   if(device->device == ACTUATOR_VIBRATOR)
@@ -263,6 +382,39 @@ static void m_power_led_cb(bool b){
   UNUSED_PARAMETER(_dummy);
 }
 
+static inline uint8_t m_output(struct device_state_s *device){
+  return device->gamma ? m_gamma[device->desired_val & IC_LTC_MAX_VAL] : device->desired_val;
+}
+
+static uint8_t m_limited_output(struct device_state_s *device){
+  __auto_type _val = m_output(device);
+
+  if(device->device == ACTUATOR_VIBRATOR)
+    return m_limit.vibrator_deferred ? 0 : _val;
+
+  return _val * m_limit.scale / IC_LTC_BUDGET_SCALE_ONE;
+}
+
+/**
+ * @brief Take limit of power budget for outputs of this refresh. Outputs which did not change are
+ * written again when limit changed.
+ */
+static void m_govern(void){
+  uint8_t _levels[IC_VIBRATOR + 1];
+
+  for(int i = 0; i <= IC_VIBRATOR; ++i)
+    _levels[i] = m_output(&m_device_state[i]);
+
+  __auto_type _limit = ic_ltc_budget_apply(_levels);
+  if(_limit.scale == m_limit.scale && _limit.vibrator_deferred == m_limit.vibrator_deferred)
+    return;
+
+  m_limit = _limit;
+  for(int i = 0; i <= IC_VIBRATOR; ++i)
+    if(m_device_state[i].turned_on)
+      m_device_state[i].refresh_ltc = true;
+}
+
 static void refresh_device(struct device_state_s * device){
   __auto_type _ret_val = IC_SUCCESS;
 
@@ -277,7 +429,7 @@ static void refresh_device(struct device_state_s * device){
   else if(device->refresh_ltc){
     _ret_val = ic_actuator_set(
         device->device,
-        device->desired_val,
+        m_limited_output(device),
         device->associated_callback);
   }
 
@@ -288,15 +440,25 @@ static void refresh_device(struct device_state_s * device){
 }
 
 static void refresh_time(struct device_state_s * device){
-  if((device->cur_period += QUANTUM_OF_TIME)>device->period){
-    __auto_type _delta = device->cur_period - device->period;
-    device->cur_period = _delta-1;
-  }
-
-  if(device->duration > 0)
-    if((device->cur_duration += QUANTUM_OF_TIME)>=device->duration){
-      device->func = FUN_TYPE_OFF;
+  for(; (int32_t)(m_quantum - device->quantum) > 0; ++device->quantum){
+    device->step += device->step_inc;
+    if(device->step_inc_rem != 0)
+      if((device->step_rem += device->step_inc_rem) > device->period){
+        device->step_rem -= device->period + 1;
+        ++device->step;
+      }
+
+    if((device->cur_period += QUANTUM_OF_TIME)>device->period){
+      __auto_type _delta = device->cur_period - device->period;
+      device->cur_period = _delta-1;
+      device->step -= PERIOD_STEPS;
     }
+
+    if(device->duration > 0)
+      if((device->cur_duration += QUANTUM_OF_TIME)>=device->duration){
+        device->func = FUN_TYPE_OFF;
+      }
+  }
 }
 
 static void refresh_function(struct device_state_s *device){
@@ -318,8 +480,138 @@ static void refresh_activation(struct device_state_s *device){
   }
 }
 
-static void ltc_refresh_timer_callback(TimerHandle_t xTimer){
+/**
+ * @brief Quanta until cur_period (or cur_duration) reaches position, at least one.
+ */
+static inline uint32_t m_quanta_to(uint32_t from, uint32_t to){
+  return to > from ? (to - from + QUANTUM_OF_TIME - 1) / QUANTUM_OF_TIME : 1;
+}
+
+/**
+ * @brief Quanta until phase reaches step, PERIOD_STEPS is the end of period. Phase is
+ * cur_period*PERIOD_STEPS/period, so the step starts at the first cur_period not below
+ * step*period/PERIOD_STEPS.
+ */
+static uint32_t m_quanta_to_step(struct device_state_s *device, uint32_t step){
+  uint32_t _period = device->period + 1;
+
+  /* No period, phase stands still */
+  if(_period == 0)
+    return IC_LTC_MAX_SLEEP;
+
+  return m_quanta_to(
+      device->cur_period,
+      ((uint64_t)step * _period + PERIOD_STEPS - 1) / PERIOD_STEPS);
+}
+
+/**
+ * @brief Quanta until output of device may change. Waveforms are functions of step, so output
+ * holds until the step changes; ON holds forever, ramping of OFF and SQUARE changes every quantum.
+ */
+static uint32_t m_next_change(struct device_state_s *device){
+  /* Set but not advanced yet */
+  if(device->cur_period == 0 && device->cur_duration == 0)
+    return 1;
+
+  uint32_t _quanta;
+  uint8_t _target;
+
+  if(device->device == ACTUATOR_POWER_LEDS || device->func == FUN_TYPE_BLINK){
+    _quanta = device->cur_period < QUANTUM_OF_TIME ? 1 : m_quanta_to_step(device, PERIOD_STEPS);
+  }
+  else if(device->func >= LTC_FUNC_NUM || m_function_map[device->func] == NULL){
+    _quanta = IC_LTC_MAX_SLEEP;
+  }
+  else if(device->func >= IC_LTC_FUNC_CURVE){
+    _quanta = m_quanta_to_step(device, device->step + 1);
+  }
+  else switch(device->func){
+    case FUN_TYPE_ON:
+      _quanta = IC_LTC_MAX_SLEEP;
+      break;
+    case FUN_TYPE_SQUARE:
+      _target = device->step < PERIOD_STEPS/2 ? device->intensity : 0;
+      if(device->device != ACTUATOR_VIBRATOR && device->desired_val != _target)
+        _quanta = 1;
+      else
+        _quanta = m_quanta_to_step(
+            device,
+            device->step < PERIOD_STEPS/2 ? PERIOD_STEPS/2 : PERIOD_STEPS);
+      break;
+    case FUN_TYPE_SIN_WAVE:
+    case FUN_TYPE_SAW:
+    case FUN_TYPE_TRIANGLE:
+    case FUN_TYPE_RAMP:
+      _quanta = m_quanta_to_step(device, device->step + 1);
+      break;
+    default:
+      _quanta = 1;
+      break;
+  }
+
+  if(device->duration > 0)
+    _quanta = MIN(_quanta, m_quanta_to(device->cur_duration, device->duration));
+
+  return MIN(_quanta, IC_LTC_MAX_SLEEP);
+}
+
+/**
+ * @brief The nearest quantum at which any active device has to be processed.
+ */
+static uint32_t m_next_quantum(void){
+  __auto_type _next = m_quantum + IC_LTC_MAX_SLEEP;
+
+  for(int i = 0; i < sizeof(m_device_state)/sizeof(m_device_state[0]); ++i){
+    if(!m_device_state[i].turned_on)
+      continue;
+
+    __auto_type _quantum = m_device_state[i].quantum + m_next_change(&m_device_state[i]);
+    if((int32_t)(_quantum - _next) < 0)
+      _next = _quantum;
+  }
+  return _next;
+}
+
+static TickType_t m_tick_of(uint32_t quantum){
+  TickType_t _tick;
+
+  CRITICAL_REGION_ENTER();
+  _tick = m_quantum_tick + (quantum - m_quantum) * QUANTUM_OF_TIME;
+  CRITICAL_REGION_EXIT();
+
+  return _tick;
+}
+
+/**
+ * @brief Advance devices to quantum and write only channels whose value changed.
+ */
+static void m_refresh(uint32_t quantum){
+  __auto_type _tick = m_tick_of(quantum);
+
+  CRITICAL_REGION_ENTER();
+  m_quantum_tick = _tick;
+  m_quantum = quantum;
+  CRITICAL_REGION_EXIT();
+
+  REFRESH_ALL(time);
+  REFRESH_ALL(function);
+  m_govern();
   REFRESH_ALL(device);
+  REFRESH_ALL(activation);
+}
+
+static void m_wake_task(void){
+  if(m_ltc_refresh_task_handle == NULL)
+    return;
+
+  if(isr_context()){
+    __auto_type _yield_required = pdFALSE;
+    vTaskNotifyGiveFromISR(m_ltc_refresh_task_handle, &_yield_required);
+    portYIELD_FROM_ISR(_yield_required);
+  }
+  else{
+    xTaskNotifyGive(m_ltc_refresh_task_handle);
+  }
 }
 
 static void m_ltc_turned_off(bool b){
@@ -333,26 +625,20 @@ static void ltc_power_led_timer_callback(TimerHandle_t xTimer){
 }
 
 static void ltc_refresh_task_callback(void *arg){
-  __auto_type _last_wake_time = GET_TICK_COUNT();
-
   for(;;){
-    if(_last_wake_time == GET_TICK_COUNT()){
-      _last_wake_time = GET_TICK_COUNT();
-    }
-
     if(m_active_function_counter < 1){
-      vTaskSuspend(NULL);
-      _last_wake_time = GET_TICK_COUNT();
+      (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
     }
 
-    REFRESH_ALL(time);
-    REFRESH_ALL(function);
-    REFRESH_ALL(device);
-    REFRESH_ALL(activation);
+    __auto_type _next = m_next_quantum();
+    __auto_type _wait = (int32_t)(m_tick_of(_next) - GET_TICK_COUNT());
 
-    xTimerReset(m_ltc_refresh_timer_handle, 2);
+    /* Function was set meanwhile, deadline has to be computed again */
+    if(_wait > 0 && ulTaskNotifyTake(pdTRUE, _wait) != 0)
+      continue;
 
-    vTaskDelayUntil(&_last_wake_time, QUANTUM_OF_TIME);
+    m_refresh(_next);
   }
 }
 
@@ -363,25 +649,31 @@ static ic_return_val_e actuator_set_func(
     uint32_t duration,
     uint8_t intensity)
 {
-  device->alpha = (128.0)/(period);
+  /* Phase advances by QUANTUM_OF_TIME*PERIOD_STEPS/period steps per quantum */
+  device->step_inc = period != 0 ? QUANTUM_OF_TIME * PERIOD_STEPS / period : 0;
+  device->step_inc_rem = period != 0 ? QUANTUM_OF_TIME * PERIOD_STEPS % period : 0;
 
   if((device->device == ACTUATOR_VIBRATOR) && (func != FUN_TYPE_OFF)){
-    device->intensity = intensity*m_beta_factor_vib1;
-    device->beta = device->intensity*m_beta_factor;
+    device->intensity = intensity*IC_LTC_VIB_MAX_VAL/63;
+    device->beta = m_q16_ratio(device->intensity, IC_LTC_MAX_VAL);
   }
   else if(func==FUN_TYPE_RAMP){
     device->b_ramp_coef = device->desired_val;
     int _tmp = (intensity - device->desired_val);
-    device->a_ramp_coef = _tmp/127.0;
+    device->a_ramp_coef = m_q16_ratio(_tmp, PERIOD_STEPS - 1);
     device->ramp_step = 0;
-    NRF_LOG_INFO("_tmp: %d, intensity: %d, device->intensity: %d a: " NRF_LOG_FLOAT_MARKER "\n",_tmp, intensity, device->intensity, NRF_LOG_FLOAT(device->a_ramp_coef));
+    NRF_LOG_INFO("_tmp: %d, intensity: %d, device->intensity: %d a: %d/65536\n",_tmp, intensity, device->intensity, device->a_ramp_coef);
     device->intensity = intensity;
   }
   else{
-    device->beta = func==FUN_TYPE_OFF ? device->desired_val*m_beta_factor : intensity*m_beta_factor;
+    device->beta = m_q16_ratio(
+        func==FUN_TYPE_OFF ? device->desired_val : intensity,
+        IC_LTC_MAX_VAL);
     device->intensity = intensity;
   }
 
+  device->step = 0;
+  device->step_rem = 0;
   device->cur_period = 0;
   device->cur_duration = 0;
 
@@ -393,12 +685,27 @@ static ic_return_val_e actuator_set_func(
   device->period = period-1;
   device->duration = duration == 0 ? 0 : duration-1;
 
+  /* Device is advanced the first time at the next quantum */
+  CRITICAL_REGION_ENTER();
+  if(xTaskGetCurrentTaskHandle() == m_ltc_refresh_task_handle){
+    device->quantum = m_quantum;
+  }
+  else{
+    /* Idle engine moves its quanta, so the next one is now */
+    if(m_active_function_counter == 0 && GET_TICK_COUNT() - m_quantum_tick > QUANTUM_OF_TIME)
+      m_quantum_tick = GET_TICK_COUNT() - QUANTUM_OF_TIME;
+
+    /* The last quantum before now */
+    __auto_type _elapsed = GET_TICK_COUNT() - m_quantum_tick;
+    device->quantum = m_quantum + (_elapsed == 0 ? 0 : (_elapsed - 1) / QUANTUM_OF_TIME);
+  }
+  CRITICAL_REGION_EXIT();
+
   if(!device->turned_on){
     device->turned_on = true;
-    if(m_active_function_counter++ == 0){
-      RESUME_TASK(m_ltc_refresh_task_handle);
-    }
+    m_active_function_counter++;
   }
+  m_wake_task();
 
   return IC_SUCCESS;
 }
@@ -515,21 +822,88 @@ ic_return_val_e ic_actuator_set_ramp_func(
       intensity);
 }
 
+ic_return_val_e ic_actuator_set_curve_func(
+    ic_devices_e device,
+    uint8_t slot,
+    uint32_t period,
+    uint32_t duration,
+    uint8_t intensity)
+{
+  if(slot >= IC_LTC_CURVES)
+    return IC_ERROR;
+
+  return actuator_set_func(
+      &m_device_state[device],
+      IC_LTC_FUNC_CURVE + slot,
+      period,
+      duration,
+      intensity);
+}
+
+ic_return_val_e ic_actuator_set_curve(
+    uint8_t slot,
+    uint8_t first,
+    const uint8_t *points,
+    size_t count)
+{
+  if(slot >= IC_LTC_CURVES || points == NULL || first + count > IC_LTC_CURVE_POINTS)
+    return IC_ERROR;
+
+  for(size_t i = 0; i < count; ++i)
+    m_curves[slot][first + i] = points[i] > IC_LTC_MAX_VAL ? IC_LTC_MAX_VAL : points[i];
+
+  return IC_SUCCESS;
+}
+
+ic_return_val_e ic_actuator_set_gamma(ic_devices_e device, bool enabled){
+  if(device >= IC_VIBRATOR)
+    return IC_ERROR;
+
+  m_device_state[device].gamma = enabled;
+  return IC_SUCCESS;
+}
+
+ic_return_val_e ic_actuator_set_func(
+    ic_devices_e device,
+    uint8_t func_type,
+    uint32_t period,
+    uint32_t duration,
+    uint8_t intensity)
+{
+  __auto_type _func = func_type & ~IC_LTC_FUNC_GAMMA;
+
+  if(device > IC_POWER_LEDS || _func >= LTC_FUNC_NUM)
+    return IC_ERROR;
+
+  if(device < IC_VIBRATOR)
+    m_device_state[device].gamma = (func_type & IC_LTC_FUNC_GAMMA) != 0;
+
+  return actuator_set_func(&m_device_state[device], _func, period, duration, intensity);
+}
+
+uint8_t ic_actuator_active(void){
+  uint8_t _mask = 0;
+
+  for(int i = 0; i < sizeof(m_device_state)/sizeof(m_device_state[0]); ++i)
+    if(m_device_state[i].turned_on)
+      _mask |= 1 << i;
+
+  return _mask;
+}
+
 ic_return_val_e ic_ltc_service_init(){
   if(m_module_initialized) return IC_SUCCESS;
 
   nrf_gpio_cfg_output(24);
   ic_actuator_init();
 
-  cmd_task_connect_to_device_cmd(m_device_parse);
+  cmd_register(DEVICE_CMD, m_device_parse, NULL);
+  cmd_register(CMD_LTC_CURVE, m_curve_parse, NULL);
+  ic_pattern_init();
+  ic_ltc_budget_init();
 
-  if(m_ltc_refresh_timer_handle == NULL)
-    m_ltc_refresh_timer_handle = xTimerCreate(
-        "LTC_TIMER",
-        pdMS_TO_TICKS(200),
-        pdTRUE,
-        NULL,
-        ltc_refresh_timer_callback);
+  /* Engine is idle */
+  m_quantum_tick = GET_TICK_COUNT() - QUANTUM_OF_TIME;
 
   if(m_ltc_blink_timer_handle == NULL)
     m_ltc_blink_timer_handle = xTimerCreate(
@@ -557,10 +931,7 @@ ic_return_val_e ic_ltc_service_deinit(){
   nrf_gpio_cfg_default(24);
   if(m_module_initialized == false) return IC_NOT_INIALIZED;
   ic_actuator_deinit();
-
-  __auto_type _ret_val = pdTRUE;
-  UNUSED_VARIABLE(_ret_val);
-  STOP_TIMER(m_ltc_refresh_timer_handle, 0, _ret_val);
+  ic_ltc_budget_deinit();
 
   vTaskSuspend(m_ltc_refresh_task_handle);
 
@@ -11,12 +11,25 @@
 #define IC_SERVICE_LTC_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "ic_common_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Function types continuing e_funcType. IC_LTC_FUNC_CURVE + slot plays custom curve, it is
+ * uploaded with CMD_LTC_CURVE: [slot:8][first point:8][count:8][points:up to 13]. Points are
+ * levels 0 - IC_LTC_MAX_VAL spread evenly over period. Frames of one curve can be sent as a batch,
+ * so the curve is not played half updated.
+ */
+#define IC_LTC_FUNC_CURVE     0x10
+/** Flag of func_type, LED output follows perceived brightness (CIE 1931 lightness) */
+#define IC_LTC_FUNC_GAMMA     0x80
+#define IC_LTC_CURVE_POINTS   64
+
 /**
  * @brief 
  */
@@ -160,6 +173,49 @@ ic_return_val_e ic_actuator_set_ramp_func(
     uint8_t intensity);
 
 
+/**
+ * @brief Play custom curve from slot (0 - IC_LTC_CURVES-1) scaled to intensity.
+ */
+ic_return_val_e ic_actuator_set_curve_func(
+    ic_devices_e device,
+    uint8_t slot,
+    uint32_t period,
+    uint32_t duration,
+    uint8_t intensity);
+
+/**
+ * @brief Overwrite points of custom curve slot, levels above IC_LTC_MAX_VAL are saturated.
+ *
+ * @return IC_ERROR when slot or points are out of range.
+ */
+ic_return_val_e ic_actuator_set_curve(
+    uint8_t slot,
+    uint8_t first,
+    const uint8_t *points,
+    size_t count);
+
+/**
+ * @brief Gamma correct output of LED (no effect on vibrator and power LEDs).
+ */
+ic_return_val_e ic_actuator_set_gamma(ic_devices_e device, bool enabled);
+
+/**
+ * @brief Set function by its type as in DEVICE_CMD (e_funcType, curve or gamma flag).
+ *
+ * @return IC_ERROR when device or function is unknown.
+ */
+ic_return_val_e ic_actuator_set_func(
+    ic_devices_e device,
+    uint8_t func_type,
+    uint32_t period,
+    uint32_t duration,
+    uint8_t intensity);
+
+/**
+ * @brief Mask (1 << ic_devices_e) of devices whose function did not end yet.
+ */
+uint8_t ic_actuator_active(void);
+
 /**
  * @brief 
  *
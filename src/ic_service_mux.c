@@ -0,0 +1,317 @@
+/**
+ * @file    ic_service_mux.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Multiplexed stream of tagged records
+ *
+ * Producers write records straight into packet ring under critical region. There is no mux task:
+ * ring is drained by whoever makes progress possible - producer that sealed packet, BLE task on
+ * TX_COMPLETE and flush timer, which seals packets older than @ref IC_MUX_FLUSH_DEADLINE. Only one
+ * of them drains at a time, the others leave a note for it.
+ */
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "MUX"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_service_mux.h"
+#include "ic_ble_service.h"
+#include "ic_ring_buffer.h"
+
+#define MUX_RECORD_HEADER 3
+
+typedef struct{
+  uint8_t data[IC_MUX_PACKET_SIZE];
+  uint8_t len;
+}mux_packet_s;
+
+/**
+ * @brief Packets filled by producers (MPSC), sent by @ref m_drain. Packet being filled is
+ * IC_RING_NEXT slot.
+ */
+static IC_RING_BUFFER(mux_packet_s, IC_MUX_PACKETS) m_packets;
+
+static struct{
+  bool initialized;
+  bool volatile active;
+  bool synced;                        /** SYNC record was sent since subscription */
+  bool draining;                      /** Some context is in @ref m_drain */
+  bool drain_again;                   /** Ring changed while it was drained */
+  uint8_t fill_len;                   /** Stream bytes in packet being filled */
+  uint8_t seq;
+  TickType_t fill_started;
+  uint32_t last_tick;                 /** Timestamp of previous record */
+  uint32_t last_sync;
+  ic_mux_stats_s stats;
+  TimerHandle_t flush_timer;
+  void (*clients[IC_MUX_MAX_CLIENTS])(bool);
+}m_mux;
+
+/**
+ * @brief Pass packet being filled to @ref m_drain. Called with interrupts disabled.
+ */
+static void m_seal(void){
+  if(m_mux.fill_len == 0)
+    return;
+
+  __auto_type _packet = &IC_RING_NEXT(m_packets);
+  _packet->data[0] = m_mux.seq++;
+  _packet->len = 2 + m_mux.fill_len;
+
+  ic_ring_commit(&m_packets.ring);
+  m_mux.fill_len = 0;
+}
+
+/**
+ * @brief Free bytes in stream buffers. Called with interrupts disabled.
+ */
+static size_t m_free(void){
+  return (IC_RING_SIZE(m_packets) - IC_RING_COUNT(m_packets)) * IC_MUX_PAYLOAD - m_mux.fill_len;
+}
+
+/**
+ * @brief Write bytes to stream, full packets are sealed. Called with interrupts disabled.
+ */
+static void m_put(const uint8_t *data, size_t len, bool record_start){
+  for(size_t i = 0; i < len; ++i){
+    __auto_type _packet = &IC_RING_NEXT(m_packets);
+
+    if(m_mux.fill_len == 0){
+      _packet->data[1] = IC_MUX_NO_RECORD;
+      m_mux.fill_started = GET_TICK_COUNT();
+    }
+
+    if(i == 0 && record_start && _packet->data[1] == IC_MUX_NO_RECORD)
+      _packet->data[1] = m_mux.fill_len;
+
+    _packet->data[2 + m_mux.fill_len++] = data[i];
+
+    if(m_mux.fill_len == IC_MUX_PAYLOAD)
+      m_seal();
+  }
+}
+
+static void m_record(ic_mux_record_e type, int8_t dt, const void *data, size_t len){
+  const uint8_t _header[MUX_RECORD_HEADER] = {type, len, (uint8_t)dt};
+
+  m_put(_header, sizeof(_header), true);
+  m_put(data, len, false);
+}
+
+static void m_notify_clients(bool active){
+  for(int i = 0; i < IC_MUX_MAX_CLIENTS; ++i)
+    if(m_mux.clients[i] != NULL)
+      m_mux.clients[i](active);
+}
+
+/**
+ * @brief Send sealed packets until ring is empty or SoftDevice is out of buffers, then TX_COMPLETE
+ * calls it again. When central unsubscribed ring is dropped instead. Call from task.
+ */
+static void m_drain(void){
+  bool _owner;
+
+  CRITICAL_REGION_ENTER();
+  _owner = !m_mux.draining;
+  m_mux.draining = true;
+  m_mux.drain_again = !_owner;
+  CRITICAL_REGION_EXIT();
+
+  /* Ring has single consumer, current one rechecks it before leaving */
+  if(!_owner)
+    return;
+
+  for(bool _again = true; _again;){
+    if(!m_mux.active){
+      CRITICAL_REGION_ENTER();
+      m_mux.fill_len = 0;
+      CRITICAL_REGION_EXIT();
+      ic_ring_clean(&m_packets.ring);
+    }
+
+    while(!IC_RING_EMPTY(m_packets)){
+      __auto_type _packet = &IC_RING_FIRST(m_packets);
+      __auto_type _ret_val = ble_iccs_send_to_mux(_packet->data, _packet->len, NULL);
+
+      /* Resumed by TX_COMPLETE */
+      if(_ret_val == IC_BUSY)
+        break;
+
+      if(_ret_val == IC_SUCCESS)
+        ++m_mux.stats.pdus;
+
+      ic_ring_release(&m_packets.ring);
+    }
+
+    CRITICAL_REGION_ENTER();
+    _again = m_mux.drain_again;
+    m_mux.drain_again = false;
+    m_mux.draining = _again;
+    CRITICAL_REGION_EXIT();
+  }
+}
+
+/**
+ * @brief Seals partially filled packet past its deadline. Runs every quarter of deadline while
+ * central is subscribed.
+ */
+static void m_flush_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+
+  CRITICAL_REGION_ENTER();
+  __auto_type _age = GET_TICK_COUNT() - m_mux.fill_started;
+  if(m_mux.fill_len != 0 && _age >= IC_MUX_FLUSH_DEADLINE)
+    m_seal();
+  CRITICAL_REGION_EXIT();
+
+  m_drain();
+}
+
+static void on_mux_state_change(bool active){
+  if(active){
+    CRITICAL_REGION_ENTER();
+    m_mux.synced = false;
+    m_mux.active = true;
+    CRITICAL_REGION_EXIT();
+
+    xTimerStart(m_mux.flush_timer, OSTIMER_WAIT_FOR_QUEUE);
+  }
+  else{
+    m_mux.active = false;
+    xTimerStop(m_mux.flush_timer, OSTIMER_WAIT_FOR_QUEUE);
+
+    __auto_type _stats = ic_mux_get_stats();
+    NRF_LOG_INFO("%d records in %d PDUs, %d/100 payload bytes per PDU\n",
+        _stats.records,
+        _stats.pdus,
+        _stats.pdus != 0 ? _stats.payload * 100 / _stats.pdus : 0);
+  }
+
+  m_drain();
+  m_notify_clients(active);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_service_mux_init(void){
+  if(m_mux.initialized)
+    return IC_SUCCESS;
+
+  ic_ring_clean(&m_packets.ring);
+
+  if(m_mux.flush_timer == NULL){
+    m_mux.flush_timer = xTimerCreate("MUX", IC_MUX_FLUSH_DEADLINE/4, pdTRUE, NULL, m_flush_callback);
+    if(m_mux.flush_timer == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+  }
+
+  ble_iccs_connect_to_mux(on_mux_state_change);
+
+  m_mux.initialized = true;
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_mux_connect(void (*p_func)(bool)){
+  for(int i = 0; i < IC_MUX_MAX_CLIENTS; ++i){
+    if(m_mux.clients[i] == NULL || m_mux.clients[i] == p_func){
+      m_mux.clients[i] = p_func;
+      return IC_SUCCESS;
+    }
+  }
+
+  return IC_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ic_mux_active(void){
+  return m_mux.active;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_mux_append(
+    ic_mux_record_e type,
+    uint32_t timestamp,
+    const void *data,
+    size_t len)
+{
+  if(len > UINT8_MAX)
+    return IC_ERROR;
+
+  __auto_type _ret_val = IC_SUCCESS;
+  __auto_type _sealed = false;
+
+  CRITICAL_REGION_ENTER();
+  if(!m_mux.active){
+    _ret_val = IC_BLE_NOT_CONNECTED;
+  }
+  else{
+    /* Producers are not synchronized, so dt can be negative */
+    __auto_type _dt = (int32_t)(timestamp - m_mux.last_tick);
+    __auto_type _sync = !m_mux.synced
+      || _dt < INT8_MIN
+      || _dt > INT8_MAX
+      || timestamp - m_mux.last_sync >= IC_MUX_SYNC_PERIOD;
+    __auto_type _needed = MUX_RECORD_HEADER + len
+      + (_sync ? MUX_RECORD_HEADER + sizeof(timestamp) : 0);
+
+    if(m_free() < _needed){
+      ++m_mux.stats.dropped;
+      _ret_val = IC_BUSY;
+    }
+    else{
+      __auto_type _count = IC_RING_COUNT(m_packets);
+
+      if(_sync){
+        m_record(IC_MUX_SYNC, 0, &timestamp, sizeof(timestamp));
+        m_mux.synced = true;
+        m_mux.last_sync = timestamp;
+        _dt = 0;
+      }
+      m_record(type, _dt, data, len);
+      m_mux.last_tick = timestamp;
+
+      ++m_mux.stats.records;
+      m_mux.stats.payload += len;
+      _sealed = IC_RING_COUNT(m_packets) != _count;
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(_sealed)
+    m_drain();
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_mux_stats_s ic_mux_get_stats(void){
+  ic_mux_stats_s _stats;
+
+  CRITICAL_REGION_ENTER();
+  _stats = m_mux.stats;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_mux_on_ble_evt(ble_evt_t *p_ble_evt){
+  switch(p_ble_evt->header.evt_id){
+    case BLE_EVT_TX_COMPLETE:
+      m_drain();
+      break;
+    default:
+      break;
+  }
+}
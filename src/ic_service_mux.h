@@ -0,0 +1,96 @@
+/**
+ * @file    ic_service_mux.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Multiplexed stream of tagged records
+ *
+ * Records from all producers are packed into one byte stream sent on mux characteristic. Stream is
+ * cut into full notifications, partially filled notification is sent after
+ * @ref IC_MUX_FLUSH_DEADLINE.
+ *
+ * Notification:  [seq:8][first:8][stream bytes:up to IC_MUX_PAYLOAD]
+ *  - seq   - notification counter, gap means lost bytes,
+ *  - first - offset of the first record starting in this notification, 0xFF when notification
+ *            carries only continuation of a record. Decoder resynchronizes from it after a gap.
+ *
+ * Record:        [type:8][len:8][dt:8][payload:len]
+ *  - dt    - ticks since previous record. SYNC record carries absolute tick count (uint32) and is
+ *            sent at start, when dt does not fit in 8 bits and every @ref IC_MUX_SYNC_PERIOD, so
+ *            decoder regains absolute time after lost notification.
+ *
+ * Multi-byte values are little endian.
+ */
+
+#ifndef IC_SERVICE_MUX_H
+#define IC_SERVICE_MUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ble.h"
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_MUX
+ *  @{
+ */
+
+#define IC_MUX_PACKET_SIZE  20
+#define IC_MUX_PAYLOAD      (IC_MUX_PACKET_SIZE - 2)
+#define IC_MUX_NO_RECORD    0xFF
+
+typedef enum{
+  IC_MUX_SYNC = 0x00,                 /** Payload - uint32 tick count */
+  IC_MUX_EEG,                         /** Payload - EEG samples */
+  IC_MUX_ACC_PPG,                     /** Payload - acc x, y, z, ir, red */
+  IC_MUX_POLICY,                      /** Payload - @ref ic_stream_policy_frame_s */
+  IC_MUX_BUDGET                       /** Payload - @ref ic_ltc_budget_frame_s */
+}ic_mux_record_e;
+
+typedef struct{
+  uint32_t pdus;                      /** Notifications sent */
+  uint32_t payload;                   /** Record payload bytes sent (without any headers) */
+  uint32_t records;
+  uint32_t dropped;                   /** Records dropped because buffers were full */
+}ic_mux_stats_s;
+
+ic_return_val_e ic_service_mux_init(void);
+
+/**
+ * @brief Connect module producing records. Callback is called when central subscribes (module has
+ * to sample) and unsubscribes.
+ */
+ic_return_val_e ic_mux_connect(void (*p_func)(bool));
+
+/**
+ * @brief Central subscribed to multiplexed stream.
+ */
+bool ic_mux_active(void);
+
+/**
+ * @brief Append record. Does not block, data is copied. Call from task.
+ *
+ * @return IC_SUCCESS, IC_BLE_NOT_CONNECTED when central is not subscribed, IC_BUSY when buffers
+ * are full, IC_ERROR when record is too long.
+ */
+ic_return_val_e ic_mux_append(
+    ic_mux_record_e type,
+    uint32_t timestamp,
+    const void *data,
+    size_t len);
+
+/**
+ * @brief Efficiency is payload/pdus bytes per notification.
+ */
+ic_mux_stats_s ic_mux_get_stats(void);
+
+/**
+ * @brief Sends buffered notifications when SoftDevice released its buffers.
+ */
+void ic_mux_on_ble_evt(ble_evt_t *p_ble_evt);
+
+/** @} */
+
+#endif /* !IC_SERVICE_MUX_H */
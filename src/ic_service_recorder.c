@@ -0,0 +1,942 @@
+/**
+ * @file    ic_service_recorder.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Offline session recording to external flash
+ *
+ * Stream tasks copy frames into RAM pages under critical region, recorder task is the only flash
+ * user: it programs sealed pages, keeps the index journal and runs work of attached module (bulk
+ * download). Index and allocator state are touched only by recorder task.
+ */
+
+#include <string.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "crc16.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "RECORDER"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_service_recorder.h"
+#include "ic_service_time.h"
+#include "ic_ble_service.h"
+#include "ic_ring_buffer.h"
+
+_Static_assert(
+    sizeof(ic_recorder_page_s) == IC_FLASH_PAGE_SIZE,
+    "Recorder page has to fill flash page");
+_Static_assert(
+    sizeof(ic_recorder_index_s) == 16,
+    "Index records have to fill flash pages");
+_Static_assert(
+    IC_RECORDER_INDEX_SECTORS*IC_FLASH_SECTOR_SIZE <= IC_FLASH_BLOCK_SIZE,
+    "Index has to fit in the first block");
+_Static_assert(IC_RECORDER_MAX_BLOCKS <= UINT8_MAX, "Block number is 8 bit");
+
+#define RECORDER_NO_ADDRESS       UINT32_MAX
+#define RECORDER_FREE             UINT32_MAX
+#define RECORDER_NO_BLOCK         UINT8_MAX
+#define RECORDER_PAGES_PER_BLOCK  (IC_FLASH_BLOCK_SIZE/IC_FLASH_PAGE_SIZE)
+#define RECORDER_INDEX_RECORDS    (IC_FLASH_SECTOR_SIZE/sizeof(ic_recorder_index_s))
+#define RECORDER_SCAN_CHUNK       8
+
+/**
+ * @brief Pages filled by stream tasks (MPSC), programmed by recorder task. Page being filled is
+ * IC_RING_NEXT slot.
+ */
+static IC_RING_BUFFER(ic_recorder_page_s, IC_RECORDER_PAGE_BUFFERS) m_pages;
+
+/** Session page. Used only by recorder task */
+static ic_recorder_page_s m_scratch;
+
+/** Sequence of first page of block (RECORDER_FREE when block is free) and its erase cycles */
+static uint32_t m_block_first[IC_RECORDER_MAX_BLOCKS];
+static uint16_t m_block_erases[IC_RECORDER_MAX_BLOCKS];
+
+/** Live index records of block. Used only by recorder task while index is compacted */
+static uint16_t m_block_records[IC_RECORDER_MAX_BLOCKS];
+
+static struct{
+  bool initialized;
+  bool volatile active;
+  uint16_t volatile headed;           /** The newest session with header page written */
+  uint8_t fill_len;                   /** Payload bytes in page being filled */
+  TickType_t fill_started;
+  uint32_t address;                   /** Next page to program, RECORDER_NO_ADDRESS - new block */
+  uint32_t erased;                    /** Sector erased in advance */
+  uint32_t sequence;
+  uint16_t session;
+  uint8_t blocks;                     /** Data blocks in flash */
+  uint8_t next_block;                 /** Block chosen in advance */
+  uint8_t index_sector;
+  uint16_t volatile index_slot;       /** First free record in index sector */
+  uint32_t index_generation;
+  ic_recorder_stats_s stats;
+  TaskHandle_t task;
+  TickType_t (*worker)(void);         /** Attached by other flash user, see @ref ic_recorder_attach */
+  void (*clients[IC_RECORDER_MAX_CLIENTS])(bool);
+}m_recorder;
+
+static void m_wake_task(void){
+  if(m_recorder.task == NULL)
+    return;
+
+  if(isr_context()){
+    __auto_type _yield_required = pdFALSE;
+    vTaskNotifyGiveFromISR(m_recorder.task, &_yield_required);
+    portYIELD_FROM_ISR(_yield_required);
+  }
+  else{
+    xTaskNotifyGive(m_recorder.task);
+  }
+}
+
+/**
+ * @brief Pass page being filled to recorder task. Called with interrupts disabled.
+ */
+static void m_seal(void){
+  if(m_recorder.fill_len == 0)
+    return;
+
+  __auto_type _page = &IC_RING_NEXT(m_pages);
+  _page->header.type = IC_RECORDER_PAGE_DATA;
+  _page->header.len = m_recorder.fill_len;
+  _page->header.session = m_recorder.session;
+  memset(
+      &_page->payload[m_recorder.fill_len],
+      0xFF,
+      IC_RECORDER_PAGE_PAYLOAD - m_recorder.fill_len);
+
+  ic_ring_commit(&m_pages.ring);
+  m_recorder.fill_len = 0;
+}
+
+static void m_notify_clients(bool active){
+  for(int i = 0; i < IC_RECORDER_MAX_CLIENTS; ++i)
+    if(m_recorder.clients[i] != NULL)
+      m_recorder.clients[i](active);
+}
+
+static inline uint32_t m_block_address(uint8_t block){
+  return (block + 1) * IC_FLASH_BLOCK_SIZE;
+}
+
+static inline uint32_t m_index_address(uint8_t sector, uint16_t slot){
+  return sector * IC_FLASH_SECTOR_SIZE + slot * sizeof(ic_recorder_index_s);
+}
+
+static inline uint32_t m_now(void){
+  return (uint32_t)ic_unix_timestamp_get().unix_timestamp;
+}
+
+/* Flash can be busy with download, synchronous calls are retried */
+static bool m_read_sync(uint32_t address, void *data, size_t len){
+  ic_return_val_e _ret_val;
+
+  while((_ret_val = ic_flash_read(address, data, len, NULL, NULL)) == IC_BUSY)
+    vTaskDelay(1);
+
+  return _ret_val == IC_SUCCESS;
+}
+
+static bool m_program_sync(uint32_t address, const void *data, size_t len){
+  ic_return_val_e _ret_val;
+
+  while((_ret_val = ic_flash_program(address, (uint8_t *)data, len, NULL, NULL)) == IC_BUSY)
+    vTaskDelay(1);
+
+  if(_ret_val != IC_SUCCESS)
+    ++m_recorder.stats.errors;
+
+  return _ret_val == IC_SUCCESS;
+}
+
+static ic_return_val_e m_erase_sector(uint32_t address){
+  ic_return_val_e _ret_val;
+
+  while((_ret_val = ic_flash_erase(address, IC_FLASH_ERASE_SECTOR, NULL, NULL)) == IC_BUSY)
+    vTaskDelay(1);
+
+  if(_ret_val != IC_SUCCESS)
+    ++m_recorder.stats.errors;
+
+  return _ret_val;
+}
+
+/**
+ * @brief Page headers and index records start with non 0xFFFF field.
+ */
+static bool m_erased(uint32_t address){
+  uint16_t _value;
+
+  return !m_read_sync(address, &_value, sizeof(_value)) || _value == UINT16_MAX;
+}
+
+/**
+ * @brief Page was programmed since block was allocated with given first sequence. Sectors ahead of
+ * write position are erased one by one, until then they hold pages of previous use of the block.
+ */
+static bool m_page_written(uint32_t address, uint32_t first){
+  ic_recorder_page_header_s _header;
+
+  if(!m_read_sync(address, &_header, sizeof(_header)) || _header.magic == UINT16_MAX)
+    return false;
+
+  return _header.magic != IC_RECORDER_MAGIC || _header.sequence >= first;
+}
+
+static uint16_t m_index_crc(const ic_recorder_index_s *record){
+  return crc16_compute((const uint8_t *)record, offsetof(ic_recorder_index_s, crc), NULL);
+}
+
+static bool m_index_valid(const ic_recorder_index_s *record){
+  return record->type >= IC_RECORDER_INDEX_HEADER
+    && record->type <= IC_RECORDER_INDEX_SESSION
+    && record->crc == m_index_crc(record);
+}
+
+static bool m_index_read(uint8_t sector, uint16_t slot, ic_recorder_index_s *record){
+  return m_read_sync(m_index_address(sector, slot), record, sizeof(*record))
+    && m_index_valid(record);
+}
+
+/**
+ * @brief Record describes data which was not overwritten.
+ */
+static bool m_index_live(const ic_recorder_index_s *record){
+  if(record->block >= m_recorder.blocks)
+    return false;
+
+  __auto_type _first = m_block_first[record->block];
+
+  switch(record->type){
+    case IC_RECORDER_INDEX_BLOCK:
+      return _first != RECORDER_FREE && _first == record->sequence;
+    case IC_RECORDER_INDEX_SESSION:
+      return _first != RECORDER_FREE && _first <= record->sequence;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief BLOCK record of block freed by compaction, keeps its erase counter.
+ */
+static bool m_index_freed(const ic_recorder_index_s *record){
+  return record->type == IC_RECORDER_INDEX_BLOCK
+    && record->sequence == RECORDER_FREE
+    && record->block < m_recorder.blocks
+    && m_block_first[record->block] == RECORDER_FREE;
+}
+
+/**
+ * @brief Call handler for valid records from slots [first, last) of index sector.
+ */
+static void m_index_scan(
+    uint8_t sector,
+    uint16_t first,
+    uint16_t last,
+    void (*handler)(const ic_recorder_index_s *, void *),
+    void *context)
+{
+  ic_recorder_index_s _records[RECORDER_SCAN_CHUNK];
+
+  for(uint16_t _slot = first; _slot < last; _slot += RECORDER_SCAN_CHUNK){
+    __auto_type _count = MIN(last - _slot, RECORDER_SCAN_CHUNK);
+
+    if(!m_read_sync(m_index_address(sector, _slot), _records, _count * sizeof(_records[0]))){
+      ++m_recorder.stats.errors;
+      continue;
+    }
+
+    for(int i = 0; i < _count; ++i)
+      if(m_index_valid(&_records[i]))
+        handler(&_records[i], context);
+  }
+}
+
+static void m_index_write(ic_recorder_index_s *record){
+  record->crc = m_index_crc(record);
+
+  if(m_program_sync(
+        m_index_address(m_recorder.index_sector, m_recorder.index_slot),
+        record,
+        sizeof(*record)))
+  {
+    ++m_recorder.stats.index_records;
+  }
+
+  ++m_recorder.index_slot;
+}
+
+/**
+ * @brief Erase sector and make it the current one. Header is written by @ref m_index_commit.
+ */
+static void m_index_open(uint8_t sector){
+  m_erase_sector(m_index_address(sector, 0));
+  m_recorder.index_sector = sector;
+  m_recorder.index_slot = 1;
+}
+
+/**
+ * @brief Write header of current sector. Until then sector with previous generation stays valid.
+ */
+static void m_index_commit(uint32_t generation){
+  ic_recorder_index_s _header = {
+    .type = IC_RECORDER_INDEX_HEADER,
+    .sequence = generation,
+    .timestamp = m_now()
+  };
+  _header.crc = m_index_crc(&_header);
+
+  if(m_program_sync(m_index_address(m_recorder.index_sector, 0), &_header, sizeof(_header)))
+    ++m_recorder.stats.index_records;
+
+  m_recorder.index_generation = generation;
+}
+
+static void m_index_count_live(const ic_recorder_index_s *record, void *context){
+  if(!m_index_live(record) && !m_index_freed(record))
+    return;
+
+  ++*(uint16_t *)context;
+  ++m_block_records[record->block];
+}
+
+static void m_index_copy_live(const ic_recorder_index_s *record, void *context){
+  UNUSED_PARAMETER(context);
+
+  if(!m_index_live(record) && !m_index_freed(record))
+    return;
+
+  __auto_type _copy = *record;
+  m_index_write(&_copy);
+}
+
+/**
+ * @brief Free the oldest blocks until live records fill at most half of index sector.
+ *
+ * Block being written (the newest one) is never freed. Every freed block is left with one record.
+ *
+ * @return Bit mask of freed blocks.
+ */
+static uint64_t m_index_free_oldest(uint16_t live){
+  _Static_assert(IC_RECORDER_MAX_BLOCKS <= 64, "Freed blocks mask is 64 bit");
+  uint64_t _freed = 0;
+
+  while(live > RECORDER_INDEX_RECORDS/2){
+    __auto_type _oldest = RECORDER_NO_BLOCK;
+    __auto_type _used = 0;
+
+    for(uint8_t i = 0; i < m_recorder.blocks; ++i){
+      if(m_block_first[i] == RECORDER_FREE)
+        continue;
+      ++_used;
+      if(_oldest == RECORDER_NO_BLOCK || m_block_first[i] < m_block_first[_oldest])
+        _oldest = i;
+    }
+
+    if(_used < 2)
+      break;
+
+    NRF_LOG_INFO("block %d freed, %d records\n", _oldest, m_block_records[_oldest]);
+    m_block_first[_oldest] = RECORDER_FREE;
+    live -= m_block_records[_oldest] - 1;
+    _freed |= 1ULL << _oldest;
+    if(m_recorder.next_block == _oldest)
+      m_recorder.next_block = RECORDER_NO_BLOCK;
+  }
+
+  return _freed;
+}
+
+/**
+ * @brief Copy live records to the next index sector.
+ *
+ * New sector gets its header only after all records are copied, power loss in between leaves the
+ * old sector valid. When there are too many live records, the oldest blocks are freed (their
+ * records are not live anymore) so at least half of sector is free.
+ */
+static void m_index_compact(void){
+  __auto_type _sector = m_recorder.index_sector;
+  __auto_type _used = m_recorder.index_slot;
+  uint16_t _live = 0;
+
+  memset(m_block_records, 0, sizeof(m_block_records));
+  m_index_scan(_sector, 1, _used, m_index_count_live, &_live);
+  __auto_type _freed = m_index_free_oldest(_live);
+
+  m_index_open((_sector + 1) % IC_RECORDER_INDEX_SECTORS);
+
+  /* Freed blocks go first, records stay ordered by session and time */
+  for(uint8_t i = 0; i < m_recorder.blocks; ++i){
+    if((_freed & (1ULL << i)) == 0)
+      continue;
+
+    ic_recorder_index_s _record = {
+      .type         = IC_RECORDER_INDEX_BLOCK,
+      .block        = i,
+      .sequence     = RECORDER_FREE,
+      .erase_count  = m_block_erases[i]
+    };
+    m_index_write(&_record);
+  }
+
+  m_index_scan(_sector, 1, _used, m_index_copy_live, NULL);
+  m_index_commit(m_recorder.index_generation + 1);
+
+  NRF_LOG_INFO("index moved to sector %d, %d records\n",
+      m_recorder.index_sector,
+      m_recorder.index_slot);
+}
+
+static void m_index_append(ic_recorder_index_s *record){
+  if(m_recorder.index_slot >= RECORDER_INDEX_RECORDS)
+    m_index_compact();
+
+  m_index_write(record);
+}
+
+/**
+ * @brief The least worn free block or the oldest one when all blocks are used.
+ */
+static uint8_t m_choose_block(void){
+  __auto_type _free = RECORDER_NO_BLOCK;
+  __auto_type _oldest = RECORDER_NO_BLOCK;
+
+  for(uint8_t i = 0; i < m_recorder.blocks; ++i){
+    if(m_block_first[i] == RECORDER_FREE){
+      if(_free == RECORDER_NO_BLOCK || m_block_erases[i] < m_block_erases[_free])
+        _free = i;
+    }
+    else if(_oldest == RECORDER_NO_BLOCK || m_block_first[i] < m_block_first[_oldest]){
+      _oldest = i;
+    }
+  }
+
+  return _free != RECORDER_NO_BLOCK ? _free : _oldest;
+}
+
+static void m_alloc_block(uint16_t session){
+  __auto_type _block = m_recorder.next_block;
+  if(_block == RECORDER_NO_BLOCK)
+    _block = m_choose_block();
+  m_recorder.next_block = RECORDER_NO_BLOCK;
+
+  m_block_first[_block] = m_recorder.sequence;
+  ++m_block_erases[_block];
+  m_recorder.address = m_block_address(_block);
+
+  ic_recorder_index_s _record = {
+    .type         = IC_RECORDER_INDEX_BLOCK,
+    .block        = _block,
+    .session      = session,
+    .sequence     = m_recorder.sequence,
+    .timestamp    = m_now(),
+    .erase_count  = m_block_erases[_block]
+  };
+  m_index_append(&_record);
+}
+
+/**
+ * @brief Journal that block holds no data. Index must not describe a block with erased sectors.
+ */
+static void m_free_block(uint8_t block){
+  if(m_block_first[block] == RECORDER_FREE)
+    return;
+
+  NRF_LOG_INFO("block %d reused\n", block);
+  m_block_first[block] = RECORDER_FREE;
+
+  ic_recorder_index_s _record = {
+    .type         = IC_RECORDER_INDEX_BLOCK,
+    .block        = block,
+    .session      = m_recorder.headed,
+    .sequence     = RECORDER_FREE,
+    .timestamp    = m_now(),
+    .erase_count  = m_block_erases[block]
+  };
+  m_index_append(&_record);
+}
+
+/**
+ * @brief Sector following the one at address. Next block is chosen when block ends, when flash is
+ * full it is the oldest block, which is freed before its first sector is erased in advance.
+ */
+static uint32_t m_next_sector(uint32_t address){
+  __auto_type _next = (address / IC_FLASH_SECTOR_SIZE + 1) * IC_FLASH_SECTOR_SIZE;
+  if(_next % IC_FLASH_BLOCK_SIZE != 0)
+    return _next;
+
+  if(m_recorder.next_block == RECORDER_NO_BLOCK){
+    __auto_type _block = m_choose_block();
+    m_free_block(_block);
+    m_recorder.next_block = _block;
+  }
+
+  return m_block_address(m_recorder.next_block);
+}
+
+/**
+ * @brief Program page at write position. Type, length and session have to be set by caller.
+ */
+static void m_program(ic_recorder_page_s *page){
+  if(m_recorder.address == RECORDER_NO_ADDRESS)
+    m_alloc_block(page->header.session);
+
+  __auto_type _address = m_recorder.address;
+  __auto_type _sector_start = _address % IC_FLASH_SECTOR_SIZE == 0;
+
+  if(_sector_start && m_recorder.erased != _address)
+    m_erase_sector(_address);
+
+  page->header.magic = IC_RECORDER_MAGIC;
+  page->header.sequence = m_recorder.sequence++;
+  page->header.crc = 0;
+  page->header.crc = crc16_compute((uint8_t *)page, sizeof(*page), NULL);
+
+  if(m_program_sync(_address, page, sizeof(*page)))
+    ++m_recorder.stats.pages;
+
+  m_recorder.address = _address + IC_FLASH_PAGE_SIZE;
+  m_recorder.stats.head = m_recorder.address;
+  if(m_recorder.address % IC_FLASH_BLOCK_SIZE == 0)
+    m_recorder.address = RECORDER_NO_ADDRESS;
+
+  /* Erase next sector while current one is being filled */
+  if(_sector_start){
+    __auto_type _next = m_next_sector(_address);
+    if(m_erase_sector(_next) == IC_SUCCESS)
+      m_recorder.erased = _next;
+  }
+}
+
+static void m_write_session(uint16_t session){
+  if(m_recorder.address == RECORDER_NO_ADDRESS)
+    m_alloc_block(session);
+
+  ic_recorder_session_s _session = {
+    .version        = IC_RECORDER_VERSION,
+    .tick_rate      = configTICK_RATE_HZ,
+    .start_tick     = GET_TICK_COUNT(),
+    .unix_timestamp = ic_unix_timestamp_get().unix_timestamp
+  };
+
+  ic_recorder_index_s _record = {
+    .type       = IC_RECORDER_INDEX_SESSION,
+    .block      = m_recorder.address / IC_FLASH_BLOCK_SIZE - 1,
+    .session    = session,
+    .sequence   = m_recorder.sequence,
+    .timestamp  = (uint32_t)_session.unix_timestamp,
+    .page       = m_recorder.address % IC_FLASH_BLOCK_SIZE / IC_FLASH_PAGE_SIZE
+  };
+  m_index_append(&_record);
+
+  memset(&m_scratch, 0xFF, sizeof(m_scratch));
+  memcpy(m_scratch.payload, &_session, sizeof(_session));
+  m_scratch.header.type = IC_RECORDER_PAGE_SESSION;
+  m_scratch.header.len = sizeof(_session);
+  m_scratch.header.session = session;
+
+  NRF_LOG_INFO("session %d at 0x%06X\n", session, m_recorder.address);
+
+  m_program(&m_scratch);
+  m_recorder.headed = session;
+}
+
+static void recorder_task(void *arg){
+  UNUSED_PARAMETER(arg);
+  TickType_t _wait = IC_RECORDER_FLUSH_PERIOD/4;
+
+  for(;;){
+    (void)ulTaskNotifyTake(pdTRUE, _wait);
+
+    CRITICAL_REGION_ENTER();
+    __auto_type _age = GET_TICK_COUNT() - m_recorder.fill_started;
+    if(m_recorder.fill_len != 0 && (!m_recorder.active || _age >= IC_RECORDER_FLUSH_PERIOD))
+      m_seal();
+    CRITICAL_REGION_EXIT();
+
+    while(!IC_RING_EMPTY(m_pages)){
+      __auto_type _page = &IC_RING_FIRST(m_pages);
+      /*
+       * Header goes before the first page of session. Sessions can start faster than task writes
+       * pages, so any queued page can start one.
+       */
+      if(_page->header.session != m_recorder.headed)
+        m_write_session(_page->header.session);
+
+      m_program(_page);
+      ic_ring_release(&m_pages.ring);
+    }
+
+    /*
+     * Session without pages yet, empty sessions started in between get no header. Not while log is
+     * being mounted.
+     */
+    __auto_type _session = m_recorder.session;
+    if(m_recorder.initialized && _session != m_recorder.headed)
+      m_write_session(_session);
+
+    _wait = IC_RECORDER_FLUSH_PERIOD/4;
+    if(m_recorder.worker != NULL)
+      _wait = MIN(_wait, m_recorder.worker());
+  }
+}
+
+static void m_replay(const ic_recorder_index_s *record, void *context){
+  __auto_type _last_block = (uint8_t *)context;
+
+  if(record->block >= m_recorder.blocks)
+    return;
+
+  if(record->type == IC_RECORDER_INDEX_BLOCK){
+    m_block_first[record->block] = record->sequence;
+    m_block_erases[record->block] = record->erase_count;
+    if(record->sequence != RECORDER_FREE)
+      *_last_block = record->block;
+  }
+
+  if(record->session > m_recorder.session)
+    m_recorder.session = record->session;
+}
+
+/**
+ * @brief Restore allocator and write position from index. Reads index sector headers, binary
+ * searches end of index and of the newest block and replays the newest index sector.
+ */
+static void m_mount(void){
+  __auto_type _found = false;
+  ic_recorder_index_s _record;
+
+  m_recorder.sequence = 0;
+  m_recorder.session = 0;
+  m_recorder.address = RECORDER_NO_ADDRESS;
+  m_recorder.erased = UINT32_MAX;
+  m_recorder.next_block = RECORDER_NO_BLOCK;
+  m_recorder.blocks = MIN(ic_flash_size() / IC_FLASH_BLOCK_SIZE - 1, IC_RECORDER_MAX_BLOCKS);
+  memset(m_block_first, 0xFF, sizeof(m_block_first));
+  memset(m_block_erases, 0, sizeof(m_block_erases));
+
+  for(uint8_t _sector = 0; _sector < IC_RECORDER_INDEX_SECTORS; ++_sector){
+    if(m_index_read(_sector, 0, &_record)
+        && _record.type == IC_RECORDER_INDEX_HEADER
+        && (!_found || _record.sequence > m_recorder.index_generation))
+    {
+      _found = true;
+      m_recorder.index_sector = _sector;
+      m_recorder.index_generation = _record.sequence;
+    }
+  }
+
+  if(!_found){
+    NRF_LOG_INFO("no index, formatting\n");
+    m_index_open(0);
+    m_index_commit(0);
+    return;
+  }
+
+  /* Records are appended in order, free slots are at the end of sector */
+  uint16_t _low = 1, _high = RECORDER_INDEX_RECORDS;
+  while(_low < _high){
+    __auto_type _mid = (_low + _high) / 2;
+    if(m_erased(m_index_address(m_recorder.index_sector, _mid)))
+      _high = _mid;
+    else
+      _low = _mid + 1;
+  }
+  m_recorder.index_slot = _low;
+
+  uint8_t _block = RECORDER_NO_BLOCK;
+  m_index_scan(m_recorder.index_sector, 1, m_recorder.index_slot, m_replay, &_block);
+
+  if(_block == RECORDER_NO_BLOCK)
+    return;
+
+  /* Pages of block are written in order, find the first one not written since allocation */
+  __auto_type _base = m_block_address(_block);
+  _low = 0;
+  _high = RECORDER_PAGES_PER_BLOCK;
+  while(_low < _high){
+    __auto_type _mid = (_low + _high) / 2;
+    if(!m_page_written(_base + _mid * IC_FLASH_PAGE_SIZE, m_block_first[_block]))
+      _high = _mid;
+    else
+      _low = _mid + 1;
+  }
+
+  m_recorder.sequence = m_block_first[_block] + _low;
+  if(_low < RECORDER_PAGES_PER_BLOCK)
+    m_recorder.address = _base + _low * IC_FLASH_PAGE_SIZE;
+}
+
+/**
+ * @brief Records are ordered by session and time.
+ */
+static bool m_index_not_after(const ic_recorder_index_s *record, uint16_t session, uint32_t time){
+  return record->session < session || (record->session == session && record->timestamp <= time);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_service_recorder_init(void){
+  if(m_recorder.initialized)
+    return IC_SUCCESS;
+
+  __auto_type _ret_val = ic_flash_init();
+  if(_ret_val != IC_SUCCESS){
+    NRF_LOG_ERROR("Couldn't initialize flash driver\n");
+    return _ret_val;
+  }
+
+  if(ic_flash_size() < 2*IC_FLASH_BLOCK_SIZE){
+    NRF_LOG_ERROR("Flash too small\n");
+    ic_flash_deinit();
+    return IC_ERROR;
+  }
+
+  __auto_type _mount_start = GET_TICK_COUNT();
+  m_mount();
+  m_recorder.stats.mount_ticks = GET_TICK_COUNT() - _mount_start;
+  m_recorder.headed = m_recorder.session;
+  m_recorder.stats.session = m_recorder.session;
+  m_recorder.stats.head = m_recorder.address;
+  ic_ring_clean(&m_pages.ring);
+  m_recorder.fill_len = 0;
+
+  NRF_LOG_INFO("mounted in %d ticks: last session %d, next page 0x%06X\n",
+      m_recorder.stats.mount_ticks,
+      m_recorder.session,
+      m_recorder.address);
+
+  if(m_recorder.task == NULL)
+    if(pdPASS != xTaskCreate(
+          recorder_task,
+          "RECORDER",
+          192,
+          NULL,
+          IC_RECORDER_TASK_PRIORITY,
+          &m_recorder.task))
+    {
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+    }
+
+  m_recorder.initialized = true;
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_service_recorder_deinit(void){
+  if(!m_recorder.initialized)
+    return IC_NOT_INIALIZED;
+
+  ic_recorder_stop();
+
+  /* Let recorder task write buffered pages */
+  while(!IC_RING_EMPTY(m_pages) || m_recorder.headed != m_recorder.session)
+    vTaskDelay(1);
+
+  m_recorder.initialized = false;
+
+  return ic_flash_deinit();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_recorder_connect(void (*p_func)(bool)){
+  for(int i = 0; i < IC_RECORDER_MAX_CLIENTS; ++i){
+    if(m_recorder.clients[i] == NULL || m_recorder.clients[i] == p_func){
+      m_recorder.clients[i] = p_func;
+      return IC_SUCCESS;
+    }
+  }
+
+  return IC_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_recorder_attach(TickType_t (*p_func)(void)){
+  if(m_recorder.task == NULL)
+    return IC_NOT_INIALIZED;
+
+  if(m_recorder.worker != NULL && m_recorder.worker != p_func)
+    return IC_ERROR;
+
+  m_recorder.worker = p_func;
+  m_wake_task();
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_recorder_wake(void){
+  m_wake_task();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_recorder_start(void){
+  if(!m_recorder.initialized)
+    return IC_NOT_INIALIZED;
+
+  if(m_recorder.active)
+    return IC_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  m_seal();
+  ++m_recorder.session;
+  m_recorder.stats.session = m_recorder.session;
+  m_recorder.active = true;
+  CRITICAL_REGION_EXIT();
+
+  m_wake_task();
+  m_notify_clients(true);
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_recorder_stop(void){
+  if(!m_recorder.active)
+    return IC_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  m_recorder.active = false;
+  m_seal();
+  CRITICAL_REGION_EXIT();
+
+  m_wake_task();
+  m_notify_clients(false);
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ic_recorder_active(void){
+  return m_recorder.active;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_recorder_append(ic_recorder_stream_e stream, const uint8_t *data, size_t len){
+  if(len > IC_RECORDER_PAGE_PAYLOAD - sizeof(ic_recorder_record_s))
+    return IC_ERROR;
+
+  __auto_type _ret_val = IC_SUCCESS;
+  __auto_type _wake = false;
+
+  CRITICAL_REGION_ENTER();
+  if(!m_recorder.active){
+    _ret_val = IC_NOT_INIALIZED;
+  }
+  else{
+    if(m_recorder.fill_len + sizeof(ic_recorder_record_s) + len > IC_RECORDER_PAGE_PAYLOAD){
+      m_seal();
+      _wake = true;
+    }
+
+    if(IC_RING_FULL(m_pages)){
+      ++m_recorder.stats.dropped;
+      _ret_val = IC_BUSY;
+    }
+    else{
+      if(m_recorder.fill_len == 0)
+        m_recorder.fill_started = GET_TICK_COUNT();
+
+      __auto_type _record =
+        (ic_recorder_record_s *)&IC_RING_NEXT(m_pages).payload[m_recorder.fill_len];
+      _record->stream = stream;
+      _record->len = len;
+      memcpy(_record->data, data, len);
+      m_recorder.fill_len += sizeof(ic_recorder_record_s) + len;
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  if(_wake)
+    m_wake_task();
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_recorder_stats_s ic_recorder_get_stats(void){
+  ic_recorder_stats_s _stats;
+
+  CRITICAL_REGION_ENTER();
+  _stats = m_recorder.stats;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_recorder_seek(uint16_t session, uint32_t timestamp, uint32_t *address){
+  if(!m_recorder.initialized)
+    return IC_NOT_INIALIZED;
+
+  uint8_t _sector;
+  uint16_t _used;
+
+  /* Sector is not erased until index wraps, records appended later are not needed */
+  CRITICAL_REGION_ENTER();
+  _sector = m_recorder.index_sector;
+  _used = m_recorder.index_slot;
+  CRITICAL_REGION_EXIT();
+
+  /* The first record after (session, timestamp), damaged records are skipped as older ones */
+  uint16_t _low = 1, _high = _used;
+  ic_recorder_index_s _record;
+  while(_low < _high){
+    __auto_type _mid = (_low + _high) / 2;
+    if(!m_index_read(_sector, _mid, &_record)
+        || _record.type == IC_RECORDER_INDEX_HEADER
+        || m_index_not_after(&_record, session, timestamp))
+      _low = _mid + 1;
+    else
+      _high = _mid;
+  }
+
+  /*
+   * Record before it covers timestamp. When it belongs to previous session use session start, when
+   * its block was reused use the oldest data left.
+   */
+  __auto_type _found = _low > 1
+    && m_index_read(_sector, _low - 1, &_record)
+    && _record.session == session
+    && m_index_live(&_record);
+
+  if(!_found)
+    _found = _low < _used
+      && m_index_read(_sector, _low, &_record)
+      && _record.session == session
+      && m_index_live(&_record);
+
+  if(!_found)
+    return IC_ERROR;
+
+  *address = m_block_address(_record.block);
+  if(_record.type == IC_RECORDER_INDEX_SESSION)
+    *address += _record.page * IC_FLASH_PAGE_SIZE;
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_recorder_on_ble_evt(ble_evt_t *p_ble_evt){
+  switch(p_ble_evt->header.evt_id){
+    case BLE_GAP_EVT_CONNECTED:
+      ic_recorder_stop();
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      if(ble_iccs_stream0_ready() || ble_iccs_stream1_ready() || ble_iccs_mux_ready())
+        ic_recorder_start();
+      break;
+    default:
+      break;
+  }
+}
@@ -0,0 +1,207 @@
+/**
+ * @file    ic_service_recorder.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Offline session recording to external flash
+ *
+ * Frames which could not be sent over BLE are appended to external flash as an append-only log of
+ * 256B pages, every page is protected with CRC16 and has global sequence number. Session starts
+ * with session header page.
+ *
+ * Flash layout:
+ *  - first @ref IC_RECORDER_INDEX_SECTORS sectors - index journal of
+ *    @ref ic_recorder_index_s records. Records are appended to one sector, when it is full live
+ *    records are copied to the next one (sectors are used round robin) and its HEADER is written
+ *    last. Sector with the newest HEADER generation is valid. When live records would fill more
+ *    than half of sector, the oldest blocks are freed, BLOCK record with UINT32_MAX sequence
+ *    keeps their erase counters.
+ *  - following 64kB blocks - data pages. Pages of a block are written in order. Allocator takes the
+ *    least worn free block, when flash is full the oldest block is reused. Every allocation is
+ *    recorded in index with block erase counter.
+ *
+ * Records are ordered by page sequence, so data can be found by session and time with binary
+ * search of index and log is mounted from index without reading data blocks. Sector ahead of
+ * write position is erased in advance. When it is the first sector of reused (the oldest) block,
+ * the block is freed in index before the erase, so power loss never leaves index pointing at erased
+ * data.
+ *
+ * Frames are gathered in RAM pages and programmed by recorder task. Page is written when it is full
+ * or when it is older than @ref IC_RECORDER_FLUSH_PERIOD, so power loss costs at most
+ * @ref IC_RECORDER_FLUSH_PERIOD of data plus pages waiting for flash.
+ */
+
+#ifndef IC_SERVICE_RECORDER_H
+#define IC_SERVICE_RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ble.h"
+
+#include "FreeRTOS.h"
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+#include "ic_driver_flash.h"
+
+/** @defgroup IC_RECORDER
+ *  @{
+ */
+
+#define IC_RECORDER_MAGIC         0x5243  /* "CR" */
+#define IC_RECORDER_VERSION       2
+
+typedef enum{
+  IC_RECORDER_PAGE_SESSION = 0x01,    /** Payload - @ref ic_recorder_session_s */
+  IC_RECORDER_PAGE_DATA               /** Payload - @ref ic_recorder_record_s records */
+}ic_recorder_page_e;
+
+typedef enum{
+  IC_RECORDER_EEG = 0x01,             /** Stream0 frame */
+  IC_RECORDER_ACC_PPG                 /** Stream1 frame */
+}ic_recorder_stream_e;
+
+typedef enum{
+  IC_RECORDER_INDEX_HEADER = 0x01,    /** First record of index sector, sequence - generation */
+  IC_RECORDER_INDEX_BLOCK,            /** Block allocated (first page sequence and time) or freed */
+  IC_RECORDER_INDEX_SESSION           /** Session header page sequence and time */
+}ic_recorder_index_e;
+
+typedef struct __attribute__((packed)){
+  uint8_t type;                       /** @ref ic_recorder_index_e */
+  uint8_t block;                      /** Data block, 0 is the first block after index */
+  uint16_t session;                   /** Session of the page */
+  uint32_t sequence;
+  uint32_t timestamp;                 /** Unix time (s) */
+  union{
+    uint16_t erase_count;             /** BLOCK - erase cycles of block */
+    uint16_t page;                    /** SESSION - page in block */
+  };
+  uint16_t crc;                       /** CRC16 of record without this field */
+}ic_recorder_index_s;
+
+typedef struct __attribute__((packed)){
+  uint16_t magic;
+  uint8_t type;                       /** @ref ic_recorder_page_e */
+  uint8_t len;                        /** Used payload bytes */
+  uint16_t session;
+  uint16_t crc;                       /** CRC16 of whole page with this field set to 0 */
+  uint32_t sequence;                  /** Global page number, never repeats */
+}ic_recorder_page_header_s;
+
+#define IC_RECORDER_PAGE_PAYLOAD  (IC_FLASH_PAGE_SIZE - sizeof(ic_recorder_page_header_s))
+
+typedef struct __attribute__((packed)){
+  ic_recorder_page_header_s header;
+  uint8_t payload[IC_RECORDER_PAGE_PAYLOAD];
+}ic_recorder_page_s;
+
+/**
+ * @brief Payload of session page
+ */
+typedef struct __attribute__((packed)){
+  uint16_t version;
+  uint16_t tick_rate;                 /** Frames timestamps ticks per second */
+  uint32_t start_tick;
+  uint64_t unix_timestamp;            /** 0 when time was not set */
+}ic_recorder_session_s;
+
+/**
+ * @brief Record in data page. Records do not cross pages.
+ */
+typedef struct __attribute__((packed)){
+  uint8_t stream;                     /** @ref ic_recorder_stream_e */
+  uint8_t len;
+  uint8_t data[];
+}ic_recorder_record_s;
+
+typedef struct{
+  uint32_t pages;                     /** Pages written */
+  uint32_t dropped;                   /** Frames dropped because page buffers were full */
+  uint16_t errors;                    /** Flash errors */
+  uint16_t session;                   /** Current (or last) session */
+  uint32_t head;                      /** Next page to be written */
+  uint32_t index_records;             /** Index records written (with copies) */
+  uint32_t mount_ticks;               /** Time of last mount */
+}ic_recorder_stats_s;
+
+/**
+ * @brief Initialize flash, mount log and start recorder task. Call from task. Flash has to have
+ * at least two 64kB blocks.
+ */
+ic_return_val_e ic_service_recorder_init(void);
+
+ic_return_val_e ic_service_recorder_deinit(void);
+
+/**
+ * @brief Connect module producing frames. Callback is called with true when recording starts (module
+ * has to sample even without BLE subscribers) and with false when it stops.
+ */
+ic_return_val_e ic_recorder_connect(void (*p_func)(bool));
+
+/**
+ * @brief Run function of another flash user on recorder task, so it needs no task of its own and
+ * never competes with recorder for flash. Function is called after every wake up of recorder task
+ * and returns ticks it can wait for the next call. It is delayed while recorder programs or erases
+ * flash. Only one function can be attached.
+ *
+ * @return IC_SUCCESS, IC_NOT_INIALIZED when recorder task does not run, IC_ERROR when another
+ * function is attached.
+ */
+ic_return_val_e ic_recorder_attach(TickType_t (*p_func)(void));
+
+/**
+ * @brief Wake recorder task, attached function runs soon. Safe to call from IRQ.
+ */
+void ic_recorder_wake(void);
+
+/**
+ * @brief Start new session.
+ */
+ic_return_val_e ic_recorder_start(void);
+
+/**
+ * @brief Finish session. Buffered data is written to flash.
+ */
+ic_return_val_e ic_recorder_stop(void);
+
+bool ic_recorder_active(void);
+
+/**
+ * @brief Append frame to current session. Does not block, frame is copied.
+ *
+ * @return IC_SUCCESS, IC_NOT_INIALIZED when session is not started, IC_BUSY when buffers are full,
+ * IC_ERROR when frame is too long.
+ */
+ic_return_val_e ic_recorder_append(ic_recorder_stream_e stream, const uint8_t *data, size_t len);
+
+ic_recorder_stats_s ic_recorder_get_stats(void);
+
+/**
+ * @brief Find flash address of data of session recorded at given time. Reads O(log n) index
+ * records. Call from task.
+ *
+ * Index has one record per allocated block, so time resolves to the start of the 64kB block
+ * holding it (or to session header page when session started in that block). Data before the
+ * requested time has to be skipped by reader using frame timestamps. When data of that time was
+ * overwritten, the oldest data left in the session is returned.
+ *
+ * @param session   Session number.
+ * @param timestamp Unix time (s). Time before session start gives session header page.
+ * @param address   Address of page. Data of session is continued in the next allocated blocks.
+ *
+ * @return IC_SUCCESS, IC_NOT_INIALIZED, IC_ERROR when session data is not in flash.
+ */
+ic_return_val_e ic_recorder_seek(uint16_t session, uint32_t timestamp, uint32_t *address);
+
+/**
+ * @brief Recording starts when link is lost during streaming and stops on new connection.
+ *
+ * Has to be dispatched before @ref ble_iccs_on_ble_evt, which clears streams state on disconnect.
+ */
+void ic_recorder_on_ble_evt(ble_evt_t *p_ble_evt);
+
+/** @} */
+
+#endif /* !IC_SERVICE_RECORDER_H */
@@ -21,6 +21,10 @@
 #include "ic_frame_handle.h"
 
 #include "ic_service_stream1.h"
+#include "ic_service_recorder.h"
+#include "ic_service_mux.h"
+#include "ic_stream_policy.h"
+#include "ic_smart_wake.h"
 #include "ic_driver_acc.h"
 #include "ic_driver_afe4400.h"
 
@@ -34,6 +38,7 @@ static TaskHandle_t m_send_data_task_handle = NULL;
 static bool m_module_initialized = false;
 
 static uint8_t m_measurement_cnt = 0;
+static uint8_t m_tick_cnt = 0;
 static volatile uint32_t m_stream1_timestamp;
 static acc_data_s m_acc_measurement;
 static ic_afe_val_s m_afe_measurement;
@@ -43,8 +48,16 @@ ALLOCK_SEMAPHORE(m_data_lock);
 static void read_acc_callback(acc_data_s acc_measurement);
 static void read_afe_callback(ic_afe_val_s afe_measurement);
 static void on_stream1_state_change(bool active);
+static void on_record_state_change(bool active);
+static void on_mux_state_change(bool active);
+static void on_smart_wake_state_change(bool active);
 
 static void stream1_timer_callback(TimerHandle_t xTimer){
+  /* Decimated by stream policy - sensors are not even read */
+  if(++m_tick_cnt < ic_stream_policy_acc_ppg_divider())
+    return;
+  m_tick_cnt = 0;
+
   __auto_type _semphr_successfull = pdTRUE;
   TAKE_SEMAPHORE(m_data_lock, 0, _semphr_successfull);
   if(_semphr_successfull == pdFALSE){
@@ -78,8 +91,26 @@ static void stream1_timer_callback(TimerHandle_t xTimer){
   }
 }
 
+/**
+ * @brief Frame without timestamp, which is in record header.
+ */
+static ic_return_val_e m_mux_append(const u_otherDataFrameContainer *packet){
+  uint8_t _record[
+    sizeof(packet->frame.acc) + sizeof(packet->frame.ir_sample) + sizeof(packet->frame.red_sample)];
+  __auto_type _p = _record;
+
+  memcpy(_p, packet->frame.acc, sizeof(packet->frame.acc));
+  _p += sizeof(packet->frame.acc);
+  memcpy(_p, &packet->frame.ir_sample, sizeof(packet->frame.ir_sample));
+  _p += sizeof(packet->frame.ir_sample);
+  memcpy(_p, &packet->frame.red_sample, sizeof(packet->frame.red_sample));
+
+  return ic_mux_append(IC_MUX_ACC_PPG, packet->frame.time_stamp, _record, sizeof(_record));
+}
+
 static void send_data_task(void *arg){
   u_otherDataFrameContainer m_stream1_packet;
+  int _retry = 0;
   for(;;){
     m_stream1_packet.frame.time_stamp = m_stream1_timestamp; //GET_TICK_COUNT();
     GIVE_SEMAPHORE(m_data_lock);
@@ -92,25 +123,40 @@ static void send_data_task(void *arg){
     m_stream1_packet.frame.red_sample = m_afe_measurement.red_diff;
     portEXIT_CRITICAL();
 
+    if(_retry == 0)
+      ic_smart_wake_acc(&m_stream1_packet);
+
     /*NRF_LOG_INFO("x: %d\ty: %d\tz: %d\n", m_stream1_packet.frame.acc[0], m_stream1_packet.frame.acc[1], m_stream1_packet.frame.acc[2]);*/
 
-    __auto_type _ret_val = ble_iccs_send_to_stream1(
-        m_stream1_packet.raw_data,
-        sizeof(u_otherDataFrameContainer),
-        NULL);
+    __auto_type _ret_val = ic_mux_active() ?
+      m_mux_append(&m_stream1_packet) :
+      ble_iccs_send_to_stream1(
+          m_stream1_packet.raw_data,
+          sizeof(u_otherDataFrameContainer),
+          NULL);
 
     switch(_ret_val){
       case IC_SUCCESS:
         break;
       case IC_BLE_NOT_CONNECTED:
+        ic_recorder_append(
+            IC_RECORDER_ACC_PPG,
+            m_stream1_packet.raw_data,
+            sizeof(u_otherDataFrameContainer));
         break;
       case IC_BUSY:
-        vTaskDelay(1);
-        continue; // TODO: Fix it. Can kill CPU.
+        ic_stream_policy_refused();
+        if(_retry++ < IC_STREAM_POLICY_MAX_RETRY){
+          vTaskDelay(1);
+          continue;
+        }
+        ic_stream_policy_drop();
+        break;
       default:
         /*NRF_LOG_INFO("err: %s\n", (uint32_t)ic_get_nrferr2str(_nrf_error));*/
         break;
     }
+    _retry = 0;
     vTaskSuspend(NULL);
     taskYIELD();
   }
@@ -148,6 +194,9 @@ ic_return_val_e ic_service_stream1_init(void){
     }
 
   ble_iccs_connect_to_stream1(on_stream1_state_change);
+  ic_recorder_connect(on_record_state_change);
+  ic_mux_connect(on_mux_state_change);
+  ic_smart_wake_connect(on_smart_wake_state_change);
 
   vTaskSuspend(m_send_data_task_handle);
 
@@ -184,7 +233,7 @@ static void on_stream1_state_change(bool active){
     GIVE_SEMAPHORE(m_data_lock);
     START_TIMER (m_service_stream1_timer_handle, 0, _timer_ret_val);
   }
-  else{
+  else if(!ic_recorder_active() && !ic_mux_active() && !ic_smart_wake_sampling()){
     GIVE_SEMAPHORE(m_data_lock);
     vTaskSuspend(m_send_data_task_handle);
     STOP_TIMER  (m_service_stream1_timer_handle, 0, _timer_ret_val);
@@ -193,6 +242,18 @@ static void on_stream1_state_change(bool active){
   UNUSED_PARAMETER(_timer_ret_val);
 }
 
+static void on_record_state_change(bool active){
+  on_stream1_state_change(active || ble_iccs_stream1_ready());
+}
+
+static void on_mux_state_change(bool active){
+  on_stream1_state_change(active || ble_iccs_stream1_ready());
+}
+
+static void on_smart_wake_state_change(bool active){
+  on_stream1_state_change(active || ble_iccs_stream1_ready());
+}
+
 static void read_acc_callback(acc_data_s acc_measurement){
   /*NRF_LOG_INFO("x: %d\ty: %d\tz: %d\n", acc_measurement.x , acc_measurement.y, acc_measurement.z);*/
   memcpy(&m_acc_measurement, &acc_measurement, sizeof(acc_data_s));
@@ -40,7 +40,7 @@ uint32_t m_relative_fraction_mem = 0;
 uint32_t m_unix_sub_timer_mem = 0;
 
 static TimerHandle_t m_timer_handle = NULL;
-static bool m_module_initialized = true;
+static bool m_module_initialized = false;
 
 static inline void increment_timestamp(void){
   m_unix_timestamp.sub_timer = GET_TICK_COUNT()&0x3FF;
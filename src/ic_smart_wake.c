@@ -0,0 +1,502 @@
+/**
+ * @file    ic_smart_wake.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Sunrise smart wake in light sleep
+ *
+ * State machine ARMED - WATCHING - SUNRISE - ALARM runs in timer callback only, commands leave a
+ * request and fire the timer. Filters are integer (Q format, shifts instead of coefficients), they
+ * run in producer tasks and add per frame sums in a short critical region, timer takes them at the
+ * end of epoch.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "WAKE"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_smart_wake.h"
+#include "ic_command_task.h"
+#include "ic_service_time.h"
+#include "ic_service_ltc.h"
+#include "ic_ltc_pattern.h"
+#include "ic_low_level_control.h"
+
+#define REQUEST_NONE      0
+#define REQUEST_SET       1
+#define REQUEST_CANCEL    2
+
+#define EEG_SAMPLES       (sizeof(((u_eegDataFrameContainter *)0)->frame.eeg_data)/sizeof(int16_t))
+#define EEG_Q             4           /** Fraction bits of filters */
+#define EEG_BASE_SHIFT    8           /** Baseline (DC) follower, ~0.08 Hz */
+#define EEG_SLOW_SHIFT    3           /** Low pass of slow band, ~2.7 Hz */
+
+#define SUNRISE_SEGMENTS  (sizeof(m_sunrise_colors)/sizeof(m_sunrise_colors[0]))
+#define VIB_PULSE         512         /** Ticks, period of vibration in burst */
+#define VIB_BURST         (4*VIB_PULSE)
+
+_Static_assert(configTICK_RATE_HZ / IC_ADS_TICK_PERIOD == 128, "Filters are tuned for 128 Hz EEG");
+_Static_assert(sizeof(ic_smart_wake_status_s) <= CMD_RESPONSE_DATA_LEN, "Status has to fit frame");
+
+typedef struct{
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+}sunrise_color_s;
+
+/** Colors at the end of sunrise segments, LEDs ramp between them (gamma corrected) */
+static const sunrise_color_s m_sunrise_colors[] = {
+  {20,  2,  0},                       /* Dawn */
+  {40, 12,  0},
+  {56, 32,  6},
+  {63, 52, 30}                        /* Daylight */
+};
+
+static struct{
+  uint8_t volatile request;
+  bool volatile sampling;
+  ic_smart_wake_state_e state;
+  uint8_t light_epochs;
+  uint8_t step;                       /** Sunrise segment or vibration burst */
+  uint16_t epochs;
+  uint16_t ramp;
+  uint32_t start;
+  uint32_t end;
+  TickType_t segment;                 /** Ticks of sunrise segment */
+  uint16_t delta_ratio;
+  uint16_t activity;
+  struct{
+    uint32_t start;
+    uint32_t end;
+    uint16_t ramp;
+  }pending;                           /** Window of REQUEST_SET */
+  void (*clients[IC_SMART_WAKE_MAX_CLIENTS])(bool);
+  TimerHandle_t timer;
+}m_wake;
+
+/** Filters run in ADS task, powers are taken by timer at the end of epoch */
+static struct{
+  bool primed;
+  int32_t base;
+  int32_t low;
+  uint64_t slow_power;
+  uint64_t fast_power;
+  uint32_t samples;
+}m_eeg;
+
+static struct{
+  bool primed;
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  uint32_t activity;
+  uint32_t samples;
+}m_acc;
+
+static inline uint32_t m_now(void){
+  return (uint32_t)ic_unix_timestamp_get().unix_timestamp;
+}
+
+static inline bool m_clock_set(uint32_t now){
+  return now >= IC_SCHEDULER_EPOCH;
+}
+
+static TickType_t m_ticks(uint32_t seconds){
+  if(seconds == 0)
+    return 1;
+  return seconds > IC_SMART_WAKE_MAX_SLEEP / configTICK_RATE_HZ ?
+    IC_SMART_WAKE_MAX_SLEEP :
+    seconds * configTICK_RATE_HZ;
+}
+
+/**
+ * @brief Sunrise starts at the latest so it ends with window.
+ */
+static uint32_t m_deadline(void){
+  return m_wake.end - m_wake.start > m_wake.ramp ? m_wake.end - m_wake.ramp : m_wake.start;
+}
+
+static void m_kick(void){
+  if(xTimerChangePeriod(m_wake.timer, 1, OSTIMER_WAIT_FOR_QUEUE) != pdPASS)
+    NRF_LOG_ERROR("Timer not armed\n");
+}
+
+static void m_sample(bool active){
+  m_wake.sampling = active;
+  for(int i = 0; i < IC_SMART_WAKE_MAX_CLIENTS; ++i)
+    if(m_wake.clients[i] != NULL)
+      m_wake.clients[i](active);
+}
+
+static void m_lights(e_funcType func, uint32_t period, sunrise_color_s color){
+  __auto_type _func = func | IC_LTC_FUNC_GAMMA;
+
+  ic_actuator_set_func(IC_LEFT_RED_LED, _func, period, 0, color.red);
+  ic_actuator_set_func(IC_RIGHT_RED_LED, _func, period, 0, color.red);
+  ic_actuator_set_func(IC_LEFT_GREEN_LED, _func, period, 0, color.green);
+  ic_actuator_set_func(IC_RIGHT_GREEN_LED, _func, period, 0, color.green);
+  ic_actuator_set_func(IC_LEFT_BLUE_LED, _func, period, 0, color.blue);
+  ic_actuator_set_func(IC_RIGHT_BLUE_LED, _func, period, 0, color.blue);
+}
+
+static void m_off(void){
+  m_lights(FUN_TYPE_OFF, 0, (sunrise_color_s){0});
+  ic_actuator_set_func(IC_VIBRATOR, FUN_TYPE_OFF, 0, 0, 0);
+}
+
+static void m_stop(void){
+  if(m_wake.sampling)
+    m_sample(false);
+  if(m_wake.state == IC_SMART_WAKE_SUNRISE || m_wake.state == IC_SMART_WAKE_ALARM)
+    m_off();
+  m_wake.state = IC_SMART_WAKE_IDLE;
+}
+
+/**
+ * @brief Take accumulated samples and score epoch.
+ *
+ * @return true when epoch is light sleep (or wake).
+ */
+static bool m_score(void){
+  uint64_t _slow, _fast;
+  uint32_t _eeg_samples, _activity, _acc_samples;
+
+  CRITICAL_REGION_ENTER();
+  _slow = m_eeg.slow_power;
+  _fast = m_eeg.fast_power;
+  _eeg_samples = m_eeg.samples;
+  _activity = m_acc.activity;
+  _acc_samples = m_acc.samples;
+  m_eeg.slow_power = m_eeg.fast_power = 0;
+  m_eeg.samples = 0;
+  m_acc.activity = m_acc.samples = 0;
+  CRITICAL_REGION_EXIT();
+
+  /* Once per epoch, so 64 bit division is affordable */
+  __auto_type _ratio = _fast != 0 ? _slow * 16 / _fast : 0;
+  __auto_type _mean = _acc_samples != 0 ? _activity / _acc_samples : 0;
+  m_wake.delta_ratio = _ratio > UINT16_MAX ? UINT16_MAX : _ratio;
+  m_wake.activity = _mean > UINT16_MAX ? UINT16_MAX : _mean;
+
+  /* Filters settle in the first epoch */
+  if(m_wake.epochs++ == 0)
+    return false;
+
+  __auto_type _moving = _acc_samples != 0 && _activity > _acc_samples * IC_SMART_WAKE_ACTIVITY;
+  __auto_type _light_eeg = _eeg_samples != 0 && _slow < _fast * IC_SMART_WAKE_DELTA_RATIO;
+
+  return _moving || _light_eeg;
+}
+
+static TickType_t m_alarm(void){
+  if(m_wake.step == IC_SMART_WAKE_VIB_STEPS){
+    NRF_LOG_INFO("Alarm ended\n");
+    m_off();
+    m_wake.state = IC_SMART_WAKE_IDLE;
+    return 0;
+  }
+
+  ++m_wake.step;
+  ic_actuator_set_func(
+      IC_VIBRATOR,
+      FUN_TYPE_SQUARE,
+      VIB_PULSE,
+      VIB_BURST,
+      IC_LTC_MAX_VAL * m_wake.step / IC_SMART_WAKE_VIB_STEPS);
+
+  return IC_SMART_WAKE_VIB_PERIOD;
+}
+
+static TickType_t m_sunrise(void){
+  if(m_wake.step == SUNRISE_SEGMENTS){
+    m_wake.state = IC_SMART_WAKE_ALARM;
+    m_wake.step = 0;
+    return m_alarm();
+  }
+
+  m_lights(FUN_TYPE_RAMP, m_wake.segment, m_sunrise_colors[m_wake.step++]);
+  return m_wake.segment;
+}
+
+static TickType_t m_sunrise_start(uint32_t now){
+  uint32_t _left = m_wake.end > now ? m_wake.end - now : 0;
+  uint32_t _length = _left < m_wake.ramp ? _left : m_wake.ramp;
+
+  NRF_LOG_INFO("Sunrise after %d epochs\n", m_wake.epochs);
+
+  m_wake.segment = (_length != 0 ? _length : 1) * configTICK_RATE_HZ / SUNRISE_SEGMENTS;
+  m_wake.state = IC_SMART_WAKE_SUNRISE;
+  m_wake.step = 0;
+
+  ic_pattern_stop();
+  return m_sunrise();
+}
+
+/**
+ * @brief Ticks to the end of epoch, epoch is cut by deadline.
+ */
+static TickType_t m_epoch_ticks(uint32_t now){
+  __auto_type _deadline = m_deadline();
+  if(_deadline <= now)
+    return 1;
+
+  __auto_type _ticks = m_ticks(_deadline - now);
+  return _ticks < IC_SMART_WAKE_EPOCH ? _ticks : IC_SMART_WAKE_EPOCH;
+}
+
+static TickType_t m_watching(void){
+  __auto_type _now = m_now();
+
+  if(m_score()){
+    if(m_wake.light_epochs < UINT8_MAX)
+      ++m_wake.light_epochs;
+  }
+  else{
+    m_wake.light_epochs = 0;
+  }
+
+  if(m_wake.light_epochs < IC_SMART_WAKE_LIGHT_EPOCHS && _now < m_deadline())
+    return m_epoch_ticks(_now);
+
+  m_sample(false);
+  return m_sunrise_start(_now);
+}
+
+static TickType_t m_armed(void){
+  __auto_type _now = m_now();
+
+  /* Clock is followed, it may be set or changed meanwhile */
+  if(!m_clock_set(_now))
+    return IC_SMART_WAKE_MAX_SLEEP;
+
+  if(_now >= m_wake.end){
+    NRF_LOG_INFO("Window expired\n");
+    m_wake.state = IC_SMART_WAKE_IDLE;
+    return 0;
+  }
+
+  if(_now < m_wake.start)
+    return m_ticks(m_wake.start - _now);
+
+  CRITICAL_REGION_ENTER();
+  memset(&m_eeg, 0, sizeof(m_eeg));
+  memset(&m_acc, 0, sizeof(m_acc));
+  CRITICAL_REGION_EXIT();
+
+  m_wake.state = IC_SMART_WAKE_WATCHING;
+  m_wake.light_epochs = 0;
+  m_wake.epochs = 0;
+  m_sample(true);
+
+  return m_epoch_ticks(_now);
+}
+
+static void m_timer_callback(TimerHandle_t xTimer){
+  uint8_t _request;
+
+  CRITICAL_REGION_ENTER();
+  _request = m_wake.request;
+  m_wake.request = REQUEST_NONE;
+  CRITICAL_REGION_EXIT();
+
+  if(_request != REQUEST_NONE)
+    m_stop();
+
+  if(_request == REQUEST_SET){
+    CRITICAL_REGION_ENTER();
+    m_wake.start = m_wake.pending.start;
+    m_wake.end = m_wake.pending.end;
+    m_wake.ramp = m_wake.pending.ramp;
+    CRITICAL_REGION_EXIT();
+    m_wake.state = IC_SMART_WAKE_ARMED;
+  }
+
+  TickType_t _ticks = 0;
+  switch(m_wake.state){
+    case IC_SMART_WAKE_ARMED:
+      _ticks = m_armed();
+      break;
+    case IC_SMART_WAKE_WATCHING:
+      _ticks = m_watching();
+      break;
+    case IC_SMART_WAKE_SUNRISE:
+      _ticks = m_sunrise();
+      break;
+    case IC_SMART_WAKE_ALARM:
+      _ticks = m_alarm();
+      break;
+    default:
+      break;
+  }
+
+  if(_ticks != 0)
+    xTimerChangePeriod(xTimer, _ticks, 0);
+}
+
+static ic_return_val_e m_smart_wake_cmd(u_BLECmdPayload payload, void *ctx){
+  UNUSED_PARAMETER(ctx);
+
+  switch(payload.data[0]){
+    case IC_SMART_WAKE_OP_SET:
+      return ic_smart_wake_set(
+          payload.data[1]
+          | payload.data[2] << 8
+          | payload.data[3] << 16
+          | (uint32_t)payload.data[4] << 24,
+          payload.data[5]
+          | payload.data[6] << 8
+          | payload.data[7] << 16
+          | (uint32_t)payload.data[8] << 24,
+          payload.data[9] | payload.data[10] << 8);
+    case IC_SMART_WAKE_OP_CANCEL:
+      ic_smart_wake_cancel();
+      return IC_SUCCESS;
+    case IC_SMART_WAKE_OP_STATUS:
+      {
+        __auto_type _status = ic_smart_wake_get_status();
+        cmd_respond(cmd_defer(), CMD_STATUS_OK, &_status, sizeof(_status));
+      }
+      return IC_SUCCESS;
+    default:
+      return IC_ERROR;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_smart_wake_init(void){
+  if(m_wake.timer == NULL){
+    m_wake.timer = xTimerCreate("WAKE", 1, pdFALSE, NULL, m_timer_callback);
+    if(m_wake.timer == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+  }
+
+  cmd_register(CMD_SMART_WAKE, m_smart_wake_cmd, NULL);
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_smart_wake_set(uint32_t start, uint32_t end, uint16_t ramp){
+  if(m_wake.timer == NULL)
+    return IC_NOT_INIALIZED;
+
+  __auto_type _now = m_now();
+  if(!m_clock_set(_now) || end <= start || end <= _now)
+    return IC_ERROR;
+
+  CRITICAL_REGION_ENTER();
+  m_wake.pending.start = start;
+  m_wake.pending.end = end;
+  m_wake.pending.ramp = ramp != 0 ? ramp : IC_SMART_WAKE_RAMP;
+  m_wake.request = REQUEST_SET;
+  CRITICAL_REGION_EXIT();
+
+  m_kick();
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_smart_wake_cancel(void){
+  if(m_wake.timer == NULL)
+    return;
+
+  m_wake.request = REQUEST_CANCEL;
+  m_kick();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_smart_wake_status_s ic_smart_wake_get_status(void){
+  ic_smart_wake_status_s _status;
+
+  CRITICAL_REGION_ENTER();
+  _status = (ic_smart_wake_status_s){
+    .state        = m_wake.state,
+    .light_epochs = m_wake.light_epochs,
+    .epochs       = m_wake.epochs,
+    .start        = m_wake.state != IC_SMART_WAKE_IDLE ? m_wake.start : 0,
+    .end          = m_wake.state != IC_SMART_WAKE_IDLE ? m_wake.end : 0,
+    .delta_ratio  = m_wake.delta_ratio,
+    .activity     = m_wake.activity
+  };
+  CRITICAL_REGION_EXIT();
+
+  return _status;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_smart_wake_connect(void (*p_func)(bool)){
+  for(int i = 0; i < IC_SMART_WAKE_MAX_CLIENTS; ++i){
+    if(m_wake.clients[i] == NULL || m_wake.clients[i] == p_func){
+      m_wake.clients[i] = p_func;
+      return IC_SUCCESS;
+    }
+  }
+
+  return IC_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ic_smart_wake_sampling(void){
+  return m_wake.sampling;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_smart_wake_eeg(const u_eegDataFrameContainter *frame){
+  if(!m_wake.sampling)
+    return;
+
+  uint64_t _slow = 0, _fast = 0;
+
+  for(size_t i = 0; i < EEG_SAMPLES; ++i){
+    int32_t _x = (int32_t)frame->frame.eeg_data[i] << EEG_Q;
+    if(!m_eeg.primed){
+      m_eeg.base = m_eeg.low = _x;
+      m_eeg.primed = true;
+    }
+
+    m_eeg.base += (_x - m_eeg.base) >> EEG_BASE_SHIFT;
+    m_eeg.low += (_x - m_eeg.low) >> EEG_SLOW_SHIFT;
+
+    uint32_t _s = abs(m_eeg.low - m_eeg.base) >> EEG_Q;
+    uint32_t _f = abs(_x - m_eeg.low) >> EEG_Q;
+    _slow += _s * _s;
+    _fast += _f * _f;
+  }
+
+  CRITICAL_REGION_ENTER();
+  m_eeg.slow_power += _slow;
+  m_eeg.fast_power += _fast;
+  m_eeg.samples += EEG_SAMPLES;
+  CRITICAL_REGION_EXIT();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_smart_wake_acc(const u_otherDataFrameContainer *frame){
+  if(!m_wake.sampling)
+    return;
+
+  int16_t _x = frame->frame.acc[0];
+  int16_t _y = frame->frame.acc[1];
+  int16_t _z = frame->frame.acc[2];
+
+  CRITICAL_REGION_ENTER();
+  if(m_acc.primed){
+    m_acc.activity += abs(_x - m_acc.x) + abs(_y - m_acc.y) + abs(_z - m_acc.z);
+    ++m_acc.samples;
+  }
+  m_acc.x = _x;
+  m_acc.y = _y;
+  m_acc.z = _z;
+  m_acc.primed = true;
+  CRITICAL_REGION_EXIT();
+}
@@ -0,0 +1,107 @@
+/**
+ * @file    ic_smart_wake.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Sunrise smart wake in light sleep
+ *
+ * Central sets wake window (unix time), the rest runs on device, so it does not depend on BLE link.
+ * In window EEG and ACC are sampled (services sample for @ref ic_smart_wake_connect clients like
+ * for recorder) and scored in @ref IC_SMART_WAKE_EPOCH epochs:
+ *  - EEG is split by one-pole filters into slow (below ~3 Hz, delta) and fast band, epoch is deep
+ *    sleep when slow band power is @ref IC_SMART_WAKE_DELTA_RATIO times the fast one,
+ *  - ACC epoch is movement when mean change between samples is above @ref IC_SMART_WAKE_ACTIVITY.
+ * Epoch which is not deep sleep or has movement is light. After @ref IC_SMART_WAKE_LIGHT_EPOCHS
+ * light epochs in row (at the latest so it ends with window) sampling stops and sunrise starts -
+ * LEDs ramp from dim red through orange to white, then vibration bursts of rising intensity
+ * follow. Alarm ends after @ref IC_SMART_WAKE_VIB_STEPS bursts or when central cancels it.
+ *
+ * One timer wakes once per epoch or sunrise segment, samples are only accumulated by producers.
+ *
+ * CMD_SMART_WAKE payload[0] selects operation:
+ *  - SET     - [start:32][end:32][ramp:16] window (unix time) and sunrise length (s, 0 - default
+ *              @ref IC_SMART_WAKE_RAMP), replaces current wake,
+ *  - CANCEL  - stop wake or alarm,
+ *  - STATUS  - response carries @ref ic_smart_wake_status_s.
+ *
+ * Multi-byte values are little endian.
+ */
+
+#ifndef IC_SMART_WAKE_H
+#define IC_SMART_WAKE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ic_frame_handle.h"
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_SMART_WAKE
+ *  @{
+ */
+
+typedef enum{
+  IC_SMART_WAKE_OP_SET = 0x00,
+  IC_SMART_WAKE_OP_CANCEL,
+  IC_SMART_WAKE_OP_STATUS
+}ic_smart_wake_op_e;
+
+typedef enum{
+  IC_SMART_WAKE_IDLE = 0x00,
+  IC_SMART_WAKE_ARMED,                /** Waiting for window */
+  IC_SMART_WAKE_WATCHING,             /** Scoring epochs */
+  IC_SMART_WAKE_SUNRISE,
+  IC_SMART_WAKE_ALARM                 /** Vibration bursts */
+}ic_smart_wake_state_e;
+
+typedef struct __attribute__((packed)){
+  uint8_t state;                      /** @ref ic_smart_wake_state_e */
+  uint8_t light_epochs;               /** Light epochs in row */
+  uint16_t epochs;                    /** Epochs scored in window */
+  uint32_t start;                     /** Window, unix time */
+  uint32_t end;
+  uint16_t delta_ratio;               /** Slow to fast EEG power of last epoch, x16 */
+  uint16_t activity;                  /** Mean ACC change of last epoch */
+}ic_smart_wake_status_s;
+
+/**
+ * @brief Create timer and register CMD_SMART_WAKE. Call after command task was initialized.
+ */
+ic_return_val_e ic_smart_wake_init(void);
+
+/**
+ * @brief Wake in window, replaces current wake.
+ *
+ * @param start Unix time (s).
+ * @param end   Unix time (s), the latest wake.
+ * @param ramp  Sunrise length (s), 0 - @ref IC_SMART_WAKE_RAMP.
+ *
+ * @return IC_SUCCESS, IC_ERROR when clock is not set or window is empty or expired.
+ */
+ic_return_val_e ic_smart_wake_set(uint32_t start, uint32_t end, uint16_t ramp);
+
+void ic_smart_wake_cancel(void);
+
+ic_smart_wake_status_s ic_smart_wake_get_status(void);
+
+/**
+ * @brief Connect module producing samples. Callback is called with true when module has to sample
+ * (even without BLE subscribers) and with false when it stops.
+ */
+ic_return_val_e ic_smart_wake_connect(void (*p_func)(bool));
+
+bool ic_smart_wake_sampling(void);
+
+/**
+ * @brief Accumulate EEG frame of ADS service (samples IC_ADS_TICK_PERIOD apart). Does not block.
+ */
+void ic_smart_wake_eeg(const u_eegDataFrameContainter *frame);
+
+/**
+ * @brief Accumulate ACC sample of stream1 frame. Does not block.
+ */
+void ic_smart_wake_acc(const u_otherDataFrameContainer *frame);
+
+/** @} */
+
+#endif /* !IC_SMART_WAKE_H */
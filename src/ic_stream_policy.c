@@ -0,0 +1,237 @@
+/**
+ * @file    ic_stream_policy.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Stream degradation under BLE backpressure
+ *
+ * Periodic timer judges the link and moves one level of the ladder at a time. After step down TX
+ * buffers are still full of frames of the previous level, they drain for
+ * @ref IC_STREAM_POLICY_SETTLE_PERIODS before link is judged again, otherwise one burst would step
+ * streams down to the end of the ladder. Announcement which could not be sent yet is replaced by
+ * the next transition, its previous level stays the last announced one, so central sees a chain of
+ * levels without gaps.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+
+#include "ic_config.h"
+
+#define NRF_LOG_MODULE_NAME "POLICY"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#include "ic_stream_policy.h"
+#include "ic_ble_service.h"
+#include "ic_service_mux.h"
+
+_Static_assert(sizeof(ic_stream_policy_frame_s) <= 20, "Announcement has to fit notification");
+
+static const char *m_level_names[IC_STREAM_POLICY_LEVEL_NUM] = {
+  "full", "acc decimated", "ppg vitals", "eeg compressed"
+};
+
+static struct{
+  ic_stream_policy_level_e volatile level;
+  bool announce;                      /** Transition not announced yet */
+  uint8_t clean_periods;
+  uint8_t settle_periods;             /** Periods left not judged after step down */
+  TimerHandle_t timer;
+  uint32_t last_refused;              /** Producer accounting at the end of previous period */
+  uint32_t last_drops;
+  ic_stream_policy_frame_s frame;
+  ic_stream_policy_stats_s stats;
+}m_policy;
+
+static inline uint16_t m_saturate(uint32_t val){
+  return val > UINT16_MAX ? UINT16_MAX : val;
+}
+
+static void m_announce(void){
+  if(!m_policy.announce)
+    return;
+
+  m_policy.frame.time_stamp = GET_TICK_COUNT();
+
+  __auto_type _ret_val = ic_mux_active() ?
+    ic_mux_append(
+        IC_MUX_POLICY,
+        m_policy.frame.time_stamp,
+        &m_policy.frame,
+        sizeof(m_policy.frame)) :
+    ble_iccs_send_to_stream2((uint8_t *)&m_policy.frame, sizeof(m_policy.frame), NULL);
+
+  switch(_ret_val){
+    case IC_BUSY:
+      /* Repeated next period */
+      return;
+    case IC_SUCCESS:
+      break;
+    default:
+      ++m_policy.stats.lost_announcements;
+      break;
+  }
+  m_policy.announce = false;
+}
+
+static void m_set_level(
+    ic_stream_policy_level_e level,
+    const ble_iccs_tx_stats_t *tx,
+    uint32_t refused,
+    uint32_t drops)
+{
+  __auto_type _previous = m_policy.level;
+  /* Transition not announced yet is merged into this one */
+  __auto_type _announced = m_policy.announce ? m_policy.frame.previous : _previous;
+
+  if(level > _previous){
+    ++m_policy.stats.step_downs;
+    m_policy.settle_periods = IC_STREAM_POLICY_SETTLE_PERIODS;
+  }
+  else{
+    ++m_policy.stats.step_ups;
+  }
+
+  m_policy.level = level;
+  m_policy.stats.level = level;
+
+  m_policy.frame = (ic_stream_policy_frame_s){
+    .type       = IC_STREAM_POLICY_FRAME,
+    .level      = level,
+    .previous   = _announced,
+    .in_flight  = tx->in_flight,
+    .capacity   = tx->capacity,
+    .refused    = m_saturate(refused),
+    .drops      = m_saturate(drops)
+  };
+  m_policy.announce = level != _announced;
+
+  NRF_LOG_INFO("%s -> %s\n",
+      (uint32_t)m_level_names[_previous],
+      (uint32_t)m_level_names[level]);
+}
+
+static void m_timer_callback(TimerHandle_t xTimer){
+  UNUSED_PARAMETER(xTimer);
+
+  /* Bulk and mux treat refused notifications as flow control, only stream producers count */
+  __auto_type _tx = ble_iccs_get_tx_stats();
+  uint32_t _refused, _drops;
+
+  CRITICAL_REGION_ENTER();
+  _refused = m_policy.stats.refused;
+  _drops = m_policy.stats.drops;
+  CRITICAL_REGION_EXIT();
+
+  __auto_type _refused_now = _refused - m_policy.last_refused;
+  __auto_type _dropped = _drops - m_policy.last_drops;
+  m_policy.last_refused = _refused;
+  m_policy.last_drops = _drops;
+
+  __auto_type _congested = _refused_now >= IC_STREAM_POLICY_BUSY_THRESHOLD || _dropped != 0;
+  /* TX buffers have to drain, otherwise stepping up would congest link again */
+  __auto_type _clean = _refused_now == 0 && _tx.in_flight * 2 <= _tx.capacity;
+
+  if(m_policy.settle_periods != 0){
+    --m_policy.settle_periods;
+    m_policy.clean_periods = 0;
+  }
+  else if(_congested){
+    m_policy.clean_periods = 0;
+    if(m_policy.level < IC_STREAM_POLICY_LEVEL_NUM - 1)
+      m_set_level(m_policy.level + 1, &_tx, _refused_now, _dropped);
+  }
+  else if(_clean && m_policy.level != IC_STREAM_POLICY_FULL){
+    if(++m_policy.clean_periods >= IC_STREAM_POLICY_RECOVERY_PERIODS){
+      m_policy.clean_periods = 0;
+      m_set_level(m_policy.level - 1, &_tx, _refused_now, _dropped);
+    }
+  }
+  else{
+    m_policy.clean_periods = 0;
+  }
+
+  m_announce();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_stream_policy_init(void){
+  if(m_policy.timer == NULL){
+    m_policy.timer =
+      xTimerCreate("POLICY", IC_STREAM_POLICY_PERIOD, pdTRUE, NULL, m_timer_callback);
+    if(m_policy.timer == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+  }
+
+  m_policy.level = IC_STREAM_POLICY_FULL;
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_stream_policy_level_e ic_stream_policy_level(void){
+  return m_policy.level;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint8_t ic_stream_policy_acc_ppg_divider(void){
+  switch(m_policy.level){
+    case IC_STREAM_POLICY_FULL:
+      return 1;
+    case IC_STREAM_POLICY_ACC_DECIMATED:
+      return IC_STREAM_POLICY_ACC_DIVIDER;
+    default:
+      return IC_STREAM_POLICY_VITALS_DIVIDER;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_stream_policy_refused(void){
+  CRITICAL_REGION_ENTER();
+  ++m_policy.stats.refused;
+  CRITICAL_REGION_EXIT();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_stream_policy_drop(void){
+  CRITICAL_REGION_ENTER();
+  ++m_policy.stats.drops;
+  CRITICAL_REGION_EXIT();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_stream_policy_stats_s ic_stream_policy_get_stats(void){
+  ic_stream_policy_stats_s _stats;
+
+  CRITICAL_REGION_ENTER();
+  _stats = m_policy.stats;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_stream_policy_on_ble_evt(ble_evt_t *p_ble_evt){
+  switch(p_ble_evt->header.evt_id){
+    case BLE_GAP_EVT_CONNECTED:
+      m_policy.last_refused = m_policy.stats.refused;
+      m_policy.last_drops = m_policy.stats.drops;
+      m_policy.clean_periods = 0;
+      m_policy.settle_periods = 0;
+      if(m_policy.timer != NULL)
+        xTimerStart(m_policy.timer, OSTIMER_WAIT_FOR_QUEUE);
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      if(m_policy.timer != NULL)
+        xTimerStop(m_policy.timer, OSTIMER_WAIT_FOR_QUEUE);
+      m_policy.level = IC_STREAM_POLICY_FULL;
+      m_policy.stats.level = IC_STREAM_POLICY_FULL;
+      m_policy.announce = false;
+      break;
+    default:
+      break;
+  }
+}
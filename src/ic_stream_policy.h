@@ -0,0 +1,103 @@
+/**
+ * @file    ic_stream_policy.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Stream degradation under BLE backpressure
+ *
+ * Every @ref IC_STREAM_POLICY_PERIOD link is judged from notifications refused to stream producers,
+ * frames they dropped and occupancy of ICCS TX buffers. Bulk download and mux flush use refused
+ * notifications for flow control, so global ICCS accounting is not used. Congested
+ * period steps streams one level down, @ref IC_STREAM_POLICY_RECOVERY_PERIODS clean periods step
+ * them one level up:
+ *  - FULL           - all streams at full rate,
+ *  - ACC_DECIMATED  - ACC/PPG frames decimated by @ref IC_STREAM_POLICY_ACC_DIVIDER,
+ *  - PPG_VITALS     - ACC/PPG frames decimated by @ref IC_STREAM_POLICY_VITALS_DIVIDER, enough for
+ *                     pulse and SpO2 trends,
+ *  - EEG_COMPRESSED - additionally EEG pairs of samples are averaged, one frame carries 16 samples
+ *                     at half rate.
+ *
+ * Link is not judged for @ref IC_STREAM_POLICY_SETTLE_PERIODS after step down.
+ *
+ * Each transition is announced in-band with @ref ic_stream_policy_frame_s - as a record of
+ * multiplexed stream when central is subscribed to it, otherwise on stream2. Transitions made
+ * before announcement was sent are merged, previous level of frame is always the last announced.
+ */
+
+#ifndef IC_STREAM_POLICY_H
+#define IC_STREAM_POLICY_H
+
+#include <stdint.h>
+
+#include "ble.h"
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_STREAM_POLICY
+ *  @{
+ */
+
+/** Type of stream2 frame, continues @ref ic_bus_stats_frame_e */
+#define IC_STREAM_POLICY_FRAME  0x10
+
+typedef enum{
+  IC_STREAM_POLICY_FULL = 0,
+  IC_STREAM_POLICY_ACC_DECIMATED,
+  IC_STREAM_POLICY_PPG_VITALS,
+  IC_STREAM_POLICY_EEG_COMPRESSED,
+
+  IC_STREAM_POLICY_LEVEL_NUM
+}ic_stream_policy_level_e;
+
+/**
+ * @brief Transition announcement. Counters cover evaluation period which caused transition.
+ */
+typedef struct __attribute__((packed)){
+  uint8_t type;                       /** @ref IC_STREAM_POLICY_FRAME */
+  uint8_t level;                      /** @ref ic_stream_policy_level_e */
+  uint8_t previous;
+  uint8_t in_flight;
+  uint8_t capacity;
+  uint16_t refused;
+  uint16_t drops;
+  uint32_t time_stamp;
+}ic_stream_policy_frame_s;
+
+typedef struct{
+  uint8_t level;                      /** @ref ic_stream_policy_level_e */
+  uint16_t step_downs;
+  uint16_t step_ups;
+  uint16_t lost_announcements;        /** Transitions not announced, no stream was subscribed */
+  uint32_t refused;                   /** Notifications refused to producers (retried) */
+  uint32_t drops;                     /** Frames dropped by producers */
+}ic_stream_policy_stats_s;
+
+ic_return_val_e ic_stream_policy_init(void);
+
+/**
+ * @brief Current level. Back to FULL when link is lost, recorder gets full streams.
+ */
+ic_stream_policy_level_e ic_stream_policy_level(void);
+
+/**
+ * @brief Every n-th ACC/PPG frame is sent at current level.
+ */
+uint8_t ic_stream_policy_acc_ppg_divider(void);
+
+/**
+ * @brief Report notification of stream frame refused because TX buffers are full.
+ */
+void ic_stream_policy_refused(void);
+
+/**
+ * @brief Report frame dropped because TX buffers stayed full for @ref IC_STREAM_POLICY_MAX_RETRY.
+ */
+void ic_stream_policy_drop(void);
+
+ic_stream_policy_stats_s ic_stream_policy_get_stats(void);
+
+void ic_stream_policy_on_ble_evt(ble_evt_t *p_ble_evt);
+
+/** @} */
+
+#endif /* !IC_STREAM_POLICY_H */
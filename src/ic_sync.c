@@ -0,0 +1,104 @@
+/**
+ * @file    ic_sync.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Tasks blocked on completion of bus operations
+ *
+ * Waiters live in static pool of IC_SYNC_WAITERS, their semaphores are created by the first
+ * @ref ic_sync_init and never deleted. Pool is searched with interrupts disabled, it is small.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+
+#include "ic_sync.h"
+
+static ic_sync_s m_waiters[IC_SYNC_WAITERS];
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_sync_init(void){
+  for(int i = 0; i < IC_SYNC_WAITERS; ++i){
+    if(m_waiters[i].semaphore != NULL)
+      continue;
+
+    m_waiters[i].semaphore = xSemaphoreCreateBinary();
+    if(m_waiters[i].semaphore == NULL)
+      APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+  }
+
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_sync_s *ic_sync_claim(TickType_t timeout){
+  __auto_type _start = xTaskGetTickCount();
+
+  for(;;){
+    ic_sync_s *_sync = NULL;
+
+    CRITICAL_REGION_ENTER();
+    for(int i = 0; i < IC_SYNC_WAITERS && _sync == NULL; ++i){
+      if(!m_waiters[i].used && m_waiters[i].semaphore != NULL){
+        _sync = &m_waiters[i];
+        _sync->used = true;
+      }
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(_sync != NULL){
+      ic_sync_reset(_sync);
+      return _sync;
+    }
+
+    if(xTaskGetTickCount() - _start >= timeout)
+      return NULL;
+    vTaskDelay(1);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_sync_reset(ic_sync_s *sync){
+  sync->done = false;
+  sync->result = IC_ERROR;
+  (void)xSemaphoreTake(sync->semaphore, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_sync_signal(ic_sync_s *sync, ic_return_val_e result){
+  sync->result = result;
+  sync->done = true;
+
+  if(isr_context()){
+    __auto_type _yield_required = pdFALSE;
+    xSemaphoreGiveFromISR(sync->semaphore, &_yield_required);
+    portYIELD_FROM_ISR(_yield_required);
+  }
+  else{
+    xSemaphoreGive(sync->semaphore);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ic_sync_wait(ic_sync_s *sync, TickType_t start, TickType_t timeout){
+  while(!sync->done){
+    __auto_type _elapsed = xTaskGetTickCount() - start;
+    if(_elapsed >= timeout)
+      return sync->done;
+
+    (void)xSemaphoreTake(sync->semaphore, timeout - _elapsed);
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ic_sync_release(ic_sync_s *sync){
+  if(sync == NULL)
+    return;
+
+  (void)xSemaphoreTake(sync->semaphore, 0);
+  sync->used = false;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file    ic_sync.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Tasks blocked on completion of bus operations
+ *
+ * Synchronous drivers used to sleep on the task notification of the caller, which also woke them
+ * on notifications meant for something else and ate notifications of tasks which use them as
+ * events. Waiter is a binary semaphore with completion flag and result, claimed from a pool for
+ * one blocking call. Completion is signalled from IRQ or task, caller sleeps until the flag is set
+ * or the deadline passes, so stray wake-ups are harmless.
+ *
+ * Waiter can be released only when nothing can signal it anymore (operation finished or was
+ * cancelled), otherwise late signal would wake next owner.
+ */
+
+#ifndef IC_SYNC_H
+#define IC_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "ic_config.h"
+#include "ic_common_types.h"
+
+/** @defgroup IC_SYNC
+ *  @{
+ */
+
+typedef struct{
+  SemaphoreHandle_t semaphore;
+  ic_return_val_e volatile result;
+  bool volatile done;
+  bool used;
+}ic_sync_s;
+
+/**
+ * @brief Create pool of waiters. Can be called many times.
+ */
+ic_return_val_e ic_sync_init(void);
+
+/**
+ * @brief Claim waiter, polls the pool when it is empty. Call from task.
+ *
+ * @return Waiter ready for @ref ic_sync_wait or NULL when pool stayed empty for timeout ticks.
+ */
+ic_sync_s *ic_sync_claim(TickType_t timeout);
+
+/**
+ * @brief Prepare claimed waiter for next operation.
+ */
+void ic_sync_reset(ic_sync_s *sync);
+
+/**
+ * @brief Complete operation and wake its waiter. Safe to call from IRQ.
+ */
+void ic_sync_signal(ic_sync_s *sync, ic_return_val_e result);
+
+/**
+ * @brief Block until operation is completed.
+ *
+ * @param start   Tick the operation started.
+ * @param timeout Ticks from start.
+ *
+ * @return true when completed, result is in waiter.
+ */
+bool ic_sync_wait(ic_sync_s *sync, TickType_t start, TickType_t timeout);
+
+void ic_sync_release(ic_sync_s *sync);
+
+/** @} */
+
+#endif /* !IC_SYNC_H */
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Decode TWI/SPI bus statistics dumped by the device on stream2.
+
+Build firmware with IC_BUS_STATS_ENABLED set to 1, send STATUS_CMD (payload[0] != 0 also clears
+statistics after the dump) and capture stream2 notifications. Feed the capture to this tool, one
+notification per line as hex bytes, e.g. exported from nRF Connect log:
+
+    ./tools/bus_stats_dump.py capture.txt
+    ./tools/bus_stats_dump.py --twi-queue 8 --spi-queue 16 < capture.txt
+
+Frames are ic_bus_stats_frame_s (src/ic_bus_stats.h), other stream2 frames are skipped. Histogram
+bucket n counts transactions which took [2^n, 2^(n+1)) timer ticks, the last one everything
+longer.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_SUMMARY = 0x01
+FRAME_WAIT = 0x02
+FRAME_TRANSFER = 0x03
+
+BUS_NAMES = {0: "TWI", 1: "SPI"}
+FRAME_LEN = 20
+HEX_BYTE = re.compile(r"(?:0x)?([0-9a-fA-F]{2})(?![0-9a-fA-F])")
+
+
+class Device:
+    def __init__(self, bus, dev_id):
+        self.bus = bus
+        self.id = dev_id
+        self.transactions = 0
+        self.busy = 0
+        self.errors = 0
+        self.high_water = 0
+        self.wait = {}
+        self.transfer = {}
+
+
+def parse_line(line):
+    """Return bytes of notification or None when line does not hold a whole frame."""
+    data = bytes(int(b, 16) for b in HEX_BYTE.findall(line))
+    if len(data) < FRAME_LEN:
+        return None
+    return data[-FRAME_LEN:]
+
+
+def decode(lines, buckets):
+    devices = {}
+    for line in lines:
+        frame = parse_line(line)
+        if frame is None:
+            continue
+        ftype, bus, dev_id, first = frame[0:4]
+        if ftype not in (FRAME_SUMMARY, FRAME_WAIT, FRAME_TRANSFER) or bus not in BUS_NAMES:
+            continue
+        val = struct.unpack("<8H", frame[4:])
+        dev = devices.setdefault((bus, dev_id), Device(bus, dev_id))
+        if ftype == FRAME_SUMMARY:
+            dev.transactions = val[0] | val[1] << 16
+            dev.busy = val[2]
+            dev.errors = val[3]
+            dev.high_water = first
+        else:
+            hist = dev.wait if ftype == FRAME_WAIT else dev.transfer
+            for i, count in enumerate(val):
+                if first + i < buckets:
+                    hist[first + i] = count
+    return devices
+
+
+def bucket_label(n, last, tick_us):
+    low = 0 if n == 0 else (1 << n) * tick_us
+    if n == last:
+        return ">= {} us".format(low)
+    return "{}-{} us".format(low, (1 << (n + 1)) * tick_us)
+
+
+def print_hist(name, hist, buckets, tick_us):
+    if not any(hist.values()):
+        print("  {}: empty".format(name))
+        return
+    last = buckets - 1
+    total = sum(hist.values())
+    print("  {}:".format(name))
+    for n in range(buckets):
+        count = hist.get(n, 0)
+        if count == 0:
+            continue
+        bar = "#" * max(1, 40 * count // total)
+        print("    {:>18} {:>6} {}".format(bucket_label(n, last, tick_us), count, bar))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", type=argparse.FileType("r"), default=sys.stdin)
+    parser.add_argument("--tick-us", type=int, default=8, help="IC_BUS_STATS_TICK_US")
+    parser.add_argument("--buckets", type=int, default=12, help="IC_BUS_STATS_BUCKETS")
+    parser.add_argument("--twi-queue", type=int, help="IC_TWI_PENDIG_TRANSACTIONS")
+    parser.add_argument("--spi-queue", type=int, help="IC_SPI_PENDIG_TRANSACTIONS")
+    args = parser.parse_args()
+
+    devices = decode(args.capture, args.buckets)
+    if not devices:
+        print("no bus statistics frames found", file=sys.stderr)
+        return 1
+
+    queue = {0: args.twi_queue, 1: args.spi_queue}
+    for (bus, dev_id), dev in sorted(devices.items()):
+        print("{} 0x{:02X}: {} transactions, {} busy, {} errors, queue high-water {}".format(
+            BUS_NAMES[bus], dev_id, dev.transactions, dev.busy, dev.errors, dev.high_water))
+        print_hist("enqueue to start", dev.wait, args.buckets, args.tick_us)
+        print_hist("start to complete", dev.transfer, args.buckets, args.tick_us)
+        size = queue[bus]
+        if size is not None and (dev.busy or dev.high_water >= size):
+            print("  queue of {} entries was full, consider a bigger one".format(size))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
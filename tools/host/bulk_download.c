@@ -0,0 +1,348 @@
+/**
+ * @file    bulk_download.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Bulk download end to end, firmware bulk service against host reference receiver
+ *
+ * Sessions are recorded to emulated flash, then downloaded by @ref bulk_receiver_s over simulated
+ * link. Notification stub gives SoftDevice buffers per connection event, TX_COMPLETE hands them
+ * back. Notifications sent in an event are delivered to receiver at its end, requests of receiver
+ * reach bulk characteristic right away.
+ *
+ * Checks:
+ *  - INFO reports flash size, log head and session of recorder,
+ *  - SEEK of recorded session gives its session page, of unknown session an error,
+ *  - every scenario ends with DONE and downloaded bytes are equal to flash,
+ *  - without loss nothing is retransmitted and every free buffer is filled,
+ *  - lost notifications are requested again by NACK,
+ *  - download broken by disconnect is resumed with START from the first missing byte.
+ * Throughput report is in time of simulated link.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "app_util_platform.h"
+
+#include "ic_service_bulk.h"
+#include "ic_service_recorder.h"
+#include "ic_service_time.h"
+#include "ic_ble_service.h"
+
+#include "host_port.h"
+#include "flash_emu.h"
+#include "bulk_receiver.h"
+
+#define BULK_IMAGE            "bulk_download.img"
+#define BULK_CAPACITY         18          /** 256kB - index block and 3 data blocks */
+#define BULK_SPEED            4
+#define BULK_SESSIONS         3
+#define BULK_FRAMES           200         /** Frames of session, 4 fill a page */
+#define BULK_FRAME_LEN        58
+#define BULK_LENGTH           (16 * 1024)
+#define BULK_MAX_EVENTS       20000
+#define BULK_MAX_CREDITS      8
+
+typedef struct{
+  const char *name;
+  TickType_t interval;                /** Connection interval, ticks */
+  uint8_t credits;                    /** Notifications per interval */
+  uint32_t loss_every;                /** 0 - no loss */
+  uint32_t disconnect_at;             /** Connection event of link loss, 0 - none */
+}bulk_scenario_s;
+
+static const bulk_scenario_s m_scenarios[] = {
+  {"1 buffer",    8, 1, 0,  0},
+  {"3 buffers",   8, 3, 0,  0},
+  {"6 buffers",   8, 6, 0,  0},
+  {"lossy",       8, 6, 13, 0},
+  {"resume",      8, 6, 0,  100},
+};
+
+static void (*m_state_change)(bool);
+static void (*m_request)(uint8_t *, size_t);
+
+static struct{
+  uint8_t credits;
+  uint32_t loss_every;
+  uint32_t accepted;
+  uint32_t lost;
+  uint8_t packets[BULK_MAX_CREDITS][IC_BULK_PACKET_SIZE];
+  uint8_t lengths[BULK_MAX_CREDITS];
+  uint32_t count;                     /** Notifications sent in current event */
+}m_link;
+
+static bulk_receiver_s m_receiver;
+static uint8_t m_download[BULK_LENGTH];
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_unix_timestamp_s ic_unix_timestamp_get(){
+  return (ic_unix_timestamp_s){.unix_timestamp = 1500000000 + xTaskGetTickCount()/configTICK_RATE_HZ};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_stream0_ready(){
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_stream1_ready(){
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_mux_ready(){
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_connect_to_bulk(void (*p_func)(bool), void (*p_control)(uint8_t *, size_t)){
+  m_state_change = p_func;
+  m_request = p_control;
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_send_to_bulk(const uint8_t *data, size_t len, uint32_t *err){
+  UNUSED_PARAMETER(err);
+
+  if(len > IC_BULK_PACKET_SIZE){
+    fprintf(stderr, "bulk notification of %zu bytes\n", len);
+    abort();
+  }
+
+  __auto_type _ret_val = IC_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  if(m_link.credits == 0){
+    _ret_val = IC_BUSY;
+  }
+  else{
+    --m_link.credits;
+    if(m_link.loss_every != 0 && ++m_link.accepted % m_link.loss_every == 0){
+      ++m_link.lost;
+    }
+    else{
+      memcpy(m_link.packets[m_link.count], data, len);
+      m_link.lengths[m_link.count] = len;
+      ++m_link.count;
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  return _ret_val;
+}
+
+static void m_write(const uint8_t *data, size_t len, void *ctx){
+  UNUSED_PARAMETER(ctx);
+  m_request((uint8_t *)data, len);
+}
+
+/**
+ * @brief Notifications of last interval go to receiver, it answers and buffers are given back.
+ */
+static void m_connection_event(const bulk_scenario_s *scenario){
+  static uint8_t _packets[BULK_MAX_CREDITS][IC_BULK_PACKET_SIZE];
+  static uint8_t _lengths[BULK_MAX_CREDITS];
+  ble_evt_t _evt = {.header.evt_id = BLE_EVT_TX_COMPLETE};
+  uint32_t _count;
+
+  vTaskDelay(scenario->interval);
+
+  CRITICAL_REGION_ENTER();
+  _count = m_link.count;
+  memcpy(_packets, m_link.packets, sizeof(_packets));
+  memcpy(_lengths, m_link.lengths, sizeof(_lengths));
+  m_link.count = 0;
+  m_link.credits = scenario->credits;
+  CRITICAL_REGION_EXIT();
+
+  for(uint32_t i = 0; i < _count; ++i)
+    bulk_receiver_feed(&m_receiver, _packets[i], _lengths[i]);
+  bulk_receiver_event(&m_receiver);
+
+  ic_bulk_on_ble_evt(&_evt);
+}
+
+/**
+ * @brief Link is lost, notifications of last interval never arrive.
+ */
+static void m_disconnect(void){
+  CRITICAL_REGION_ENTER();
+  m_link.count = 0;
+  m_link.credits = 0;
+  CRITICAL_REGION_EXIT();
+
+  m_state_change(false);
+}
+
+static int m_check(const char *what, uint32_t value, uint32_t expected, bool exact){
+  __auto_type _ok = exact ? value == expected : value <= expected;
+  if(!_ok)
+    printf("  %-26s %8u %s %u  FAIL\n", what, value, exact ? "==" : "<=", expected);
+  return _ok ? 0 : 1;
+}
+
+static void m_session(uint32_t frames){
+  uint8_t _frame[BULK_FRAME_LEN];
+
+  if(ic_recorder_start() != IC_SUCCESS)
+    return;
+
+  __auto_type _session = ic_recorder_get_stats().session;
+  for(uint32_t i = 0; i < frames; ++i){
+    for(int j = 0; j < sizeof(_frame); ++j)
+      _frame[j] = (uint8_t)(_session * 31 + i + j);
+    while(ic_recorder_append(IC_RECORDER_EEG, _frame, sizeof(_frame)) == IC_BUSY)
+      vTaskDelay(1);
+  }
+
+  ic_recorder_stop();
+}
+
+/**
+ * @brief Wait for answer to INFO or SEEK, link has free buffers.
+ */
+static bool m_wait_answer(const bool *answered){
+  static const bulk_scenario_s _idle = {"idle", 8, BULK_MAX_CREDITS, 0, 0};
+
+  for(int i = 0; i < 64 && !*answered; ++i)
+    m_connection_event(&_idle);
+
+  return *answered;
+}
+
+static int m_info_seek(void){
+  int _failed = 0;
+  __auto_type _stats = ic_recorder_get_stats();
+
+  bulk_receiver_info(&m_receiver);
+  _failed += m_check("INFO answered", m_wait_answer(&m_receiver.info), true, true);
+  _failed += m_check("INFO flash size", m_receiver.flash_size, 1 << BULK_CAPACITY, true);
+  _failed += m_check("INFO head", m_receiver.head, _stats.head, true);
+  _failed += m_check("INFO session", m_receiver.session, _stats.session, true);
+
+  for(uint16_t _session = 1; _session <= BULK_SESSIONS; ++_session){
+    bulk_receiver_seek(&m_receiver, _session, 0);
+    _failed += m_check("SEEK answered", m_wait_answer(&m_receiver.seek), true, true);
+    _failed += m_check("SEEK result", m_receiver.seek_result, IC_SUCCESS, true);
+
+    __auto_type _page = (const ic_recorder_page_s *)&flash_emu_memory()[m_receiver.seek_address];
+    _failed += m_check("SEEK session page",
+        m_receiver.seek_address % IC_FLASH_PAGE_SIZE == 0
+          && m_receiver.seek_address < flash_emu_size()
+          && _page->header.magic == IC_RECORDER_MAGIC
+          && _page->header.type == IC_RECORDER_PAGE_SESSION
+          && _page->header.session == _session,
+        true, true);
+  }
+
+  bulk_receiver_seek(&m_receiver, BULK_SESSIONS + 1, 0);
+  _failed += m_check("SEEK unknown answered", m_wait_answer(&m_receiver.seek), true, true);
+  _failed += m_check("SEEK unknown result", m_receiver.seek_result, IC_ERROR, true);
+
+  return _failed;
+}
+
+static int m_run(const bulk_scenario_s *scenario, uint32_t offset){
+  uint32_t _events = 0;
+
+  CRITICAL_REGION_ENTER();
+  m_link.loss_every = scenario->loss_every;
+  m_link.accepted = 0;
+  m_link.lost = 0;
+  CRITICAL_REGION_EXIT();
+
+  memset(m_download, 0, sizeof(m_download));
+  m_receiver.stats = (bulk_receiver_stats_s){0};
+  bulk_receiver_start(&m_receiver, offset, BULK_LENGTH, m_download);
+
+  while(m_receiver.active && _events < BULK_MAX_EVENTS){
+    m_connection_event(scenario);
+    if(++_events == scenario->disconnect_at){
+      m_disconnect();
+      bulk_receiver_resume(&m_receiver);
+    }
+  }
+
+  __auto_type _rx = &m_receiver.stats;
+  __auto_type _packets = (BULK_LENGTH + IC_BULK_PAYLOAD - 1) / IC_BULK_PAYLOAD;
+  __auto_type _seconds = (double)_events * scenario->interval / configTICK_RATE_HZ;
+
+  printf("%-10s %7u %7u %6u %6u %5u %7.2f %8.1f\n",
+      scenario->name, _events, _rx->packets, m_link.lost, _rx->nacks, _rx->stalls,
+      (double)_rx->packets / _events, BULK_LENGTH / 1024.0 / _seconds);
+
+  int _failed = 0;
+  _failed += m_check("done", m_receiver.done, true, true);
+  _failed += m_check("error", m_receiver.failed, false, true);
+  _failed += m_check("protocol errors", _rx->protocol_errors, 0, true);
+  _failed += m_check("content",
+      memcmp(m_download, &flash_emu_memory()[offset], BULK_LENGTH) == 0, true, true);
+
+  if(scenario->loss_every == 0 && scenario->disconnect_at == 0){
+    _failed += m_check("retransmitted", _rx->packets, _packets, true);
+    _failed += m_check("NACKs", _rx->nacks, 0, true);
+    /* Every event fills all buffers, first and last ones can not */
+    _failed += m_check("events", _events, _packets / scenario->credits + 3, false);
+  }
+  if(scenario->loss_every != 0)
+    _failed += m_check("NACKs of lost", m_link.lost, _rx->nacks + _rx->stalls, false);
+  if(scenario->disconnect_at != 0){
+    _failed += m_check("resumes", _rx->resumes, 1, true);
+    /* Only packets sent in the lost interval and not acknowledged ones are downloaded again */
+    _failed += m_check("resent after resume", _rx->packets, _packets + scenario->credits, false);
+  }
+
+  return _failed;
+}
+
+int main(void){
+  int _failed = 0;
+
+  unlink(BULK_IMAGE);
+
+  host_port_init();
+  host_tick_speed(BULK_SPEED);
+  host_timer_daemon_start();
+  if(!flash_emu_open(BULK_IMAGE, BULK_CAPACITY))
+    return 1;
+  flash_emu_timing(1, 4, 8);
+
+  if(ic_service_recorder_init() != IC_SUCCESS || ic_service_bulk_init() != IC_SUCCESS)
+    return 1;
+  if(m_state_change == NULL || m_request == NULL)
+    return 1;
+
+  for(int i = 0; i < BULK_SESSIONS; ++i)
+    m_session(BULK_FRAMES);
+  /* Let recorder task write buffered pages */
+  while(ic_recorder_get_stats().pages < BULK_SESSIONS * (BULK_FRAMES/4 + 1))
+    vTaskDelay(1);
+
+  __auto_type _ble = host_task_new("BLE");
+  host_task_enter(_ble);
+  bulk_receiver_init(&m_receiver, m_write, NULL);
+  m_state_change(true);
+
+  _failed += m_info_seek();
+
+  uint32_t _offset = 0;
+  if(ic_recorder_seek(1, 0, &_offset) != IC_SUCCESS)
+    return 1;
+
+  printf("%-10s %7s %7s %6s %6s %5s %7s %8s\n",
+      "scenario", "events", "packets", "lost", "nacks", "stall", "pkt/evt", "kB/s");
+  for(int i = 0; i < sizeof(m_scenarios)/sizeof(m_scenarios[0]); ++i)
+    _failed += m_run(&m_scenarios[i], _offset);
+
+  flash_emu_close();
+  unlink(BULK_IMAGE);
+
+  printf(_failed == 0 ? "PASS\n" : "FAIL\n");
+  return _failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file    bulk_receiver.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Receiver side of bulk download
+ *
+ * Device keeps one retransmission range, new NACK replaces it, so only the first gap is requested
+ * in a connection event. Gaps behind it are requested when it is filled.
+ */
+
+#include <string.h>
+
+#include "app_util_platform.h"
+
+#include "bulk_receiver.h"
+
+static inline uint16_t m_get16(const uint8_t *data){
+  return data[0] | data[1] << 8;
+}
+
+static inline uint32_t m_get32(const uint8_t *data){
+  return m_get16(data) | (uint32_t)m_get16(data + 2) << 16;
+}
+
+static inline void m_put16(uint8_t *data, uint16_t value){
+  data[0] = (uint8_t)value;
+  data[1] = (uint8_t)(value >> 8);
+}
+
+static inline void m_put32(uint8_t *data, uint32_t value){
+  m_put16(data, (uint16_t)value);
+  m_put16(data + 2, (uint16_t)(value >> 16));
+}
+
+static void m_finish(bulk_receiver_s *receiver){
+  receiver->active = false;
+  receiver->done = receiver->next == receiver->packets;
+}
+
+static void m_control(bulk_receiver_s *receiver, uint16_t op, const uint8_t *args, size_t len){
+  switch(op){
+    case IC_BULK_DONE:
+      if(!receiver->active)
+        break;
+      m_finish(receiver);
+      if(!receiver->done)
+        ++receiver->stats.protocol_errors;
+      break;
+    case IC_BULK_ERROR:
+      receiver->active = false;
+      receiver->failed = true;
+      receiver->error = len >= 1 ? args[0] : IC_ERROR;
+      break;
+    case IC_BULK_INFO:
+      if(len < 10)
+        break;
+      receiver->info = true;
+      receiver->flash_size = m_get32(&args[0]);
+      receiver->head = m_get32(&args[4]);
+      receiver->session = m_get16(&args[8]);
+      return;
+    case IC_BULK_SEEK:
+      if(len < 5)
+        break;
+      receiver->seek = true;
+      receiver->seek_result = args[0];
+      receiver->seek_address = m_get32(&args[1]);
+      return;
+    default:
+      break;
+  }
+
+  if(op != IC_BULK_DONE && op != IC_BULK_ERROR)
+    ++receiver->stats.protocol_errors;
+}
+
+static void m_nack(bulk_receiver_s *receiver, uint32_t count){
+  uint8_t _request[4] = {IC_BULK_NACK};
+
+  m_put16(&_request[1], receiver->next & IC_BULK_SEQ_MASK);
+  _request[3] = (uint8_t)MIN(count, UINT8_MAX);
+  receiver->write(_request, sizeof(_request), receiver->ctx);
+
+  receiver->nacked = receiver->next;
+  receiver->nack_age = 0;
+  receiver->idle = 0;
+  ++receiver->stats.nacks;
+}
+
+/**
+ * @brief Packets missing from next to the first received one.
+ */
+static uint32_t m_gap(const bulk_receiver_s *receiver){
+  uint32_t _count = 1;
+
+  while(receiver->next + _count < receiver->highest
+      && !receiver->received[(receiver->next + _count) % IC_BULK_WINDOW])
+    ++_count;
+
+  return _count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void bulk_receiver_init(
+    bulk_receiver_s *receiver,
+    void (*write)(const uint8_t *, size_t, void *),
+    void *ctx)
+{
+  memset(receiver, 0, sizeof(*receiver));
+  receiver->write = write;
+  receiver->ctx = ctx;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void bulk_receiver_info(bulk_receiver_s *receiver){
+  uint8_t _request = IC_BULK_INFO;
+
+  receiver->info = false;
+  receiver->write(&_request, 1, receiver->ctx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void bulk_receiver_seek(bulk_receiver_s *receiver, uint16_t session, uint32_t timestamp){
+  uint8_t _request[7] = {IC_BULK_SEEK};
+
+  m_put16(&_request[1], session);
+  m_put32(&_request[3], timestamp);
+  receiver->seek = false;
+  receiver->write(_request, sizeof(_request), receiver->ctx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void bulk_receiver_start(bulk_receiver_s *receiver, uint32_t offset, uint32_t length, uint8_t *dst){
+  uint8_t _request[9] = {IC_BULK_START};
+
+  receiver->dst = dst;
+  receiver->offset = offset;
+  receiver->length = length;
+  receiver->packets = (length + IC_BULK_PAYLOAD - 1) / IC_BULK_PAYLOAD;
+  receiver->next = receiver->acked = receiver->highest = 0;
+  receiver->nacked = UINT32_MAX;
+  receiver->nack_age = receiver->idle = 0;
+  memset(receiver->received, 0, sizeof(receiver->received));
+  receiver->active = true;
+  receiver->done = receiver->failed = false;
+
+  m_put32(&_request[1], offset);
+  m_put32(&_request[5], length);
+  receiver->write(_request, sizeof(_request), receiver->ctx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void bulk_receiver_resume(bulk_receiver_s *receiver){
+  if(receiver->next == receiver->packets){
+    m_finish(receiver);
+    return;
+  }
+
+  __auto_type _bytes = receiver->next * IC_BULK_PAYLOAD;
+
+  ++receiver->stats.resumes;
+  bulk_receiver_start(
+      receiver,
+      receiver->offset + _bytes,
+      receiver->length - _bytes,
+      receiver->dst + _bytes);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void bulk_receiver_feed(bulk_receiver_s *receiver, const uint8_t *data, size_t len){
+  if(len < 2){
+    ++receiver->stats.protocol_errors;
+    return;
+  }
+
+  __auto_type _seq = m_get16(data);
+  if(_seq & IC_BULK_CONTROL_FLAG){
+    m_control(receiver, _seq & ~IC_BULK_CONTROL_FLAG, data + 2, len - 2);
+    return;
+  }
+
+  /* Packets of broken download */
+  if(!receiver->active)
+    return;
+
+  ++receiver->stats.packets;
+  receiver->idle = 0;
+
+  __auto_type _ahead = (uint32_t)(_seq - receiver->next) & IC_BULK_SEQ_MASK;
+  if(_ahead > IC_BULK_SEQ_MASK/2){
+    ++receiver->stats.duplicates;
+    return;
+  }
+
+  __auto_type _index = receiver->next + _ahead;
+  if(_ahead >= IC_BULK_WINDOW || _index >= receiver->packets
+      || len - 2 != MIN(IC_BULK_PAYLOAD, receiver->length - _index * IC_BULK_PAYLOAD))
+  {
+    ++receiver->stats.protocol_errors;
+    return;
+  }
+
+  __auto_type _slot = &receiver->received[_index % IC_BULK_WINDOW];
+  if(*_slot){
+    ++receiver->stats.duplicates;
+    return;
+  }
+
+  memcpy(&receiver->dst[_index * IC_BULK_PAYLOAD], data + 2, len - 2);
+  *_slot = true;
+  if(_index != receiver->next)
+    ++receiver->stats.out_of_order;
+  receiver->highest = MAX(receiver->highest, _index + 1);
+
+  while(receiver->next < receiver->packets && receiver->received[receiver->next % IC_BULK_WINDOW]){
+    receiver->received[receiver->next % IC_BULK_WINDOW] = false;
+    ++receiver->next;
+  }
+  receiver->highest = MAX(receiver->highest, receiver->next);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void bulk_receiver_event(bulk_receiver_s *receiver){
+  if(!receiver->active)
+    return;
+
+  if(receiver->next > receiver->acked){
+    uint8_t _request[3] = {IC_BULK_ACK};
+
+    m_put16(&_request[1], (receiver->next - 1) & IC_BULK_SEQ_MASK);
+    receiver->write(_request, sizeof(_request), receiver->ctx);
+    receiver->acked = receiver->next;
+    ++receiver->stats.acks;
+  }
+
+  if(receiver->highest > receiver->next){
+    if(receiver->nacked != receiver->next || receiver->nack_age >= BULK_RECEIVER_RENACK)
+      m_nack(receiver, m_gap(receiver));
+  }
+  else if(receiver->idle >= BULK_RECEIVER_STALL){
+    /* Tail of window or DONE was lost */
+    if(receiver->next == receiver->packets){
+      m_finish(receiver);
+      return;
+    }
+    ++receiver->stats.stalls;
+    m_nack(receiver, MIN(IC_BULK_WINDOW, receiver->packets - receiver->next));
+  }
+
+  ++receiver->idle;
+  ++receiver->nack_age;
+}
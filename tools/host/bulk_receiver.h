@@ -0,0 +1,98 @@
+/**
+ * @file    bulk_receiver.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Receiver side of bulk download, protocol is described in ic_service_bulk.h
+ *
+ * Notifications are fed in order of arrival, packets are stored at their place in destination
+ * buffer, so receiver keeps only a bitmap of one window. At the end of every connection event it
+ * acknowledges packets received in order and asks for retransmission of the first gap. When
+ * nothing came for @ref BULK_RECEIVER_STALL events, tail of window is requested again, it covers
+ * loss of the last packets sent. Download broken by disconnect is resumed with START from the first
+ * missing byte.
+ */
+
+#ifndef BULK_RECEIVER_H
+#define BULK_RECEIVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ic_service_bulk.h"
+
+#define BULK_RECEIVER_STALL   4       /** Connection events without packet before tail is NACKed */
+#define BULK_RECEIVER_RENACK  2       /** Connection events before gap is NACKed again */
+
+typedef struct{
+  uint32_t packets;
+  uint32_t duplicates;                /** Packets received more than once */
+  uint32_t out_of_order;              /** Packets received after a gap */
+  uint32_t acks;
+  uint32_t nacks;
+  uint32_t stalls;                    /** Tail NACKs */
+  uint32_t resumes;
+  uint32_t protocol_errors;           /** Malformed notification or packet outside window */
+}bulk_receiver_stats_s;
+
+typedef struct{
+  void (*write)(const uint8_t *, size_t, void *);
+  void *ctx;
+  bool active;
+  bool done;                          /** DONE received, whole range is in destination */
+  bool failed;                        /** ERROR received */
+  uint8_t error;                      /** ic_return_val_e of ERROR */
+  uint8_t *dst;                       /** Destination of packet 0 */
+  uint32_t offset;                    /** Flash address of packet 0 */
+  uint32_t length;
+  uint32_t packets;
+  uint32_t next;                      /** Packets below are received */
+  uint32_t acked;                     /** Packets below are acknowledged */
+  uint32_t highest;                   /** Packets below were seen at least once */
+  uint32_t nacked;                    /** Gap which was NACKed */
+  uint32_t nack_age;                  /** Connection events since NACK */
+  uint32_t idle;                      /** Connection events without packet */
+  bool received[IC_BULK_WINDOW];      /** Packets from next, indexed by packet % window */
+  bool info;                          /** INFO answer received */
+  uint32_t flash_size;
+  uint32_t head;
+  uint16_t session;
+  bool seek;                          /** SEEK answer received */
+  uint8_t seek_result;
+  uint32_t seek_address;
+  bulk_receiver_stats_s stats;
+}bulk_receiver_s;
+
+/**
+ * @brief Requests are passed to write, harness delivers them to bulk characteristic.
+ */
+void bulk_receiver_init(
+    bulk_receiver_s *receiver,
+    void (*write)(const uint8_t *, size_t, void *),
+    void *ctx);
+
+void bulk_receiver_info(bulk_receiver_s *receiver);
+
+void bulk_receiver_seek(bulk_receiver_s *receiver, uint16_t session, uint32_t timestamp);
+
+/**
+ * @brief Download length bytes from flash address to dst.
+ */
+void bulk_receiver_start(bulk_receiver_s *receiver, uint32_t offset, uint32_t length, uint8_t *dst);
+
+/**
+ * @brief Continue download after reconnection from the first byte not received in order.
+ */
+void bulk_receiver_resume(bulk_receiver_s *receiver);
+
+/**
+ * @brief Process one notification.
+ */
+void bulk_receiver_feed(bulk_receiver_s *receiver, const uint8_t *data, size_t len);
+
+/**
+ * @brief End of connection event, sends ACK and NACK requests.
+ */
+void bulk_receiver_event(bulk_receiver_s *receiver);
+
+#endif /* !BULK_RECEIVER_H */
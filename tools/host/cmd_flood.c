@@ -0,0 +1,210 @@
+/**
+ * @file    cmd_flood.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Command intake flood, checks intake never blocks and every request is answered
+ *
+ * Writer task plays BLE stack task: it pushes frames into intake registered by command task as
+ * fast as it can. Mix of tagged, legacy, wrong CRC, wrong SYNC, unknown and coalescable
+ * DEVICE_CMD frames, handlers are slow so command queue overflows. Response characteristic is
+ * busy on every third notification.
+ *
+ * Checks:
+ *  - writer never sleeps (intake must not call vTaskDelay),
+ *  - every tagged request got exactly one response or was counted as lost,
+ *  - statuses of responses agree with intake statistics.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "app_util_platform.h"
+
+#include "ic_command_task.h"
+#include "ic_scheduler.h"
+#include "ic_ble_service.h"
+
+#include "host_port.h"
+
+#define FLOOD_FRAMES      20000
+#define FLOOD_DEVICES     3         /** Different device masks, the fewer the more coalescing */
+#define FLOOD_VALID_MARK  0xA5      /** Last frame byte, stands in for CRC */
+#define FLOOD_UNKNOWN_CMD 0x77
+#define FLOOD_DRAIN_MS    5000
+#define FLOOD_STATUSES    (CMD_STATUS_EXPIRED + 1)
+
+static void (*m_intake)(uint8_t *, size_t);
+static TaskHandle_t m_writer;
+
+static struct{
+  uint32_t notifications;
+  uint32_t delivered;
+  uint32_t status[FLOOD_STATUSES];
+  uint32_t tagged;                  /** Requests which have to be answered */
+  uint32_t invalid_tagged;
+  uint32_t unknown;
+}m_flood;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_connect_to_cmd(void (*p_func)(uint8_t *, size_t)){
+  CRITICAL_REGION_ENTER();
+  m_intake = p_func;
+  CRITICAL_REGION_EXIT();
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_send_to_response(const uint8_t *data, size_t len, uint32_t *err){
+  UNUSED_PARAMETER(err);
+
+  if(len < CMD_RESPONSE_HEADER || len > 20){
+    fprintf(stderr, "response of %zu bytes\n", len);
+    abort();
+  }
+
+  __auto_type _ret_val = IC_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  if(++m_flood.notifications % 3 == 0){
+    _ret_val = IC_BUSY;
+  }
+  else{
+    ++m_flood.delivered;
+    ++m_flood.status[data[2] < FLOOD_STATUSES ? data[2] : CMD_STATUS_ERROR];
+  }
+  CRITICAL_REGION_EXIT();
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool neuroon_cmd_frame_validate(uint8_t *data, size_t len){
+  return data[len - 1] == FLOOD_VALID_MARK;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_scheduler_add(
+    uint32_t time,
+    const u_cmdFrameContainer *frames,
+    uint8_t count,
+    ic_scheduler_handle_s *handle)
+{
+  UNUSED_PARAMETER(time);
+  UNUSED_PARAMETER(frames);
+  UNUSED_PARAMETER(count);
+  *handle = (ic_scheduler_handle_s){0};
+  return IC_SUCCESS;
+}
+
+static void m_spin(uint32_t us){
+  __auto_type _end = xTaskGetTickCount() + (us * configTICK_RATE_HZ + 999999) / 1000000;
+  while((int32_t)(xTaskGetTickCount() - _end) < 0);
+}
+
+static ic_return_val_e m_slow_handle(u_BLECmdPayload payload, void *ctx){
+  UNUSED_PARAMETER(payload);
+  UNUSED_PARAMETER(ctx);
+  m_spin(500);
+  return IC_SUCCESS;
+}
+
+static void m_writer_task(void *args){
+  UNUSED_PARAMETER(args);
+
+  while(m_intake == NULL)
+    taskYIELD();
+
+  srand(1);
+  for(int i = 0; i < FLOOD_FRAMES; ++i){
+    u_cmdFrameContainer _frame;
+    memset(&_frame, 0, sizeof(_frame));
+
+    _frame.frame.sync = i % (CMD_MAX_REQUEST_ID + 1);
+    _frame.frame.cmd = DEVICE_CMD;
+    _frame.frame.payload.device_cmd.device = 1 << (rand() % FLOOD_DEVICES);
+    _frame.data[sizeof(_frame) - 1] = FLOOD_VALID_MARK;
+
+    switch(rand() % 10){
+      case 0:
+        _frame.frame.sync = CMD_SYNC_LEGACY;
+        break;
+      case 1:
+        _frame.data[sizeof(_frame) - 1] = (uint8_t)~FLOOD_VALID_MARK;
+        ++m_flood.invalid_tagged;
+        break;
+      case 2:
+        _frame.frame.sync = CMD_LOCAL_ID_FIRST;
+        break;
+      case 3:
+        _frame.frame.cmd = FLOOD_UNKNOWN_CMD;
+        ++m_flood.unknown;
+        break;
+      default:
+        break;
+    }
+    if(_frame.frame.sync <= CMD_MAX_REQUEST_ID)
+      ++m_flood.tagged;
+
+    m_intake(_frame.data, sizeof(_frame));
+  }
+}
+
+static uint32_t m_answered(void){
+  __auto_type _lost = cmd_get_intake_stats().lost_responses;
+
+  CRITICAL_REGION_ENTER();
+  __auto_type _answered = m_flood.delivered + _lost;
+  CRITICAL_REGION_EXIT();
+
+  return _answered;
+}
+
+static int m_check(const char *what, uint32_t value, uint32_t expected, bool exact){
+  __auto_type _ok = exact ? value == expected : value <= expected;
+  printf("%-28s %8u %s %u%s\n", what, value, exact ? "==" : "<=", expected, _ok ? "" : "  FAIL");
+  return _ok ? 0 : 1;
+}
+
+int main(void){
+  host_port_init();
+
+  cmd_module_init();
+  if(cmd_register(DEVICE_CMD, m_slow_handle, NULL) != IC_SUCCESS)
+    return 1;
+
+  if(xTaskCreate(m_writer_task, "BLE", 256, NULL, 0, &m_writer) != pdPASS)
+    return 1;
+  host_join(m_writer);
+
+  __auto_type _deadline = xTaskGetTickCount() + pdMS_TO_TICKS(FLOOD_DRAIN_MS);
+  while(m_answered() < m_flood.tagged && (int32_t)(xTaskGetTickCount() - _deadline) < 0)
+    vTaskDelay(1);
+
+  __auto_type _stats = cmd_get_intake_stats();
+  int _failed = 0;
+
+  printf("%u frames, %u tagged, %u received, %u invalid, %u notifications\n",
+      FLOOD_FRAMES, m_flood.tagged, _stats.received, _stats.invalid, m_flood.notifications);
+
+  _failed += m_check("writer delays", host_task_delays(m_writer), 0, true);
+  _failed += m_check("answered", m_answered(), m_flood.tagged, true);
+  _failed += m_check("lost", _stats.lost_responses, m_flood.tagged, false);
+  _failed += m_check("INVALID_FRAME responses",
+      m_flood.status[CMD_STATUS_INVALID_FRAME], m_flood.invalid_tagged, false);
+  _failed += m_check("UNKNOWN_CMD responses",
+      m_flood.status[CMD_STATUS_UNKNOWN_CMD], m_flood.unknown, false);
+  _failed += m_check("BUSY responses", m_flood.status[CMD_STATUS_BUSY], _stats.overflows, false);
+  _failed += m_check("COALESCED responses",
+      m_flood.status[CMD_STATUS_COALESCED], _stats.coalesced, false);
+  _failed += m_check("queue high water", _stats.high_water, IC_CMD_QUEUE_LEN, false);
+
+  if(_stats.lost_responses == 0)
+    _failed += m_check("INVALID_FRAME exact",
+        m_flood.status[CMD_STATUS_INVALID_FRAME], m_flood.invalid_tagged, true);
+
+  printf(_failed == 0 ? "PASS\n" : "FAIL\n");
+  return _failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,557 @@
+/**
+ * @file    flash_emu.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   File backed JEDEC SPI NOR flash behind nrf_drv_spi shim
+ *
+ * Transfer clocks all its bytes through chip state machine at once, completion is passed to IRQ
+ * thread which calls SPI driver handler as interrupt (@ref host_irq_enter). Uninit drops pending
+ * completion like disabling the peripheral does on target. Emulator lock is taken inside critical
+ * region, never the other way round.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "nrf_drv_spi.h"
+
+#include "ic_config.h"
+
+#include "host_port.h"
+#include "flash_emu.h"
+
+#define EMU_CMD_WRITE_ENABLE    0x06
+#define EMU_CMD_READ_STATUS     0x05
+#define EMU_CMD_PAGE_PROGRAM    0x02
+#define EMU_CMD_FAST_READ       0x0B
+#define EMU_CMD_SECTOR_ERASE    0x20
+#define EMU_CMD_BLOCK_ERASE     0xD8
+#define EMU_CMD_READ_ID         0x9F
+#define EMU_CMD_POWER_DOWN      0xB9
+#define EMU_CMD_RESUME          0xAB
+#define EMU_CMD_IGNORED         0x00
+
+#define EMU_STATUS_WIP          0x01
+#define EMU_STATUS_WEL          0x02
+
+#define EMU_PAGE_SIZE           256
+#define EMU_SECTOR_SIZE         4096
+#define EMU_BLOCK_SIZE          65536
+#define EMU_MAX_SECTORS         4096  /** 16MB */
+
+/**
+ * @brief Program or erase, journal record.
+ */
+typedef struct{
+  uint8_t command;
+  uint32_t address;
+  uint8_t page[EMU_PAGE_SIZE];
+  bool latched[EMU_PAGE_SIZE];        /** Page buffer byte received in program frame */
+}emu_step_s;
+
+static struct{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int fd;
+  uint8_t *memory;
+  uint32_t size;
+  uint8_t capacity;
+
+  /* Chip */
+  bool selected;
+  uint32_t index;                     /** Byte of current frame */
+  emu_step_s frame;
+  bool was_busy;                      /** Status frame returned WIP */
+  bool wrapped;
+  bool wel;
+  bool power_down;
+  bool stalled;                       /** Next program or erase does not finish */
+  bool stuck;
+  TickType_t busy_until;
+  TickType_t program_ticks;
+  TickType_t sector_ticks;
+  TickType_t block_ticks;
+  int journal;
+  uint32_t erases[EMU_MAX_SECTORS];   /** Erase cycles of sectors since open */
+
+  /* SPI peripheral */
+  nrf_drv_spi_handler_t handler;
+  uint8_t orc;
+  bool initialized;
+  bool irq_started;
+  pthread_t irq;
+  uint32_t generation;                /** Bumped by uninit, drops completion in flight */
+  bool pending;
+  uint32_t pending_generation;
+  bool lose_next;
+
+  flash_emu_stats_s stats;
+}m_emu = {
+  .lock           = PTHREAD_MUTEX_INITIALIZER,
+  .cond           = PTHREAD_COND_INITIALIZER,
+  .fd             = -1,
+  .journal        = -1,
+  .program_ticks  = 1,
+  .sector_ticks   = 48,
+  .block_ticks    = 160,
+};
+
+static bool m_busy(void){
+  return m_emu.stuck || (int32_t)(xTaskGetTickCount() - m_emu.busy_until) < 0;
+}
+
+static uint8_t m_status(void){
+  return (m_busy() ? EMU_STATUS_WIP : 0) | (m_emu.wel ? EMU_STATUS_WEL : 0);
+}
+
+/**
+ * @brief Command byte starts frame. Chip accepts only status read while busy and only resume in
+ * deep power-down.
+ */
+static void m_command(uint8_t command){
+  m_emu.frame.command = command;
+  m_emu.frame.address = 0;
+  m_emu.was_busy = false;
+  m_emu.wrapped = false;
+  memset(m_emu.frame.latched, 0, sizeof(m_emu.frame.latched));
+
+  if((m_emu.power_down && command != EMU_CMD_RESUME)
+      || (!m_emu.power_down && m_busy() && command != EMU_CMD_READ_STATUS))
+  {
+    ++m_emu.stats.busy_violations;
+    m_emu.frame.command = EMU_CMD_IGNORED;
+  }
+}
+
+static uint8_t m_clock(uint8_t mosi){
+  __auto_type _index = m_emu.index++;
+
+  if(_index == 0){
+    m_command(mosi);
+    return 0xFF;
+  }
+
+  switch(m_emu.frame.command){
+    case EMU_CMD_READ_STATUS:
+      m_emu.was_busy |= m_busy();
+      return m_status();
+    case EMU_CMD_READ_ID:
+      switch(_index){
+        case 1: return FLASH_EMU_MANUFACTURER;
+        case 2: return FLASH_EMU_TYPE;
+        case 3: return m_emu.capacity;
+        default: return 0xFF;
+      }
+    case EMU_CMD_FAST_READ:
+    case EMU_CMD_PAGE_PROGRAM:
+    case EMU_CMD_SECTOR_ERASE:
+    case EMU_CMD_BLOCK_ERASE:
+      if(_index <= 3){
+        m_emu.frame.address = m_emu.frame.address << 8 | mosi;
+        return 0xFF;
+      }
+      break;
+    default:
+      return 0xFF;
+  }
+
+  if(m_emu.frame.command == EMU_CMD_FAST_READ){
+    if(_index == 4)
+      return 0xFF;                    /* Dummy byte */
+    ++m_emu.stats.read_bytes;
+    return m_emu.memory[(m_emu.frame.address + _index - 5) % m_emu.size];
+  }
+
+  if(m_emu.frame.command == EMU_CMD_PAGE_PROGRAM){
+    __auto_type _offset = (m_emu.frame.address + _index - 4) % EMU_PAGE_SIZE;
+    if(m_emu.frame.address % EMU_PAGE_SIZE + _index - 4 >= EMU_PAGE_SIZE)
+      m_emu.wrapped = true;
+    m_emu.frame.page[_offset] = mosi;
+    m_emu.frame.latched[_offset] = true;
+  }
+
+  return 0xFF;
+}
+
+static bool m_write_enabled(void){
+  if(m_emu.wel)
+    return true;
+  ++m_emu.stats.wel_violations;
+  return false;
+}
+
+static void m_start_busy(TickType_t ticks){
+  m_emu.wel = false;
+  m_emu.busy_until = xTaskGetTickCount() + ticks;
+  m_emu.stuck = m_emu.stalled;
+}
+
+/**
+ * @brief Execute program or erase. Power cut leaves it half done.
+ */
+static void m_apply(const emu_step_s *step, bool cut){
+  __auto_type _address = step->address % m_emu.size;
+
+  if(step->command == EMU_CMD_PAGE_PROGRAM){
+    __auto_type _page = _address & ~(EMU_PAGE_SIZE - 1);
+    int _left = 0;
+
+    for(int i = 0; i < EMU_PAGE_SIZE; ++i)
+      _left += step->latched[i];
+    if(cut)
+      _left /= 2;
+
+    for(int i = 0; i < EMU_PAGE_SIZE && _left > 0; ++i){
+      if(!step->latched[i])
+        continue;
+      if((m_emu.memory[_page + i] & step->page[i]) != step->page[i])
+        ++m_emu.stats.dirty_programs;
+      m_emu.memory[_page + i] &= step->page[i];
+      --_left;
+    }
+    return;
+  }
+
+  __auto_type _size = step->command == EMU_CMD_BLOCK_ERASE ? EMU_BLOCK_SIZE : EMU_SECTOR_SIZE;
+  memset(&m_emu.memory[_address & ~(_size - 1)], 0xFF, cut ? _size/2 : _size);
+}
+
+static void m_step(void){
+  m_apply(&m_emu.frame, false);
+
+  if(m_emu.frame.command != EMU_CMD_PAGE_PROGRAM){
+    __auto_type _size = m_emu.frame.command == EMU_CMD_BLOCK_ERASE ? EMU_BLOCK_SIZE : EMU_SECTOR_SIZE;
+    __auto_type _first = ((m_emu.frame.address % m_emu.size) & ~(_size - 1)) / EMU_SECTOR_SIZE;
+    for(uint32_t i = 0; i < _size / EMU_SECTOR_SIZE; ++i)
+      ++m_emu.erases[_first + i];
+  }
+
+  if(m_emu.journal >= 0 && write(m_emu.journal, &m_emu.frame, sizeof(m_emu.frame)) < 0){
+    close(m_emu.journal);
+    m_emu.journal = -1;
+  }
+}
+
+/**
+ * @brief CS went high, program and erase are executed now.
+ */
+static void m_frame_end(void){
+  if(m_emu.index == 0)
+    return;
+
+  ++m_emu.stats.frames;
+
+  switch(m_emu.frame.command){
+    case EMU_CMD_WRITE_ENABLE:
+      m_emu.wel = true;
+      break;
+    case EMU_CMD_READ_STATUS:
+      ++m_emu.stats.status_polls;
+      if(m_emu.was_busy)
+        ++m_emu.stats.busy_polls;
+      break;
+    case EMU_CMD_FAST_READ:
+      ++m_emu.stats.reads;
+      break;
+    case EMU_CMD_PAGE_PROGRAM:
+      if(m_emu.index < 5 || !m_write_enabled())
+        break;
+      m_step();
+      if(m_emu.wrapped)
+        ++m_emu.stats.page_wraps;
+      ++m_emu.stats.programs;
+      m_emu.stats.program_bytes += m_emu.wrapped ? EMU_PAGE_SIZE : m_emu.index - 4;
+      m_start_busy(m_emu.program_ticks);
+      break;
+    case EMU_CMD_SECTOR_ERASE:
+      if(m_emu.index != 4 || !m_write_enabled())
+        break;
+      m_step();
+      ++m_emu.stats.sector_erases;
+      m_start_busy(m_emu.sector_ticks);
+      break;
+    case EMU_CMD_BLOCK_ERASE:
+      if(m_emu.index != 4 || !m_write_enabled())
+        break;
+      m_step();
+      ++m_emu.stats.block_erases;
+      m_start_busy(m_emu.block_ticks);
+      break;
+    case EMU_CMD_POWER_DOWN:
+      m_emu.power_down = true;
+      break;
+    case EMU_CMD_RESUME:
+      m_emu.power_down = false;
+      break;
+    default:
+      break;
+  }
+
+  m_emu.index = 0;
+}
+
+static void *m_irq_entry(void *arg){
+  (void)arg;
+  nrf_drv_spi_evt_t _event = {.type = NRF_DRV_SPI_EVENT_DONE};
+
+  for(;;){
+    pthread_mutex_lock(&m_emu.lock);
+    while(!m_emu.pending)
+      pthread_cond_wait(&m_emu.cond, &m_emu.lock);
+    __auto_type _generation = m_emu.pending_generation;
+    pthread_mutex_unlock(&m_emu.lock);
+
+    host_irq_enter();
+    pthread_mutex_lock(&m_emu.lock);
+    __auto_type _valid = m_emu.pending && m_emu.generation == _generation;
+    if(_valid)
+      m_emu.pending = false;
+    __auto_type _handler = m_emu.handler;
+    pthread_mutex_unlock(&m_emu.lock);
+
+    if(_valid)
+      _handler(&_event);
+    host_irq_exit();
+  }
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_gpio_write(uint32_t pin, bool value){
+  if(pin != IC_SPI_FLASH_SS_PIN)
+    return;
+
+  pthread_mutex_lock(&m_emu.lock);
+  if(!value && !m_emu.selected){
+    m_emu.selected = true;
+    m_emu.index = 0;
+  }
+  else if(value && m_emu.selected){
+    m_emu.selected = false;
+    m_frame_end();
+  }
+  pthread_mutex_unlock(&m_emu.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ret_code_t nrf_drv_spi_init(
+    nrf_drv_spi_t const *p_instance,
+    nrf_drv_spi_config_t const *p_config,
+    nrf_drv_spi_handler_t handler)
+{
+  (void)p_instance;
+
+  pthread_mutex_lock(&m_emu.lock);
+  m_emu.handler = handler;
+  m_emu.orc = p_config->orc;
+  m_emu.initialized = true;
+  if(!m_emu.irq_started && pthread_create(&m_emu.irq, NULL, m_irq_entry, NULL) == 0)
+    m_emu.irq_started = true;
+  pthread_mutex_unlock(&m_emu.lock);
+
+  return m_emu.irq_started ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void nrf_drv_spi_uninit(nrf_drv_spi_t const *p_instance){
+  (void)p_instance;
+
+  pthread_mutex_lock(&m_emu.lock);
+  m_emu.initialized = false;
+  m_emu.pending = false;
+  ++m_emu.generation;
+  pthread_mutex_unlock(&m_emu.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ret_code_t nrf_drv_spi_transfer(
+    nrf_drv_spi_t const *p_instance,
+    uint8_t const *p_tx_buffer,
+    uint8_t tx_buffer_length,
+    uint8_t *p_rx_buffer,
+    uint8_t rx_buffer_length)
+{
+  (void)p_instance;
+
+  pthread_mutex_lock(&m_emu.lock);
+  if(!m_emu.initialized || m_emu.pending){
+    pthread_mutex_unlock(&m_emu.lock);
+    return NRF_ERROR_BUSY;
+  }
+
+  __auto_type _len = tx_buffer_length > rx_buffer_length ? tx_buffer_length : rx_buffer_length;
+  for(int i = 0; i < _len; ++i){
+    __auto_type _mosi = i < tx_buffer_length ? p_tx_buffer[i] : m_emu.orc;
+    __auto_type _miso = m_emu.selected && m_emu.memory != NULL ? m_clock(_mosi) : 0xFF;
+    if(i < rx_buffer_length)
+      p_rx_buffer[i] = _miso;
+  }
+
+  if(m_emu.lose_next){
+    m_emu.lose_next = false;
+    ++m_emu.stats.lost_irqs;
+  }
+  else{
+    m_emu.pending = true;
+    m_emu.pending_generation = m_emu.generation;
+    pthread_cond_broadcast(&m_emu.cond);
+  }
+  pthread_mutex_unlock(&m_emu.lock);
+
+  return NRF_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool flash_emu_open(const char *path, uint8_t capacity){
+  __auto_type _size = 1UL << capacity;
+  struct stat _stat;
+
+  if(_size / EMU_SECTOR_SIZE > EMU_MAX_SECTORS)
+    return false;
+
+  __auto_type _fd = open(path, O_RDWR | O_CREAT, 0644);
+  if(_fd < 0 || fstat(_fd, &_stat) != 0)
+    return false;
+
+  __auto_type _fresh = _stat.st_size != _size;
+  if(_fresh && ftruncate(_fd, _size) != 0){
+    close(_fd);
+    return false;
+  }
+
+  uint8_t *_memory = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if(_memory == MAP_FAILED){
+    close(_fd);
+    return false;
+  }
+  if(_fresh)
+    memset(_memory, 0xFF, _size);
+
+  pthread_mutex_lock(&m_emu.lock);
+  m_emu.fd = _fd;
+  m_emu.memory = _memory;
+  m_emu.size = _size;
+  m_emu.capacity = capacity;
+  m_emu.selected = false;
+  m_emu.index = 0;
+  m_emu.wel = false;
+  m_emu.power_down = false;
+  m_emu.stalled = false;
+  m_emu.stuck = false;
+  m_emu.busy_until = xTaskGetTickCount();
+  memset(&m_emu.stats, 0, sizeof(m_emu.stats));
+  memset(m_emu.erases, 0, sizeof(m_emu.erases));
+  pthread_mutex_unlock(&m_emu.lock);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void flash_emu_close(void){
+  pthread_mutex_lock(&m_emu.lock);
+  if(m_emu.memory != NULL){
+    munmap(m_emu.memory, m_emu.size);
+    close(m_emu.fd);
+  }
+  m_emu.memory = NULL;
+  m_emu.fd = -1;
+  pthread_mutex_unlock(&m_emu.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint8_t *flash_emu_memory(void){
+  return m_emu.memory;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t flash_emu_size(void){
+  return m_emu.size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void flash_emu_timing(TickType_t program, TickType_t sector_erase, TickType_t block_erase){
+  pthread_mutex_lock(&m_emu.lock);
+  m_emu.program_ticks = program;
+  m_emu.sector_ticks = sector_erase;
+  m_emu.block_ticks = block_erase;
+  pthread_mutex_unlock(&m_emu.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void flash_emu_stall(bool stalled){
+  pthread_mutex_lock(&m_emu.lock);
+  m_emu.stalled = stalled;
+  if(!stalled)
+    m_emu.stuck = false;
+  pthread_mutex_unlock(&m_emu.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void flash_emu_lose_irq(void){
+  pthread_mutex_lock(&m_emu.lock);
+  m_emu.lose_next = true;
+  pthread_mutex_unlock(&m_emu.lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool flash_emu_journal(const char *path){
+  pthread_mutex_lock(&m_emu.lock);
+  if(m_emu.journal >= 0)
+    close(m_emu.journal);
+  m_emu.journal = path != NULL ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+  __auto_type _ret_val = path == NULL || m_emu.journal >= 0;
+  pthread_mutex_unlock(&m_emu.lock);
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool flash_emu_replay(const char *path, uint32_t step, uint32_t *address){
+  emu_step_s _step;
+  uint32_t _done = 0;
+
+  __auto_type _fd = open(path, O_RDONLY);
+  if(_fd < 0)
+    return false;
+
+  pthread_mutex_lock(&m_emu.lock);
+  while(m_emu.memory != NULL && _done < step
+      && read(_fd, &_step, sizeof(_step)) == sizeof(_step))
+  {
+    ++_done;
+    m_apply(&_step, _done == step);
+    if(_done == step && address != NULL)
+      *address = _step.address % m_emu.size;
+  }
+  pthread_mutex_unlock(&m_emu.lock);
+
+  close(_fd);
+  return _done == step;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t flash_emu_sector_erases(uint32_t address){
+  return m_emu.erases[(address % m_emu.size) / EMU_SECTOR_SIZE];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+flash_emu_stats_s flash_emu_get_stats(void){
+  pthread_mutex_lock(&m_emu.lock);
+  __auto_type _stats = m_emu.stats;
+  pthread_mutex_unlock(&m_emu.lock);
+  return _stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void flash_emu_reset_stats(void){
+  pthread_mutex_lock(&m_emu.lock);
+  memset(&m_emu.stats, 0, sizeof(m_emu.stats));
+  pthread_mutex_unlock(&m_emu.lock);
+}
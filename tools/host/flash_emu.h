@@ -0,0 +1,101 @@
+/**
+ * @file    flash_emu.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   File backed JEDEC SPI NOR flash behind nrf_drv_spi shim
+ *
+ * Chip decodes byte stream of SPI transfers framed by its CS pin (IC_SPI_FLASH_SS_PIN) like real
+ * part: WREN, RDSR, RDID, FAST_READ, PP, SE, BE, DP and RES. Program only clears bits and wraps at
+ * the end of page, program and erase need write enable and are executed when CS goes high, then
+ * chip is busy for configured number of ticks. Commands other than status read sent while chip is
+ * busy (or in deep power-down) are ignored and counted as violations, so driver bugs show up in
+ * statistics and not only as wrong data.
+ *
+ * Memory is a shared mapping of a file, its content survives reopening and end of process. Programs
+ * and erases can be journaled, replay of journal rebuilds image of power cut during any of them.
+ */
+
+#ifndef FLASH_EMU_H
+#define FLASH_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+#define FLASH_EMU_MANUFACTURER  0xEF
+#define FLASH_EMU_TYPE          0x40
+
+typedef struct{
+  uint32_t frames;                    /** CS low to CS high */
+  uint32_t reads;
+  uint32_t read_bytes;
+  uint32_t programs;
+  uint32_t program_bytes;
+  uint32_t sector_erases;
+  uint32_t block_erases;
+  uint32_t status_polls;
+  uint32_t busy_polls;                /** Status reads which returned WIP */
+  uint32_t busy_violations;           /** Commands ignored because chip was busy or powered down */
+  uint32_t wel_violations;            /** Program or erase ignored, no write enable */
+  uint32_t page_wraps;                /** Page program wrapped to the start of page */
+  uint32_t dirty_programs;            /** Program which needed to set bits, data got corrupted */
+  uint32_t lost_irqs;
+}flash_emu_stats_s;
+
+/**
+ * @brief Map file as flash of 2^capacity bytes (up to 16MB). New file (or of other size) is erased.
+ */
+bool flash_emu_open(const char *path, uint8_t capacity);
+
+void flash_emu_close(void);
+
+/**
+ * @brief Flash content, can be read and modified by harness while driver is idle.
+ */
+uint8_t *flash_emu_memory(void);
+
+uint32_t flash_emu_size(void);
+
+/**
+ * @brief Ticks chip stays busy after program, sector erase and block erase.
+ */
+void flash_emu_timing(TickType_t program, TickType_t sector_erase, TickType_t block_erase);
+
+/**
+ * @brief Program or erase started while stalled keeps chip busy (WIP set) until called with false.
+ */
+void flash_emu_stall(bool stalled);
+
+/**
+ * @brief Transfer started next is clocked, but its completion IRQ never comes.
+ */
+void flash_emu_lose_irq(void);
+
+/**
+ * @brief Append every program and erase to journal file from now on. NULL stops journaling.
+ */
+bool flash_emu_journal(const char *path);
+
+/**
+ * @brief Rebuild image of power cut during given program or erase of journal (1 is the first one).
+ *
+ * Earlier steps are applied to opened image, the given one only partially: program writes the first
+ * half of its bytes, erase clears the first half of its area.
+ *
+ * @param address   Address of the given step, can be NULL.
+ *
+ * @return false when journal is shorter.
+ */
+bool flash_emu_replay(const char *path, uint32_t step, uint32_t *address);
+
+/**
+ * @brief Erase cycles of sector holding address since flash was opened.
+ */
+uint32_t flash_emu_sector_erases(uint32_t address);
+
+flash_emu_stats_s flash_emu_get_stats(void);
+
+void flash_emu_reset_stats(void);
+
+#endif /* !FLASH_EMU_H */
@@ -0,0 +1,350 @@
+/**
+ * @file    flash_test.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Flash, SPI and sync drivers against file backed chip emulator, see flash_emu.h
+ *
+ * Checks:
+ *  - init     - JEDEC ID and size are probed, image survives reopening,
+ *  - program  - program stays in its page, page crossing is refused, program only clears bits,
+ *  - read     - long and unaligned reads go through many fast-read chains,
+ *  - erase    - sector and block erase clear exactly their area, misaligned erase is refused,
+ *  - busy     - driver polls status until chip is done and sends nothing else meanwhile, second
+ *               operation gets IC_BUSY, stray task notification does not end blocking operation,
+ *  - stuck    - chip which never gets ready ends operation with IC_TIMEOUT, driver recovers,
+ *  - lost irq - waiter aborts operation whose SPI IRQ never came (IC_TIMEOUT), buffer is not
+ *               touched afterwards and next operation works.
+ *
+ * Ticks run IC_FLASH_TEST_SPEED times faster than clock, so timeouts take a fraction of second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ic_driver_flash.h"
+#include "ic_config.h"
+
+#include "host_port.h"
+#include "flash_emu.h"
+
+#define FLASH_TEST_IMAGE      "flash_test.img"
+#define FLASH_TEST_CAPACITY   20          /** 1MB */
+#define FLASH_TEST_SPEED      16
+#define FLASH_TEST_READ_LEN   3000        /** More than one fast-read chain */
+
+static int m_failed;
+
+static void m_check(const char *what, uint32_t value, uint32_t expected){
+  if(value == expected)
+    return;
+  printf("  %-40s %8u != %u  FAIL\n", what, value, expected);
+  ++m_failed;
+}
+
+static void m_check_min(const char *what, uint32_t value, uint32_t min){
+  if(value >= min)
+    return;
+  printf("  %-40s %8u < %u  FAIL\n", what, value, min);
+  ++m_failed;
+}
+
+static bool m_all(const uint8_t *data, size_t len, uint8_t value){
+  for(size_t i = 0; i < len; ++i)
+    if(data[i] != value)
+      return false;
+  return true;
+}
+
+static void m_no_violations(void){
+  __auto_type _stats = flash_emu_get_stats();
+  m_check("busy violations", _stats.busy_violations, 0);
+  m_check("write enable violations", _stats.wel_violations, 0);
+  m_check("page wraps", _stats.page_wraps, 0);
+}
+
+static void m_init(void){
+  m_check("init", ic_flash_init(), IC_SUCCESS);
+
+  __auto_type _id = ic_flash_get_id();
+  m_check("manufacturer", _id.manufacturer, FLASH_EMU_MANUFACTURER);
+  m_check("type", _id.type, FLASH_EMU_TYPE);
+  m_check("capacity", _id.capacity, FLASH_TEST_CAPACITY);
+  m_check("size", ic_flash_size(), flash_emu_size());
+
+  /* Image is a file, content is there after reopening */
+  m_check("erase", ic_flash_erase(0, IC_FLASH_ERASE_SECTOR, NULL, NULL), IC_SUCCESS);
+  m_check("program", ic_flash_program(0, (const uint8_t *)"NEUROON", 7, NULL, NULL), IC_SUCCESS);
+  flash_emu_close();
+  m_check("reopen", flash_emu_open(FLASH_TEST_IMAGE, FLASH_TEST_CAPACITY), true);
+  m_check("image kept", memcmp(flash_emu_memory(), "NEUROON", 7), 0);
+
+  m_no_violations();
+}
+
+static void m_program(void){
+  uint8_t _data[IC_FLASH_PAGE_SIZE];
+  uint8_t _read[IC_FLASH_PAGE_SIZE];
+  __auto_type _memory = flash_emu_memory();
+
+  for(int i = 0; i < sizeof(_data); ++i)
+    _data[i] = (uint8_t)(i*7 + 3);
+
+  m_check("erase", ic_flash_erase(0x1000, IC_FLASH_ERASE_SECTOR, NULL, NULL), IC_SUCCESS);
+  flash_emu_reset_stats();
+
+  m_check("full page", ic_flash_program(0x1100, _data, sizeof(_data), NULL, NULL), IC_SUCCESS);
+  m_check("full page content", memcmp(&_memory[0x1100], _data, sizeof(_data)), 0);
+  m_check("page before untouched", m_all(&_memory[0x1000], 0x100, 0xFF), true);
+  m_check("page after untouched", m_all(&_memory[0x1200], 0x100, 0xFF), true);
+
+  m_check("end of page", ic_flash_program(0x12F0, _data, 16, NULL, NULL), IC_SUCCESS);
+  m_check("end of page content", memcmp(&_memory[0x12F0], _data, 16), 0);
+  m_check("start of page untouched", m_all(&_memory[0x1200], 0xF0, 0xFF), true);
+
+  __auto_type _programs = flash_emu_get_stats().programs;
+  m_check("crossing page", ic_flash_program(0x13F0, _data, 17, NULL, NULL), IC_ERROR);
+  m_check("longer than page", ic_flash_program(0x1400, _data, 257, NULL, NULL), IC_ERROR);
+  m_check("past the end", ic_flash_program(flash_emu_size() - 1, _data, 2, NULL, NULL), IC_ERROR);
+  m_check("refused programs sent", flash_emu_get_stats().programs, _programs);
+
+  /* Program clears bits only */
+  _read[0] = 0x0F;
+  m_check("low nibble", ic_flash_program(0x1500, _read, 1, NULL, NULL), IC_SUCCESS);
+  _read[0] = 0xF3;
+  m_check("high nibble", ic_flash_program(0x1500, _read, 1, NULL, NULL), IC_SUCCESS);
+  m_check("bits and", _memory[0x1500], 0x03);
+
+  m_check("read back", ic_flash_read(0x1100, _read, sizeof(_read), NULL, NULL), IC_SUCCESS);
+  m_check("read back content", memcmp(_read, _data, sizeof(_data)), 0);
+
+  m_no_violations();
+}
+
+static void m_read(void){
+  static uint8_t _read[FLASH_TEST_READ_LEN + 2];
+  __auto_type _memory = flash_emu_memory();
+  __auto_type _address = 0x20000 + 13;
+
+  for(int i = 0; i < FLASH_TEST_READ_LEN; ++i)
+    _memory[_address + i] = (uint8_t)(rand() >> 4);
+
+  flash_emu_reset_stats();
+  memset(_read, 0xA5, sizeof(_read));
+  m_check("long read", ic_flash_read(_address, _read + 1, FLASH_TEST_READ_LEN, NULL, NULL),
+      IC_SUCCESS);
+  m_check("long read content", memcmp(_read + 1, &_memory[_address], FLASH_TEST_READ_LEN), 0);
+  m_check("byte before buffer", _read[0], 0xA5);
+  m_check("byte after buffer", _read[FLASH_TEST_READ_LEN + 1], 0xA5);
+  m_check("fast-read frames",
+      flash_emu_get_stats().reads,
+      (FLASH_TEST_READ_LEN + IC_FLASH_READ_CHUNKS*255 - 1) / (IC_FLASH_READ_CHUNKS*255));
+
+  m_check("single byte", ic_flash_read(_address + 7, _read, 1, NULL, NULL), IC_SUCCESS);
+  m_check("single byte content", _read[0], _memory[_address + 7]);
+
+  __auto_type _end = flash_emu_size() - 16;
+  m_check("last bytes", ic_flash_read(_end, _read, 16, NULL, NULL), IC_SUCCESS);
+  m_check("last bytes content", memcmp(_read, &_memory[_end], 16), 0);
+  m_check("past the end", ic_flash_read(_end, _read, 17, NULL, NULL), IC_ERROR);
+  m_check("empty read", ic_flash_read(0, _read, 0, NULL, NULL), IC_ERROR);
+
+  m_no_violations();
+}
+
+static void m_erase(void){
+  __auto_type _memory = flash_emu_memory();
+
+  memset(&_memory[0x30000], 0, 3*IC_FLASH_BLOCK_SIZE);
+  flash_emu_reset_stats();
+
+  m_check("sector", ic_flash_erase(0x41000, IC_FLASH_ERASE_SECTOR, NULL, NULL), IC_SUCCESS);
+  m_check("sector erased", m_all(&_memory[0x41000], IC_FLASH_SECTOR_SIZE, 0xFF), true);
+  m_check("sector before kept", m_all(&_memory[0x40000], IC_FLASH_SECTOR_SIZE, 0x00), true);
+  m_check("sector after kept", m_all(&_memory[0x42000], IC_FLASH_SECTOR_SIZE, 0x00), true);
+
+  m_check("block", ic_flash_erase(0x30000, IC_FLASH_ERASE_BLOCK, NULL, NULL), IC_SUCCESS);
+  m_check("block erased", m_all(&_memory[0x30000], IC_FLASH_BLOCK_SIZE, 0xFF), true);
+  m_check("next block kept", _memory[0x40000] == 0x00 && _memory[0x4FFFF] == 0x00, true);
+
+  m_check("misaligned sector", ic_flash_erase(0x50100, IC_FLASH_ERASE_SECTOR, NULL, NULL), IC_ERROR);
+  m_check("misaligned block", ic_flash_erase(0x51000, IC_FLASH_ERASE_BLOCK, NULL, NULL), IC_ERROR);
+  m_check("past the end",
+      ic_flash_erase(flash_emu_size(), IC_FLASH_ERASE_SECTOR, NULL, NULL),
+      IC_ERROR);
+  m_check("third block kept", m_all(&_memory[0x50000], IC_FLASH_BLOCK_SIZE, 0x00), true);
+
+  __auto_type _stats = flash_emu_get_stats();
+  m_check("sector erases", _stats.sector_erases, 1);
+  m_check("block erases", _stats.block_erases, 1);
+
+  m_no_violations();
+}
+
+static struct{
+  uint32_t calls;
+  ic_return_val_e result;
+}m_callback;
+
+static void m_erase_done(ic_return_val_e result, void *context){
+  ++m_callback.calls;
+  m_callback.result = result;
+  *(TickType_t *)context = xTaskGetTickCount();
+}
+
+static TaskHandle_t m_notified;
+static bool volatile m_notifying;
+
+static void m_notifier_task(void *arg){
+  (void)arg;
+  while(m_notifying){
+    xTaskNotifyGive(m_notified);
+    vTaskDelay(2);
+  }
+}
+
+static void m_busy(void){
+  TickType_t _done = 0;
+  uint8_t _byte;
+
+  flash_emu_timing(4, 200, 400);
+  flash_emu_reset_stats();
+
+  __auto_type _start = xTaskGetTickCount();
+  m_check("async erase", ic_flash_erase(0x60000, IC_FLASH_ERASE_BLOCK, m_erase_done, &_done),
+      IC_SUCCESS);
+  m_check("driver busy", ic_flash_busy(), true);
+  m_check("read while busy", ic_flash_read(0, &_byte, 1, NULL, NULL), IC_BUSY);
+  m_check("erase while busy", ic_flash_erase(0, IC_FLASH_ERASE_SECTOR, NULL, NULL), IC_BUSY);
+
+  while(ic_flash_busy() && xTaskGetTickCount() - _start < 2*IC_FLASH_SYNC_TIMEOUT)
+    vTaskDelay(8);
+
+  m_check("callback calls", m_callback.calls, 1);
+  m_check("callback result", m_callback.result, IC_SUCCESS);
+  m_check_min("erase took", _done - _start, 400);
+
+  __auto_type _stats = flash_emu_get_stats();
+  m_check_min("busy status polls", _stats.busy_polls, 1);
+  m_check("last poll ready", _stats.status_polls - _stats.busy_polls, 1);
+  m_check_min("poll period", (_done - _start) / _stats.status_polls, IC_FLASH_ERASE_POLL/2);
+
+  /* Notifications of the task are not completion of blocking operation */
+  m_notified = xTaskGetCurrentTaskHandle();
+  m_notifying = true;
+  TaskHandle_t _notifier;
+  if(xTaskCreate(m_notifier_task, "NOTIFY", 128, NULL, 1, &_notifier) != pdPASS)
+    abort();
+
+  _start = xTaskGetTickCount();
+  m_check("sync erase", ic_flash_erase(0x70000, IC_FLASH_ERASE_BLOCK, NULL, NULL), IC_SUCCESS);
+  m_check_min("sync erase took", xTaskGetTickCount() - _start, 400);
+  m_check("erased when returned", m_all(&flash_emu_memory()[0x70000], 64, 0xFF), true);
+
+  _start = xTaskGetTickCount();
+  m_check("sync program", ic_flash_program(0x70000, &_byte, 1, NULL, NULL), IC_SUCCESS);
+  m_check_min("sync program took", xTaskGetTickCount() - _start, 4);
+
+  m_notifying = false;
+  host_join(_notifier);
+
+  flash_emu_timing(1, 48, 160);
+  m_no_violations();
+}
+
+static void m_stuck(void){
+  uint8_t _data[4] = {1, 2, 3, 4};
+
+  m_check("erase", ic_flash_erase(0x80000, IC_FLASH_ERASE_SECTOR, NULL, NULL), IC_SUCCESS);
+  flash_emu_reset_stats();
+  flash_emu_stall(true);
+
+  __auto_type _start = xTaskGetTickCount();
+  m_check("program of stuck chip", ic_flash_program(0x80000, _data, 4, NULL, NULL), IC_TIMEOUT);
+  __auto_type _took = xTaskGetTickCount() - _start;
+  m_check_min("timed out after", _took, IC_FLASH_SYNC_TIMEOUT);
+  m_check("driver gave up on its own", _took < IC_FLASH_SYNC_TIMEOUT + IC_SPI_SYNC_TIMEOUT, true);
+  m_check("driver idle", ic_flash_busy(), false);
+  m_check_min("status polls", flash_emu_get_stats().status_polls, 2);
+
+  flash_emu_stall(false);
+  vTaskDelay(2);
+  m_check("program after stall", ic_flash_program(0x80004, _data, 4, NULL, NULL), IC_SUCCESS);
+  m_check("content after stall", memcmp(&flash_emu_memory()[0x80000], _data, 4), 0);
+
+  m_no_violations();
+}
+
+static void m_lost_irq(void){
+  static uint8_t _buffer[600];
+  __auto_type _memory = flash_emu_memory();
+
+  for(int i = 0; i < sizeof(_buffer); ++i)
+    _memory[0x90000 + i] = (uint8_t)(i ^ 0x5C);
+
+  flash_emu_reset_stats();
+  memset(_buffer, 0xA5, sizeof(_buffer));
+  flash_emu_lose_irq();
+
+  __auto_type _start = xTaskGetTickCount();
+  m_check("read without irq", ic_flash_read(0x90000, _buffer, sizeof(_buffer), NULL, NULL),
+      IC_TIMEOUT);
+  m_check_min("aborted after", xTaskGetTickCount() - _start, IC_FLASH_SYNC_TIMEOUT);
+  m_check("lost irqs", flash_emu_get_stats().lost_irqs, 1);
+  m_check("driver idle", ic_flash_busy(), false);
+  m_check("buffer untouched", m_all(_buffer, sizeof(_buffer), 0xA5), true);
+
+  /* Nothing continues aborted chain later */
+  vTaskDelay(64);
+  m_check("buffer untouched later", m_all(_buffer, sizeof(_buffer), 0xA5), true);
+
+  m_check("read after abort", ic_flash_read(0x90000, _buffer, sizeof(_buffer), NULL, NULL),
+      IC_SUCCESS);
+  m_check("content after abort", memcmp(_buffer, &_memory[0x90000], sizeof(_buffer)), 0);
+
+  m_no_violations();
+}
+
+int main(void){
+  static const struct{
+    const char *name;
+    void (*run)(void);
+  }_cases[] = {
+    {"init",      m_init},
+    {"program",   m_program},
+    {"read",      m_read},
+    {"erase",     m_erase},
+    {"busy",      m_busy},
+    {"stuck",     m_stuck},
+    {"lost irq",  m_lost_irq},
+  };
+
+  host_port_init();
+  host_tick_speed(FLASH_TEST_SPEED);
+  host_timer_daemon_start();
+
+  unlink(FLASH_TEST_IMAGE);
+  if(!flash_emu_open(FLASH_TEST_IMAGE, FLASH_TEST_CAPACITY)){
+    printf("can not open %s\nFAIL\n", FLASH_TEST_IMAGE);
+    return 1;
+  }
+
+  for(int i = 0; i < sizeof(_cases)/sizeof(_cases[0]); ++i){
+    __auto_type _failed = m_failed;
+    _cases[i].run();
+    printf("%-12s %s\n", _cases[i].name, _failed == m_failed ? "ok" : "FAIL");
+    if(i == 0 && _failed != m_failed)
+      break;                          /* No chip, nothing else can pass */
+  }
+
+  m_check("deinit", ic_flash_deinit(), IC_SUCCESS);
+  flash_emu_close();
+  unlink(FLASH_TEST_IMAGE);
+
+  printf(m_failed == 0 ? "PASS\n" : "FAIL\n");
+  return m_failed == 0 ? 0 : 1;
+}
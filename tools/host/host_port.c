@@ -0,0 +1,552 @@
+/**
+ * @file    host_port.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   FreeRTOS subset on top of pthreads, lets firmware modules run on host
+ *
+ * Every task is a thread and they really run in parallel, critical region is one recursive lock
+ * shared by all of them. Ticks follow monotonic clock at configTICK_RATE_HZ (optionally sped up,
+ * @ref host_tick_speed), unless harness sets them (@ref host_tick_set). Timers fire only when
+ * harness calls @ref host_timer_fire or started @ref host_timer_daemon_start, callback runs as
+ * timer daemon task. Interrupt handlers are run by threads between @ref host_irq_enter and
+ * @ref host_irq_exit, they hold critical region like on target. Task returning from blocking call
+ * waits for handler which is running, so it does not race with the end of handler which woke it.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "semphr.h"
+#include "app_util_platform.h"
+#include "core_cm0.h"
+
+#include "host_port.h"
+
+struct host_task_s{
+  pthread_t thread;
+  TaskFunction_t code;
+  void *params;
+  const char *name;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t notifications;
+  bool suspended;
+  uint32_t volatile delays;
+};
+
+struct host_timer_s{
+  const char *name;
+  TickType_t period;
+  TickType_t expiry;                  /** Tick of next firing by daemon */
+  bool reload;
+  bool active;
+  void *id;
+  TimerCallbackFunction_t callback;
+  struct host_timer_s *next;
+};
+
+struct host_semaphore_s{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool given;
+};
+
+static SCB_Type m_scb;
+static SCB_Type m_irq_scb = {.ICSR = 1};
+__thread SCB_Type *SCB = &m_scb;     /** Thread running handler sees active vector */
+
+static pthread_mutex_t m_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static struct timespec m_start;
+static bool m_manual_tick;            /** Tick is set by harness, not by clock */
+static uint32_t m_speed = 1;          /** Ticks run that many times faster than clock */
+static TickType_t volatile m_tick;
+static __thread struct host_task_s *m_current;
+static struct host_task_s m_daemon = {
+  .name   = "Tmr Svc",
+  .lock   = PTHREAD_MUTEX_INITIALIZER,
+  .cond   = PTHREAD_COND_INITIALIZER
+};
+static struct host_timer_s *m_timers;  /** All created timers, scanned by daemon */
+
+static struct host_task_s *m_task_new(const char *name){
+  struct host_task_s *_task = calloc(1, sizeof(*_task));
+  if(_task == NULL)
+    abort();
+
+  _task->name = name;
+  pthread_mutex_init(&_task->lock, NULL);
+  pthread_cond_init(&_task->cond, NULL);
+  return _task;
+}
+
+/**
+ * @brief Task woken by interrupt handler runs after handler returns, like context switch pended by
+ * handler on target.
+ */
+static void m_irq_barrier(void){
+  host_critical_enter();
+  host_critical_exit();
+}
+
+static void *m_task_entry(void *arg){
+  m_current = arg;
+  m_current->code(m_current->params);
+  return NULL;
+}
+
+static struct timespec m_deadline(TickType_t ticks){
+  struct timespec _ts;
+  clock_gettime(CLOCK_MONOTONIC, &_ts);
+
+  uint64_t _ns = (uint64_t)ticks * 1000000000ULL / configTICK_RATE_HZ / m_speed + _ts.tv_nsec;
+  _ts.tv_sec += _ns / 1000000000ULL;
+  _ts.tv_nsec = _ns % 1000000000ULL;
+  return _ts;
+}
+
+/**
+ * @return false on timeout.
+ */
+static bool m_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline){
+  if(deadline == NULL)
+    return pthread_cond_wait(cond, lock) == 0;
+  return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_port_init(void){
+  clock_gettime(CLOCK_MONOTONIC, &m_start);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_join(TaskHandle_t task){
+  pthread_join(task->thread, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_tick_set(TickType_t tick){
+  m_tick = tick;
+  m_manual_tick = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_tick_speed(uint32_t factor){
+  m_speed = factor;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TaskHandle_t host_task_new(const char *name){
+  return m_task_new(name);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TaskHandle_t host_task_enter(TaskHandle_t task){
+  __auto_type _previous = xTaskGetCurrentTaskHandle();
+  m_current = task;
+  return _previous;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t host_task_delays(TaskHandle_t task){
+  return task->delays;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_critical_enter(void){
+  pthread_mutex_lock(&m_critical);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_critical_exit(void){
+  pthread_mutex_unlock(&m_critical);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_irq_enter(void){
+  host_critical_enter();
+  SCB = &m_irq_scb;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_irq_exit(void){
+  SCB = &m_scb;
+  host_critical_exit();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+__attribute__((weak)) void host_gpio_write(uint32_t pin, bool value){
+  (void)pin;
+  (void)value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTaskCreate(
+    TaskFunction_t code,
+    const char *name,
+    uint16_t stack,
+    void *params,
+    UBaseType_t priority,
+    TaskHandle_t *handle)
+{
+  (void)stack;
+  (void)priority;
+
+  __auto_type _task = m_task_new(name);
+  _task->code = code;
+  _task->params = params;
+  if(handle != NULL)
+    *handle = _task;
+
+  if(pthread_create(&_task->thread, NULL, m_task_entry, _task) != 0)
+    return pdFAIL;
+  return pdPASS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void vTaskDelete(TaskHandle_t task){
+  if(task == NULL || task == m_current)
+    pthread_exit(NULL);
+  pthread_cancel(task->thread);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void vTaskDelay(TickType_t ticks){
+  __auto_type _task = xTaskGetCurrentTaskHandle();
+  ++_task->delays;
+
+  __auto_type _deadline = m_deadline(ticks);
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &_deadline, NULL) == EINTR);
+  m_irq_barrier();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void vTaskDelayUntil(TickType_t *previous, TickType_t increment){
+  *previous += increment;
+
+  __auto_type _now = xTaskGetTickCount();
+  if((int32_t)(*previous - _now) > 0)
+    vTaskDelay(*previous - _now);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void vTaskSuspend(TaskHandle_t task){
+  if(task == NULL)
+    task = xTaskGetCurrentTaskHandle();
+
+  pthread_mutex_lock(&task->lock);
+  task->suspended = true;
+  if(task == m_current){
+    while(task->suspended)
+      m_wait(&task->cond, &task->lock, NULL);
+  }
+  pthread_mutex_unlock(&task->lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void vTaskResume(TaskHandle_t task){
+  pthread_mutex_lock(&task->lock);
+  task->suspended = false;
+  pthread_cond_broadcast(&task->cond);
+  pthread_mutex_unlock(&task->lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTaskResumeFromISR(TaskHandle_t task){
+  vTaskResume(task);
+  return pdFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TickType_t xTaskGetTickCount(void){
+  if(m_manual_tick)
+    return m_tick;
+
+  struct timespec _ts;
+  clock_gettime(CLOCK_MONOTONIC, &_ts);
+
+  int64_t _ns = (int64_t)(_ts.tv_sec - m_start.tv_sec) * 1000000000LL
+    + (_ts.tv_nsec - m_start.tv_nsec);
+  return (TickType_t)(_ns * configTICK_RATE_HZ * m_speed / 1000000000LL);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TickType_t xTaskGetTickCountFromISR(void){
+  return xTaskGetTickCount();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TaskHandle_t xTaskGetCurrentTaskHandle(void){
+  /* Threads not created by xTaskCreate (main) get handle on first use */
+  if(m_current == NULL)
+    m_current = m_task_new("main");
+  return m_current;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTaskGetSchedulerState(void){
+  return taskSCHEDULER_RUNNING;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout){
+  __auto_type _task = xTaskGetCurrentTaskHandle();
+  __auto_type _deadline = m_deadline(timeout);
+
+  pthread_mutex_lock(&_task->lock);
+  while(_task->notifications == 0 && timeout != 0){
+    if(!m_wait(&_task->cond, &_task->lock, timeout == portMAX_DELAY ? NULL : &_deadline))
+      break;
+  }
+
+  __auto_type _value = _task->notifications;
+  if(_value != 0)
+    _task->notifications = clear ? 0 : _value - 1;
+  pthread_mutex_unlock(&_task->lock);
+
+  m_irq_barrier();
+  return _value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTaskNotifyGive(TaskHandle_t task){
+  pthread_mutex_lock(&task->lock);
+  ++task->notifications;
+  pthread_cond_broadcast(&task->cond);
+  pthread_mutex_unlock(&task->lock);
+  return pdPASS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *yield){
+  (void)xTaskNotifyGive(task);
+  if(yield != NULL)
+    *yield = pdFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_yield(void){
+  sched_yield();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TimerHandle_t xTimerCreate(
+    const char *name,
+    TickType_t period,
+    UBaseType_t reload,
+    void *id,
+    TimerCallbackFunction_t callback)
+{
+  struct host_timer_s *_timer = calloc(1, sizeof(*_timer));
+  if(_timer == NULL)
+    return NULL;
+
+  *_timer = (struct host_timer_s){
+    .name     = name,
+    .period   = period,
+    .reload   = reload,
+    .id       = id,
+    .callback = callback
+  };
+
+  CRITICAL_REGION_ENTER();
+  _timer->next = m_timers;
+  m_timers = _timer;
+  CRITICAL_REGION_EXIT();
+  return _timer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t block){
+  (void)block;
+
+  CRITICAL_REGION_ENTER();
+  timer->active = true;
+  timer->expiry = xTaskGetTickCount() + timer->period;
+  CRITICAL_REGION_EXIT();
+  return pdPASS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t block){
+  (void)block;
+
+  CRITICAL_REGION_ENTER();
+  timer->active = false;
+  CRITICAL_REGION_EXIT();
+  return pdPASS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t block){
+  return xTimerStart(timer, block);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t block){
+  CRITICAL_REGION_ENTER();
+  timer->period = period;
+  CRITICAL_REGION_EXIT();
+  return xTimerStart(timer, block);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerStartFromISR(TimerHandle_t timer, BaseType_t *yield){
+  if(yield != NULL)
+    *yield = pdFALSE;
+  return xTimerStart(timer, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerStopFromISR(TimerHandle_t timer, BaseType_t *yield){
+  if(yield != NULL)
+    *yield = pdFALSE;
+  return xTimerStop(timer, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerChangePeriodFromISR(TimerHandle_t timer, TickType_t period, BaseType_t *yield){
+  if(yield != NULL)
+    *yield = pdFALSE;
+  return xTimerChangePeriod(timer, period, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer){
+  return timer->active;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void *pvTimerGetTimerID(TimerHandle_t timer){
+  return timer->id;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TaskHandle_t xTimerGetTimerDaemonTaskHandle(void){
+  return &m_daemon;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xTimerPendFunctionCall(
+    PendedFunction_t function,
+    void *arg1,
+    uint32_t arg2,
+    TickType_t block)
+{
+  (void)block;
+
+  __auto_type _caller = m_current;
+  m_current = &m_daemon;
+  function(arg1, arg2);
+  m_current = _caller;
+  return pdPASS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_timer_fire(TimerHandle_t timer){
+  CRITICAL_REGION_ENTER();
+  __auto_type _active = timer->active;
+  if(!timer->reload)
+    timer->active = false;
+  timer->expiry += timer->period;
+  CRITICAL_REGION_EXIT();
+
+  if(!_active)
+    return;
+
+  __auto_type _caller = m_current;
+  m_current = &m_daemon;
+  timer->callback(timer);
+  m_current = _caller;
+}
+
+/**
+ * @brief Timer daemon, fires due timers every tick. Callback can restart its own timer.
+ */
+static void *m_daemon_entry(void *arg){
+  (void)arg;
+  m_current = &m_daemon;
+
+  for(;;){
+    __auto_type _now = xTaskGetTickCount();
+    struct host_timer_s *_due = NULL;
+
+    CRITICAL_REGION_ENTER();
+    for(__auto_type _timer = m_timers; _timer != NULL && _due == NULL; _timer = _timer->next)
+      if(_timer->active && (int32_t)(_now - _timer->expiry) >= 0)
+        _due = _timer;
+    CRITICAL_REGION_EXIT();
+
+    if(_due != NULL)
+      host_timer_fire(_due);
+    else
+      vTaskDelay(1);
+  }
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void host_timer_daemon_start(void){
+  if(pthread_create(&m_daemon.thread, NULL, m_daemon_entry, NULL) != 0)
+    abort();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SemaphoreHandle_t xSemaphoreCreateBinary(void){
+  struct host_semaphore_s *_semaphore = calloc(1, sizeof(*_semaphore));
+  if(_semaphore == NULL)
+    return NULL;
+
+  pthread_mutex_init(&_semaphore->lock, NULL);
+  pthread_cond_init(&_semaphore->cond, NULL);
+  return _semaphore;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout){
+  __auto_type _deadline = m_deadline(timeout);
+
+  pthread_mutex_lock(&semaphore->lock);
+  while(!semaphore->given && timeout != 0){
+    if(!m_wait(&semaphore->cond, &semaphore->lock, timeout == portMAX_DELAY ? NULL : &_deadline))
+      break;
+  }
+
+  __auto_type _taken = semaphore->given;
+  semaphore->given = false;
+  pthread_mutex_unlock(&semaphore->lock);
+
+  if(timeout != 0)
+    m_irq_barrier();
+  return _taken ? pdTRUE : pdFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore){
+  pthread_mutex_lock(&semaphore->lock);
+  __auto_type _given = !semaphore->given;
+  semaphore->given = true;
+  pthread_cond_broadcast(&semaphore->cond);
+  pthread_mutex_unlock(&semaphore->lock);
+
+  return _given ? pdTRUE : pdFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t semaphore, BaseType_t *yield){
+  if(yield != NULL)
+    *yield = pdFALSE;
+  return xSemaphoreTake(semaphore, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *yield){
+  if(yield != NULL)
+    *yield = pdFALSE;
+  return xSemaphoreGive(semaphore);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file    host_port.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Harness side of host FreeRTOS port
+ */
+
+#ifndef HOST_PORT_H
+#define HOST_PORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * @brief Start tick counter, call before any task is created.
+ */
+void host_port_init(void);
+
+/**
+ * @brief Wait until task function returns.
+ */
+void host_join(TaskHandle_t task);
+
+/**
+ * @brief Stop following clock, tick count is the given one until next call.
+ */
+void host_tick_set(TickType_t tick);
+
+/**
+ * @brief Make ticks (and all timeouts) run factor times faster than clock.
+ */
+void host_tick_speed(uint32_t factor);
+
+/**
+ * @brief Fire timers from daemon thread when their period elapses, instead of by harness.
+ */
+void host_timer_daemon_start(void);
+
+/**
+ * @brief Run code as interrupt handler: critical region is held and isr_context() is true.
+ */
+void host_irq_enter(void);
+
+void host_irq_exit(void);
+
+/**
+ * @brief Called by nrf_gpio_pin_set/clear shims. Weak no-op, device emulators override it.
+ */
+void host_gpio_write(uint32_t pin, bool value);
+
+/**
+ * @brief Task handle without thread, code under test can be run on its behalf by
+ * @ref host_task_enter.
+ */
+TaskHandle_t host_task_new(const char *name);
+
+/**
+ * @brief Calling thread acts as task from now on.
+ *
+ * @return Task thread was acting as.
+ */
+TaskHandle_t host_task_enter(TaskHandle_t task);
+
+/**
+ * @return Number of vTaskDelay calls made by task.
+ */
+uint32_t host_task_delays(TaskHandle_t task);
+
+#endif /* !HOST_PORT_H */
@@ -0,0 +1,40 @@
+/**
+ * @file    app_error.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SDK error handling, errors abort the harness
+ */
+
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS               0
+#define NRF_ERROR_NO_MEM          4
+#define NRF_ERROR_BUSY            17
+
+#define APP_ERROR_HANDLER(err)                                                                    \
+  do{                                                                                             \
+    fprintf(stderr, "%s:%d: error %u\n", __FILE__, __LINE__, (unsigned)(err));                    \
+    abort();                                                                                      \
+  }while(0)
+
+#define APP_ERROR_CHECK(err)                                                                      \
+  do{                                                                                             \
+    uint32_t _err = (err);                                                                        \
+    if(_err != NRF_SUCCESS)                                                                       \
+      APP_ERROR_HANDLER(_err);                                                                    \
+  }while(0)
+
+#define ASSERT(expr)                                                                              \
+  do{                                                                                             \
+    if(!(expr))                                                                                   \
+      APP_ERROR_HANDLER(0);                                                                       \
+  }while(0)
+
+#endif /* !APP_ERROR_H__ */
@@ -0,0 +1,37 @@
+/**
+ * @file    app_util_platform.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SDK platform utilities, critical region is one recursive lock
+ */
+
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+#include <stdint.h>
+
+#include "app_error.h"
+
+#define APP_IRQ_PRIORITY_HIGHEST  0
+#define APP_IRQ_PRIORITY_HIGH     1
+#define APP_IRQ_PRIORITY_MID      2
+#define APP_IRQ_PRIORITY_LOW      3
+#define APP_IRQ_PRIORITY_LOWEST   3
+
+#define UNUSED_PARAMETER(x)       (void)(x)
+#define UNUSED_VARIABLE(x)        (void)(x)
+
+#ifndef MIN
+#define MIN(a, b)                 ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)                 ((a) > (b) ? (a) : (b))
+#endif
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#define CRITICAL_REGION_ENTER()   host_critical_enter()
+#define CRITICAL_REGION_EXIT()    host_critical_exit()
+
+#endif /* !APP_UTIL_PLATFORM_H__ */
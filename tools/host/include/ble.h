@@ -0,0 +1,24 @@
+/**
+ * @file    ble.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SoftDevice BLE event
+ */
+
+#ifndef BLE_H__
+#define BLE_H__
+
+#include <stdint.h>
+
+#define BLE_EVT_TX_COMPLETE       0x01
+#define BLE_GAP_EVT_CONNECTED     0x10
+#define BLE_GAP_EVT_DISCONNECTED  0x11
+
+typedef struct{
+  struct{
+    uint16_t evt_id;
+    uint16_t evt_len;
+  }header;
+}ble_evt_t;
+
+#endif /* !BLE_H__ */
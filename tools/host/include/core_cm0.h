@@ -0,0 +1,22 @@
+/**
+ * @file    core_cm0.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of Cortex-M0 core registers. Harness runs everything in thread mode.
+ */
+
+#ifndef CORE_CM0_H
+#define CORE_CM0_H
+
+#include <stdint.h>
+
+typedef struct{
+  volatile uint32_t ICSR;
+}SCB_Type;
+
+/** Per thread, so only thread running interrupt handler sees active vector */
+extern __thread SCB_Type *SCB;
+
+#define SCB_ICSR_VECTACTIVE_Msk   0x1FFUL
+
+#endif /* !CORE_CM0_H */
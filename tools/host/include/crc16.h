@@ -0,0 +1,28 @@
+/**
+ * @file    crc16.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SDK CRC16 (CCITT, 0xFFFF start), same algorithm as components/libraries
+ */
+
+#ifndef CRC16_H__
+#define CRC16_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+static inline uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc){
+  uint16_t _crc = p_crc == NULL ? 0xFFFF : *p_crc;
+
+  for(uint32_t i = 0; i < size; ++i){
+    _crc = (uint8_t)(_crc >> 8) | (_crc << 8);
+    _crc ^= p_data[i];
+    _crc ^= (uint8_t)(_crc & 0xFF) >> 4;
+    _crc ^= (_crc << 8) << 4;
+    _crc ^= ((_crc & 0xFF) << 4) << 1;
+  }
+
+  return _crc;
+}
+
+#endif /* !CRC16_H__ */
@@ -0,0 +1,14 @@
+/**
+ * @file    nrf.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of device header
+ */
+
+#ifndef NRF_H
+#define NRF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#endif /* !NRF_H */
@@ -0,0 +1,13 @@
+/**
+ * @file    nrf_assert.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SDK assert, ASSERT comes from app_error.h shim
+ */
+
+#ifndef NRF_ASSERT_H_
+#define NRF_ASSERT_H_
+
+#include "app_error.h"
+
+#endif /* !NRF_ASSERT_H_ */
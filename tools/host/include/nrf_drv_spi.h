@@ -0,0 +1,69 @@
+/**
+ * @file    nrf_drv_spi.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SDK SPI master driver, transfers go to device emulator (flash_emu.c)
+ *
+ * Bytes are clocked when transfer starts, event handler is called later from emulated SPI IRQ.
+ */
+
+#ifndef NRF_DRV_SPI_H__
+#define NRF_DRV_SPI_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_error.h"
+
+#define NRF_DRV_SPI_PIN_NOT_USED  0xFF
+
+typedef struct{
+  uint8_t drv_inst_idx;
+}nrf_drv_spi_t;
+
+#define NRF_DRV_SPI_INSTANCE(id)  {.drv_inst_idx = (id)}
+
+typedef struct{
+  uint8_t sck_pin;
+  uint8_t mosi_pin;
+  uint8_t miso_pin;
+  uint8_t ss_pin;
+  uint8_t irq_priority;
+  uint8_t orc;                        /** Sent when there is nothing more to send */
+}nrf_drv_spi_config_t;
+
+#define NRF_DRV_SPI_DEFAULT_CONFIG                                                                \
+  {                                                                                               \
+    .sck_pin      = NRF_DRV_SPI_PIN_NOT_USED,                                                     \
+    .mosi_pin     = NRF_DRV_SPI_PIN_NOT_USED,                                                     \
+    .miso_pin     = NRF_DRV_SPI_PIN_NOT_USED,                                                     \
+    .ss_pin       = NRF_DRV_SPI_PIN_NOT_USED,                                                     \
+    .irq_priority = 3,                                                                            \
+    .orc          = 0xFF                                                                          \
+  }
+
+typedef enum{
+  NRF_DRV_SPI_EVENT_DONE
+}nrf_drv_spi_evt_type_t;
+
+typedef struct{
+  nrf_drv_spi_evt_type_t type;
+}nrf_drv_spi_evt_t;
+
+typedef void (*nrf_drv_spi_handler_t)(nrf_drv_spi_evt_t const *p_event);
+
+ret_code_t nrf_drv_spi_init(
+    nrf_drv_spi_t const *p_instance,
+    nrf_drv_spi_config_t const *p_config,
+    nrf_drv_spi_handler_t handler);
+
+void nrf_drv_spi_uninit(nrf_drv_spi_t const *p_instance);
+
+ret_code_t nrf_drv_spi_transfer(
+    nrf_drv_spi_t const *p_instance,
+    uint8_t const *p_tx_buffer,
+    uint8_t tx_buffer_length,
+    uint8_t *p_rx_buffer,
+    uint8_t rx_buffer_length);
+
+#endif /* !NRF_DRV_SPI_H__ */
@@ -0,0 +1,21 @@
+/**
+ * @file    nrf_gpio.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of GPIO HAL, outputs go to host_gpio_write() of device emulators
+ */
+
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+void host_gpio_write(uint32_t pin, bool value);
+
+static inline void nrf_gpio_cfg_output(uint32_t pin){ (void)pin; }
+static inline void nrf_gpio_cfg_default(uint32_t pin){ (void)pin; }
+static inline void nrf_gpio_pin_set(uint32_t pin){ host_gpio_write(pin, true); }
+static inline void nrf_gpio_pin_clear(uint32_t pin){ host_gpio_write(pin, false); }
+
+#endif /* !NRF_GPIO_H__ */
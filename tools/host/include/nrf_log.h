@@ -0,0 +1,24 @@
+/**
+ * @file    nrf_log.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SDK logger, logs are dropped
+ *
+ * Firmware passes strings as uint32_t like SDK logger expects, so arguments can not go to printf.
+ */
+
+#ifndef NRF_LOG_H_
+#define NRF_LOG_H_
+
+static inline void host_log_drop(const char *format, ...){
+  (void)format;
+}
+
+#define NRF_LOG_ERROR(...)        host_log_drop(__VA_ARGS__)
+#define NRF_LOG_WARNING(...)      host_log_drop(__VA_ARGS__)
+#define NRF_LOG_INFO(...)         host_log_drop(__VA_ARGS__)
+#define NRF_LOG_DEBUG(...)        host_log_drop(__VA_ARGS__)
+#define NRF_LOG_RAW_INFO(...)     host_log_drop(__VA_ARGS__)
+#define NRF_LOG_FLUSH()           do{}while(0)
+
+#endif /* !NRF_LOG_H_ */
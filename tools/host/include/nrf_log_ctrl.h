@@ -0,0 +1,11 @@
+/**
+ * @file    nrf_log_ctrl.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of SDK logger control
+ */
+
+#ifndef NRF_LOG_CTRL_H
+#define NRF_LOG_CTRL_H
+
+#endif /* !NRF_LOG_CTRL_H */
@@ -0,0 +1,39 @@
+/**
+ * @file    timers.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Host shim of FreeRTOS software timers, harness fires them with host_timer_fire()
+ */
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct host_timer_s *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+typedef void (*PendedFunction_t)(void *, uint32_t);
+
+TimerHandle_t xTimerCreate(
+    const char *name,
+    TickType_t period,
+    UBaseType_t reload,
+    void *id,
+    TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t block);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t block);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t block);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t block);
+BaseType_t xTimerStartFromISR(TimerHandle_t timer, BaseType_t *yield);
+BaseType_t xTimerStopFromISR(TimerHandle_t timer, BaseType_t *yield);
+BaseType_t xTimerChangePeriodFromISR(TimerHandle_t timer, TickType_t period, BaseType_t *yield);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+BaseType_t xTimerPendFunctionCall(PendedFunction_t function, void *arg1, uint32_t arg2, TickType_t block);
+TaskHandle_t xTimerGetTimerDaemonTaskHandle(void);
+
+/** Run callback of timer if it is active, one-shot timer stops */
+void host_timer_fire(TimerHandle_t timer);
+
+#endif /* !TIMERS_H */
@@ -0,0 +1,158 @@
+/**
+ * @file    ltc_bench.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Refresh cost of fixed point waveform engine against float one it replaced
+ *
+ * For every scenario both engines get the same DEVICE_CMD and report:
+ *  - cycles (or ns when no cycle counter) spent per task wake up, fixed engine counts finding
+ *    the next quantum as well,
+ *  - task wake ups per second of simulated time,
+ *  - cost of one second of simulated time, which is what battery sees.
+ * Host has FPU and cache, so cycle numbers only show the direction for FPU-less Cortex-M0, where
+ * every float operation is a library call. Wake ups are the same on target. Never fails.
+ *
+ *    ./ltc_bench [quanta]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ic_service_ltc.c"
+
+#include "host_port.h"
+#include "ltc_host.h"
+#include "ltc_reference.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline uint64_t m_now(void){ return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t m_now(void){
+  struct timespec _ts;
+  clock_gettime(CLOCK_MONOTONIC, &_ts);
+  return (uint64_t)_ts.tv_sec*1000000000u + _ts.tv_nsec;
+}
+#endif
+
+#define BENCH_QUANTA      200000
+#define BENCH_SECONDS     600       /** Simulated time of wake up count */
+
+typedef struct{
+  const char *name;
+  uint8_t func;
+  uint8_t period;                   /** 100 ms */
+  uint8_t intensity;
+}bench_scenario_s;
+
+static const bench_scenario_s m_scenarios[] = {
+  {"on",        FUN_TYPE_ON,        0,  40},
+  {"blink 1s",  FUN_TYPE_BLINK,     10, 40},
+  {"square 2s", FUN_TYPE_SQUARE,    20, 40},
+  {"saw 2s",    FUN_TYPE_SAW,       20, 60},
+  {"tri 10s",   FUN_TYPE_TRIANGLE,  100, 60},
+  {"ramp 25s",  FUN_TYPE_RAMP,      250, 60},
+};
+
+static volatile uint32_t m_sink;
+
+static void m_reference_write(ic_actuator_e device, uint8_t val){
+  m_sink += val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_actuator_set(ic_actuator_e device, uint8_t val, void(*fp)(bool)){
+  UNUSED_PARAMETER(fp);
+  m_sink += val;
+  return IC_SUCCESS;
+}
+
+/**
+ * @brief Both engines idle, then all actuators but power LED run scenario from tick 1.
+ */
+static void m_start(const bench_scenario_s *scenario){
+  u_BLECmdPayload _payload = {0};
+
+  ltc_host_reset();
+  ltc_reference_init(m_reference_write);
+
+  _payload.device_cmd.device = 0x7F;
+  _payload.device_cmd.func_type = scenario->func;
+  _payload.device_cmd.func_parameter.periodic_func.period = scenario->period;
+  memset(&_payload.device_cmd.intensity, scenario->intensity, 7);
+
+  host_tick_set(1);
+  (void)ltc_reference_parse(_payload);
+  (void)m_device_parse(_payload, NULL);
+}
+
+static double m_reference_cost(const bench_scenario_s *scenario, uint32_t quanta){
+  m_start(scenario);
+
+  __auto_type _begin = m_now();
+  for(uint32_t i = 0; i < quanta; ++i)
+    ltc_reference_quantum();
+
+  return (double)(m_now() - _begin) / quanta;
+}
+
+static double m_fixed_cost(const bench_scenario_s *scenario, uint32_t quanta){
+  uint32_t _wakes = 0;
+
+  m_start(scenario);
+  __auto_type _caller = host_task_enter(m_host_task);
+
+  __auto_type _begin = m_now();
+  for(uint32_t i = 0; i < quanta; ++_wakes){
+    __auto_type _next = m_next_quantum();
+    i += _next - m_quantum;
+    m_refresh(_next);
+  }
+  __auto_type _cost = (double)(m_now() - _begin) / _wakes;
+
+  host_task_enter(_caller);
+  return _cost;
+}
+
+static void m_wakes(const bench_scenario_s *scenario, double *reference, double *fixed){
+  uint32_t _reference = 0;
+  uint32_t _fixed = 0;
+  uint32_t _ticks = BENCH_SECONDS * configTICK_RATE_HZ;
+
+  m_start(scenario);
+  for(uint32_t _tick = 1; _tick < _ticks; ++_tick){
+    host_tick_set(_tick);
+    _reference += ltc_reference_tick(_tick);
+    _fixed += ltc_host_run_due(_tick);
+  }
+
+  *reference = (double)_reference / BENCH_SECONDS;
+  *fixed = (double)_fixed / BENCH_SECONDS;
+}
+
+int main(int argc, char **argv){
+  uint32_t _quanta = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_QUANTA;
+
+  host_port_init();
+
+  printf("%-10s %12s %12s %8s %8s %10s %10s\n", "", "float", "fixed", "float", "fixed",
+      "float", "fixed");
+  printf("%-10s %12s %12s %8s %8s %10s %10s\n", "scenario", BENCH_UNIT "/wake", BENCH_UNIT "/wake",
+      "wakes/s", "wakes/s", BENCH_UNIT "/s", BENCH_UNIT "/s");
+
+  for(int i = 0; i < sizeof(m_scenarios)/sizeof(m_scenarios[0]); ++i){
+    double _reference_wakes, _fixed_wakes;
+
+    __auto_type _reference_cost = m_reference_cost(&m_scenarios[i], _quanta);
+    __auto_type _fixed_cost = m_fixed_cost(&m_scenarios[i], _quanta);
+    m_wakes(&m_scenarios[i], &_reference_wakes, &_fixed_wakes);
+
+    printf("%-10s %12.0f %12.0f %8.1f %8.1f %10.0f %10.0f\n", m_scenarios[i].name,
+        _reference_cost, _fixed_cost, _reference_wakes, _fixed_wakes,
+        _reference_cost * _reference_wakes, _fixed_cost * _fixed_wakes);
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file    ltc_golden.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Fixed point waveform engine against float golden model, write by write
+ *
+ * Both engines get the same random DEVICE_CMD sequence and run tick by tick on simulated clock.
+ * Actuator writes of every tick have to be the same (device, value and order). Engine under test
+ * is included as source, so its refresh task is driven directly: it processes the quanta which are
+ * due, like the task does after waking up. Power budget is not limited here and function types
+ * the float engine did not have (sine table, curves, gamma) are not generated.
+ *
+ *    ./ltc_golden [seeds] [ticks]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ic_service_ltc.c"
+
+#include "host_port.h"
+#include "ltc_host.h"
+#include "ltc_reference.h"
+
+#define GOLDEN_SEEDS      8
+#define GOLDEN_TICKS      2000000
+#define GOLDEN_CMD_RATE   1500      /** One command per this many ticks on average */
+#define GOLDEN_WRITES     64        /** Writes kept per tick */
+
+typedef struct{
+  uint8_t count;
+  struct{
+    uint8_t device;
+    uint8_t val;
+  }writes[GOLDEN_WRITES];
+}golden_writes_s;
+
+static golden_writes_s m_expected;
+static golden_writes_s m_actual;
+static uint32_t m_rand_state;
+
+static void m_push(golden_writes_s *writes, ic_actuator_e device, uint8_t val){
+  if(writes->count == GOLDEN_WRITES){
+    fprintf(stderr, "too many writes in one tick\n");
+    exit(2);
+  }
+  writes->writes[writes->count].device = device;
+  writes->writes[writes->count].val = val;
+  ++writes->count;
+}
+
+static void m_reference_write(ic_actuator_e device, uint8_t val){
+  m_push(&m_expected, device, val);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_actuator_set(ic_actuator_e device, uint8_t val, void(*fp)(bool)){
+  UNUSED_PARAMETER(fp);
+  m_push(&m_actual, device, val);
+  return IC_SUCCESS;
+}
+
+static uint32_t m_rand(void){
+  m_rand_state = m_rand_state*1103515245u + 12345u;
+  return m_rand_state >> 8;
+}
+
+/**
+ * @brief DEVICE_CMD of random devices, function known to the float engine and parameters, a quarter
+ * of intensities out of range.
+ */
+static u_BLECmdPayload m_random_cmd(void){
+  static const uint8_t _funcs[] = {
+    FUN_TYPE_NO_FUNCTION, FUN_TYPE_OFF, FUN_TYPE_ON, FUN_TYPE_BLINK,
+    FUN_TYPE_SQUARE, FUN_TYPE_SAW, FUN_TYPE_TRIANGLE, FUN_TYPE_RAMP
+  };
+  u_BLECmdPayload _payload = {0};
+
+  _payload.device_cmd.device = m_rand() & 0xFF;
+  _payload.device_cmd.func_type = _funcs[m_rand() % sizeof(_funcs)];
+  _payload.device_cmd.func_parameter.periodic_func.period = m_rand() % 3 ? 1 + m_rand() % 255 : 0;
+  _payload.device_cmd.func_parameter.periodic_func.duration = m_rand() % 4 ? 0 : m_rand() % 256;
+
+  uint8_t *_intensity = &_payload.device_cmd.intensity.right_red_led;
+  int _max = m_rand() % 4 ? IC_LTC_MAX_VAL + 1 : 256;
+  for(int i = 0; i < 8; ++i)
+    _intensity[i] = m_rand() % _max;
+
+  return _payload;
+}
+
+static void m_print_writes(const char *name, const golden_writes_s *writes){
+  printf("  %-8s", name);
+  for(int i = 0; i < writes->count; ++i)
+    printf(" %d:%d", writes->writes[i].device, writes->writes[i].val);
+  printf("\n");
+}
+
+/**
+ * @return Number of writes compared, 0 on mismatch.
+ */
+static uint32_t m_run(uint32_t seed, uint32_t ticks){
+  uint32_t _compared = 0;
+
+  m_rand_state = seed;
+  ltc_host_reset();
+  ltc_reference_init(m_reference_write);
+
+  for(uint32_t _tick = 1; _tick < ticks; ++_tick){
+    m_expected.count = 0;
+    m_actual.count = 0;
+    host_tick_set(_tick);
+
+    if(m_rand() % GOLDEN_CMD_RATE == 0){
+      __auto_type _payload = m_random_cmd();
+      (void)ltc_reference_parse(_payload);
+      (void)m_device_parse(_payload, NULL);
+    }
+
+    ltc_reference_tick(_tick);
+    ltc_host_run_due(_tick);
+
+    if(m_expected.count != m_actual.count
+        || memcmp(m_expected.writes, m_actual.writes, m_actual.count * 2) != 0){
+      printf("seed %u: writes differ at tick %u\n", seed, _tick);
+      m_print_writes("float", &m_expected);
+      m_print_writes("fixed", &m_actual);
+      return 0;
+    }
+    _compared += m_actual.count;
+  }
+  return _compared;
+}
+
+int main(int argc, char **argv){
+  uint32_t _seeds = argc > 1 ? strtoul(argv[1], NULL, 0) : GOLDEN_SEEDS;
+  uint32_t _ticks = argc > 2 ? strtoul(argv[2], NULL, 0) : GOLDEN_TICKS;
+
+  host_port_init();
+
+  for(uint32_t _seed = 1; _seed <= _seeds; ++_seed){
+    __auto_type _compared = m_run(_seed, _ticks);
+    if(_compared == 0){
+      printf("FAIL\n");
+      return 1;
+    }
+    printf("seed %u: %u writes in %u ticks match\n", _seed, _compared, _ticks);
+  }
+
+  printf("PASS\n");
+  return 0;
+}
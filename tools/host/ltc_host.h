@@ -0,0 +1,75 @@
+/**
+ * @file    ltc_host.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Runs ic_service_ltc.c on simulated clock, include it after the engine source
+ *
+ * Refresh task is not started, harness processes quanta which are due on behalf of it (the task
+ * does the same after waking up). Power budget never limits outputs.
+ */
+
+#ifndef LTC_HOST_H
+#define LTC_HOST_H
+
+#include <string.h>
+
+#include "host_port.h"
+
+static TaskHandle_t m_host_task;
+static struct device_state_s m_host_initial[sizeof(m_device_state)/sizeof(m_device_state[0])];
+
+/* Used by service init/deinit only, they are not called here */
+ic_return_val_e ic_actuator_init(void){ return IC_SUCCESS; }
+ic_return_val_e ic_actuator_deinit(){ return IC_SUCCESS; }
+ic_return_val_e ic_pattern_init(void){ return IC_SUCCESS; }
+ic_return_val_e ic_ltc_budget_init(void){ return IC_SUCCESS; }
+ic_return_val_e ic_ltc_budget_deinit(void){ return IC_SUCCESS; }
+ic_return_val_e cmd_register(e_cmd cmd, cmd_handler_t handler, void *ctx){ return IC_SUCCESS; }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_ltc_budget_limit_s ic_ltc_budget_apply(const uint8_t *levels){
+  UNUSED_PARAMETER(levels);
+  return (ic_ltc_budget_limit_s){.scale = IC_LTC_BUDGET_SCALE_ONE};
+}
+
+/**
+ * @brief Idle engine with all devices off at tick 0, as after @ref ic_ltc_service_init.
+ */
+static inline void ltc_host_reset(void){
+  if(m_host_task == NULL){
+    m_host_task = host_task_new("LTC");
+    memcpy(m_host_initial, m_device_state, sizeof(m_device_state));
+  }
+
+  host_tick_set(0);
+  memcpy(m_device_state, m_host_initial, sizeof(m_device_state));
+  m_active_function_counter = 0;
+  m_quantum = 0;
+  m_quantum_tick = GET_TICK_COUNT() - QUANTUM_OF_TIME;
+  m_limit = (ic_ltc_budget_limit_s){.scale = IC_LTC_BUDGET_SCALE_ONE};
+  m_ltc_refresh_task_handle = m_host_task;
+}
+
+/**
+ * @brief Process quanta due at tick.
+ *
+ * @return Number of refreshes (task wake ups).
+ */
+static inline uint32_t ltc_host_run_due(TickType_t tick){
+  uint32_t _refreshes = 0;
+  __auto_type _caller = host_task_enter(m_host_task);
+
+  while(m_active_function_counter >= 1){
+    __auto_type _next = m_next_quantum();
+    if((int32_t)(m_tick_of(_next) - tick) > 0)
+      break;
+
+    m_refresh(_next);
+    ++_refreshes;
+  }
+
+  host_task_enter(_caller);
+  return _refreshes;
+}
+
+#endif /* !LTC_HOST_H */
@@ -0,0 +1,351 @@
+/**
+ * @file    ltc_reference.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Float waveform engine ic_service_ltc.c had before fixed point, golden model
+ *
+ * Waveform math, time keeping and write decisions are kept as they were (float alpha/beta/ramp
+ * coefficients, processing every QUANTUM_OF_TIME ticks after resume). Only the phase step is
+ * computed exactly, cur_period*alpha in float lost a step at exact boundaries, and stands still
+ * with no period (float divided by zero). Task, timers and power LED blinking are left out,
+ * harness calls @ref ltc_reference_tick.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ic_frame_handle.h"
+#include "ic_low_level_control.h"
+
+#include "ic_config.h"
+#include "ic_driver_actuators.h"
+
+#include "ltc_reference.h"
+
+#define QUANTUM_OF_TIME 16
+
+static const float m_beta_factor = 1.0/IC_LTC_MAX_VAL;
+static const float m_beta_factor_vib1 = IC_LTC_VIB_MAX_VAL/63.0;
+
+static struct device_state_s{
+  uint8_t desired_val;
+  ic_actuator_e device;
+  bool turned_on;
+  bool refresh_ltc;
+  e_funcType func;
+  uint32_t period;
+  uint32_t duration;
+  uint32_t cur_period;
+  uint32_t cur_duration;
+  uint8_t intensity;
+  float beta;
+  float a_ramp_coef;
+  uint8_t b_ramp_coef;
+  uint8_t ramp_step;
+}m_device_state[] =
+{
+  {.device = ACTUATOR_LEFT_GREEN_LED,   .func = FUN_TYPE_OFF},
+  {.device = ACTUATOR_LEFT_RED_LED,     .func = FUN_TYPE_OFF},
+  {.device = ACTUATOR_LEFT_BLUE_LED,    .func = FUN_TYPE_OFF},
+  {.device = ACTUATOR_RIGHT_GREEN_LED,  .func = FUN_TYPE_OFF},
+  {.device = ACTUATOR_RIGHT_RED_LED,    .func = FUN_TYPE_OFF},
+  {.device = ACTUATOR_RIGHT_BLUE_LED,   .func = FUN_TYPE_OFF},
+  {.device = ACTUATOR_VIBRATOR,         .func = FUN_TYPE_OFF},
+  {.device = ACTUATOR_POWER_LEDS,       .func = FUN_TYPE_OFF}
+};
+
+#define DEVICES (sizeof(m_device_state)/sizeof(m_device_state[0]))
+
+static struct device_state_s m_initial[DEVICES];
+static bool m_initial_taken;
+
+static struct{
+  ltc_reference_write_t write;
+  uint32_t active;                    /** m_active_function_counter */
+  bool resumed;                       /** Task was resumed while suspended */
+  bool suspended;
+  uint32_t next;                      /** Tick of the next pass of task */
+}m_ref = {.suspended = true};
+
+static void actuator_set_func(
+    struct device_state_s *device,
+    e_funcType func,
+    uint32_t period,
+    uint32_t duration,
+    uint8_t intensity);
+
+static uint8_t m_step(struct device_state_s *device){
+  if(device->period+1 == 0)
+    return 0;
+  return (uint64_t)device->cur_period*128/(device->period+1);
+}
+
+static uint8_t function_ramp_down(struct device_state_s *device){
+  uint8_t _step = QUANTUM_OF_TIME * device->beta;
+  if (_step == 0) _step = 1;
+  return ({int16_t _ret_val =
+      device->desired_val - _step; _ret_val<0 ? 0 : _ret_val;});
+}
+
+static uint8_t function_ramp_up(struct device_state_s *device){
+  uint8_t _step = QUANTUM_OF_TIME * device->beta;
+  if (_step == 0) _step = 1;
+  return ({__auto_type _ret_val =
+      device->desired_val + _step; _ret_val>device->intensity ? device->intensity : _ret_val;});
+}
+
+static uint8_t function_ramp(struct device_state_s *device){
+  int16_t _step = m_step(device);
+  uint8_t _ret_val;
+  if(_step<device->ramp_step || _step==127){
+    _ret_val = 127*device->a_ramp_coef + device->b_ramp_coef;
+    actuator_set_func(device,FUN_TYPE_ON, 0, 0, _ret_val);
+    return device->desired_val;
+  }
+  _ret_val = _step*device->a_ramp_coef + device->b_ramp_coef;
+  device->ramp_step = _step;
+  return _ret_val;
+}
+
+static uint8_t function_off(struct device_state_s *device){
+  return device->device == ACTUATOR_POWER_LEDS ? 0 : function_ramp_down(device);
+}
+
+static uint8_t function_on(struct device_state_s *device){
+  return device->intensity;
+}
+
+static uint8_t function_saw(struct device_state_s *device){
+  uint8_t _step = m_step(device);
+  return (_step>>1)*device->beta;
+}
+
+static uint8_t function_triangle(struct device_state_s *device){
+  uint8_t _step = m_step(device);
+  return (_step<64?_step:127-_step)*device->beta;
+}
+
+static uint8_t function_square(struct device_state_s *device){
+  uint8_t _step = m_step(device);
+  uint8_t _ret_val;
+  if(_step<64){
+    if(device->device == ACTUATOR_VIBRATOR)
+      _ret_val = device->intensity;
+    else
+      _ret_val = device->intensity == device->desired_val ?
+        device->intensity : function_ramp_up(device);
+  } else {
+    if(device->device == ACTUATOR_VIBRATOR)
+      _ret_val = 0;
+    else
+      _ret_val = 0 == device->desired_val ? 0 : function_ramp_down(device);
+  }
+  return _ret_val;
+}
+
+static uint8_t function_blink(struct device_state_s *device){
+  return device->cur_period<QUANTUM_OF_TIME ? device->intensity : 0;
+}
+
+/** SIN_WAVE was a triangle, it is not part of the model */
+static uint8_t(*m_function_map[])(struct device_state_s *) = {
+  [FUN_TYPE_NO_FUNCTION]  = function_off,
+  [FUN_TYPE_OFF]          = function_off,
+  [FUN_TYPE_ON]           = function_on,
+  [FUN_TYPE_BLINK]        = function_blink,
+  [FUN_TYPE_SQUARE]       = function_square,
+  [FUN_TYPE_SAW]          = function_saw,
+  [FUN_TYPE_TRIANGLE]     = function_triangle,
+  [FUN_TYPE_RAMP]         = function_ramp
+};
+
+static uint8_t calculate_val(struct device_state_s *device){
+  uint8_t _offset = 0;
+
+  __auto_type _ret_val = m_function_map[device->func] != NULL ?
+    m_function_map[device->func](device)+_offset : 0;
+
+  if(device->device == ACTUATOR_VIBRATOR)
+    if(device->func != FUN_TYPE_OFF && _ret_val>0)
+      _offset = IC_LTC_VIB_MIN_VAL;
+
+  return _ret_val+_offset;
+}
+
+#define REFRESH_ALL(func) do{\
+  for (int i = 0; i < DEVICES; ++i){\
+    if(m_device_state[i].turned_on) refresh_##func(&m_device_state[i]);\
+  }\
+}while(0)
+
+static void refresh_device(struct device_state_s * device){
+  if(device->device == ACTUATOR_POWER_LEDS){
+    if(device->cur_period < QUANTUM_OF_TIME)
+      m_ref.write(ACTUATOR_POWER_LEDS, 63);
+  }
+  else if(device->refresh_ltc){
+    m_ref.write(device->device, device->desired_val);
+  }
+}
+
+static void refresh_time(struct device_state_s * device){
+  if((device->cur_period += QUANTUM_OF_TIME)>device->period){
+    __auto_type _delta = device->cur_period - device->period;
+    device->cur_period = _delta-1;
+  }
+
+  if(device->duration > 0)
+    if((device->cur_duration += QUANTUM_OF_TIME)>=device->duration){
+      device->func = FUN_TYPE_OFF;
+    }
+}
+
+static void refresh_function(struct device_state_s *device){
+  __auto_type _tmp_val = calculate_val(device);
+  device->refresh_ltc = _tmp_val == device->desired_val ? false : true;
+  if(device->refresh_ltc){
+    device->desired_val = _tmp_val;
+  }
+}
+
+static void refresh_activation(struct device_state_s *device){
+  if((device->desired_val == 0)&&(device->func == FUN_TYPE_OFF)){
+    device->turned_on = false;
+    m_ref.active--;
+  }
+}
+
+static void actuator_set_func(
+    struct device_state_s *device,
+    e_funcType func,
+    uint32_t period,
+    uint32_t duration,
+    uint8_t intensity)
+{
+  if((device->device == ACTUATOR_VIBRATOR) && (func != FUN_TYPE_OFF)){
+    device->intensity = intensity*m_beta_factor_vib1;
+    device->beta = device->intensity*m_beta_factor;
+  }
+  else if(func==FUN_TYPE_RAMP){
+    device->b_ramp_coef = device->desired_val;
+    int _tmp = (intensity - device->desired_val);
+    device->a_ramp_coef = _tmp/127.0;
+    device->ramp_step = 0;
+    device->intensity = intensity;
+  }
+  else{
+    device->beta = func==FUN_TYPE_OFF ? device->desired_val*m_beta_factor : intensity*m_beta_factor;
+    device->intensity = intensity;
+  }
+
+  device->cur_period = 0;
+  device->cur_duration = 0;
+
+  if(device->device == ACTUATOR_POWER_LEDS && func != FUN_TYPE_BLINK)
+    device->func = FUN_TYPE_OFF;
+  else
+    device->func = func;
+
+  device->period = period-1;
+  device->duration = duration == 0 ? 0 : duration-1;
+
+  if(!device->turned_on){
+    device->turned_on = true;
+    if(m_ref.active++ == 0)
+      m_ref.resumed = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ltc_reference_init(ltc_reference_write_t write){
+  if(!m_initial_taken){
+    memcpy(m_initial, m_device_state, sizeof(m_device_state));
+    m_initial_taken = true;
+  }
+
+  memcpy(m_device_state, m_initial, sizeof(m_device_state));
+  m_ref = (__typeof__(m_ref)){.write = write, .suspended = true};
+}
+
+#define INTENSITY(field) offsetof(u_BLECmdPayload, device_cmd.intensity.field)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ltc_reference_parse(u_BLECmdPayload payload){
+  static const struct{
+    uint8_t mask;
+    ic_actuator_e device;
+    size_t intensity;                 /** Offset of intensity in payload */
+  }_map[] = {
+    {DEV_RIGHT_RED_LED,   ACTUATOR_RIGHT_RED_LED,   INTENSITY(right_red_led)},
+    {DEV_RIGHT_GREEN_LED, ACTUATOR_RIGHT_GREEN_LED, INTENSITY(right_green_led)},
+    {DEV_RIGHT_BLUE_LED,  ACTUATOR_RIGHT_BLUE_LED,  INTENSITY(right_blue_led)},
+    {DEV_LEFT_RED_LED,    ACTUATOR_LEFT_RED_LED,    INTENSITY(left_red_led)},
+    {DEV_LEFT_GREEN_LED,  ACTUATOR_LEFT_GREEN_LED,  INTENSITY(left_green_led)},
+    {DEV_LEFT_BLUE_LED,   ACTUATOR_LEFT_BLUE_LED,   INTENSITY(left_blue_led)},
+    {DEV_VIBRATOR,        ACTUATOR_VIBRATOR,        INTENSITY(vibrator)}
+  };
+
+  __auto_type _func = payload.device_cmd.func_type;
+  if(_func >= sizeof(m_function_map)/sizeof(m_function_map[0]) || m_function_map[_func] == NULL)
+    return false;
+
+  __auto_type _period = pdMS_TO_TICKS((payload.device_cmd.func_parameter.periodic_func.period*100));
+  __auto_type _duration =
+    pdMS_TO_TICKS((payload.device_cmd.func_parameter.periodic_func.duration*100));
+
+  for(int i = 0; i < sizeof(_map)/sizeof(_map[0]); ++i){
+    if(payload.device_cmd.device & _map[i].mask)
+      actuator_set_func(
+          &m_device_state[_map[i].device],
+          _func,
+          _period,
+          _duration,
+          payload.data[_map[i].intensity]);
+  }
+  if(payload.device_cmd.device & DEV_POWER_LED)
+    actuator_set_func(&m_device_state[ACTUATOR_POWER_LEDS], _func, _period, _duration, 0);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ltc_reference_quantum(void){
+  REFRESH_ALL(time);
+  REFRESH_ALL(function);
+  REFRESH_ALL(device);
+  REFRESH_ALL(activation);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ltc_reference_tick(uint32_t tick){
+  if(m_ref.suspended){
+    if(!m_ref.resumed)
+      return false;
+
+    m_ref.resumed = false;
+    m_ref.suspended = false;
+    ltc_reference_quantum();
+    m_ref.next = tick + QUANTUM_OF_TIME;
+    return true;
+  }
+
+  if(tick != m_ref.next)
+    return false;
+
+  if(m_ref.active < 1){
+    m_ref.suspended = true;
+    m_ref.resumed = false;
+    return false;
+  }
+
+  ltc_reference_quantum();
+  m_ref.next += QUANTUM_OF_TIME;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t ltc_reference_active(void){
+  return m_ref.active;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file    ltc_reference.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Float waveform engine, golden model of ic_service_ltc.c
+ */
+
+#ifndef LTC_REFERENCE_H
+#define LTC_REFERENCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "ic_frame_handle.h"
+#include "ic_driver_actuators.h"
+
+typedef void (*ltc_reference_write_t)(ic_actuator_e device, uint8_t val);
+
+/**
+ * @brief Idle engine with all devices off, outputs go to write.
+ */
+void ltc_reference_init(ltc_reference_write_t write);
+
+/**
+ * @brief Apply DEVICE_CMD payload.
+ *
+ * @return false when function type is not part of the model, nothing was applied.
+ */
+bool ltc_reference_parse(u_BLECmdPayload payload);
+
+/**
+ * @brief Call on every tick, engine is processed every QUANTUM_OF_TIME ticks while active.
+ *
+ * @return true when engine was processed (task woke up) at tick.
+ */
+bool ltc_reference_tick(uint32_t tick);
+
+/**
+ * @brief Process all active devices once, as task did every quantum.
+ */
+void ltc_reference_quantum(void);
+
+/**
+ * @return Number of active devices.
+ */
+uint32_t ltc_reference_active(void);
+
+#endif /* !LTC_REFERENCE_H */
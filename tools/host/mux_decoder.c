@@ -0,0 +1,111 @@
+/**
+ * @file    mux_decoder.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Receiver side of multiplexed stream
+ *
+ * Record boundaries come from record headers only, first offset of every notification is checked
+ * against them and is used to regain alignment after a gap.
+ */
+
+#include <string.h>
+
+#include "ic_service_mux.h"
+
+#include "mux_decoder.h"
+
+static void m_emit(mux_decoder_s *decoder){
+  __auto_type _header = decoder->record;
+  mux_decoded_record_s _record = {
+    .type     = _header[0],
+    .len      = _header[1],
+    .payload  = &_header[MUX_DECODER_HEADER]
+  };
+
+  if(_record.type == IC_MUX_SYNC && _record.len == sizeof(uint32_t)){
+    memcpy(&decoder->tick, _record.payload, sizeof(decoder->tick));
+    decoder->timed = true;
+    ++decoder->stats.sync_records;
+    return;
+  }
+
+  decoder->tick += (int8_t)_header[2];
+  _record.timed = decoder->timed;
+  _record.tick = decoder->tick;
+
+  ++decoder->stats.records;
+  decoder->stats.payload += _record.len;
+  if(!_record.timed)
+    ++decoder->stats.untimed;
+
+  decoder->on_record(&_record, decoder->ctx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void mux_decoder_init(
+    mux_decoder_s *decoder,
+    void (*on_record)(const mux_decoded_record_s *, void *),
+    void *ctx)
+{
+  memset(decoder, 0, sizeof(*decoder));
+  decoder->on_record = on_record;
+  decoder->ctx = ctx;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void mux_decoder_feed(mux_decoder_s *decoder, const uint8_t *data, size_t len){
+  if(len < 2){
+    ++decoder->stats.framing_errors;
+    return;
+  }
+
+  __auto_type _seq = data[0];
+  __auto_type _first = data[1];
+  __auto_type _stream = data + 2;
+  __auto_type _len = len - 2;
+
+  ++decoder->stats.pdus;
+  decoder->stats.stream_bytes += _len;
+
+  if(decoder->started && _seq != decoder->next_seq){
+    decoder->stats.lost_pdus += (uint8_t)(_seq - decoder->next_seq);
+    decoder->aligned = false;
+    decoder->timed = false;
+    decoder->have = 0;
+  }
+  decoder->started = true;
+  decoder->next_seq = _seq + 1;
+
+  if(_first != IC_MUX_NO_RECORD && _first >= _len){
+    ++decoder->stats.framing_errors;
+    _first = IC_MUX_NO_RECORD;
+  }
+
+  size_t i = 0;
+  if(!decoder->aligned){
+    if(_first == IC_MUX_NO_RECORD){
+      decoder->stats.skipped_bytes += _len;
+      return;
+    }
+    decoder->stats.skipped_bytes += _first;
+    decoder->aligned = true;
+    ++decoder->stats.resyncs;
+    i = _first;
+  }
+
+  __auto_type _found = (uint8_t)IC_MUX_NO_RECORD;
+  for(; i < _len; ++i){
+    if(decoder->have == 0 && _found == IC_MUX_NO_RECORD)
+      _found = i;
+
+    decoder->record[decoder->have++] = _stream[i];
+    if(decoder->have >= MUX_DECODER_HEADER
+        && decoder->have == MUX_DECODER_HEADER + decoder->record[1]){
+      m_emit(decoder);
+      decoder->have = 0;
+    }
+  }
+
+  if(_found != _first)
+    ++decoder->stats.framing_errors;
+}
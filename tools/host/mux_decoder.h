@@ -0,0 +1,65 @@
+/**
+ * @file    mux_decoder.h
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Receiver side of multiplexed stream, framing is described in ic_service_mux.h
+ *
+ * Notifications are fed in order of arrival. Gap in seq drops partial record and decoder waits for
+ * notification with record start (first != 0xFF). Times are rebuilt from SYNC records and dt, after
+ * a gap they are unknown until next SYNC, records decoded in between are delivered untimed.
+ */
+
+#ifndef MUX_DECODER_H
+#define MUX_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MUX_DECODER_HEADER  3
+
+typedef struct{
+  uint8_t type;
+  uint8_t len;
+  bool timed;                         /** tick is valid */
+  uint32_t tick;
+  const uint8_t *payload;
+}mux_decoded_record_s;
+
+typedef struct{
+  uint32_t pdus;
+  uint32_t lost_pdus;                 /** From seq gaps */
+  uint32_t stream_bytes;              /** Bytes after notification header */
+  uint32_t skipped_bytes;             /** Dropped while resynchronizing */
+  uint32_t records;                   /** Without SYNC */
+  uint32_t sync_records;
+  uint32_t payload;                   /** Payload bytes of records without SYNC */
+  uint32_t untimed;                   /** Records delivered without tick */
+  uint32_t resyncs;
+  uint32_t framing_errors;            /** first offset did not match decoded record boundary */
+}mux_decoder_stats_s;
+
+typedef struct{
+  void (*on_record)(const mux_decoded_record_s *, void *);
+  void *ctx;
+  bool started;
+  bool aligned;                       /** Next stream byte is expected to belong to known record */
+  bool timed;
+  uint8_t next_seq;
+  uint32_t tick;
+  size_t have;
+  uint8_t record[MUX_DECODER_HEADER + UINT8_MAX];
+  mux_decoder_stats_s stats;
+}mux_decoder_s;
+
+void mux_decoder_init(
+    mux_decoder_s *decoder,
+    void (*on_record)(const mux_decoded_record_s *, void *),
+    void *ctx);
+
+/**
+ * @brief Decode one notification, records completed by it are passed to on_record.
+ */
+void mux_decoder_feed(mux_decoder_s *decoder, const uint8_t *data, size_t len);
+
+#endif /* !MUX_DECODER_H */
@@ -0,0 +1,366 @@
+/**
+ * @file    mux_stream.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Multiplexed stream end to end, firmware mux against host decoder
+ *
+ * Notification stub gives SoftDevice credits per connection interval, TX_COMPLETE hands them back
+ * and drains the ring like on target. Every record carries serial of the append that queued it, so
+ * decoder output is checked against log of accepted appends.
+ *
+ * Scenarios:
+ *  - clean      - every accepted record decoded in order with exact tick,
+ *  - lossy      - every n-th notification lost on the air: decoded records keep order, timed ones
+ *                 have exact tick, first offset always agrees with record headers,
+ *  - congested  - link slower than producers: appends refused, all accepted records decoded,
+ *  - contention - producer tasks and BLE task in parallel, ring must have one consumer at a time.
+ * Efficiency report shows where notification bytes go.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ic_service_mux.c"
+
+#include "host_port.h"
+#include "mux_decoder.h"
+
+#define STREAM_LOG          (1 << 16)
+#define STREAM_PRODUCERS    3
+#define STREAM_THREADED     3000      /** Records per producer task */
+
+typedef struct{
+  const char *name;
+  uint32_t seconds;
+  TickType_t interval;              /** Connection interval, ticks */
+  uint8_t credits;                  /** Notifications per interval */
+  uint32_t loss_every;              /** 0 - no loss */
+}stream_scenario_s;
+
+typedef struct{
+  const char *name;
+  uint8_t type;
+  uint8_t len;
+  TickType_t period;
+}stream_producer_s;
+
+typedef struct{
+  uint8_t type;
+  uint8_t len;
+  uint32_t tick;
+}stream_log_s;
+
+static const stream_scenario_s m_scenarios[] = {
+  {"clean",     60, 8,  4, 0},
+  {"lossy",     60, 8,  4, 23},
+  {"congested", 60, 32, 1, 0},
+};
+
+/* Rates of target producers, policy announcements are rare */
+static const stream_producer_s m_producers[] = {
+  {"eeg",     IC_MUX_EEG,     16, 64},
+  {"acc_ppg", IC_MUX_ACC_PPG, 14, 40},
+  {"policy",  IC_MUX_POLICY,  6,  1024},
+};
+
+static void (*m_state_change)(bool);
+
+static struct{
+  uint8_t credits;
+  uint32_t loss_every;
+  uint32_t accepted;
+  uint32_t volatile senders;        /** Contexts inside send stub */
+  uint32_t overlaps;
+  mux_decoder_s decoder;
+}m_link;
+
+static struct{
+  stream_log_s entries[STREAM_LOG];
+  uint32_t count;
+  uint32_t refused;
+  uint32_t decoded;
+  int64_t last_serial;
+  uint32_t order_errors;
+  uint32_t content_errors;
+  uint32_t tick_errors;
+  uint32_t next[STREAM_PRODUCERS];  /** Contention - next serial of every producer */
+}m_log;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_connect_to_mux(void (*p_func)(bool)){
+  m_state_change = p_func;
+  return IC_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_send_to_mux(const uint8_t *data, size_t len, uint32_t *err){
+  UNUSED_PARAMETER(err);
+
+  if(__atomic_fetch_add(&m_link.senders, 1, __ATOMIC_SEQ_CST) != 0)
+    ++m_link.overlaps;
+
+  /* Lets other drainer in, host may have single CPU */
+  host_yield();
+
+  __auto_type _ret_val = IC_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  if(m_link.credits == 0){
+    _ret_val = IC_BUSY;
+  }
+  else{
+    --m_link.credits;
+    if(m_link.loss_every == 0 || ++m_link.accepted % m_link.loss_every != 0)
+      mux_decoder_feed(&m_link.decoder, data, len);
+  }
+  CRITICAL_REGION_EXIT();
+
+  __atomic_fetch_sub(&m_link.senders, 1, __ATOMIC_SEQ_CST);
+  return _ret_val;
+}
+
+static void m_payload(uint8_t *payload, uint8_t len, uint32_t serial){
+  memcpy(payload, &serial, sizeof(serial));
+  for(int i = sizeof(serial); i < len; ++i)
+    payload[i] = (uint8_t)(serial * 31 + i);
+}
+
+static void m_on_record(const mux_decoded_record_s *record, void *ctx){
+  UNUSED_PARAMETER(ctx);
+
+  uint32_t _serial;
+  uint8_t _expected[UINT8_MAX];
+
+  memcpy(&_serial, record->payload, sizeof(_serial));
+  ++m_log.decoded;
+
+  if(_serial >= m_log.count || (int64_t)_serial <= m_log.last_serial){
+    ++m_log.order_errors;
+    return;
+  }
+  m_log.last_serial = _serial;
+
+  __auto_type _entry = &m_log.entries[_serial];
+  m_payload(_expected, _entry->len, _serial);
+  if(record->type != _entry->type || record->len != _entry->len
+      || memcmp(record->payload, _expected, record->len) != 0)
+    ++m_log.content_errors;
+
+  if(record->timed && record->tick != _entry->tick)
+    ++m_log.tick_errors;
+}
+
+/**
+ * @brief Append record of producer at current tick, accepted ones are logged.
+ */
+static void m_produce(const stream_producer_s *producer, TickType_t tick){
+  uint8_t _payload[UINT8_MAX];
+  __auto_type _serial = m_log.count;
+
+  if(_serial == STREAM_LOG)
+    APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+
+  /* Logged first, append drains the ring when it seals a notification */
+  m_log.entries[_serial] = (stream_log_s){producer->type, producer->len, tick};
+  ++m_log.count;
+
+  m_payload(_payload, producer->len, _serial);
+  if(ic_mux_append(producer->type, tick, _payload, producer->len) != IC_SUCCESS){
+    ++m_log.refused;
+    --m_log.count;
+  }
+}
+
+static void m_connection_event(uint8_t credits){
+  ble_evt_t _evt = {.header.evt_id = BLE_EVT_TX_COMPLETE};
+
+  CRITICAL_REGION_ENTER();
+  m_link.credits = credits;
+  CRITICAL_REGION_EXIT();
+
+  ic_mux_on_ble_evt(&_evt);
+}
+
+static void m_subscribe(const stream_scenario_s *scenario){
+  memset(&m_log, 0, sizeof(m_log));
+  m_log.last_serial = -1;
+
+  m_link.credits = 0;
+  m_link.loss_every = scenario->loss_every;
+  m_link.accepted = 0;
+  mux_decoder_init(&m_link.decoder, m_on_record, NULL);
+
+  m_mux.stats = (ic_mux_stats_s){0};
+  m_state_change(true);
+}
+
+static void m_report(const char *name){
+  __auto_type _mux = ic_mux_get_stats();
+  __auto_type _rx = &m_link.decoder.stats;
+  __auto_type _capacity = (double)_rx->pdus * IC_MUX_PACKET_SIZE;
+  __auto_type _headers = 2.0 * _rx->pdus
+    + (double)MUX_DECODER_HEADER * (_rx->records + _rx->sync_records);
+  __auto_type _sync = (double)sizeof(uint32_t) * _rx->sync_records;
+
+  printf("%-10s %6u %6u %6u %7.2f %6.1f%% %6.1f%% %6.1f%% %6.1f%% %5u %5u %6u\n",
+      name, _mux.pdus, _mux.records, _mux.dropped,
+      _mux.pdus != 0 ? (double)_mux.payload / _mux.pdus : 0.0,
+      100.0 * _rx->payload / _capacity,
+      100.0 * _headers / _capacity,
+      100.0 * _sync / _capacity,
+      100.0 * (_rx->pdus * IC_MUX_PAYLOAD - _rx->stream_bytes) / _capacity,
+      _rx->lost_pdus, _rx->resyncs, _rx->untimed);
+}
+
+static int m_check(const char *what, uint32_t value, uint32_t expected, bool exact){
+  __auto_type _ok = exact ? value == expected : value <= expected;
+  if(!_ok)
+    printf("  %-26s %8u %s %u  FAIL\n", what, value, exact ? "==" : "<=", expected);
+  return _ok ? 0 : 1;
+}
+
+static int m_run(const stream_scenario_s *scenario){
+  TickType_t _tick = 1;
+  __auto_type _end = scenario->seconds * configTICK_RATE_HZ;
+
+  host_tick_set(_tick);
+  m_subscribe(scenario);
+
+  for(; _tick < _end; ++_tick){
+    host_tick_set(_tick);
+
+    for(int i = 0; i < sizeof(m_producers)/sizeof(m_producers[0]); ++i)
+      if(_tick % m_producers[i].period == 0)
+        m_produce(&m_producers[i], _tick);
+
+    if(_tick % (IC_MUX_FLUSH_DEADLINE/4) == 0)
+      host_timer_fire(m_mux.flush_timer);
+
+    if(_tick % scenario->interval == 0)
+      m_connection_event(scenario->credits);
+  }
+
+  /* Producers stopped, deadline flushes the rest */
+  for(__auto_type _idle = _tick + 8*IC_MUX_FLUSH_DEADLINE + 64*scenario->interval; _tick < _idle;
+      ++_tick){
+    host_tick_set(_tick);
+    host_timer_fire(m_mux.flush_timer);
+    m_connection_event(scenario->credits);
+  }
+
+  m_report(scenario->name);
+  m_state_change(false);
+
+  __auto_type _rx = &m_link.decoder.stats;
+  __auto_type _lossy = scenario->loss_every != 0;
+  int _failed = 0;
+
+  _failed += m_check("ring drained", IC_RING_COUNT(m_packets) + m_mux.fill_len, 0, true);
+  _failed += m_check("order errors", m_log.order_errors, 0, true);
+  _failed += m_check("content errors", m_log.content_errors, 0, true);
+  _failed += m_check("tick errors", m_log.tick_errors, 0, true);
+  _failed += m_check("framing errors", _rx->framing_errors, 0, true);
+  _failed += m_check("refused appends", m_log.refused, ic_mux_get_stats().dropped, true);
+  _failed += m_check("lost notifications", _rx->lost_pdus,
+      _lossy ? ic_mux_get_stats().pdus / scenario->loss_every : 0, true);
+  if(!_lossy){
+    _failed += m_check("decoded", m_log.decoded, m_log.count, true);
+    _failed += m_check("untimed", _rx->untimed, 0, true);
+  }
+  else{
+    /* Every loss costs at most records of two notifications and time until next SYNC */
+    __auto_type _bound = _rx->lost_pdus * (2 * IC_MUX_PAYLOAD / MUX_DECODER_HEADER);
+    _failed += m_check("undecoded", m_log.count - m_log.decoded, _bound, false);
+    _failed += m_check("resyncs", _rx->resyncs, _rx->lost_pdus + 1, false);
+  }
+
+  return _failed;
+}
+
+static void m_producer_task(void *arg){
+  __auto_type _id = (uint32_t)(uintptr_t)arg;
+  uint8_t _payload[8];
+
+  for(uint32_t i = 0; i < STREAM_THREADED;){
+    __auto_type _serial = _id << 24 | i;
+    m_payload(_payload, sizeof(_payload), _serial);
+
+    if(ic_mux_append(IC_MUX_EEG, GET_TICK_COUNT(), _payload, sizeof(_payload)) == IC_SUCCESS)
+      ++i;
+    else
+      taskYIELD();
+  }
+}
+
+static void m_on_threaded_record(const mux_decoded_record_s *record, void *ctx){
+  UNUSED_PARAMETER(ctx);
+
+  uint32_t _serial;
+  memcpy(&_serial, record->payload, sizeof(_serial));
+
+  __auto_type _id = _serial >> 24;
+  ++m_log.decoded;
+  if(_id >= STREAM_PRODUCERS || (_serial & 0xFFFFFF) != m_log.next[_id]++)
+    ++m_log.order_errors;
+}
+
+/**
+ * @brief Producer tasks race each other, BLE task and flush timer for the ring.
+ */
+static int m_contention(void){
+  TaskHandle_t _producers[STREAM_PRODUCERS];
+  __auto_type _scenario = &(stream_scenario_s){"contention", 0, 1, 4, 0};
+
+  m_subscribe(_scenario);
+  mux_decoder_init(&m_link.decoder, m_on_threaded_record, NULL);
+
+  for(uintptr_t i = 0; i < STREAM_PRODUCERS; ++i)
+    if(xTaskCreate(m_producer_task, "PROD", 128, (void *)i, 1, &_producers[i]) != pdPASS)
+      return 1;
+
+  __auto_type _ble = host_task_new("BLE");
+  __auto_type _caller = host_task_enter(_ble);
+  __auto_type _expected = STREAM_PRODUCERS * STREAM_THREADED;
+
+  __auto_type _deadline = xTaskGetTickCount() + pdMS_TO_TICKS(20000);
+  while(m_log.decoded < _expected && (int32_t)(xTaskGetTickCount() - _deadline) < 0){
+    m_connection_event(_scenario->credits);
+    host_timer_fire(m_mux.flush_timer);
+    host_yield();
+  }
+  host_task_enter(_caller);
+
+  for(int i = 0; i < STREAM_PRODUCERS; ++i)
+    host_join(_producers[i]);
+
+  m_report(_scenario->name);
+  m_state_change(false);
+
+  int _failed = 0;
+  _failed += m_check("decoded", m_log.decoded, _expected, true);
+  _failed += m_check("order errors", m_log.order_errors, 0, true);
+  _failed += m_check("drain overlaps", m_link.overlaps, 0, true);
+  _failed += m_check("lost notifications", m_link.decoder.stats.lost_pdus, 0, true);
+  _failed += m_check("framing errors", m_link.decoder.stats.framing_errors, 0, true);
+  return _failed;
+}
+
+int main(void){
+  int _failed = 0;
+
+  host_port_init();
+  if(ic_service_mux_init() != IC_SUCCESS || m_state_change == NULL)
+    return 1;
+
+  printf("%-10s %6s %6s %6s %7s %7s %7s %7s %7s %5s %5s %6s\n", "scenario", "pdus", "recs",
+      "refused", "pay/pdu", "payload", "headers", "sync", "unfill", "lost", "rsync", "untimed");
+
+  /* Runs on host clock, before scenarios fix tick count */
+  _failed += m_contention();
+
+  for(int i = 0; i < sizeof(m_scenarios)/sizeof(m_scenarios[0]); ++i)
+    _failed += m_run(&m_scenarios[i]);
+
+  printf(_failed == 0 ? "PASS\n" : "FAIL\n");
+  return _failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+/**
+ * @file    power_cut.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Recorder survives power cut at every program and erase, see ic_service_recorder.h
+ *
+ * Every boot runs in its own process, flash image is the only thing left after power cut. Recording
+ * of a workload is started on empty image once, with its programs and erases journaled. For step
+ * n = 1, 2, ... of the journal image of power cut during n-th program or erase is rebuilt
+ * (flash_emu_replay), next boot mounts the log and records one more session. Workloads:
+ *  - wrap        - long sessions wrap the flash, cut at every step,
+ *  - compaction  - many short sessions fill index sector several times, so it is compacted and the
+ *                  oldest blocks are freed, cut at every step in index.
+ * Checks of every boot:
+ *  - mount succeeds and session counter is not behind any session in flash,
+ *  - erase counters of blocks in index are not behind the ones before the cut,
+ *  - no program lands on flash which is not erased,
+ *  - new session continues sequence of pages written before the cut (one page can be torn),
+ *    sequences of all CRC valid pages are unique,
+ *  - CRC valid pages of the newest blocks written before the cut are kept,
+ *  - after another mount new session is found by seek at its session page.
+ * Image of recording which finished is booted too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "crc16.h"
+
+#include "ic_service_recorder.h"
+#include "ic_service_time.h"
+#include "ic_ble_service.h"
+
+#include "host_port.h"
+#include "flash_emu.h"
+
+#define CUT_IMAGE             "power_cut.img"
+#define CUT_JOURNAL           "power_cut.jnl"
+#define CUT_CAPACITY          18          /** 256kB - index block and 3 data blocks */
+#define CUT_SPEED             2
+#define CUT_FRAME_LEN         58          /** 4 frames fill a page */
+#define CUT_BOOT_FRAMES       40
+#define CUT_PAGES             ((1 << CUT_CAPACITY) / IC_FLASH_PAGE_SIZE)
+#define CUT_FIRST_PAGE        (IC_FLASH_BLOCK_SIZE / IC_FLASH_PAGE_SIZE)
+#define CUT_BLOCKS            ((1 << CUT_CAPACITY) / IC_FLASH_BLOCK_SIZE - 1)
+#define CUT_INDEX_SIZE        (IC_RECORDER_INDEX_SECTORS * IC_FLASH_SECTOR_SIZE)
+#define CUT_INDEX_RECORDS     (IC_FLASH_SECTOR_SIZE / sizeof(ic_recorder_index_s))
+#define CUT_MAX_FAILED_STEPS  8
+
+typedef struct{
+  const char *name;
+  uint32_t sessions;
+  uint32_t frames;                    /** Frames of session */
+  uint32_t kept_blocks;               /** The newest blocks never freed */
+  bool index_only;                    /** Cut only during programs and erases of index */
+}cut_workload_s;
+
+static const cut_workload_s m_workloads[] = {
+  {"wrap",        6,    600,  2,  false},
+  {"compaction",  320,  1,    1,  true},
+};
+
+static const cut_workload_s *m_workload;
+static int m_failed;
+static uint32_t m_step;
+
+static void m_check(const char *what, uint32_t value, uint32_t expected){
+  if(value == expected)
+    return;
+  printf("  %s step %-5u %-36s %8u != %u  FAIL\n", m_workload->name, m_step, what, value,
+      expected);
+  ++m_failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_unix_timestamp_s ic_unix_timestamp_get(){
+  return (ic_unix_timestamp_s){.unix_timestamp = 1500000000 + xTaskGetTickCount()/configTICK_RATE_HZ};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_stream0_ready(){
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_stream1_ready(){
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_mux_ready(){
+  return false;
+}
+
+/**
+ * @brief CRC valid pages of data blocks.
+ */
+typedef struct{
+  bool valid[CUT_PAGES];
+  uint32_t sequence[CUT_PAGES];
+  uint16_t session[CUT_PAGES];
+  uint8_t type[CUT_PAGES];
+  uint32_t max_sequence;
+  uint16_t max_session;
+  bool any;
+}cut_scan_s;
+
+static bool m_page_valid(const ic_recorder_page_s *page){
+  __auto_type _copy = *page;
+  _copy.header.crc = 0;
+
+  return page->header.magic == IC_RECORDER_MAGIC
+    && (page->header.type == IC_RECORDER_PAGE_SESSION || page->header.type == IC_RECORDER_PAGE_DATA)
+    && page->header.crc == crc16_compute((const uint8_t *)&_copy, sizeof(_copy), NULL);
+}
+
+static void m_scan(cut_scan_s *scan){
+  __auto_type _pages = (const ic_recorder_page_s *)flash_emu_memory();
+
+  memset(scan, 0, sizeof(*scan));
+  for(int i = CUT_FIRST_PAGE; i < CUT_PAGES; ++i){
+    if(!m_page_valid(&_pages[i]))
+      continue;
+
+    scan->valid[i] = true;
+    scan->sequence[i] = _pages[i].header.sequence;
+    scan->session[i] = _pages[i].header.session;
+    scan->type[i] = _pages[i].header.type;
+    scan->max_sequence = !scan->any ? scan->sequence[i] : MAX(scan->max_sequence, scan->sequence[i]);
+    scan->max_session = MAX(scan->max_session, scan->session[i]);
+    scan->any = true;
+  }
+}
+
+static bool m_index_valid(const ic_recorder_index_s *record){
+  return record->crc
+    == crc16_compute((const uint8_t *)record, offsetof(ic_recorder_index_s, crc), NULL);
+}
+
+/**
+ * @brief Erase counters of BLOCK records in index sector which mount uses.
+ */
+static void m_index_erases(uint16_t *erases){
+  __auto_type _records = (const ic_recorder_index_s *)flash_emu_memory();
+  const ic_recorder_index_s *_sector = NULL;
+
+  memset(erases, 0, CUT_BLOCKS * sizeof(erases[0]));
+  for(int i = 0; i < IC_RECORDER_INDEX_SECTORS; ++i){
+    __auto_type _header = &_records[i * CUT_INDEX_RECORDS];
+    if(m_index_valid(_header) && _header->type == IC_RECORDER_INDEX_HEADER
+        && (_sector == NULL || _header->sequence > _sector->sequence))
+      _sector = _header;
+  }
+
+  for(int i = 1; _sector != NULL && i < CUT_INDEX_RECORDS; ++i)
+    if(m_index_valid(&_sector[i]) && _sector[i].type == IC_RECORDER_INDEX_BLOCK
+        && _sector[i].block < CUT_BLOCKS)
+      erases[_sector[i].block] = MAX(erases[_sector[i].block], _sector[i].erase_count);
+}
+
+static int m_compare(const void *a, const void *b){
+  __auto_type _a = *(const uint32_t *)a;
+  __auto_type _b = *(const uint32_t *)b;
+  return _a < _b ? -1 : _a > _b;
+}
+
+static void m_boot(void){
+  host_port_init();
+  host_tick_speed(CUT_SPEED);
+  host_timer_daemon_start();
+
+  if(!flash_emu_open(CUT_IMAGE, CUT_CAPACITY))
+    abort();
+  flash_emu_timing(1, 4, 8);
+}
+
+static void m_session(uint32_t frames){
+  uint8_t _frame[CUT_FRAME_LEN];
+
+  if(ic_recorder_start() != IC_SUCCESS)
+    return;
+
+  __auto_type _session = ic_recorder_get_stats().session;
+  for(uint32_t i = 0; i < frames; ++i){
+    for(int j = 0; j < sizeof(_frame); ++j)
+      _frame[j] = (uint8_t)(_session * 31 + i + j);
+    while(ic_recorder_append(IC_RECORDER_EEG, _frame, sizeof(_frame)) == IC_BUSY)
+      vTaskDelay(1);
+  }
+
+  ic_recorder_stop();
+}
+
+/**
+ * @brief Journaled recording which wraps the flash.
+ */
+static int m_record(uint32_t step){
+  UNUSED_PARAMETER(step);
+  m_boot();
+
+  if(!flash_emu_journal(CUT_JOURNAL) || ic_service_recorder_init() != IC_SUCCESS)
+    return 1;
+
+  for(int i = 0; i < m_workload->sessions; ++i)
+    m_session(m_workload->frames);
+
+  return ic_service_recorder_deinit() == IC_SUCCESS ? 0 : 1;
+}
+
+/**
+ * @brief Boot after power cut, mount and record new session.
+ */
+static int m_recover(uint32_t step){
+  UNUSED_PARAMETER(step);
+  static cut_scan_s _before, _after;
+  static uint32_t _sequences[CUT_PAGES];
+  uint16_t _erases_before[CUT_BLOCKS], _erases_after[CUT_BLOCKS];
+  __auto_type _kept_pages = m_workload->kept_blocks * IC_FLASH_BLOCK_SIZE / IC_FLASH_PAGE_SIZE;
+
+  m_boot();
+  m_scan(&_before);
+  m_index_erases(_erases_before);
+
+  m_check("mount", ic_service_recorder_init(), IC_SUCCESS);
+  if(m_failed != 0)
+    return 1;
+
+  __auto_type _stats = ic_recorder_get_stats();
+  m_check("session recovered", _stats.session >= _before.max_session, true);
+
+  flash_emu_reset_stats();
+  m_session(CUT_BOOT_FRAMES);
+  __auto_type _session = ic_recorder_get_stats().session;
+  m_check("deinit", ic_service_recorder_deinit(), IC_SUCCESS);
+  m_check("programs of not erased flash", flash_emu_get_stats().dirty_programs, 0);
+  m_check("recorder errors", ic_recorder_get_stats().errors, 0);
+
+  m_scan(&_after);
+  m_index_erases(_erases_after);
+  for(int i = 0; i < CUT_BLOCKS; ++i)
+    m_check("erase counter kept", _erases_after[i] >= _erases_before[i], true);
+
+  uint32_t _new_pages = 0, _count = 0, _new_first = UINT32_MAX;
+  for(int i = CUT_FIRST_PAGE; i < CUT_PAGES; ++i){
+    if(_after.valid[i])
+      _sequences[_count++] = _after.sequence[i];
+
+    if(_after.valid[i] && _after.session[i] == _session){
+      ++_new_pages;
+      _new_first = MIN(_new_first, _after.sequence[i]);
+    }
+
+    if(_before.valid[i] && _before.sequence[i] + _kept_pages > _before.max_sequence
+        && (!_after.valid[i] || _after.sequence[i] != _before.sequence[i]))
+      m_check("page kept", i * IC_FLASH_PAGE_SIZE, UINT32_MAX);
+  }
+  m_check("new session pages", _new_pages >= CUT_BOOT_FRAMES / 4, true);
+
+  /* Page torn by the cut takes one sequence number */
+  if(_before.any && (_new_first <= _before.max_sequence || _new_first > _before.max_sequence + 2))
+    m_check("sequence recovered", _new_first, _before.max_sequence + 1);
+
+  qsort(_sequences, _count, sizeof(_sequences[0]), m_compare);
+  for(uint32_t i = 1; i < _count; ++i)
+    if(_sequences[i] == _sequences[i-1])
+      m_check("sequence unique", _sequences[i], UINT32_MAX);
+
+  /* Index of the new session is consistent after one more mount */
+  uint32_t _address = 0;
+  m_check("mount again", ic_service_recorder_init(), IC_SUCCESS);
+  m_check("seek", ic_recorder_seek(_session, 0, &_address), IC_SUCCESS);
+  __auto_type _page = _address / IC_FLASH_PAGE_SIZE;
+  m_check("seek to session page",
+      _page < CUT_PAGES
+        && _after.valid[_page]
+        && _after.type[_page] == IC_RECORDER_PAGE_SESSION
+        && _after.session[_page] == _session,
+      true);
+
+  return m_failed == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Run boot in new process.
+ *
+ * @return Exit status, -1 when process crashed.
+ */
+static int m_run(int (*boot)(uint32_t), uint32_t step){
+  fflush(stdout);
+
+  __auto_type _pid = fork();
+  if(_pid < 0)
+    abort();
+
+  if(_pid == 0){
+    m_step = step;
+    __auto_type _status = boot(step);
+    fflush(stdout);
+    _exit(_status);
+  }
+
+  int _status;
+  if(waitpid(_pid, &_status, 0) != _pid || !WIFEXITED(_status))
+    return -1;
+  return WEXITSTATUS(_status);
+}
+
+/**
+ * @brief Image of power cut at given step, 0 is recording which finished.
+ *
+ * @return false when journal is shorter.
+ */
+static bool m_cut(uint32_t step, uint32_t *address){
+  unlink(CUT_IMAGE);
+  if(!flash_emu_open(CUT_IMAGE, CUT_CAPACITY))
+    abort();
+
+  __auto_type _ret_val = flash_emu_replay(CUT_JOURNAL, step == 0 ? UINT32_MAX : step, address);
+  flash_emu_close();
+
+  return step == 0 || _ret_val;
+}
+
+/**
+ * @return Steps which failed.
+ */
+static uint32_t m_power_cuts(const cut_workload_s *workload){
+  uint32_t _step, _cuts = 0, _failed_steps = 0, _address = 0;
+
+  m_workload = workload;
+  unlink(CUT_IMAGE);
+  if(m_run(m_record, 0) != 0){
+    printf("  %s recording failed  FAIL\n", workload->name);
+    return 1;
+  }
+
+  for(_step = 1; _failed_steps < CUT_MAX_FAILED_STEPS && m_cut(_step, &_address); ++_step){
+    if(workload->index_only && _address >= CUT_INDEX_SIZE)
+      continue;
+    ++_cuts;
+    if(m_run(m_recover, _step) != 0)
+      ++_failed_steps;
+  }
+
+  /* Recording which finished */
+  m_cut(0, NULL);
+  if(_failed_steps < CUT_MAX_FAILED_STEPS && m_run(m_recover, 0) != 0)
+    ++_failed_steps;
+
+  printf("  %-10s %5u steps, %5u power cuts, %u failed\n", workload->name, _step - 1, _cuts,
+      _failed_steps);
+  return _failed_steps;
+}
+
+int main(void){
+  uint32_t _failed_steps = 0;
+
+  for(int i = 0; i < sizeof(m_workloads)/sizeof(m_workloads[0]); ++i)
+    _failed_steps += m_power_cuts(&m_workloads[i]);
+
+  unlink(CUT_IMAGE);
+  unlink(CUT_JOURNAL);
+
+  printf(_failed_steps == 0 ? "PASS\n" : "FAIL\n");
+  return _failed_steps == 0 ? 0 : 1;
+}
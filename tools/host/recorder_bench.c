@@ -0,0 +1,264 @@
+/**
+ * @file    recorder_bench.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Mount cost, write amplification and wear of recorder on emulated flash
+ *
+ * Sessions of random length are recorded until the log wrapped the flash several times. Log is
+ * mounted again when it passes checkpoints of its size, every mount reports flash reads and bytes
+ * it needed and time they take on SPI clocked by NRF_DRV_SPI_DEFAULT_CONFIG (4MHz, command and
+ * address included, CPU time not). Write amplification is flash bytes programmed (page headers,
+ * padding and index included) and erased per byte of appended frames. Wear shows erase cycles of
+ * data and index sectors.
+ *
+ * Fails when a mount reads more than the bound of its algorithm (index sector headers, binary
+ * search of index end, replay of one index sector in chunks and binary search of the newest block),
+ * which does not depend on log size, or when data sectors got more erases than one cycle of the
+ * whole flash and mounts explain. Sector erased in advance is erased again after mount, power cut
+ * could have interrupted the first erase.
+ *
+ *    ./recorder_bench [wraps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ic_service_recorder.h"
+#include "ic_service_time.h"
+#include "ic_ble_service.h"
+
+#include "host_port.h"
+#include "flash_emu.h"
+
+#define BENCH_IMAGE           "recorder_bench.img"
+#define BENCH_CAPACITY        20          /** 1MB - index block and 15 data blocks */
+#define BENCH_SPEED           4
+#define BENCH_WRAPS           4
+#define BENCH_MAX_FRAMES      3000        /** Frames of the longest session, 4 fill a page */
+#define BENCH_FRAME_LEN       58
+#define BENCH_SPI_HZ          4000000
+#define BENCH_READ_HEADER     5           /** FAST_READ command, address and dummy byte */
+#define BENCH_PAGES           ((1 << BENCH_CAPACITY) / IC_FLASH_PAGE_SIZE)
+#define BENCH_DATA_PAGES      (BENCH_PAGES - IC_FLASH_BLOCK_SIZE / IC_FLASH_PAGE_SIZE)
+#define BENCH_SECTORS         ((1 << BENCH_CAPACITY) / IC_FLASH_SECTOR_SIZE)
+#define BENCH_INDEX_RECORDS   (IC_FLASH_SECTOR_SIZE / sizeof(ic_recorder_index_s))
+#define BENCH_SCAN_CHUNK      8
+
+/** Log size of mounts, in flash sizes (percent) */
+static const uint32_t m_checkpoints[] = {0, 1, 25, 50, 100, 200, 400, 800, 1600};
+
+static struct{
+  uint64_t payload;                   /** Bytes of appended frames */
+  uint64_t programmed;
+  uint64_t erased;
+  uint32_t frames;
+  uint32_t sessions;
+  uint32_t mounts;
+  uint32_t max_reads;
+}m_bench;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_unix_timestamp_s ic_unix_timestamp_get(){
+  return (ic_unix_timestamp_s){.unix_timestamp = 1500000000 + xTaskGetTickCount()/configTICK_RATE_HZ};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_stream0_ready(){
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_stream1_ready(){
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ble_iccs_mux_ready(){
+  return false;
+}
+
+static uint32_t m_log2(uint32_t value){
+  uint32_t _bits = 0;
+
+  while((1u << _bits) < value)
+    ++_bits;
+
+  return _bits;
+}
+
+/**
+ * @brief Reads of mount: headers of index sectors, binary search of the end of index sector,
+ * replay of used slots in chunks and binary search of the first free page of the newest block.
+ */
+static uint32_t m_mount_bound(void){
+  return IC_RECORDER_INDEX_SECTORS
+    + m_log2(BENCH_INDEX_RECORDS) + 1
+    + (BENCH_INDEX_RECORDS + BENCH_SCAN_CHUNK - 1) / BENCH_SCAN_CHUNK
+    + m_log2(IC_FLASH_BLOCK_SIZE / IC_FLASH_PAGE_SIZE) + 1;
+}
+
+static void m_session(uint32_t frames){
+  uint8_t _frame[BENCH_FRAME_LEN];
+
+  if(ic_recorder_start() != IC_SUCCESS)
+    return;
+
+  __auto_type _session = ic_recorder_get_stats().session;
+  for(uint32_t i = 0; i < frames; ++i){
+    for(int j = 0; j < sizeof(_frame); ++j)
+      _frame[j] = (uint8_t)(_session * 31 + i + j);
+    while(ic_recorder_append(IC_RECORDER_EEG, _frame, sizeof(_frame)) == IC_BUSY)
+      vTaskDelay(1);
+  }
+
+  ic_recorder_stop();
+
+  m_bench.payload += frames * BENCH_FRAME_LEN;
+  m_bench.frames += frames;
+  ++m_bench.sessions;
+}
+
+/**
+ * @brief Add programs and erases since the last mount, statistics of emulator start again with
+ * every mount, the ones of recorder do not.
+ */
+static int m_account(void){
+  __auto_type _flash = flash_emu_get_stats();
+  __auto_type _errors = ic_recorder_get_stats().errors;
+
+  m_bench.programmed += _flash.program_bytes;
+  m_bench.erased += (uint64_t)_flash.sector_erases * IC_FLASH_SECTOR_SIZE
+    + (uint64_t)_flash.block_erases * IC_FLASH_BLOCK_SIZE;
+  flash_emu_reset_stats();
+
+  if(_flash.dirty_programs == 0 && _errors == 0)
+    return 0;
+
+  printf("  %u programs of not erased flash, %u recorder errors  FAIL\n",
+      _flash.dirty_programs, _errors);
+  return 1;
+}
+
+/**
+ * @return 0 or number of failed checks.
+ */
+static int m_mount(uint32_t pages){
+  if(ic_service_recorder_deinit() != IC_SUCCESS)
+    return 1;
+
+  __auto_type _failed = m_account();
+  __auto_type _ret_val = ic_service_recorder_init();
+  __auto_type _flash = flash_emu_get_stats();
+  __auto_type _stats = ic_recorder_get_stats();
+
+  /* Reads of flash init (JEDEC ID) are not reads of memory */
+  __auto_type _spi_us = (uint64_t)(_flash.read_bytes + BENCH_READ_HEADER * _flash.reads) * 8
+    * 1000000 / BENCH_SPI_HZ;
+
+  printf("%9.2f %7u %8u %6u %6u %10u %8u\n",
+      (double)pages / BENCH_DATA_PAGES, _stats.session, _stats.index_records, _flash.reads,
+      _flash.read_bytes, (uint32_t)_spi_us, m_mount_bound());
+
+  ++m_bench.mounts;
+  m_bench.max_reads = MAX(m_bench.max_reads, _flash.reads);
+
+  if(_ret_val != IC_SUCCESS || _flash.reads > m_mount_bound()){
+    printf("  mount %u failed or read more than %u  FAIL\n", m_bench.mounts, m_mount_bound());
+    ++_failed;
+  }
+  return _failed;
+}
+
+/**
+ * @return Erases above min + 1 summed over sectors.
+ */
+static uint32_t m_wear(uint32_t first, uint32_t last, uint32_t *min, uint32_t *max, double *mean){
+  uint64_t _sum = 0;
+  uint32_t _excess = 0;
+
+  *min = UINT32_MAX;
+  *max = 0;
+  for(uint32_t i = first; i < last; ++i){
+    __auto_type _erases = flash_emu_sector_erases(i * IC_FLASH_SECTOR_SIZE);
+    *min = MIN(*min, _erases);
+    *max = MAX(*max, _erases);
+    _sum += _erases;
+  }
+  *mean = (double)_sum / (last - first);
+
+  for(uint32_t i = first; i < last; ++i)
+    _excess += MAX(flash_emu_sector_erases(i * IC_FLASH_SECTOR_SIZE), *min + 1) - (*min + 1);
+
+  return _excess;
+}
+
+int main(int argc, char *argv[]){
+  __auto_type _wraps = argc > 1 ? (uint32_t)atoi(argv[1]) : BENCH_WRAPS;
+  int _failed = 0;
+
+  unlink(BENCH_IMAGE);
+
+  host_port_init();
+  host_tick_speed(BENCH_SPEED);
+  host_timer_daemon_start();
+  if(!flash_emu_open(BENCH_IMAGE, BENCH_CAPACITY))
+    return 1;
+  flash_emu_timing(1, 4, 8);
+
+  if(ic_service_recorder_init() != IC_SUCCESS)
+    return 1;
+
+  printf("%9s %7s %8s %6s %6s %10s %8s\n",
+      "log/flash", "session", "index", "reads", "bytes", "spi us", "bound");
+
+  srand(1);
+  uint32_t _checkpoint = 0;
+
+  while(_checkpoint < sizeof(m_checkpoints)/sizeof(m_checkpoints[0])
+      && m_checkpoints[_checkpoint] <= 100 * _wraps)
+  {
+    __auto_type _pages = ic_recorder_get_stats().pages;
+
+    if((uint64_t)_pages * 100 < (uint64_t)m_checkpoints[_checkpoint] * BENCH_DATA_PAGES){
+      m_session(1 + rand() % BENCH_MAX_FRAMES);
+      continue;
+    }
+
+    _failed += m_mount(_pages);
+    ++_checkpoint;
+  }
+
+  __auto_type _index_records = ic_recorder_get_stats().index_records;
+  uint32_t _min, _max, _index_min, _index_max;
+  double _mean, _index_mean;
+  __auto_type _first_data = IC_FLASH_BLOCK_SIZE / IC_FLASH_SECTOR_SIZE;
+
+  __auto_type _excess = m_wear(_first_data, BENCH_SECTORS, &_min, &_max, &_mean);
+  m_wear(0, IC_RECORDER_INDEX_SECTORS, &_index_min, &_index_max, &_index_mean);
+
+  printf("%u sessions, %u frames, %.1f kB of frames\n",
+      m_bench.sessions, m_bench.frames, m_bench.payload / 1024.0);
+  printf("write amplification %.3f (index %.4f), erase amplification %.3f\n",
+      (double)m_bench.programmed / m_bench.payload,
+      (double)_index_records * sizeof(ic_recorder_index_s) / m_bench.payload,
+      (double)m_bench.erased / m_bench.payload);
+  printf("data sector erases  min %u max %u mean %.2f, %u above one cycle\n",
+      _min, _max, _mean, _excess);
+  printf("index sector erases min %u max %u mean %.2f\n", _index_min, _index_max, _index_mean);
+
+  if(_excess > m_bench.mounts){
+    printf("  %u erases above one cycle, more than %u mounts  FAIL\n", _excess, m_bench.mounts);
+    ++_failed;
+  }
+
+  ic_service_recorder_deinit();
+  flash_emu_close();
+  unlink(BENCH_IMAGE);
+
+  printf(_failed == 0 ? "PASS\n" : "FAIL\n");
+  return _failed == 0 ? 0 : 1;
+}
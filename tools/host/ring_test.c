@@ -0,0 +1,256 @@
+/**
+ * @file    ring_test.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Ring buffer edge cases, see ic_ring_buffer.h
+ *
+ * Checks:
+ *  - wraparound - free running 8 bit indexes pass 255 many times, elements come out in order,
+ *  - full/empty - buffers of size 1, 2 and 128 take exactly size elements from any start index,
+ *  - live       - IC_RING_LIVE follows release of element while indexes wrap,
+ *  - mpsc       - producer tasks push under critical region shim while consumer pops, every
+ *                 element comes out once and in order of its producer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "app_util_platform.h"
+
+#include "ic_ring_buffer.h"
+
+#include "host_port.h"
+
+#define RING_ROUNDS       1000
+#define RING_PRODUCERS    4
+#define RING_PUSHES       50000     /** Elements per producer task */
+#define RING_MPSC_SIZE    16
+
+static int m_failed;
+
+static void m_check(const char *what, uint32_t value, uint32_t expected){
+  if(value == expected)
+    return;
+  printf("  %-40s %8u != %u  FAIL\n", what, value, expected);
+  ++m_failed;
+}
+
+/**
+ * @brief Move empty ring to given free running index.
+ */
+#define RING_START_AT(rb, index)                                                                  \
+  do{                                                                                             \
+    (rb).ring.head = (index);                                                                     \
+    (rb).ring.tail = (index);                                                                     \
+  }while(0)
+
+static void m_wraparound(void){
+  IC_RING_BUFFER(uint32_t, 8) _rb = {0};
+  uint32_t _pushed = 0, _popped = 0;
+  bool _ok;
+
+  /* Fill levels change every round, so head and tail cross 255 at every distance */
+  for(uint32_t _round = 0; _round < RING_ROUNDS; ++_round){
+    for(uint32_t i = 0; i < _round % 9; ++i){
+      IC_RING_PUSH_SPSC(_rb, _pushed, _ok);
+      if(!_ok)
+        break;
+      ++_pushed;
+    }
+    m_check("count after push", IC_RING_COUNT(_rb), _pushed - _popped);
+
+    for(uint32_t i = 0; i < _round % 7; ++i){
+      uint32_t _value;
+      IC_RING_POP(_rb, _value, _ok);
+      if(!_ok)
+        break;
+      m_check("popped value", _value, _popped++);
+    }
+    m_check("count after pop", IC_RING_COUNT(_rb), _pushed - _popped);
+
+    if(!IC_RING_EMPTY(_rb)){
+      m_check("first", IC_RING_FIRST(_rb), _popped);
+      m_check("last", IC_RING_LAST(_rb), _pushed - 1);
+      m_check("at", IC_RING_AT(_rb, IC_RING_COUNT(_rb) - 1), _pushed - 1);
+    }
+  }
+
+  m_check("indexes wrapped", _pushed > 4*256, true);
+}
+
+#define RING_FULL_EMPTY(size, start)                                                              \
+  do{                                                                                             \
+    IC_RING_BUFFER(uint8_t, size) _rb = {0};                                                      \
+    bool _ok;                                                                                     \
+    uint8_t _value;                                                                               \
+                                                                                                  \
+    RING_START_AT(_rb, start);                                                                    \
+    m_check("empty at start", IC_RING_EMPTY(_rb), true);                                          \
+    IC_RING_POP(_rb, _value, _ok);                                                                \
+    m_check("pop from empty", _ok, false);                                                        \
+                                                                                                  \
+    for(int i = 0; i < (size); ++i){                                                              \
+      m_check("not full", IC_RING_FULL(_rb), false);                                              \
+      IC_RING_PUSH_SPSC(_rb, (uint8_t)i, _ok);                                                    \
+      m_check("push below size", _ok, true);                                                      \
+    }                                                                                             \
+    m_check("count at size", IC_RING_COUNT(_rb), (size));                                         \
+    m_check("full at size", IC_RING_FULL(_rb), true);                                             \
+    m_check("not empty at size", IC_RING_EMPTY(_rb), false);                                      \
+    IC_RING_PUSH_SPSC(_rb, 0xEE, _ok);                                                            \
+    m_check("push to full", _ok, false);                                                          \
+    m_check("full push keeps head", (uint8_t)(_rb.ring.head - (start)), (size));                  \
+                                                                                                  \
+    for(int i = 0; i < (size); ++i){                                                              \
+      IC_RING_POP(_rb, _value, _ok);                                                              \
+      m_check("pop below size", _ok && _value == (uint8_t)i, true);                               \
+    }                                                                                             \
+    m_check("empty after pops", IC_RING_EMPTY(_rb), true);                                        \
+    ic_ring_release(&_rb.ring);                                                                   \
+    m_check("release of empty keeps tail", _rb.ring.tail, _rb.ring.head);                         \
+  }while(0)
+
+static void m_full_empty(void){
+  static const uint8_t _starts[] = {0, 1, 127, 128, 200, 255};
+
+  for(int i = 0; i < sizeof(_starts); ++i){
+    RING_FULL_EMPTY(1, _starts[i]);
+    RING_FULL_EMPTY(2, _starts[i]);
+    RING_FULL_EMPTY(128, _starts[i]);
+  }
+}
+
+static void m_live(void){
+  IC_RING_BUFFER(uint16_t, 4) _rb = {0};
+  bool _ok;
+
+  RING_START_AT(_rb, 254);
+  uint8_t _index = _rb.ring.head;
+
+  m_check("empty slot not live", IC_RING_LIVE(_rb, _index), false);
+
+  for(int i = 0; i < 4; ++i)
+    IC_RING_PUSH_SPSC(_rb, (uint16_t)(0x100 + i), _ok);
+  for(int i = 0; i < 4; ++i){
+    m_check("pushed slot live", IC_RING_LIVE(_rb, _index + i), true);
+    m_check("slot keeps element", IC_RING_SLOT(_rb, _index + i), 0x100 + i);
+  }
+  m_check("slot after head not live", IC_RING_LIVE(_rb, _index + 4), false);
+  m_check("slot before tail not live", IC_RING_LIVE(_rb, _index - 1), false);
+
+  ic_ring_release(&_rb.ring);
+  m_check("released slot not live", IC_RING_LIVE(_rb, _index), false);
+  m_check("next slot still live", IC_RING_LIVE(_rb, _index + 1), true);
+  m_check("slot does not move", IC_RING_SLOT(_rb, _index + 1), 0x101);
+  m_check("at moves", IC_RING_AT(_rb, 0), 0x101);
+
+  /*
+   * Against 32 bit model while indexes wrap: index taken less than 256 - size releases ago is live
+   * exactly when it is between tail and head, older ones alias.
+   */
+  uint32_t _head = _index + 4, _tail = _index + 1;
+  for(int _round = 0; _round < RING_ROUNDS; ++_round){
+    if(_round % 3 != 0 && !IC_RING_FULL(_rb)){
+      IC_RING_PUSH_SPSC(_rb, 0, _ok);
+      ++_head;
+    }
+    if(_round % 2 != 0 && !IC_RING_EMPTY(_rb)){
+      ic_ring_release(&_rb.ring);
+      ++_tail;
+    }
+
+    for(uint32_t _taken = _tail - (256 - IC_RING_SIZE(_rb)) + 1; _taken != _head + 1; ++_taken){
+      __auto_type _expected = _taken - _tail < _head - _tail;
+      if(IC_RING_LIVE(_rb, _taken) != _expected){
+        m_check("live against model", _taken, _tail);
+        return;
+      }
+    }
+  }
+}
+
+static IC_RING_BUFFER(uint32_t, RING_MPSC_SIZE) m_mpsc;
+static uint32_t volatile m_full_pushes;
+
+static void m_producer_task(void *arg){
+  __auto_type _id = (uint32_t)(uintptr_t)arg;
+  bool _ok;
+
+  for(uint32_t i = 0; i < RING_PUSHES;){
+    IC_RING_PUSH_MPSC(m_mpsc, _id << 24 | i, _ok);
+    if(_ok){
+      ++i;
+    }
+    else{
+      CRITICAL_REGION_ENTER();
+      ++m_full_pushes;
+      CRITICAL_REGION_EXIT();
+      taskYIELD();
+    }
+  }
+}
+
+static void m_mpsc_push(void){
+  TaskHandle_t _producers[RING_PRODUCERS];
+  uint32_t _next[RING_PRODUCERS] = {0};
+  uint32_t _popped = 0, _order_errors = 0;
+
+  for(uintptr_t i = 0; i < RING_PRODUCERS; ++i)
+    if(xTaskCreate(m_producer_task, "PROD", 128, (void *)i, 1, &_producers[i]) != pdPASS)
+      abort();
+
+  __auto_type _deadline = xTaskGetTickCount() + pdMS_TO_TICKS(20000);
+  while(_popped < RING_PRODUCERS * RING_PUSHES
+      && (int32_t)(xTaskGetTickCount() - _deadline) < 0)
+  {
+    uint32_t _value;
+    bool _ok;
+
+    if(IC_RING_COUNT(m_mpsc) > IC_RING_SIZE(m_mpsc))
+      ++_order_errors;
+
+    IC_RING_POP(m_mpsc, _value, _ok);
+    if(!_ok){
+      taskYIELD();
+      continue;
+    }
+
+    ++_popped;
+    __auto_type _id = _value >> 24;
+    if(_id >= RING_PRODUCERS || (_value & 0xFFFFFF) != _next[_id]++)
+      ++_order_errors;
+  }
+
+  for(int i = 0; i < RING_PRODUCERS; ++i)
+    host_join(_producers[i]);
+
+  printf("  %u elements, %u pushes to full ring\n", _popped, m_full_pushes);
+  m_check("popped", _popped, RING_PRODUCERS * RING_PUSHES);
+  m_check("order errors", _order_errors, 0);
+  m_check("left in ring", IC_RING_COUNT(m_mpsc), 0);
+}
+
+int main(void){
+  static const struct{
+    const char *name;
+    void (*run)(void);
+  }_cases[] = {
+    {"wraparound",  m_wraparound},
+    {"full/empty",  m_full_empty},
+    {"live",        m_live},
+    {"mpsc",        m_mpsc_push},
+  };
+
+  host_port_init();
+
+  for(int i = 0; i < sizeof(_cases)/sizeof(_cases[0]); ++i){
+    __auto_type _failed = m_failed;
+    _cases[i].run();
+    printf("%-12s %s\n", _cases[i].name, _failed == m_failed ? "ok" : "FAIL");
+  }
+
+  printf(m_failed == 0 ? "PASS\n" : "FAIL\n");
+  return m_failed == 0 ? 0 : 1;
+}
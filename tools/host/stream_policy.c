@@ -0,0 +1,339 @@
+/**
+ * @file    stream_policy.c
+ * @Author  Paweł Kaźmierzewski <p.kazmierzewski@inteliclinic.com>
+ * @date    October, 2026
+ * @brief   Stream policy against SoftDevice which throttles TX credits
+ *
+ * Send stubs play SoftDevice: notification takes one of @ref POLICY_CAPACITY TX buffers or is
+ * refused with IC_BUSY, link frees buffers at throughput of current phase every connection
+ * interval, like TX_COMPLETE does. Producers mirror EEG and ACC/PPG senders: frame rates follow
+ * policy level, refused frame is retried every tick and dropped after
+ * @ref IC_STREAM_POLICY_MAX_RETRY retries. Announcements are decoded from stream2, in mux run from
+ * policy records.
+ *
+ * Phases of link, each run with stream characteristics and with multiplexed stream:
+ *  - clean      - faster than full streams, level stays FULL,
+ *  - slowed     - slower than full streams, ACC decimation is enough,
+ *  - throttled  - only compressed EEG and vitals fit, ladder is stepped down to its end,
+ *  - recovered  - clean again, ladder is stepped up to FULL.
+ * Every announcement has to continue the previous one, the last one carries current level.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "app_util_platform.h"
+
+#include "ic_stream_policy.h"
+#include "ic_ble_service.h"
+#include "ic_service_mux.h"
+
+#include "host_port.h"
+
+#define POLICY_SPEED      8
+#define POLICY_CAPACITY   6           /** SoftDevice TX buffers */
+#define POLICY_INTERVAL   8           /** Connection interval, ticks */
+#define POLICY_FRAME_LEN  20
+#define POLICY_SAMPLE     64          /** Ticks between samples of level */
+
+typedef struct{
+  const char *name;
+  uint32_t seconds;
+  uint32_t throughput;                /** Notifications per second */
+  ic_stream_policy_level_e deepest;   /** Expected deepest level */
+  ic_stream_policy_level_e final;     /** Expected level at the end, NUM - any */
+}policy_phase_s;
+
+/* Full streams need 160 notifications/s, decimated ACC 144, vitals 132 and compressed EEG 68 */
+static const policy_phase_s m_phases[] = {
+  {"clean",     4,  400, IC_STREAM_POLICY_FULL,           IC_STREAM_POLICY_FULL},
+  {"slowed",    12, 152, IC_STREAM_POLICY_ACC_DECIMATED,  IC_STREAM_POLICY_LEVEL_NUM},
+  {"throttled", 8,  100, IC_STREAM_POLICY_EEG_COMPRESSED, IC_STREAM_POLICY_LEVEL_NUM},
+  {"recovered", 8,  400, IC_STREAM_POLICY_EEG_COMPRESSED, IC_STREAM_POLICY_FULL},
+};
+
+static const char *m_level_names[IC_STREAM_POLICY_LEVEL_NUM] = {
+  "full", "acc decimated", "ppg vitals", "eeg compressed"
+};
+
+static struct{
+  bool mux;                           /** Central subscribed to multiplexed stream */
+  bool volatile running;
+  uint32_t throughput;
+  uint32_t credits;                   /** Notifications per second times ticks, not sent yet */
+  uint8_t in_flight;
+  bool pending[2];                    /** EEG and ACC/PPG producers have frame to send */
+  uint8_t retries[2];
+  uint32_t sent[2];
+  uint32_t announcements;
+  uint8_t announced;                  /** Level of the last announcement */
+  uint32_t chain_errors;              /** Announcement not continuing the previous one */
+}m_link;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ble_iccs_tx_stats_t ble_iccs_get_tx_stats(){
+  ble_iccs_tx_stats_t _stats = {.capacity = POLICY_CAPACITY};
+
+  CRITICAL_REGION_ENTER();
+  _stats.in_flight = m_link.in_flight;
+  CRITICAL_REGION_EXIT();
+
+  return _stats;
+}
+
+static void m_announcement(const ic_stream_policy_frame_s *frame){
+  if(frame->type != IC_STREAM_POLICY_FRAME || frame->previous != m_link.announced
+      || frame->level >= IC_STREAM_POLICY_LEVEL_NUM)
+    ++m_link.chain_errors;
+
+  m_link.announced = frame->level;
+  ++m_link.announcements;
+}
+
+/**
+ * @brief SoftDevice notification, stream 0 and 1 are counted, 2 carries announcements only.
+ */
+static ic_return_val_e m_notify(int stream, const void *data, size_t len){
+  __auto_type _ret_val = IC_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  if(m_link.in_flight >= POLICY_CAPACITY){
+    _ret_val = IC_BUSY;
+  }
+  else{
+    ++m_link.in_flight;
+    if(stream < 2)
+      ++m_link.sent[stream];
+    else if(len == sizeof(ic_stream_policy_frame_s))
+      m_announcement(data);
+    else
+      ++m_link.chain_errors;
+  }
+  CRITICAL_REGION_EXIT();
+
+  return _ret_val;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_send_to_stream0(const uint8_t *data, size_t len, uint32_t *err){
+  UNUSED_PARAMETER(err);
+  return m_notify(0, data, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_send_to_stream1(const uint8_t *data, size_t len, uint32_t *err){
+  UNUSED_PARAMETER(err);
+  return m_notify(1, data, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ble_iccs_send_to_stream2(const uint8_t *data, size_t len, uint32_t *err){
+  UNUSED_PARAMETER(err);
+  return m_notify(2, data, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool ic_mux_active(void){
+  return m_link.mux;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+ic_return_val_e ic_mux_append(
+    ic_mux_record_e type,
+    uint32_t timestamp,
+    const void *data,
+    size_t len)
+{
+  UNUSED_PARAMETER(timestamp);
+
+  /* Every record takes a notification, packing of records is measured by mux_stream */
+  switch(type){
+    case IC_MUX_EEG:
+      return m_notify(0, data, len);
+    case IC_MUX_ACC_PPG:
+      return m_notify(1, data, len);
+    case IC_MUX_POLICY:
+      return m_notify(2, data, len);
+    default:
+      return IC_ERROR;
+  }
+}
+
+/**
+ * @brief TX_COMPLETE of connection interval. Packets which could have been sent when buffers were
+ * empty are lost, fraction of packet is kept.
+ */
+static void m_tx_complete(void){
+  CRITICAL_REGION_ENTER();
+  m_link.credits += m_link.throughput * POLICY_INTERVAL;
+  __auto_type _count = MIN(m_link.in_flight, m_link.credits / configTICK_RATE_HZ);
+  m_link.in_flight -= _count;
+  m_link.credits -= _count * configTICK_RATE_HZ;
+  if(m_link.in_flight == 0)
+    m_link.credits %= configTICK_RATE_HZ;
+  CRITICAL_REGION_EXIT();
+}
+
+static void m_produce(int stream){
+  m_link.pending[stream] = true;
+  m_link.retries[stream] = 0;
+}
+
+/**
+ * @brief Send pending frame of producer. Refused frame is tried again next tick, after
+ * @ref IC_STREAM_POLICY_MAX_RETRY retries it is dropped, like senders on target do.
+ */
+static void m_send(int stream){
+  uint8_t _frame[POLICY_FRAME_LEN] = {0};
+
+  if(!m_link.pending[stream])
+    return;
+
+  __auto_type _ret_val = m_link.mux ?
+    ic_mux_append(stream == 0 ? IC_MUX_EEG : IC_MUX_ACC_PPG, 0, _frame, sizeof(_frame)) :
+    stream == 0 ?
+      ble_iccs_send_to_stream0(_frame, sizeof(_frame), NULL) :
+      ble_iccs_send_to_stream1(_frame, sizeof(_frame), NULL);
+
+  if(_ret_val != IC_BUSY){
+    m_link.pending[stream] = false;
+    return;
+  }
+
+  ic_stream_policy_refused();
+  if(m_link.retries[stream]++ >= IC_STREAM_POLICY_MAX_RETRY){
+    ic_stream_policy_drop();
+    m_link.pending[stream] = false;
+  }
+}
+
+/**
+ * @brief Link and producers advance together tick by tick, so delays of host scheduler shift all
+ * of them and do not look like congestion.
+ */
+static void m_link_task(void *args){
+  UNUSED_PARAMETER(args);
+  __auto_type _wake = xTaskGetTickCount();
+  __auto_type _half = false;
+  uint8_t _tick_cnt = 0;
+
+  for(uint32_t _tick = 1; m_link.running; ++_tick){
+    vTaskDelayUntil(&_wake, 1);
+
+    if(_tick % POLICY_INTERVAL == 0)
+      m_tx_complete();
+
+    /* EEG frame every ADS tick, compressed frame carries two of them */
+    if(_tick % IC_ADS_TICK_PERIOD == 0){
+      _half = ic_stream_policy_level() >= IC_STREAM_POLICY_EEG_COMPRESSED && !_half;
+      if(!_half)
+        m_produce(0);
+    }
+
+    if(_tick % IC_STREAM1_TICK_PERIOD == 0 && ++_tick_cnt >= ic_stream_policy_acc_ppg_divider()){
+      _tick_cnt = 0;
+      m_produce(1);
+    }
+
+    m_send(0);
+    m_send(1);
+  }
+}
+
+static void m_ble_evt(uint16_t evt_id){
+  ble_evt_t _evt = {.header = {.evt_id = evt_id}};
+  ic_stream_policy_on_ble_evt(&_evt);
+}
+
+static int m_check(const char *mode, const char *what, uint32_t value, uint32_t expected){
+  __auto_type _ok = value == expected;
+
+  if(!_ok)
+    printf("  %s %s %u, expected %u  FAIL\n", mode, what, value, expected);
+  return _ok ? 0 : 1;
+}
+
+static int m_phase(const char *mode, const policy_phase_s *phase){
+  __auto_type _before = ic_stream_policy_get_stats();
+  uint32_t _sent[2];
+  ic_stream_policy_level_e _deepest = ic_stream_policy_level();
+
+  CRITICAL_REGION_ENTER();
+  m_link.throughput = phase->throughput;
+  memcpy(_sent, m_link.sent, sizeof(_sent));
+  CRITICAL_REGION_EXIT();
+
+  __auto_type _end = xTaskGetTickCount() + phase->seconds * configTICK_RATE_HZ;
+  while((int32_t)(xTaskGetTickCount() - _end) < 0){
+    vTaskDelay(POLICY_SAMPLE);
+    _deepest = MAX(_deepest, ic_stream_policy_level());
+  }
+
+  __auto_type _after = ic_stream_policy_get_stats();
+  __auto_type _level = ic_stream_policy_level();
+
+  printf("%-6s %-10s %6u %-15s %-15s %5u %4u %7.1f %7.1f %8u %6u\n",
+      mode, phase->name, phase->throughput,
+      m_level_names[_deepest], m_level_names[_level],
+      _after.step_downs - _before.step_downs, _after.step_ups - _before.step_ups,
+      (double)(m_link.sent[0] - _sent[0]) / phase->seconds,
+      (double)(m_link.sent[1] - _sent[1]) / phase->seconds,
+      _after.refused - _before.refused, _after.drops - _before.drops);
+
+  int _failed = m_check(mode, "deepest level", _deepest, phase->deepest);
+  if(phase->final != IC_STREAM_POLICY_LEVEL_NUM)
+    _failed += m_check(mode, "final level", _level, phase->final);
+  return _failed;
+}
+
+static int m_run(bool mux){
+  __auto_type _mode = mux ? "mux" : "stream";
+  TaskHandle_t _task;
+  int _failed = 0;
+
+  memset(&m_link, 0, sizeof(m_link));
+  m_link.mux = mux;
+  m_link.running = true;
+  m_ble_evt(BLE_GAP_EVT_CONNECTED);
+
+  if(xTaskCreate(m_link_task, "LINK", 256, NULL, 3, &_task) != pdPASS)
+    return 1;
+
+  for(int i = 0; i < sizeof(m_phases)/sizeof(m_phases[0]); ++i)
+    _failed += m_phase(_mode, &m_phases[i]);
+
+  m_link.running = false;
+  host_join(_task);
+
+  __auto_type _stats = ic_stream_policy_get_stats();
+  m_ble_evt(BLE_GAP_EVT_DISCONNECTED);
+
+  _failed += m_check(_mode, "announcements not continuing the previous one", m_link.chain_errors, 0);
+  _failed += m_check(_mode, "last announced level", m_link.announced, _stats.level);
+  _failed += m_check(_mode, "lost announcements", _stats.lost_announcements, 0);
+  return _failed;
+}
+
+int main(void){
+  int _failed = 0;
+
+  host_port_init();
+  host_tick_speed(POLICY_SPEED);
+  host_timer_daemon_start();
+
+  if(ic_stream_policy_init() != IC_SUCCESS)
+    return 1;
+
+  printf("%-6s %-10s %6s %-15s %-15s %5s %4s %7s %7s %8s %6s\n",
+      "mode", "phase", "link/s", "deepest", "final", "downs", "ups", "eeg/s", "acc/s",
+      "refused", "drops");
+
+  _failed += m_run(false);
+  _failed += m_run(true);
+
+  printf(_failed == 0 ? "PASS\n" : "FAIL\n");
+  return _failed == 0 ? 0 : 1;
+}